@@ -0,0 +1,241 @@
+#ifndef __TRIVIALDB_BENCH__
+#define __TRIVIALDB_BENCH__
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <functional>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/defs.h"
+
+/* The common part of the benchmarks. Each case runs `ops` operations
+ * and is timed as a whole, the best of `--repeat` runs is reported. The
+ * results are written as JSON, one object per case:
+ *
+ *   { "suite": "micro", "page_size": 4096, ..., "results": [
+ *     { "name": "int_btree.insert", "ops": 1000000, "seconds": 0.81,
+ *       "ns_per_op": 810.2, "ops_per_sec": 1234000.0 }, ... ] }
+ *
+ * so that two runs can be compared by name. */
+class bench_runner
+{
+	struct result_t
+	{
+		std::string name;
+		uint64_t ops;
+		double seconds;
+	};
+
+	const char *suite;
+	std::vector<result_t> results;
+	std::vector<std::pair<std::string, std::string>> params;
+	const char *filter, *out_path, *dir;
+	int repeat;
+	long long scale;
+	bool work_dir_made;
+	FILE *report;
+
+	static bool starts_with(const char *str, const char *prefix, const char **rest)
+	{
+		size_t len = std::strlen(prefix);
+		if(std::strncmp(str, prefix, len) != 0)
+			return false;
+		*rest = str + len;
+		return true;
+	}
+
+public:
+	typedef std::chrono::steady_clock clock;
+
+	bench_runner(const char *suite, long long default_scale)
+		: suite(suite), filter(nullptr), out_path(nullptr), dir(nullptr),
+		  repeat(1), scale(default_scale), work_dir_made(false), report(nullptr) {}
+
+	~bench_runner()
+	{
+		if(report && report != stdout)
+			std::fclose(report);
+	}
+
+	/* Parse the options common to the suites, the others (shown in the
+	 * usage as `extra_usage`) are left to `extra`, which returns false
+	 * for an unknown one. */
+	bool parse_args(int argc, char *argv[], const char *scale_name,
+		const char *extra_usage = "", std::function<bool(const char*)> extra = nullptr)
+	{
+		std::string scale_opt = std::string("--") + scale_name + "=";
+		for(int i = 1; i < argc; ++i)
+		{
+			const char *val;
+			if(starts_with(argv[i], "--filter=", &val)) {
+				filter = val;
+			} else if(starts_with(argv[i], "--out=", &val)) {
+				out_path = val;
+			} else if(starts_with(argv[i], "--dir=", &val)) {
+				dir = val;
+			} else if(starts_with(argv[i], "--repeat=", &val)) {
+				repeat = std::atoi(val);
+			} else if(starts_with(argv[i], scale_opt.c_str(), &val)) {
+				scale = std::atoll(val);
+			} else if(!extra || !extra(argv[i])) {
+				std::fprintf(stderr, "Usage: %s [--%s=N] [--repeat=N] [--filter=NAME] "
+					"[--out=FILE] [--dir=DIR]%s\n", argv[0], scale_name, extra_usage);
+				return false;
+			}
+		}
+
+		if(repeat <= 0 || scale <= 0)
+		{
+			std::fprintf(stderr, "[Error] --repeat and --%s must be positive.\n", scale_name);
+			return false;
+		}
+
+		add_param(scale_name, std::to_string(scale));
+		return true;
+	}
+
+	/* Open the report and go to the directory the files are made in,
+	 * a new one under /tmp unless given by `--dir`. With `mute_stdout`,
+	 * what else is printed to stdout goes to /dev/null. */
+	bool start(bool mute_stdout = false)
+	{
+		if(out_path)
+			report = std::fopen(out_path, "w");
+		else if(mute_stdout)
+			report = fdopen(dup(fileno(stdout)), "w");
+		else report = stdout;
+
+		if(mute_stdout && !std::freopen("/dev/null", "w", stdout))
+			return false;
+
+		if(!report)
+		{
+			std::fprintf(stderr, "[Error] Cannot open `%s`.\n", out_path ? out_path : "stdout");
+			return false;
+		}
+
+		static char tmp_dir[] = "/tmp/trivialdb_bench_XXXXXX";
+		if(!dir)
+		{
+			dir = mkdtemp(tmp_dir);
+			work_dir_made = dir != nullptr;
+		} else {
+			mkdir(dir, 0755);
+		}
+
+		if(!dir || chdir(dir) != 0)
+		{
+			std::fprintf(stderr, "[Error] Cannot use the directory `%s`.\n", dir ? dir : tmp_dir);
+			return false;
+		}
+
+		return true;
+	}
+
+	long long get_scale() const { return scale; }
+	bool is_work_dir_made() const { return work_dir_made; }
+	const char *get_dir() const { return dir; }
+	FILE *get_report() const { return report; }
+
+	void add_param(const std::string &name, const std::string &value)
+	{
+		params.emplace_back(name, value);
+	}
+
+	bool selected(const char *name) const
+	{
+		return !filter || std::strstr(name, filter);
+	}
+
+	/* Run case `name` of `ops` operations: `setup` (untimed) then `body`
+	 * (timed), `repeat` times. */
+	void run(const char *name, uint64_t ops,
+		std::function<void()> setup, std::function<void()> body)
+	{
+		if(!selected(name))
+			return;
+
+		double best = 0;
+		for(int r = 0; r != repeat; ++r)
+		{
+			if(setup) setup();
+			auto start = clock::now();
+			body();
+			double sec = std::chrono::duration<double>(clock::now() - start).count();
+			if(r == 0 || sec < best)
+				best = sec;
+		}
+
+		results.push_back({ name, ops, best });
+		std::fprintf(stderr, "%-28s %12llu ops %10.3f s %12.1f ns/op\n", name,
+			(unsigned long long)ops, best, ops ? best * 1e9 / ops : 0.0);
+	}
+
+	/* remove the files made, if in a directory of our own */
+	void clean_up()
+	{
+		if(!work_dir_made)
+			return;
+		DIR *d = opendir(".");
+		for(dirent *e; d && (e = readdir(d)); )
+		{
+			if(std::strcmp(e->d_name, ".") && std::strcmp(e->d_name, ".."))
+				unlink(e->d_name);
+		}
+
+		if(d) closedir(d);
+		if(chdir("/") == 0)
+			rmdir(dir);
+	}
+
+	void write_report()
+	{
+		std::fprintf(report, "{\n  \"suite\": \"%s\",\n", suite);
+		std::fprintf(report, "  \"page_size\": %d,\n", PAGE_SIZE);
+		std::fprintf(report, "  \"repeat\": %d,\n", repeat);
+		for(auto &p : params)
+			std::fprintf(report, "  \"%s\": \"%s\",\n", p.first.c_str(), p.second.c_str());
+		std::fprintf(report, "  \"results\": [");
+		for(size_t i = 0; i != results.size(); ++i)
+		{
+			const result_t &r = results[i];
+			double ns = r.ops ? r.seconds * 1e9 / r.ops : 0;
+			double ops_sec = r.seconds > 0 ? r.ops / r.seconds : 0;
+			std::fprintf(report, "%s\n    { \"name\": \"%s\", \"ops\": %llu, \"seconds\": %.6f, "
+				"\"ns_per_op\": %.1f, \"ops_per_sec\": %.1f }", i ? "," : "",
+				r.name.c_str(), (unsigned long long)r.ops, r.seconds, ns, ops_sec);
+		}
+
+		std::fprintf(report, "\n  ]\n}\n");
+		std::fflush(report);
+	}
+};
+
+/* the results of the cases are added to it, so the work is not
+ * optimized away */
+static volatile long long bench_sink;
+
+/* xorshift, the same sequence on every platform */
+class bench_random
+{
+	uint64_t state;
+public:
+	bench_random(uint64_t seed = 88172645463325252ull) : state(seed) {}
+	uint64_t next()
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	int uniform(int n) { return (int)(next() % (uint64_t)n); }
+};
+
+#endif
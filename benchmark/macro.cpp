@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include "bench.h"
+#include "../src/fs/page_fs.h"
+#include "../src/parser/execute.h"
+
+extern "C" char run_statements(const char *input);
+
+/* The macro-benchmarks: workloads run through SQL as a client would,
+ * on the tables
+ *
+ *   bench_t (ID int PRIMARY KEY, A int, B int, C float, S varchar(32))
+ *   bench_u (ID int PRIMARY KEY, V int, W int)
+ *   bench_v (ID int PRIMARY KEY, X int)
+ *
+ * of `--rows` rows, a tenth and a hundredth of it. bench_t.A refers to
+ * bench_u.ID and bench_u.W to bench_v.ID, bench_t.B takes 100 values.
+ * The time of a case includes making its SQL text, which is small next
+ * to running it. The rows selected go to /dev/null. */
+
+static const int INSERT_ROWS_PER_STMT = 1000;
+static const int STMTS_PER_RUN = 1000;
+
+static bool run_sql(const std::string &sql)
+{
+	if(run_statements(sql.c_str()) == 0)
+		return true;
+	std::fprintf(stderr, "[Error] Benchmark statement failed: %.200s\n", sql.c_str());
+	return false;
+}
+
+/* the rows of the tables, `make_row` appends row `i` to the text */
+template<typename RowMaker>
+static void insert_rows(const char *table, long long rows, RowMaker make_row)
+{
+	std::string sql;
+	char buf[160];
+	for(long long i = 0; i < rows; )
+	{
+		sql = "INSERT INTO ";
+		sql += table;
+		sql += " VALUES ";
+		for(int k = 0; k != INSERT_ROWS_PER_STMT && i < rows; ++k, ++i)
+		{
+			if(k) sql += ',';
+			make_row(buf, sizeof(buf), i);
+			sql += buf;
+		}
+
+		sql += ';';
+		if(!run_sql(sql))
+			return;
+	}
+}
+
+static void create_tables(long long rows)
+{
+	run_sql("CREATE TABLE bench_t (ID int PRIMARY KEY, A int, B int, C float, S varchar(32));"
+		"CREATE TABLE bench_u (ID int PRIMARY KEY, V int, W int);"
+		"CREATE TABLE bench_v (ID int PRIMARY KEY, X int);");
+	long long u_rows = std::max(1LL, rows / 10), v_rows = std::max(1LL, rows / 100);
+	bench_random rnd(11);
+	insert_rows("bench_v", v_rows, [&](char *buf, size_t size, long long i) {
+		std::snprintf(buf, size, "(%lld,%d)", i, rnd.uniform(1000));
+	} );
+
+	insert_rows("bench_u", u_rows, [&](char *buf, size_t size, long long i) {
+		std::snprintf(buf, size, "(%lld,%d,%d)", i, rnd.uniform(1000), rnd.uniform(v_rows));
+	} );
+}
+
+static void load_bench_t(long long rows)
+{
+	long long u_rows = std::max(1LL, rows / 10);
+	bench_random rnd(12);
+	insert_rows("bench_t", rows, [&](char *buf, size_t size, long long i) {
+		std::snprintf(buf, size, "(%lld,%d,%d,%.4f,'row%lld')",
+			i, rnd.uniform(u_rows), (int)(i % 100), rnd.uniform(10000) / 10000.0, i);
+	} );
+}
+
+/* `num` statements made by `make_stmt`, run STMTS_PER_RUN at a time */
+template<typename StmtMaker>
+static void run_many(long long num, StmtMaker make_stmt)
+{
+	std::string sql;
+	char buf[256];
+	for(long long i = 0; i < num; )
+	{
+		sql.clear();
+		for(int k = 0; k != STMTS_PER_RUN && i < num; ++k, ++i)
+		{
+			make_stmt(buf, sizeof(buf), i);
+			sql += buf;
+		}
+
+		if(!run_sql(sql))
+			return;
+	}
+}
+
+/* parse a size such as `64M` or `1G` into bytes, as `--buffer-pool` of
+ * trivial_db does */
+static long long parse_size(const char *str)
+{
+	char *end;
+	long long size = std::strtoll(str, &end, 10);
+	switch(*end)
+	{
+		case 'g': case 'G': size <<= 10; // fall through
+		case 'm': case 'M': size <<= 10; // fall through
+		case 'k': case 'K': size <<= 10; ++end; break;
+		default: break;
+	}
+
+	return *end ? -1 : size;
+}
+
+int main(int argc, char *argv[])
+{
+	bench_runner runner("macro", 1000000);
+	long long pool_size = 0;
+	bool wal = PAGE_WAL_DEFAULT;
+	bool ok = runner.parse_args(argc, argv, "rows", " [--buffer-pool=SIZE] [--wal=on|off]",
+		[&](const char *arg) {
+		if(std::strncmp(arg, "--buffer-pool=", 14) == 0)
+			return (pool_size = parse_size(arg + 14)) >= PAGE_SIZE;
+		if(std::strcmp(arg, "--wal=on") == 0 || std::strcmp(arg, "--wal=off") == 0)
+		{
+			wal = arg[6] == 'n';
+			return true;
+		}
+
+		return false;
+	} );
+
+	if(!ok || !runner.start(true))
+		return 1;
+
+	page_fs *fs = page_fs::get_instance();
+	if((pool_size && !fs->resize(pool_size / PAGE_SIZE)) || !fs->set_wal(wal))
+		return 1;
+	runner.add_param("buffer_pool_pages", std::to_string(fs->get_capacity()));
+	runner.add_param("wal", wal ? "on" : "off");
+
+	long long rows = runner.get_scale();
+	long long queries = std::min(rows, 100000LL);
+	long long ranges = std::min(std::max(1LL, rows / 1000), 1000LL);
+	bench_random rnd(13);
+	run_sql("CREATE DATABASE bench; USE bench;");
+
+	bool loaded = false;
+	auto reload = [&]() {
+		if(loaded)
+			run_sql("DROP TABLE bench_t; DROP TABLE bench_u; DROP TABLE bench_v;");
+		create_tables(rows);
+		loaded = true;
+	};
+
+	runner.run("bulk_insert", rows, reload, [&]() { load_bench_t(rows); });
+	if(!loaded)
+	{
+		reload();
+		load_bench_t(rows);
+	}
+
+	runner.run("point_select", queries, nullptr, [&]() {
+		run_many(queries, [&](char *buf, size_t size, long long) {
+			std::snprintf(buf, size, "SELECT A, S FROM bench_t WHERE ID = %d;", rnd.uniform(rows));
+		} );
+	} );
+
+	runner.run("range_scan", ranges * 1000, nullptr, [&]() {
+		run_many(ranges, [&](char *buf, size_t size, long long) {
+			int lo = rnd.uniform(std::max(1LL, rows - 1000));
+			std::snprintf(buf, size, "SELECT COUNT(*), SUM(A) FROM bench_t "
+				"WHERE ID >= %d AND ID < %d;", lo, lo + 1000);
+		} );
+	} );
+
+	runner.run("full_scan", rows, nullptr, [&]() {
+		run_sql("SELECT COUNT(*) FROM bench_t WHERE C > 0.5;");
+	} );
+
+	runner.run("join2", rows, nullptr, [&]() {
+		run_sql("SELECT COUNT(*) FROM bench_t, bench_u WHERE bench_t.A = bench_u.ID;");
+	} );
+
+	runner.run("join3", rows, nullptr, [&]() {
+		run_sql("SELECT COUNT(*) FROM bench_t, bench_u, bench_v "
+			"WHERE bench_t.A = bench_u.ID AND bench_u.W = bench_v.ID;");
+	} );
+
+	runner.run("aggregate", rows, nullptr, [&]() {
+		run_sql("SELECT COUNT(*), SUM(A), MIN(C), MAX(C) FROM bench_t;");
+	} );
+
+	runner.run("group_by", rows, nullptr, [&]() {
+		run_sql("SELECT B, COUNT(*), SUM(A), AVG(C) FROM bench_t GROUP BY B;");
+	} );
+
+	execute_quit();
+	runner.write_report();
+	runner.clean_up();
+	return 0;
+}
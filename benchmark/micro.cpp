@@ -0,0 +1,327 @@
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "bench.h"
+#include "../src/btree/btree.h"
+#include "../src/page/variant_page.h"
+#include "../src/fs/page_fs.h"
+#include "../src/expression/expression.h"
+#include "../src/utils/comparer.h"
+#include "../src/utils/like_matcher.h"
+
+/* The micro-benchmarks: the B-trees, the variant page, the page cache,
+ * expressions and LIKE, each run directly without the SQL layer. The
+ * scale is the number of operations of each case. */
+
+static std::vector<int> shuffled_keys(int n, uint64_t seed)
+{
+	std::vector<int> keys(n);
+	for(int i = 0; i != n; ++i)
+		keys[i] = i;
+	bench_random rnd(seed);
+	for(int i = n - 1; i > 0; --i)
+		std::swap(keys[i], keys[rnd.uniform(i + 1)]);
+	return keys;
+}
+
+static void bench_int_btree(bench_runner &runner, int n)
+{
+	std::vector<int> keys = shuffled_keys(n, 1), probes = shuffled_keys(n, 2);
+	std::unique_ptr<pager> pg;
+	std::unique_ptr<int_btree> tree;
+	auto fresh = [&]() {
+		tree.reset();
+		pg.reset();
+		unlink("int_btree.tdata");
+		pg.reset(new pager("int_btree.tdata"));
+		tree.reset(new int_btree(pg.get()));
+	};
+
+	auto fill = [&]() {
+		fresh();
+		for(int k : keys)
+			tree->insert(k, (const char*)&k, sizeof(int));
+	};
+
+	runner.run("int_btree.insert", n, fresh, [&]() {
+		for(int k : keys)
+			tree->insert(k, (const char*)&k, sizeof(int));
+	} );
+
+	if(!tree && runner.selected("int_btree.lower_bound")) fill();
+	runner.run("int_btree.lower_bound", n, nullptr, [&]() {
+		int found = 0;
+		for(int k : probes)
+			found += tree->lower_bound(k).first != 0;
+		if(found != n) std::fprintf(stderr, "[Error] int_btree.lower_bound: %d found.\n", found);
+	} );
+
+	runner.run("int_btree.erase", n, fill, [&]() {
+		for(int k : probes)
+			tree->erase(k);
+	} );
+
+	tree.reset();
+	pg.reset();
+	unlink("int_btree.tdata");
+}
+
+static void bench_index_btree(bench_runner &runner, int n)
+{
+	// the entries of an index of INT: [rid, nullmark, key]
+	const int entry_size = sizeof(int) * 2 + 1;
+	std::vector<int> keys = shuffled_keys(n, 3), probes = shuffled_keys(n, 4);
+	auto make_entry = [](char *buf, int key) {
+		*(int*)buf = key;
+		buf[4] = 0;
+		std::memcpy(buf + 5, &key, sizeof(int));
+	};
+
+	std::unique_ptr<pager> pg;
+	std::unique_ptr<index_btree> tree;
+	auto fresh = [&]() {
+		tree.reset();
+		pg.reset();
+		unlink("index_btree.tdata");
+		pg.reset(new pager("index_btree.tdata"));
+		tree.reset(new typed_index_btree<__impl::int_data_comparer>(pg.get(), 0, entry_size));
+	};
+
+	auto insert_all = [&]() {
+		char buf[entry_size];
+		for(int k : keys)
+		{
+			make_entry(buf, k);
+			tree->insert(buf, entry_size);
+		}
+	};
+
+	auto fill = [&]() { fresh(); insert_all(); };
+
+	runner.run("index_btree.insert", n, fresh, insert_all);
+	if(!tree && runner.selected("index_btree.lower_bound")) fill();
+	runner.run("index_btree.lower_bound", n, nullptr, [&]() {
+		char buf[entry_size];
+		int found = 0;
+		for(int k : probes)
+		{
+			make_entry(buf, k);
+			found += tree->lower_bound(buf).first != 0;
+		}
+
+		if(found != n) std::fprintf(stderr, "[Error] index_btree.lower_bound: %d found.\n", found);
+	} );
+
+	runner.run("index_btree.erase", n, fill, [&]() {
+		char buf[entry_size];
+		for(int k : probes)
+		{
+			make_entry(buf, k);
+			tree->erase(buf);
+		}
+	} );
+
+	tree.reset();
+	pg.reset();
+	unlink("index_btree.tdata");
+}
+
+static void bench_variant_page(bench_runner &runner, int n)
+{
+	unlink("variant_page.tdata");
+	pager pg("variant_page.tdata");
+	int pid = pg.new_page();
+	char data[PAGE_BLOCK_MAX_SIZE];
+	std::memset(data, 'v', sizeof(data));
+
+	// records of 16 to 143 bytes inserted at random positions until full
+	runner.run("variant_page.insert", n, nullptr, [&]() {
+		bench_random rnd(5);
+		variant_page page(pg.read_for_write(pid), &pg);
+		page.init();
+		for(int i = 0; i != n; ++i)
+		{
+			int size = 16 + rnd.uniform(128);
+			if(!page.insert(rnd.uniform(page.size() + 1), data, size))
+			{
+				page.init();
+				page.insert(0, data, size);
+			}
+		}
+	} );
+
+	// a full page split in two, the upper half is freed again
+	int splits = std::max(1, n / 64);
+	runner.run("variant_page.split", splits, nullptr, [&]() {
+		bench_random rnd(6);
+		for(int i = 0; i != splits; ++i)
+		{
+			variant_page page(pg.read_for_write(pid), &pg);
+			page.init();
+			while(page.insert(page.size(), data, 16 + rnd.uniform(128)));
+			auto upper = page.split(pid);
+			if(upper.first) pg.free_page(upper.first);
+		}
+	} );
+
+	pg.close();
+	unlink("variant_page.tdata");
+}
+
+static void bench_page_fs(bench_runner &runner, int n)
+{
+	page_fs *fs = page_fs::get_instance();
+	int old_capacity = fs->get_capacity();
+	unlink("page_fs.tdata");
+	pager pg("page_fs.tdata");
+
+	// pages that fit in the cache are read again and again
+	const int hot_pages = std::min(1024, old_capacity / 2);
+	std::vector<int> pids;
+	for(int i = 0; i != hot_pages; ++i)
+	{
+		int pid = pg.new_page();
+		std::memset(pg.read_for_write(pid), i, PAGE_SIZE);
+		pids.push_back(pid);
+	}
+
+	pg.flush();
+	runner.run("page_fs.hit", n, [&]() {
+		for(int pid : pids) pg.read(pid);
+	}, [&]() {
+		bench_random rnd(7);
+		unsigned sum = 0;
+		for(int i = 0; i != n; ++i)
+			sum += pg.read(pids[rnd.uniform(hot_pages)])[8];
+		bench_sink += sum;
+	} );
+
+	// the file is 16 times the cache made as small as it can be
+	fs->resize(PAGE_CACHE_SHARD_NUM * PAGE_CACHE_MIN_SHARD_CAPACITY);
+	int cold_pages = fs->get_capacity() * 16;
+	while((int)pids.size() < cold_pages)
+	{
+		int pid = pg.new_page();
+		std::memset(pg.read_for_write(pid), pid, PAGE_SIZE);
+		pids.push_back(pid);
+	}
+
+	pg.flush();
+	runner.run("page_fs.miss", n, nullptr, [&]() {
+		bench_random rnd(8);
+		unsigned sum = 0;
+		for(int i = 0; i != n; ++i)
+			sum += pg.read(pids[rnd.uniform(cold_pages)])[8];
+		bench_sink += sum;
+	} );
+
+	pg.close();
+	fs->resize(old_capacity);
+	unlink("page_fs.tdata");
+}
+
+static expr_node_t *term_int(std::vector<expr_node_t> &pool, int v)
+{
+	pool.emplace_back();
+	expr_node_t *e = &pool.back();
+	std::memset(e, 0, sizeof(*e));
+	e->term_type = TERM_INT;
+	e->val_i = v;
+	return e;
+}
+
+static expr_node_t *term_string(std::vector<expr_node_t> &pool, const char *s)
+{
+	pool.emplace_back();
+	expr_node_t *e = &pool.back();
+	std::memset(e, 0, sizeof(*e));
+	e->term_type = TERM_STRING;
+	e->val_s = const_cast<char*>(s);
+	return e;
+}
+
+static expr_node_t *op(std::vector<expr_node_t> &pool, operator_type_t o, expr_node_t *l, expr_node_t *r)
+{
+	pool.emplace_back();
+	expr_node_t *e = &pool.back();
+	std::memset(e, 0, sizeof(*e));
+	e->op = o;
+	e->left = l;
+	e->right = r;
+	return e;
+}
+
+static void bench_expression(bench_runner &runner, int n)
+{
+	// (7 + 3) * 2 > 10 AND 'abcdef' LIKE 'abc%' AND 5 <> 6
+	std::vector<expr_node_t> pool;
+	pool.reserve(32);
+	expr_node_t *arith = op(pool, OPERATOR_GT,
+		op(pool, OPERATOR_MUL, op(pool, OPERATOR_ADD, term_int(pool, 7), term_int(pool, 3)),
+			term_int(pool, 2)), term_int(pool, 10));
+	expr_node_t *like = op(pool, OPERATOR_LIKE, term_string(pool, "abcdef"), term_string(pool, "abc%"));
+	expr_node_t *expr = op(pool, OPERATOR_AND, op(pool, OPERATOR_AND, arith, like),
+		op(pool, OPERATOR_NEQ, term_int(pool, 5), term_int(pool, 6)));
+
+	runner.run("expression.eval", n, nullptr, [&]() {
+		int t = 0;
+		for(int i = 0; i != n; ++i)
+			t += expression::eval(expr).val_b;
+		if(t != n) std::fprintf(stderr, "[Error] expression.eval is false.\n");
+	} );
+
+	runner.run("compiled_expression.eval", n, nullptr, [&]() {
+		compiled_expression program(expr);
+		int t = 0;
+		for(int i = 0; i != n; ++i)
+			t += program.eval().val_b;
+		if(t != n) std::fprintf(stderr, "[Error] compiled_expression.eval is false.\n");
+	} );
+}
+
+static void bench_strlike(bench_runner &runner, int n)
+{
+	static const char *strings[] = {
+		"trivial database", "page cache of the database", "b-tree split root",
+		"write-ahead log", "the column store of analytic tables", "abc"
+	};
+
+	const int num = sizeof(strings) / sizeof(*strings);
+	runner.run("strlike", n, nullptr, [&]() {
+		int t = 0;
+		for(int i = 0; i != n; ++i)
+			t += strlike(strings[i % num], "%data_ase%");
+		bench_sink += t;
+	} );
+
+	runner.run("like_matcher.match", n, nullptr, [&]() {
+		like_matcher matcher("%data_ase%");
+		int t = 0;
+		for(int i = 0; i != n; ++i)
+			t += matcher.match(strings[i % num]);
+		bench_sink += t;
+	} );
+}
+
+int main(int argc, char *argv[])
+{
+	bench_runner runner("micro", 1000000);
+	if(!runner.parse_args(argc, argv, "ops") || !runner.start())
+		return 1;
+
+	// the pages are not logged, it is the cache which is measured
+	page_fs::get_instance()->set_wal(false);
+	int n = (int)runner.get_scale();
+	bench_int_btree(runner, n);
+	bench_index_btree(runner, n);
+	bench_variant_page(runner, n);
+	bench_page_fs(runner, n);
+	bench_expression(runner, n);
+	bench_strlike(runner, n);
+
+	runner.write_report();
+	runner.clean_up();
+	return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef __TRIVIALDB_ALGO_EXTERNAL_SORT__
+#define __TRIVIALDB_ALGO_EXTERNAL_SORT__
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <queue>
+#include <algorithm>
+
+/* Sort fixed-size records which may not fit in memory. Records are
+ * sorted in runs of at most `memory` bytes, each run is written to a
+ * temporary file, and the runs are merged when they are read back.
+ * `compare(a, b)` returns a negative number if a < b. */
+template<typename Comparer>
+class external_sorter
+{
+	int record_size;
+	size_t run_records;
+	Comparer compare;
+	std::vector<char> buffer;
+	std::vector<std::FILE*> runs;
+
+	/* sort the records in `buffer`, and return pointers to them */
+	std::vector<const char*> sort_buffer()
+	{
+		std::vector<const char*> order;
+		order.reserve(buffer.size() / record_size);
+		for(size_t i = 0; i < buffer.size(); i += record_size)
+			order.push_back(buffer.data() + i);
+		std::stable_sort(order.begin(), order.end(), [this](const char *a, const char *b) {
+			return compare(a, b) < 0;
+		} );
+		return order;
+	}
+
+	void write_run()
+	{
+		std::FILE *f = std::tmpfile();
+		if(!f)
+		{
+			// keep the run in memory then
+			std::fprintf(stderr, "[Warning] Fail to create a temporary file for sorting.\n");
+			run_records *= 2;
+			return;
+		}
+
+		for(const char *rec : sort_buffer())
+			std::fwrite(rec, record_size, 1, f);
+		std::rewind(f);
+		runs.push_back(f);
+		buffer.clear();
+	}
+
+public:
+	external_sorter(int record_size, size_t memory, Comparer compare)
+		: record_size(record_size), compare(compare)
+	{
+		run_records = std::max<size_t>(memory / record_size, 1);
+	}
+
+	~external_sorter()
+	{
+		for(std::FILE *f : runs)
+			std::fclose(f);
+	}
+
+	void add(const char *record)
+	{
+		buffer.insert(buffer.end(), record, record + record_size);
+		if(buffer.size() >= run_records * record_size)
+			write_run();
+	}
+
+	/* Call `callback` with each record in ascending order, the records
+	 * are consumed, so it can be called only once. */
+	template<typename Callback>
+	void for_each(Callback callback)
+	{
+		if(runs.empty())
+		{
+			for(const char *rec : sort_buffer())
+				callback(rec);
+			buffer.clear();
+			return;
+		}
+
+		if(!buffer.empty())
+			write_run();
+
+		// merge the runs with a heap of their first records
+		int num = (int)runs.size();
+		std::vector<char> heads((size_t)num * record_size);
+		auto head = [&](int i) { return heads.data() + (size_t)i * record_size; };
+		auto greater = [&](int a, int b) { return compare(head(a), head(b)) > 0; };
+		std::priority_queue<int, std::vector<int>, decltype(greater)> heap(greater);
+		for(int i = 0; i != num; ++i)
+		{
+			if(std::fread(head(i), record_size, 1, runs[i]) == 1)
+				heap.push(i);
+		}
+
+		while(!heap.empty())
+		{
+			int i = heap.top();
+			heap.pop();
+			callback((const char*)head(i));
+			if(std::fread(head(i), record_size, 1, runs[i]) == 1)
+				heap.push(i);
+		}
+	}
+};
+
+#endif
@@ -38,4 +38,23 @@ int upper_bound(int lo, int hi, Predicator p)
 	return !p(lo) ? lmost - 1 : lo;
 }
 
+/* the number of elements of the sorted array less than `key`, the
+ * loop has no branch but its bound, so it is not slowed down by the
+ * mispredictions of a binary search */
+template<typename T>
+int branchless_lower_bound(const T *arr, int n, const T &key)
+{
+	if(n == 0) return 0;
+
+	const T *base = arr;
+	while(n > 1)
+	{
+		int half = n >> 1;
+		base = base[half] < key ? base + half : base;
+		n -= half;
+	}
+
+	return (base - arr) + (*base < key);
+}
+
 #endif
@@ -1,12 +1,30 @@
 #include "btree.h"
 #include "../algo/search.h"
+#include "../utils/exec_stats.h"
+
+/* the position of the first key of the page not less than `key` */
+template<typename Page, typename Key, typename Comparer>
+static int page_lower_bound(Page &page, Key key, const Comparer &compare)
+{
+	return ::lower_bound(0, page.size(), [&](int id) {
+		return compare(page.get_key(id), key) < 0;
+	} );
+}
+
+/* the keys of an interior page of int keys are an array in order */
+static int page_lower_bound(fixed_page<int> &page, int key, const int_key_comparer &)
+{
+	return branchless_lower_bound(
+		reinterpret_cast<const int*>(page.begin()), page.size(), key);
+}
 
 template<typename KeyType, typename Comparer, typename Copier>
 btree<KeyType, Comparer, Copier>::btree(
 		pager *pg, int root_page_id, int field_size,
 		Comparer compare, Copier copier)
 	: pg(pg), root_page_id(root_page_id),
-	  field_size(field_size), compare(compare), copy_to_temp(copier)
+	  field_size(field_size), compare(compare), copy_to_temp(copier),
+	  bulk_fill_factor(BTREE_BULK_FILL_FACTOR), hint_leaf(0)
 {
 	if(root_page_id == 0)
 	{
@@ -34,23 +52,108 @@ inline void btree<KeyType, Comparer, Copier>::insert_split_root(insert_ret ret)
 	}
 }
 
+/* Split off an empty page after the rightmost page of a level instead
+ * of moving half of it, when an element is appended to it. So ascending
+ * inserts (e.g. of row ids) leave full pages rather than half empty. */
+template<typename KeyType, typename Comparer, typename Copier>
+template<typename Page>
+std::pair<int, Page> btree<KeyType, Comparer, Copier>::split_for_append(int cur_id, Page page)
+{
+	int page_id = pg->new_page(cur_id);
+	Page upper_page { pg->read_for_write(page_id), pg };
+	upper_page.init(field_size);
+	upper_page.prev_page_ref() = cur_id;
+	page.next_page_ref() = page_id;
+	return { page_id, upper_page };
+}
+
 template<typename KeyType, typename Comparer, typename Copier>
 void btree<KeyType, Comparer, Copier>::insert(
 		key_t key, const char *data, int data_size)
 {
-	char *addr = pg->read_for_write(root_page_id);
+	hint_leaf = 0;
+	++thread_stats().btree_descents;
+	// each page on the path is pinned until its parent is updated
+	page_pin root { pg, root_page_id, true };
+	char *addr = root.get();
 	uint16_t magic = general_page::get_magic_number(addr);
 	if(magic == PAGE_FIXED)
 	{
 		insert_ret ret = insert_interior(
 			root_page_id, addr, key, data, data_size);
-		insert_split_root<interior_page>(ret);
+		insert_split_root<interior_page>(std::move(ret));
 	} else {
 		assert(magic == PAGE_VARIANT || magic == PAGE_INDEX_LEAF);
 		insert_ret ret = insert_leaf(
 			root_page_id, addr, key, data, data_size);
-		insert_split_root<leaf_page>(ret);
+		insert_split_root<leaf_page>(std::move(ret));
+	}
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+void btree<KeyType, Comparer, Copier>::insert_sorted(
+		key_t key, const char *data, int data_size)
+{
+	if(!hint_leaf)
+		insert_sorted_locate(key);
+	if(!insert_sorted_hinted(key, data, data_size))
+		insert(key, data, data_size);
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+void btree<KeyType, Comparer, Copier>::insert_sorted_locate(key_t key)
+{
+	hint_path.clear();
+	++thread_stats().btree_descents;
+	int now = root_page_id;
+	char *addr = pg->read(now);
+	while(general_page::get_magic_number(addr) == PAGE_FIXED)
+	{
+		interior_page page { addr, pg };
+		int ch_pos = page_lower_bound(page, key, compare);
+
+		ch_pos = std::min(page.size() - 1, ch_pos);
+		hint_path.push_back({ now, ch_pos });
+		now = page.get_child(ch_pos);
+		addr = pg->read(now);
+	}
+
+	hint_leaf = now;
+}
+
+/* Insert into the remembered leaf, returns false if the element belongs
+ * to another leaf or the leaf has to be split. */
+template<typename KeyType, typename Comparer, typename Copier>
+bool btree<KeyType, Comparer, Copier>::insert_sorted_hinted(
+		key_t key, const char *data, int data_size)
+{
+	// pinned, the element may take overflow pages
+	page_pin leaf { pg, hint_leaf };
+	leaf_page page { leaf.get(), pg };
+	assert(page.magic() == PAGE_VARIANT || page.magic() == PAGE_INDEX_LEAF);
+	int size = page.size();
+	if(size == 0 ? !hint_path.empty() : compare(key, page.get_key(0)) < 0)
+		return false;
+
+	// only the rightmost leaf takes elements larger than all of it
+	bool largest = size == 0 || compare(page.get_key(size - 1), key) < 0;
+	if(largest && page.next_page())
+		return false;
+
+	int pos = largest ? size : page_lower_bound(page, key, compare);
+
+	pg->mark_dirty(hint_leaf);
+	if(!page.insert(pos, data, data_size))
+		return false;
+
+	if(largest)
+	{
+		// the pages above are the rightmost ones, whose keys are the largest
+		for(auto it = hint_path.rbegin(); it != hint_path.rend(); ++it)
+			interior_page { pg->read_for_write(it->first), pg }.set_key(it->second, key);
 	}
+
+	return true;
 }
 
 template<typename KeyType, typename Comparer, typename Copier>
@@ -71,10 +174,12 @@ btree<KeyType, Comparer, Copier>::insert_post_process(
 		bool succ_ins = page.insert(ch_pos + 1, ch_largest, ch_ret.upper_pid);
 		if(!succ_ins)
 		{
-			auto upper = page.split(pid);
+			bool append = ch_pos + 1 == page.size() && !page.next_page();
+			auto upper = append ? split_for_append(pid, page) : page.split(pid);
+			ret.upper = page_pin { pg, upper.first, true };
 			Page upper_page = upper.second;
 			Page lower_page = page;
-			if(ch_pos < lower_page.size())
+			if(!append && ch_pos < lower_page.size())
 			{
 				succ_ins = lower_page.insert(
 					ch_pos + 1, ch_largest, ch_ret.upper_pid);
@@ -87,6 +192,7 @@ btree<KeyType, Comparer, Copier>::insert_post_process(
 				assert(succ_ins);
 			}
 
+			++thread_stats().btree_splits;
 			ret.split = true;
 			ret.lower_half = lower_page.buf;
 			ret.upper_half = upper_page.buf;
@@ -107,28 +213,27 @@ btree<KeyType, Comparer, Copier>::insert_interior(
 {
 	interior_page page { addr, pg };
 
-	int ch_pos = ::lower_bound(0, page.size(), [&](int id) {
-		return compare(page.get_key(id), key) < 0;
-	} );
+	int ch_pos = page_lower_bound(page, key, compare);
 
 	ch_pos = std::min(page.size() - 1, ch_pos);
 
 	int ch_pid = page.get_child(ch_pos);
-	char *ch_addr = pg->read_for_write(ch_pid);
+	page_pin ch { pg, ch_pid, true };
+	char *ch_addr = ch.get();
 	uint16_t ch_magic = general_page::get_magic_number(ch_addr);
 
 	if(ch_magic == PAGE_FIXED)
 	{
 		auto ch_ret = insert_interior(ch_pid, ch_addr, key, data, data_size);
 		return insert_post_process<interior_page, interior_page>(
-			now, ch_pid, ch_pos, ch_ret
+			now, ch_pid, ch_pos, std::move(ch_ret)
 		);
 	} else {
 		// leaf page
 		assert(ch_magic == PAGE_VARIANT || ch_magic == PAGE_INDEX_LEAF);
 		auto ch_ret = insert_leaf(ch_pid, ch_addr, key, data, data_size);
 		return insert_post_process<interior_page, leaf_page>(
-			now, ch_pid, ch_pos, ch_ret
+			now, ch_pid, ch_pos, std::move(ch_ret)
 		);
 	}
 }
@@ -140,21 +245,21 @@ btree<KeyType, Comparer, Copier>::insert_leaf(
 {
 	leaf_page page { addr, pg };
 
-	int ch_pos = ::lower_bound(0, page.size(), [&](int id) {
-		return compare(page.get_key(id), key) < 0;
-	} );
+	int ch_pos = page_lower_bound(page, key, compare);
 
 	insert_ret ret;
 	ret.split = false;
 
 	/* When leaf_page is variant_page, insert will act as original meaning,
-	 * When leaf_page is fixed_page, data_size will be regarded as child,
-	 * and both data and key will be regarded as key */
+	 * When leaf_page is index_leaf_page, data is the key, and data_size
+	 * is the size it takes in the leaf */
 	bool succ_ins = page.insert(ch_pos, data, data_size);
 
 	if(!succ_ins)
 	{
-		auto upper = page.split(now);
+		bool append = ch_pos == page.size() && !page.next_page();
+		auto upper = append ? split_for_append(now, page) : page.split(now);
+		ret.upper = page_pin { pg, upper.first, true };
 
 		leaf_page upper_page = upper.second;
 		leaf_page lower_page = page;
@@ -169,6 +274,7 @@ btree<KeyType, Comparer, Copier>::insert_leaf(
 			assert(succ_ins);
 		}
 
+		++thread_stats().btree_splits;
 		ret.split = true;
 		ret.lower_half = lower_page.buf;
 		ret.upper_half = upper_page.buf;
@@ -182,6 +288,7 @@ template<typename KeyType, typename Comparer, typename Copier>
 typename btree<KeyType, Comparer, Copier>::search_result 
 btree<KeyType, Comparer, Copier>::lower_bound(key_t key)
 {
+	++thread_stats().btree_descents;
 	return lower_bound(root_page_id, key);
 }
 
@@ -189,23 +296,19 @@ template<typename KeyType, typename Comparer, typename Copier>
 typename btree<KeyType, Comparer, Copier>::search_result
 btree<KeyType, Comparer, Copier>::lower_bound(int now, key_t key)
 {
-	char *addr = pg->read_for_write(now);
+	char *addr = pg->read(now);
 	uint16_t magic = general_page::get_magic_number(addr);
 	if(magic == PAGE_FIXED)
 	{
 		interior_page page { addr, pg };
-		int ch_pos = ::lower_bound(0, page.size(), [&](int id) {
-			return compare(page.get_key(id), key) < 0;
-		} );
+		int ch_pos = page_lower_bound(page, key, compare);
 
 		ch_pos = std::min(page.size() - 1, ch_pos);
 		return lower_bound(page.get_child(ch_pos), key);
 	} else {
 		assert(magic == PAGE_VARIANT || magic == PAGE_INDEX_LEAF);
 		leaf_page page { addr, pg };
-		int pos = ::lower_bound(0, page.size(), [&](int id) {
-			return compare(page.get_key(id), key) < 0;
-		} );
+		int pos = page_lower_bound(page, key, compare);
 
 		if(pos == page.size())
 			return { 0, 0 };
@@ -214,83 +317,159 @@ btree<KeyType, Comparer, Copier>::lower_bound(int now, key_t key)
 }
 
 template<typename KeyType, typename Comparer, typename Copier>
-template<typename Page>
-typename btree<KeyType, Comparer, Copier>::merge_ret
-btree<KeyType, Comparer, Copier>::erase_try_merge(int pid, char *addr)
+typename btree<KeyType, Comparer, Copier>::search_result
+btree<KeyType, Comparer, Copier>::last()
 {
-	Page page { addr, pg };
-
-	if(page.underflow())
+	++thread_stats().btree_descents;
+	int now = root_page_id;
+	for(;;)
 	{
-		char *next_addr = nullptr, *prev_addr = nullptr;
-		if(page.next_page())
+		char *addr = pg->read(now);
+		if(general_page::get_magic_number(addr) == PAGE_FIXED)
 		{
-			next_addr = pg->read(page.next_page());
-			Page next_page { next_addr, pg };
-			if(!next_page.underflow_if_remove(0))
-			{
-				pg->mark_dirty(page.next_page());
-				page.move_from(next_page, 0, page.size());
-				return { false, false, 0 };
-			}
+			interior_page page { addr, pg };
+			now = page.get_child(page.size() - 1);
+			continue;
 		}
 
-		if(page.prev_page())
+		leaf_page page { addr, pg };
+		if(page.size() == 0)
+			return { 0, 0 };
+		return { now, page.size() - 1 };
+	}
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+bool btree<KeyType, Comparer, Copier>::empty()
+{
+	char *addr = pg->read(root_page_id);
+	return general_page::get_magic_number(addr) != PAGE_FIXED
+		&& leaf_page { addr, pg }.size() == 0;
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+void btree<KeyType, Comparer, Copier>::leaves(std::vector<int> &pids)
+{
+	pids.assign(1, root_page_id);
+	std::vector<int> children;
+	while(general_page::get_magic_number(pg->read(pids[0])) == PAGE_FIXED)
+	{
+		children.clear();
+		for(int pid : pids)
 		{
-			prev_addr = pg->read(page.prev_page());
-			Page prev_page { prev_addr, pg };
-			if(!prev_page.underflow_if_remove(prev_page.size() - 1))
-			{
-				pg->mark_dirty(page.prev_page());
-				page.move_from(prev_page, prev_page.size() - 1, 0);
-				return { false, false, 0 };
-			}
+			interior_page page { pg->read(pid), pg };
+			for(int i = 0; i != page.size(); ++i)
+				children.push_back(page.get_child(i));
 		}
 
-		if(next_addr)
+		pids.swap(children);
+	}
+}
+
+/* Rebalance an underflowed page with its siblings. Only the siblings
+ * under the same parent (`has_left` and `has_right`) are merged with or
+ * take an element from, since the parent keeps their keys, except that
+ * the page may take the first element of any next page, whose largest
+ * element stays the same. The rightmost pages of the levels are often
+ * underflowed, as they are not split in halves when appended to. */
+template<typename KeyType, typename Comparer, typename Copier>
+template<typename Page>
+typename btree<KeyType, Comparer, Copier>::erase_ret
+btree<KeyType, Comparer, Copier>::erase_try_merge(
+	int pid, char *addr, bool has_left, bool has_right)
+{
+	Page page { addr, pg };
+	erase_ret ret { true, false, false, false, false, 0, 0 };
+	if(pid == root_page_id)
+		return ret;
+
+	if(page.underflow())
+	{
+		int next_pid = page.next_page(), prev_pid = page.prev_page();
+		// pinned, the elements moved may read their overflow pages
+		page_pin next, prev;
+		if(next_pid) next = page_pin { pg, next_pid };
+		if(has_left) prev = page_pin { pg, prev_pid };
+		auto can_lend = [&](const page_pin &sibling_pin, bool first) {
+			Page sibling { sibling_pin.get(), pg };
+			return !sibling.underflow_if_remove(first ? 0 : sibling.size() - 1);
+		};
+
+		if(next_pid && can_lend(next, true))
 		{
-			int next_pid = page.next_page();
-			bool succ_merge = page.merge( { next_addr, pg }, pid);
-			UNUSED(succ_merge);
-			assert(succ_merge);
+			pg->mark_dirty(next_pid);
+			page.move_from( { next.get(), pg }, 0, page.size());
+		} else if(has_left && can_lend(prev, false)) {
+			pg->mark_dirty(prev_pid);
+			Page prev_page { prev.get(), pg };
+			page.move_from(prev_page, prev_page.size() - 1, 0);
+			ret.borrowed_left = true;
+		} else if(has_right && page.merge( { next.get(), pg }, pid)) {
 			pg->free_page(next_pid);
-			return { false, true, pid };
-		} else if(prev_addr) {
-			int prev_pid = page.prev_page();
-			Page prev_page { prev_addr, pg };
-			bool succ_merge = prev_page.merge(page, prev_pid);
-			UNUSED(succ_merge);
-			assert(succ_merge);
+			++thread_stats().btree_merges;
+			ret.merged_right = true;
+			ret.merged_pid = pid;
+		} else if(has_left && Page { pg->read_for_write(prev_pid), pg }.merge(page, prev_pid)) {
 			pg->free_page(pid);
-			return { true, false, prev_pid };
+			++thread_stats().btree_merges;
+			ret.merged_left = true;
+			ret.merged_pid = prev_pid;
+		} else if(page.size() == 0) {
+			// the only child of its parent, take it out of the chain
+			if(prev_pid)
+				Page { pg->read_for_write(prev_pid), pg }.next_page_ref() = next_pid;
+			if(next_pid)
+				Page { pg->read_for_write(next_pid), pg }.prev_page_ref() = prev_pid;
+			pg->free_page(pid);
+			ret.removed = true;
+			return ret;
 		}
-	} 
+	}
 
-	return { false, false, 0 };
+	ret.largest = largest_key(ret.merged_left ? ret.merged_pid : pid);
+	return ret;
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+typename btree<KeyType, Comparer, Copier>::key_t
+btree<KeyType, Comparer, Copier>::largest_key(int pid)
+{
+	char *addr = pg->read(pid);
+	if(general_page::get_magic_number(addr) == PAGE_FIXED)
+	{
+		interior_page page { addr, pg };
+		return copy_to_temp(page.get_key(page.size() - 1));
+	} else {
+		leaf_page page { addr, pg };
+		return copy_to_temp(page.get_key(page.size() - 1));
+	}
 }
 
 template<typename KeyType, typename Comparer, typename Copier>
 typename btree<KeyType, Comparer, Copier>::erase_ret
-btree<KeyType, Comparer, Copier>::erase(int now, key_t key)
+btree<KeyType, Comparer, Copier>::erase(int now, key_t key, bool has_left, bool has_right)
 {
-	char *addr = pg->read_for_write(now);
+	// pinned, the siblings and overflow pages are read meanwhile
+	page_pin pin { pg, now, true };
+	char *addr = pin.get();
 	uint16_t magic = general_page::get_magic_number(addr);
 	if(magic == PAGE_FIXED)
 	{
 		interior_page page { addr, pg };
-		int ch_pos = ::lower_bound(0, page.size(), [&](int id) {
-			return compare(page.get_key(id), key) < 0;
-		} );
+		int ch_pos = page_lower_bound(page, key, compare);
 
 		ch_pos = std::min(page.size() - 1, ch_pos);
-		erase_ret ret = erase(page.get_child(ch_pos), key);
+		erase_ret ret = erase(page.get_child(ch_pos), key,
+			ch_pos > 0, ch_pos + 1 < page.size());
 
 		if(!ret.found) return ret;
 
 		addr = pg->read_for_write(now);
 		page = interior_page { addr, pg };
-		if(ret.merged_right)
+		if(ret.removed)
 		{
+			page.erase(ch_pos);
+		} else if(ret.merged_right) {
 			page.erase(ch_pos + 1);
 			page.set_key(ch_pos, ret.largest);
 			page.set_child(ch_pos, ret.merged_pid);
@@ -300,53 +479,172 @@ btree<KeyType, Comparer, Copier>::erase(int now, key_t key)
 			page.set_child(ch_pos - 1, ret.merged_pid);
 		} else {
 			page.set_key(ch_pos, ret.largest);
+			if(ret.borrowed_left)
+				page.set_key(ch_pos - 1, largest_key(page.get_child(ch_pos - 1)));
 		}
 
-		merge_ret mret = erase_try_merge<interior_page>(now, addr);
-		return { true, mret.merged_left, mret.merged_right,
-			mret.merged_pid, copy_to_temp(page.get_key(page.size() - 1)) };
+		return erase_try_merge<interior_page>(now, addr, has_left, has_right);
 	} else {
 		assert(magic == PAGE_VARIANT || magic == PAGE_INDEX_LEAF);
 		leaf_page page { addr, pg };
-		int pos = ::lower_bound(0, page.size(), [&](int id) {
-			return compare(page.get_key(id), key) < 0;
-		} );
+		int pos = page_lower_bound(page, key, compare);
 
 		if(pos == page.size() || compare(page.get_key(pos), key) != 0)
-			return { false, false, false, 0, 0};
+			return { false, false, false, false, false, 0, 0 };
 
 		page.erase(pos);
-		auto ret = erase_try_merge<leaf_page>(now, addr);
-
-		return { true, ret.merged_left, ret.merged_right, ret.merged_pid,
-			now == root_page_id ? 0 : copy_to_temp(page.get_key(page.size() - 1)) };
+		return erase_try_merge<leaf_page>(now, addr, has_left, has_right);
 	}
 }
 
 template<typename KeyType, typename Comparer, typename Copier>
 bool btree<KeyType, Comparer, Copier>::erase(key_t key)
 {
-	erase_ret ret = erase(root_page_id, key);
+	hint_leaf = 0;
+	++thread_stats().btree_descents;
+	erase_ret ret = erase(root_page_id, key, false, false);
 
 	char *addr = pg->read_for_write(root_page_id);
 	uint16_t magic = general_page::get_magic_number(addr);
 	if(magic == PAGE_FIXED)
 	{
 		interior_page page { addr, pg };
-		if(page.size() == 1 && page.get_child(0))
+		while(page.magic() == PAGE_FIXED && page.size() == 1 && page.get_child(0))
 		{
 			debug_puts("B-tree merge root.");
+			int child = page.get_child(0);
 			pg->free_page(root_page_id);
-			root_page_id = page.get_child(0);
+			root_page_id = child;
+			page = interior_page { pg->read_for_write(root_page_id), pg };
 		}
 	}
 
 	return ret.found;
 }
 
+/* A page is filled once its used space reaches the fill factor. */
+static bool bulk_load_filled(variant_page &page, int fill_factor)
+{
+	return page.size() >= PAGE_BLOCK_MIN_NUM
+		&& PAGE_SIZE - page.free_size() >= PAGE_SIZE / 100 * fill_factor;
+}
+
+static bool bulk_load_filled(index_leaf_page &page, int fill_factor)
+{
+	return page.size() >= PAGE_BLOCK_MIN_NUM
+		&& PAGE_SIZE - page.free_size() >= PAGE_SIZE / 100 * fill_factor;
+}
+
+template<typename T>
+static bool bulk_load_filled(fixed_page<T> &page, int fill_factor)
+{
+	return page.size() >= std::max(PAGE_BLOCK_MIN_NUM, page.capacity() * fill_factor / 100);
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+void btree<KeyType, Comparer, Copier>::bulk_load_begin(int fill_factor)
+{
+	assert(bulk_pids.empty());
+	hint_leaf = 0;
+	leaf_page root { pg->read(root_page_id), pg };
+	UNUSED(root);
+	assert(root.magic() != PAGE_FIXED && root.size() == 0);
+	bulk_fill_factor = std::min(100, std::max(50, fill_factor));
+	bulk_pids.assign(1, root_page_id);
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+void btree<KeyType, Comparer, Copier>::bulk_load_append(const char *data, int data_size)
+{
+	{
+		// pinned, the element may take overflow pages
+		page_pin last { pg, bulk_pids[0], true };
+		leaf_page page { last.get(), pg };
+		if(!bulk_load_filled(page, bulk_fill_factor) && page.insert(page.size(), data, data_size))
+			return;
+	}
+
+	int pid = bulk_load_next_page<leaf_page>(0);
+	page_pin next { pg, pid, true };
+	bool succ_ins = leaf_page { next.get(), pg }.insert(0, data, data_size);
+	UNUSED(succ_ins);
+	assert(succ_ins);
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+void btree<KeyType, Comparer, Copier>::bulk_load_interior(int level, key_t key, int child)
+{
+	interior_page page { pg->read_for_write(bulk_pids[level]), pg };
+	if(!bulk_load_filled(page, bulk_fill_factor) && page.insert(page.size(), key, child))
+		return;
+
+	int pid = bulk_load_next_page<interior_page>(level);
+	bool succ_ins = interior_page { pg->read_for_write(pid), pg }.insert(0, key, child);
+	UNUSED(succ_ins);
+	assert(succ_ins);
+}
+
+/* Start a new page after the last page of `level`, whose largest key
+ * is then added to the level above. */
+template<typename KeyType, typename Comparer, typename Copier>
+template<typename Page>
+int btree<KeyType, Comparer, Copier>::bulk_load_next_page(int level)
+{
+	int prev_pid = bulk_pids[level];
+	int pid = pg->new_page(prev_pid);
+	Page { pg->read_for_write(prev_pid), pg }.next_page_ref() = pid;
+	Page page { pg->read_for_write(pid), pg };
+	page.init(field_size);
+	page.prev_page_ref() = prev_pid;
+	bulk_pids[level] = pid;
+	bulk_load_push<Page>(level, prev_pid);
+	return pid;
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+template<typename Page>
+void btree<KeyType, Comparer, Copier>::bulk_load_push(int level, int pid)
+{
+	if(level + 1 == (int)bulk_pids.size())
+	{
+		int new_pid = pg->new_page();
+		interior_page { pg->read_for_write(new_pid), pg }.init(field_size);
+		bulk_pids.push_back(new_pid);
+	}
+
+	// pinned, so that the key stays valid
+	page_pin pin { pg, pid };
+	Page page { pin.get(), pg };
+	bulk_load_interior(level + 1, page.get_key(page.size() - 1), pid);
+}
+
+template<typename KeyType, typename Comparer, typename Copier>
+void btree<KeyType, Comparer, Copier>::bulk_load_end()
+{
+	// the last page of each level is not in the level above yet
+	for(size_t level = 0; level + 1 < bulk_pids.size(); ++level)
+	{
+		if(level == 0)
+			bulk_load_push<leaf_page>(0, bulk_pids[0]);
+		else bulk_load_push<interior_page>(level, bulk_pids[level]);
+	}
+
+	root_page_id = bulk_pids.back();
+	bulk_pids.clear();
+	debug_printf("B-tree bulk loaded, root = %d.\n", root_page_id);
+}
+
 /* Explicitly instantiate templates */
-template class btree<int, int(*)(int, int), int(*)(int)>;
+template class btree<int, int_key_comparer, int(*)(int)>;
+template class btree<const char*,
+		 __impl::index_entry_comparer<__impl::int_data_comparer>,
+		 __impl::index_btree_copier_t
+	 >;
+template class btree<const char*,
+		 __impl::index_entry_comparer<__impl::float_data_comparer>,
+		 __impl::index_btree_copier_t
+	 >;
 template class btree<const char*,
-		 index_btree::comparer_t,
+		 __impl::index_entry_comparer<__impl::string_data_comparer>,
 		 __impl::index_btree_copier_t
 	 >;
@@ -8,6 +8,7 @@
 #include "../page/index_leaf_page.h"
 #include <functional>
 #include <memory>
+#include <vector>
 #include <type_traits>
 
 /* Each node of the b-tree is a page.
@@ -21,12 +22,19 @@ class btree
 	int root_page_id, field_size;
 	Comparer compare;
 	Copier copy_to_temp;
+	// the last page of each level while bulk loading, leaf first
+	std::vector<int> bulk_pids;
+	int bulk_fill_factor;
+	/* the leaf of the last `insert_sorted` (0 if unknown), and the
+	 * interior pages above it with the positions taken, root first */
+	int hint_leaf;
+	std::vector<std::pair<int, int>> hint_path;
 public:
 	typedef KeyType key_t;
 	typedef fixed_page<key_t> interior_page;
 	typedef typename std::conditional<
 		std::is_same<KeyType, const char*>::value,
-		index_leaf_page<key_t>,
+		index_leaf_page,
 		data_page<key_t>>::type leaf_page;
 	typedef std::pair<int, int> search_result;  // (page_id, pos)
 public:
@@ -36,54 +44,90 @@ public:
 	btree(pager *pg, int root_page_id, int field_size, Comparer compare, Copier copier);
 
 	void insert(key_t key, const char* data, int data_size);
+	/* The same as `insert`, for elements inserted in ascending order of
+	 * key. The leaf of the last element is remembered, and the next one
+	 * goes into it directly if it belongs there and fits, so a sorted
+	 * run shares one descent from the root. Other updates forget it. */
+	void insert_sorted(key_t key, const char* data, int data_size);
 	// erase one of the elements with specified key randomly
 	bool erase(key_t key);
 	// the first element x for which x >= key
 	search_result lower_bound(key_t key);
+	// the last element, (0, 0) if the tree is empty
+	search_result last();
+	// the root is a leaf without elements, as bulk loading requires
+	bool empty();
+	/* the page ids of the leaves in key order, listed from the interior
+	 * pages one level at a time, the leaves themselves are not read */
+	void leaves(std::vector<int> &pids);
+
+	/* Build the tree bottom up from elements appended in ascending order
+	 * of key, which must be done on an empty tree. Each page is filled up
+	 * to `fill_factor` percent, the rest is left for later inserts.
+	 * `data` and `data_size` are the same as those of `insert`. */
+	void bulk_load_begin(int fill_factor);
+	void bulk_load_append(const char* data, int data_size);
+	void bulk_load_end();
 
 	int get_root_page_id() { return root_page_id; }
 
 private:
+	/* The lower half is the page inserted into, which the caller keeps
+	 * pinned, and the upper half is pinned by `upper`. */
 	struct insert_ret
 	{
 		bool split;
 		int upper_pid;
 		char *lower_half, *upper_half;
+		page_pin upper;
 	};
 
 	struct erase_ret
 	{
 		bool found;
 		bool merged_left, merged_right;
+		// the empty page is freed, or it took an element of its left sibling
+		bool removed, borrowed_left;
 		int merged_pid;
 		key_t largest;
 	};
 
-	struct merge_ret
-	{
-		bool merged_left, merged_right;
-		int merged_pid;
-	};
-
 	template<typename Page, typename ChPage>
 	insert_ret insert_post_process(int, int, int, insert_ret);
 	template<typename Page>
 	void insert_split_root(insert_ret);
+	template<typename Page>
+	std::pair<int, Page> split_for_append(int, Page);
+	template<typename Page>
+	int bulk_load_next_page(int level);
+	template<typename Page>
+	void bulk_load_push(int level, int pid);
+	void bulk_load_interior(int level, key_t key, int child);
+	void insert_sorted_locate(key_t key);
+	bool insert_sorted_hinted(key_t key, const char*, int);
 	insert_ret insert_interior(int, char*, key_t, const char*, int);
 	insert_ret insert_leaf(int, char*, key_t, const char*, int);
 	search_result lower_bound(int now, key_t key);
-	erase_ret erase(int, key_t);
+	erase_ret erase(int, key_t, bool, bool);
 	template<typename Page>
-	merge_ret erase_try_merge(int pid, char *addr);
+	erase_ret erase_try_merge(int pid, char *addr, bool has_left, bool has_right);
+	key_t largest_key(int pid);
 };
 
-class int_btree : public btree<int, int(*)(int, int), int(*)(int)>
+/* The comparers are types rather than function pointers, so that the
+ * comparisons in the searches of a page are inlined. */
+struct int_key_comparer
+{
+	int operator () (int x, int y) const { return integer_comparer(x, y); }
+};
+
+class int_btree : public btree<int, int_key_comparer, int(*)(int)>
 {
 	static int copy_int(int x) { return x; }
 public:
 	int_btree(pager *pg, int root_page_id = 0)
 		: btree(pg, root_page_id, sizeof(int),
-				&integer_comparer,
+				int_key_comparer(),
 				&int_btree::copy_int) {}
 };
 
@@ -110,32 +154,110 @@ namespace __impl
 			return buf.get();
 		}
 	};
+
+	struct int_data_comparer
+	{
+		int operator () (const char *x, const char *y) const { return integer_bin_comparer(x, y); }
+	};
+
+	struct float_data_comparer
+	{
+		int operator () (const char *x, const char *y) const { return float_bin_comparer(x, y); }
+	};
+
+	struct string_data_comparer
+	{
+		int operator () (const char *x, const char *y) const { return string_comparer(x, y); }
+	};
+
+	/* Index entries are [rid, nullmark, data], NULL is the smallest,
+	 * and the entries of the same data are ordered by rid. */
+	template<typename DataComparer>
+	struct index_entry_comparer
+	{
+		int operator () (const char *a, const char *b) const
+		{
+			if(a[4] != b[4])
+			{
+				// one of A and B is NULL
+				return a[4] ? -1 : 1;
+			} else if(!a[4]) {
+				// A and B are not NULL
+				int r = DataComparer()(a + sizeof(int) + 1, b + sizeof(int) + 1);
+				if(r != 0) return r;
+			}
+
+			return integer_comparer(*(const int*)a, *(const int*)b);
+		}
+	};
 }
 
-class index_btree : public btree<const char*,
-	std::function<int(const char*, const char*)>,
+/* A b-tree of index entries, whatever the type of the keys. The tree
+ * of each key type is a separate instance of btree, see typed_index_btree,
+ * so only these operations are called through the vtable. */
+class index_btree
+{
+public:
+	typedef index_leaf_page leaf_page;
+	typedef std::pair<int, int> search_result;  // (page_id, pos)
+
+	virtual ~index_btree() {}
+	virtual int get_root_page_id() = 0;
+	// the key is the entry, of `entry_size` bytes in the leaf
+	virtual void insert(const char* key, int entry_size) = 0;
+	virtual void insert_sorted(const char* key, int entry_size) = 0;
+	virtual bool erase(const char* key) = 0;
+	virtual search_result lower_bound(const char* key) = 0;
+	virtual search_result last() = 0;
+	virtual bool empty() = 0;
+	virtual void bulk_load_begin(int fill_factor) = 0;
+	virtual void bulk_load_append(const char* data, int data_size) = 0;
+	virtual void bulk_load_end() = 0;
+};
+
+template<typename DataComparer>
+class typed_index_btree : public index_btree, private btree<const char*,
+	__impl::index_entry_comparer<DataComparer>,
 	__impl::index_btree_copier_t>
 {
-	typedef std::function<int(const char*, const char*)> comparer_t;
-	typedef btree<const char*, comparer_t,
+	typedef btree<const char*,
+		__impl::index_entry_comparer<DataComparer>,
 		__impl::index_btree_copier_t> base_class;
 public:
-	index_btree(pager *pg,
-			int root_page_id,
-			int size,
-			comparer_t comparer
-		) : btree(
+	typedef index_btree::leaf_page leaf_page;
+	typedef index_btree::search_result search_result;
+
+	typed_index_btree(pager *pg, int root_page_id, int size)
+		: base_class(
 			pg,
 			root_page_id,
 			size,
-			comparer,
+			__impl::index_entry_comparer<DataComparer>(),
 			__impl::index_btree_copier_t(size)
 		) {}
 
-	void insert(const char* key, int rid)
+	int get_root_page_id() { return base_class::get_root_page_id(); }
+	void insert(const char* key, int entry_size)
+	{
+		base_class::insert(key, key, entry_size);
+	}
+
+	void insert_sorted(const char* key, int entry_size)
 	{
-		base_class::insert(key, key, rid);
+		base_class::insert_sorted(key, key, entry_size);
 	}
+
+	bool erase(const char* key) { return base_class::erase(key); }
+	search_result lower_bound(const char* key) { return base_class::lower_bound(key); }
+	search_result last() { return base_class::last(); }
+	bool empty() { return base_class::empty(); }
+	void bulk_load_begin(int fill_factor) { base_class::bulk_load_begin(fill_factor); }
+	void bulk_load_append(const char* data, int data_size)
+	{
+		base_class::bulk_load_append(data, data_size);
+	}
+
+	void bulk_load_end() { base_class::bulk_load_end(); }
 };
 
 #endif
@@ -3,7 +3,10 @@
 
 #include "btree.h"
 #include "../defs.h"
+#include "../page/variant_page.h"
+#include "../page/overflow_page.h"
 #include <utility>
+#include <vector>
 
 template<typename PageType>
 class btree_iterator
@@ -12,24 +15,82 @@ private:
 	pager *pg;
 	int pid, pos;
 	int cur_size, prev_pid, next_pid;
+	// leaves walked in a row
+	int walked;
+	bool forward;
 
-	void load_info(int p)
+	/* `sequential` is set when the iterator walks into a sibling,
+	 * the page cache then treats the leaf as a scanned page. */
+	void load_info(int p, bool sequential = false)
 	{
 		pid = p;
 		if(p)
 		{
-			PageType page { pg->read(p), pg };
+			PageType page { pg->read(p, sequential), pg };
 			assert(page.magic() == PAGE_VARIANT || page.magic() == PAGE_INDEX_LEAF);
 			cur_size = page.size();
 			next_pid = page.next_page();
 			prev_pid = page.prev_page();
 		}
 	}
+
+	/* Walk into a sibling, once two leaves are walked in a row in the
+	 * same direction, the following leaves are read ahead. The request
+	 * is renewed at each leaf, since the pages staged by one request
+	 * are limited and a leaf may refer to many overflow pages. */
+	void walk_to(int p, bool fwd)
+	{
+		if(fwd != forward)
+		{
+			walked = 0;
+			forward = fwd;
+		}
+
+		load_info(p, true);
+		if(!pid || ++walked < 2)
+			return;
+
+		int window = page_fs::get_instance()->get_read_ahead_window();
+		pg->read_ahead(fwd ? next_pid : prev_pid, window, fwd, &walk_page);
+	}
+
+	/* the chain walker of read-ahead, see page_fs::chain_walker_t */
+	static int walk_page(const char *addr, bool fwd, std::vector<int> &extra)
+	{
+		char *buf = const_cast<char*>(addr);
+		switch(general_page::get_magic_number(buf))
+		{
+			case PAGE_VARIANT: {
+				variant_page page { buf, nullptr };
+				for(int i = 0; i != page.size(); ++i)
+				{
+					int ov_page = page.get_block(i).first.ov_page;
+					if(ov_page) extra.push_back(ov_page);
+				}
+
+				return fwd ? page.next_page() : page.prev_page();
+			}
+			case PAGE_OVERFLOW: {
+				overflow_page page { buf, nullptr };
+				if(page.next()) extra.push_back(page.next());
+				return 0;
+			}
+			case PAGE_INDEX_LEAF: {
+				PageType page { buf, nullptr };
+				return fwd ? page.next_page() : page.prev_page();
+			}
+			default:
+				return 0;
+		}
+	}
 public:
 	typedef std::pair<int, int> value_t;
 public:
 	btree_iterator(pager *pg, int pid, int pos)
-		: pg(pg), pid(pid), pos(pos) { load_info(pid); }
+		: pg(pg), pid(pid), pos(pos), walked(0), forward(true)
+	{
+		load_info(pid);
+	}
 
 	btree_iterator(pager *pg, value_t p)
 		: btree_iterator(pg, p.first, p.second) {}
@@ -42,7 +103,7 @@ public:
 		assert(pid);
 		if(++pos == cur_size)
 		{
-			load_info(next_pid);
+			walk_to(next_pid, true);
 			pos = 0;
 		}
 
@@ -54,7 +115,7 @@ public:
 		assert(pid);
 		if(pos-- == 0)
 		{
-			load_info(prev_pid);
+			walk_to(prev_pid, false);
 			pos = cur_size - 1;
 		}
 
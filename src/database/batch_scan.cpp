@@ -0,0 +1,456 @@
+#include <cstring>
+#include <cassert>
+#include <functional>
+#include "batch_scan.h"
+#include "../expression/expression.h"
+
+batch_scanner::batch_scanner(table_manager *table, const batch_filter *filter)
+	: table(table), it(table->get_pager(), 0, 0),
+	  leaves(nullptr), leaf_num(0), leaf_at(0), leaf_pos(0), leaf_size(0),
+	  store(table->get_column_store()), filter(filter), group_at(0), group_end(0),
+	  loaded(true), record_size(table->get_temp_record_size()), num(0), decoded(0)
+{
+	if(store) group_end = store->get_group_num();
+	else it = table->get_record_iterator_lower_bound(0);
+	records.resize((size_t)SCAN_BATCH_ROWS * record_size);
+	positions.resize(SCAN_BATCH_ROWS);
+}
+
+batch_scanner::batch_scanner(table_manager *table, const int *leaves, int leaf_num)
+	: table(table), it(table->get_pager(), 0, 0),
+	  leaves(leaves), leaf_num(leaf_num), leaf_at(0), leaf_pos(0), leaf_size(0),
+	  store(nullptr), filter(nullptr), group_at(0), group_end(0),
+	  loaded(true), record_size(table->get_temp_record_size()), num(0), decoded(0)
+{
+	records.resize((size_t)SCAN_BATCH_ROWS * record_size);
+	positions.resize(SCAN_BATCH_ROWS);
+	table->get_pager()->prefetch(leaves, leaf_num, true);
+}
+
+batch_scanner::batch_scanner(table_manager *table, column_store *store,
+	int first, int num, const batch_filter *filter)
+	: table(table), it(table->get_pager(), 0, 0),
+	  leaves(nullptr), leaf_num(0), leaf_at(0), leaf_pos(0), leaf_size(0),
+	  store(store), filter(filter), group_at(first), group_end(first + num),
+	  loaded(true), record_size(table->get_temp_record_size()), num(0), decoded(0)
+{
+	records.resize((size_t)SCAN_BATCH_ROWS * record_size);
+	positions.resize(SCAN_BATCH_ROWS);
+}
+
+int batch_scanner::next()
+{
+	num = 0;
+	decoded = 0;
+	if(store)
+	{
+		while(group_at != group_end)
+		{
+			const column_group_t &g = store->get_group(group_at++);
+			if(filter && !filter->may_match(g))
+				continue;
+			loaded = false;
+			return num = g.rows;
+		}
+
+		return 0;
+	}
+
+	if(leaves)
+	{
+		pager *pg = table->get_pager();
+		record_manager rm(pg);
+		while(num != SCAN_BATCH_ROWS && leaf_at != leaf_num)
+		{
+			int pid = leaves[leaf_at];
+			if(leaf_pos == 0)
+			{
+				data_page<int> page { pg->pin(pid), pg };
+				leaf_size = page.size();
+				pg->unpin(pid);
+			}
+
+			if(leaf_pos == leaf_size)
+			{
+				++leaf_at;
+				leaf_pos = 0;
+				continue;
+			}
+
+			rm.open(pid, leaf_pos, false);
+			rm.read(records.data() + (size_t)num * record_size, record_size);
+			positions[num++] = { pid, leaf_pos++ };
+		}
+
+		return num;
+	}
+
+	for(; num != SCAN_BATCH_ROWS && !it.is_end(); it.next())
+	{
+		record_manager rm(it.get_pager());
+		rm.open(it.get(), false);
+		rm.read(records.data() + (size_t)num * record_size, record_size);
+		positions[num++] = it.get();
+	}
+
+	return num;
+}
+
+/* The records of the group follow each other in the leaves from where
+ * the group starts, they are read through the pins of the leaves. */
+void batch_scanner::load_records()
+{
+	loaded = true;
+	const column_group_t &g = store->get_group(group_at - 1);
+	pager *pg = table->get_pager();
+	record_manager rm(pg);
+	int pid = g.pid, pos = g.pos, size = 0, next_pid = 0;
+	auto load_leaf = [&]() {
+		data_page<int> page { pg->pin(pid), pg };
+		size = page.size();
+		next_pid = page.next_page();
+		pg->unpin(pid);
+	};
+
+	load_leaf();
+	for(int i = 0; i != num; ++i)
+	{
+		while(pos == size)
+		{
+			pid = next_pid;
+			pos = 0;
+			assert(pid);
+			load_leaf();
+		}
+
+		rm.open(pid, pos, false);
+		rm.read(records.data() + (size_t)i * record_size, record_size);
+		positions[i] = { pid, pos++ };
+	}
+}
+
+const column_vector_t &batch_scanner::get_column(int cid)
+{
+	column_vector_t &col = columns[cid];
+	if((decoded >> cid) & 1)
+		return col;
+	decoded |= 1u << cid;
+
+	int type = table->get_column_type(cid);
+	if(store)
+	{
+		store->decode(group_at - 1, cid, type, col, segment);
+		return col;
+	}
+
+	int offset = table->get_column_offset(cid);
+	col.nulls.resize(num);
+	for(int i = 0; i != num; ++i)
+		col.nulls[i] = (((const int*)get_record(i))[1] >> cid) & 1;
+
+	if(type == COL_TYPE_INT || type == COL_TYPE_DATE)
+	{
+		col.ints.resize(num);
+		for(int i = 0; i != num; ++i)
+			std::memcpy(&col.ints[i], get_record(i) + offset, sizeof(int));
+	} else if(type == COL_TYPE_FLOAT) {
+		col.floats.resize(num);
+		for(int i = 0; i != num; ++i)
+			std::memcpy(&col.floats[i], get_record(i) + offset, sizeof(float));
+	}
+
+	return col;
+}
+
+morsel_queue::morsel_queue(int num, int workers)
+	: workers(workers), ranges(new range_t[workers])
+{
+	for(int i = 0; i != workers; ++i)
+	{
+		ranges[i].begin = (int64_t)num * i / workers;
+		ranges[i].end = (int64_t)num * (i + 1) / workers;
+	}
+}
+
+int morsel_queue::next(int worker)
+{
+	range_t &own = ranges[worker];
+	{
+		std::lock_guard<std::mutex> guard(own.lock);
+		if(own.begin != own.end)
+			return own.begin++;
+	}
+
+	for(;;)
+	{
+		int victim = -1, left = 0;
+		for(int i = 0; i != workers; ++i)
+		{
+			std::lock_guard<std::mutex> guard(ranges[i].lock);
+			if(ranges[i].end - ranges[i].begin > left)
+			{
+				victim = i;
+				left = ranges[i].end - ranges[i].begin;
+			}
+		}
+
+		if(victim < 0)
+			return -1;
+
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> guard(ranges[victim].lock);
+			range_t &r = ranges[victim];
+			// taken meanwhile, look again
+			if(r.begin == r.end)
+				continue;
+			end = r.end;
+			begin = r.end = r.begin + (r.end - r.begin) / 2;
+		}
+
+		std::lock_guard<std::mutex> guard(own.lock);
+		own.begin = begin + 1;
+		own.end = end;
+		return begin;
+	}
+}
+
+parallel_scanner::parallel_scanner(table_manager *table, int threads)
+	: table(table), store(table->get_column_store())
+{
+	if(!store) table->get_record_leaves(leaves);
+	this->threads = std::max(1, std::min(threads, get_morsel_num()));
+}
+
+namespace {
+
+/* The filters keep the rows without branching on the result, which
+ * leaves the loops to the compiler to unroll. */
+template<typename T, typename Cmp>
+int filter_const(const T *v, const char *nulls, T c, int *sel, int n, Cmp cmp)
+{
+	int out = 0;
+	for(int k = 0; k != n; ++k)
+	{
+		int i = sel[k];
+		sel[out] = i;
+		out += !nulls[i] & cmp(v[i], c);
+	}
+
+	return out;
+}
+
+template<typename T, typename Cmp>
+int filter_column(const T *v, const char *nulls, const T *v2, const char *nulls2,
+	int *sel, int n, Cmp cmp)
+{
+	int out = 0;
+	for(int k = 0; k != n; ++k)
+	{
+		int i = sel[k];
+		sel[out] = i;
+		out += !nulls[i] & !nulls2[i] & cmp(v[i], v2[i]);
+	}
+
+	return out;
+}
+
+template<typename T, typename Cmp>
+int filter(const T *v, const char *nulls, const T *v2, const char *nulls2,
+	T c, int *sel, int n, Cmp cmp)
+{
+	if(v2) return filter_column(v, nulls, v2, nulls2, sel, n, cmp);
+	return filter_const(v, nulls, c, sel, n, cmp);
+}
+
+template<typename T>
+int filter_op(operator_type_t op, const T *v, const char *nulls,
+	const T *v2, const char *nulls2, T c, int *sel, int n)
+{
+	switch(op)
+	{
+		case OPERATOR_EQ:  return filter(v, nulls, v2, nulls2, c, sel, n, std::equal_to<T>());
+		case OPERATOR_NEQ: return filter(v, nulls, v2, nulls2, c, sel, n, std::not_equal_to<T>());
+		case OPERATOR_LT:  return filter(v, nulls, v2, nulls2, c, sel, n, std::less<T>());
+		case OPERATOR_LEQ: return filter(v, nulls, v2, nulls2, c, sel, n, std::less_equal<T>());
+		case OPERATOR_GT:  return filter(v, nulls, v2, nulls2, c, sel, n, std::greater<T>());
+		case OPERATOR_GEQ: return filter(v, nulls, v2, nulls2, c, sel, n, std::greater_equal<T>());
+		default: return n;
+	}
+}
+
+int filter_null(const char *nulls, bool is_null, int *sel, int n)
+{
+	int out = 0;
+	for(int k = 0; k != n; ++k)
+	{
+		int i = sel[k];
+		sel[out] = i;
+		out += nulls[i] == is_null;
+	}
+
+	return out;
+}
+
+}
+
+bool batch_filter::compile(table_manager *table, const std::vector<expr_node_t*> &and_cond)
+{
+	auto lookup = [table](const expr_node_t *expr) -> int {
+		if(expr->op != OPERATOR_NONE || expr->term_type != TERM_COLUMN_REF)
+			return -1;
+		const column_ref_t *ref = expr->column_ref;
+		if(ref->table && std::strcmp(ref->table, table->get_table_name()) != 0)
+			return -1;
+		return table->lookup_column(ref->column);
+	};
+
+	kernels.clear();
+	for(expr_node_t *expr : and_cond)
+	{
+		kernel_t k;
+		k.op = expr->op;
+		k.cid2 = -1;
+		k.val_i = 0;
+		k.val_f = 0;
+		if(k.op == OPERATOR_ISNULL || k.op == OPERATOR_NOTNULL)
+		{
+			k.cid = lookup(expr->left);
+			if(k.cid < 0) return false;
+			k.type = table->get_column_type(k.cid);
+			kernels.push_back(k);
+			continue;
+		}
+
+		if(k.op != OPERATOR_EQ && k.op != OPERATOR_NEQ && k.op != OPERATOR_LT
+			&& k.op != OPERATOR_LEQ && k.op != OPERATOR_GT && k.op != OPERATOR_GEQ)
+			return false;
+
+		const expr_node_t *val = expr->right;
+		k.cid = lookup(expr->left);
+		if(k.cid < 0)
+		{
+			// constant op column
+			val = expr->left;
+			k.cid = lookup(expr->right);
+			if(k.cid < 0) return false;
+			switch(k.op)
+			{
+				case OPERATOR_LT:  k.op = OPERATOR_GT;  break;
+				case OPERATOR_GT:  k.op = OPERATOR_LT;  break;
+				case OPERATOR_LEQ: k.op = OPERATOR_GEQ; break;
+				case OPERATOR_GEQ: k.op = OPERATOR_LEQ; break;
+				default: break;
+			}
+		}
+
+		k.type = table->get_column_type(k.cid);
+		if(k.type != COL_TYPE_INT && k.type != COL_TYPE_FLOAT && k.type != COL_TYPE_DATE)
+			return false;
+
+		if(val->op != OPERATOR_NONE)
+			return false;
+		if(val->term_type == TERM_COLUMN_REF)
+		{
+			k.cid2 = lookup(val);
+			if(k.cid2 < 0 || table->get_column_type(k.cid2) != k.type)
+				return false;
+		} else if(k.type == COL_TYPE_INT && val->term_type == TERM_INT) {
+			k.val_i = val->val_i;
+		} else if(k.type == COL_TYPE_FLOAT && val->term_type == TERM_FLOAT) {
+			k.val_f = val->val_f;
+		} else if(k.type == COL_TYPE_DATE && val->term_type == TERM_DATE) {
+			expression date = expression::eval(val);
+			if(date.type != TERM_DATE) return false;
+			k.val_i = date.val_i;
+		} else {
+			return false;
+		}
+
+		kernels.push_back(k);
+	}
+
+	return true;
+}
+
+namespace {
+
+template<typename T>
+bool zone_may_match(operator_type_t op, T lo, T hi, T c)
+{
+	switch(op)
+	{
+		case OPERATOR_EQ:  return lo <= c && c <= hi;
+		case OPERATOR_NEQ: return !(lo == c && hi == c);
+		case OPERATOR_LT:  return lo < c;
+		case OPERATOR_LEQ: return lo <= c;
+		case OPERATOR_GT:  return hi > c;
+		case OPERATOR_GEQ: return hi >= c;
+		default: return true;
+	}
+}
+
+}
+
+bool batch_filter::may_match(const column_group_t &group) const
+{
+	for(const kernel_t &k : kernels)
+	{
+		const column_segment_t &seg = group.cols[k.cid];
+		if(k.op == OPERATOR_ISNULL)
+		{
+			if(seg.nulls == 0) return false;
+			continue;
+		}
+
+		// a comparison with NULL is false
+		if(seg.nulls == group.rows)
+			return false;
+		if(k.op == OPERATOR_NOTNULL)
+			continue;
+
+		if(k.cid2 >= 0)
+		{
+			if(group.cols[k.cid2].nulls == group.rows)
+				return false;
+		} else if(k.type == COL_TYPE_FLOAT) {
+			if(!zone_may_match(k.op, seg.min_f, seg.max_f, k.val_f))
+				return false;
+		} else {
+			if(!zone_may_match(k.op, seg.min_i, seg.max_i, k.val_i))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void batch_filter::apply(batch_scanner &scan, std::vector<int> &sel)
+{
+	int n = sel.size();
+	for(const kernel_t &k : kernels)
+	{
+		if(n == 0) break;
+		thread_stats().expr_evals += n;
+		const column_vector_t &col = scan.get_column(k.cid);
+		const char *nulls = col.nulls.data();
+		if(k.op == OPERATOR_ISNULL || k.op == OPERATOR_NOTNULL)
+		{
+			n = filter_null(nulls, k.op == OPERATOR_ISNULL, sel.data(), n);
+			continue;
+		}
+
+		const column_vector_t *col2 = k.cid2 < 0 ? nullptr : &scan.get_column(k.cid2);
+		const char *nulls2 = col2 ? col2->nulls.data() : nullptr;
+		if(k.type == COL_TYPE_FLOAT)
+		{
+			n = filter_op(k.op, col.floats.data(), nulls,
+				col2 ? col2->floats.data() : nullptr, nulls2, k.val_f, sel.data(), n);
+		} else {
+			n = filter_op(k.op, col.ints.data(), nulls,
+				col2 ? col2->ints.data() : nullptr, nulls2, k.val_i, sel.data(), n);
+		}
+	}
+
+	sel.resize(n);
+}
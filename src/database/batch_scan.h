@@ -0,0 +1,231 @@
+#ifndef __TRIVIALDB_BATCH_SCAN__
+#define __TRIVIALDB_BATCH_SCAN__
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdint.h>
+#include "../defs.h"
+#include "../parser/defs.h"
+#include "../fs/page_fs.h"
+#include "../utils/exec_stats.h"
+#include "../table/table.h"
+#include "../table/column_store.h"
+
+class batch_filter;
+
+/* Scan a table SCAN_BATCH_ROWS rows at a time. The records of a batch
+ * are copied out together, and a column is decoded into a typed vector
+ * when it is first asked for, so that the filters and aggregates can
+ * run over whole vectors instead of evaluating a row at a time.
+ * Given a list of leaves, only their records are scanned, through the
+ * pins of record_manager, so the scanners of several threads can run
+ * at once.
+ *
+ * Of a columnar table, a batch is a group of its column store, whose
+ * columns are decoded from their segments, and the records are read
+ * only if asked for. The groups which cannot satisfy the filter by
+ * their zone maps are skipped. */
+class batch_scanner
+{
+	table_manager *table;
+	btree_iterator<int_btree::leaf_page> it;
+	const int *leaves;
+	int leaf_num, leaf_at, leaf_pos, leaf_size;
+	column_store *store;
+	const batch_filter *filter;
+	int group_at, group_end;
+	bool loaded;  // the records of the group are read
+	std::vector<char> segment;
+	int record_size, num;
+	std::vector<char> records;
+	std::vector<std::pair<int, int>> positions;
+	uint32_t decoded;
+	column_vector_t columns[MAX_COL_NUM];
+
+	void load_records();
+
+public:
+	/* `filter` only skips the groups of a columnar table, the rows of a
+	 * batch are still to be filtered by it */
+	explicit batch_scanner(table_manager *table, const batch_filter *filter = nullptr);
+	batch_scanner(table_manager *table, const int *leaves, int leaf_num);
+	// the groups [first, first + num) of the column store
+	batch_scanner(table_manager *table, column_store *store,
+		int first, int num, const batch_filter *filter);
+
+	/* read the next batch, returns the number of rows, 0 at the end */
+	int next();
+	int size() { return num; }
+	pager *get_pager() { return table->get_pager(); }
+	const char *get_record(int i)
+	{
+		if(!loaded) load_records();
+		return records.data() + (size_t)i * record_size;
+	}
+
+	std::pair<int, int> get_position(int i)
+	{
+		if(!loaded) load_records();
+		return positions[i];
+	}
+
+	const column_vector_t &get_column(int cid);
+};
+
+/* The conjuncts of a WHERE run as kernels over the column vectors of a
+ * batch, each narrows the selection vector (the indices of the rows
+ * passing the conjuncts before it). Only the comparisons which cannot
+ * fail are compiled: a numeric or DATE column with a constant or a
+ * column of the same type, and IS [NOT] NULL. A comparison with NULL
+ * is false, as it is in a WHERE. */
+class batch_filter
+{
+	struct kernel_t
+	{
+		operator_type_t op;
+		int cid, cid2;     // cid2 is -1 for a constant
+		int type;
+		int val_i;
+		float val_f;
+	};
+
+	std::vector<kernel_t> kernels;
+
+public:
+	/* returns false if a conjunct cannot be compiled */
+	bool compile(table_manager *table, const std::vector<expr_node_t*> &and_cond);
+	void apply(batch_scanner &scan, std::vector<int> &sel);
+	/* false if no row of the group satisfies the conjuncts by the zone
+	 * maps of their columns */
+	bool may_match(const column_group_t &group) const;
+};
+
+/* Deal the morsels [0, num) to `workers` in contiguous ranges. A worker
+ * takes the morsels of its own range from the front, and once it has
+ * run out, steals the back half of the largest range left. */
+class morsel_queue
+{
+	struct range_t
+	{
+		std::mutex lock;
+		int begin, end;
+	};
+
+	int workers;
+	std::unique_ptr<range_t[]> ranges;
+
+public:
+	morsel_queue(int num, int workers);
+	/* the next morsel of `worker`, -1 if none is left */
+	int next(int worker);
+};
+
+/* Scan a table by several threads at once. The leaves of the rowid
+ * B-tree are split into morsels of PARALLEL_SCAN_MORSEL_PAGES leaves,
+ * which are handed out by a morsel_queue, and each thread runs its own
+ * batch_scanner over the morsels it takes. Of a columnar table, each
+ * group of the column store is a morsel. */
+class parallel_scanner
+{
+	table_manager *table;
+	column_store *store;
+	std::vector<int> leaves;
+	int threads;
+
+public:
+	parallel_scanner(table_manager *table, int threads);
+	int get_morsel_num()
+	{
+		if(store) return store->get_group_num();
+		return (leaves.size() + PARALLEL_SCAN_MORSEL_PAGES - 1) / PARALLEL_SCAN_MORSEL_PAGES;
+	}
+
+	int get_thread_num() { return threads; }
+
+	/* Call `callback(morsel, scan, sel)` with the rows of each batch
+	 * satisfying `filter`. It is called from all the threads at once,
+	 * the batches of a morsel come from one thread in order of rid. The
+	 * workers count their work in the statistics of the caller. */
+	template<typename Callback>
+	void run(batch_filter &filter, Callback callback)
+	{
+		morsel_queue queue(get_morsel_num(), threads);
+		// the workers read in the snapshot of the caller, if any
+		uint64_t snapshot = page_fs::get_thread_snapshot();
+		exec_stats_t worker_stats = exec_stats_t();
+		std::mutex stats_lock;
+		auto work = [&](int worker) {
+			snapshot_guard in_snapshot(snapshot);
+			std::vector<int> sel;
+			for(int m; (m = queue.next(worker)) >= 0; )
+			{
+				int first = m * PARALLEL_SCAN_MORSEL_PAGES;
+				int num = std::min((int)leaves.size() - first, PARALLEL_SCAN_MORSEL_PAGES);
+				batch_scanner scan = store ? batch_scanner(table, store, m, 1, &filter)
+					: batch_scanner(table, leaves.data() + first, num);
+				while(int rows = scan.next())
+				{
+					sel.resize(rows);
+					for(int i = 0; i != rows; ++i)
+						sel[i] = i;
+					filter.apply(scan, sel);
+					thread_stats().rows_examined += rows;
+					thread_stats().rows_emitted += sel.size();
+					if(!sel.empty())
+						callback(m, scan, sel);
+				}
+			}
+
+			if(worker != 0)
+			{
+				std::lock_guard<std::mutex> guard(stats_lock);
+				worker_stats.add(thread_stats());
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for(int i = 1; i < threads; ++i)
+			pool.emplace_back(work, i);
+		work(0);
+		for(std::thread &t : pool)
+			t.join();
+		thread_stats().add(worker_stats);
+	}
+};
+
+/* Fold the values of the selected rows into `acc` by SUM (or AVG), MIN
+ * or MAX, the NULLs are skipped. Returns the number of values folded. */
+template<typename T>
+int aggregate_vector(operator_type_t op, const std::vector<T> &v,
+	const std::vector<char> &nulls, const std::vector<int> &sel, T &acc)
+{
+	int num = 0;
+	T ret = acc;
+	for(int i : sel)
+	{
+		if(nulls[i]) continue;
+		++num;
+		switch(op)
+		{
+			case OPERATOR_SUM:
+			case OPERATOR_AVG:
+				ret += v[i];
+				break;
+			case OPERATOR_MIN:
+				if(v[i] < ret) ret = v[i];
+				break;
+			case OPERATOR_MAX:
+				if(v[i] > ret) ret = v[i];
+				break;
+			default: break;
+		}
+	}
+
+	acc = ret;
+	return num;
+}
+
+#endif
@@ -0,0 +1,766 @@
+#include "bulk_load.h"
+#include "result_sink.h"
+#include "../table/table.h"
+#include "../utils/lz_codec.h"
+#include "../utils/type_cast.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <strings.h>
+
+const char *bulk_reader::column_name(int i)
+{
+	return tb->get_column_name(cols[i]);
+}
+
+bool bulk_reader::match_header(const std::vector<const char*> &names)
+{
+	cols = given_cols;
+	if(names.size() != cols.size())
+		return false;
+
+	std::vector<int> order;
+	std::vector<bool> used(cols.size());
+	for(const char *text : names)
+	{
+		// of any table, the file may be written from another one
+		const char *name = std::strrchr(text, '.');
+		name = name ? name + 1 : text;
+		size_t j = 0;
+		while(j != cols.size() && (used[j] || strcasecmp(name, column_name(j)) != 0))
+			++j;
+		if(j == cols.size())
+			return false;
+		used[j] = true;
+		order.push_back(cols[j]);
+	}
+
+	cols.swap(order);
+	return true;
+}
+
+void bulk_reader::bad_row(const char *reason, int i)
+{
+	if(i < 0)
+		std::fprintf(stderr, "[Error] %s %lld: %s.\n", row_unit, row_num, reason);
+	else std::fprintf(stderr, "[Error] %s %lld, column `%s`: %s.\n",
+		row_unit, row_num, column_name(i), reason);
+}
+
+bool bulk_reader::parse_date(const char *text, size_t len, int &time)
+{
+	// YYYY-MM-DD, as a DATE literal
+	int part[3] = { 0, 0, 0 }, digits[3] = { 0, 0, 0 }, k = 0;
+	for(size_t i = 0; i != len; ++i)
+	{
+		if(text[i] == '-' && k != 2 && digits[k]) {
+			++k;
+		} else if(text[i] >= '0' && text[i] <= '9' && digits[k] != 4) {
+			part[k] = part[k] * 10 + text[i] - '0';
+			++digits[k];
+		} else {
+			return false;
+		}
+	}
+
+	if(k != 2 || !digits[2] || digits[1] > 2 || digits[2] > 2)
+		return false;
+
+	int key = part[0] * 10000 + part[1] * 100 + part[2];
+	date_entry_t &e = dates[(unsigned)key % DATE_CACHE_SIZE];
+	if(e.key != key)
+	{
+		std::tm tm{};
+		tm.tm_year = part[0] - 1900;
+		tm.tm_mon  = part[1] - 1;
+		tm.tm_mday = part[2];
+		e.time = part[1] >= 1 && part[1] <= 12 ? (int)std::mktime(&tm) : -1;
+		// a day past the end of the month is carried to the next one
+		if(tm.tm_mday != part[2])
+			e.time = -1;
+		e.key = key;
+	}
+
+	time = e.time;
+	return time != -1;
+}
+
+bool bulk_reader::set_text(int i, const char *text, size_t len, bool quoted)
+{
+	int col = cols[i];
+	int type = tb->get_column_type(col);
+	if(!quoted && ((len == 4 && std::memcmp(text, "NULL", 4) == 0)
+		|| (len == 0 && type != COL_TYPE_VARCHAR)))
+		return tb->set_temp_record(col, nullptr);
+
+	char *end;
+	switch(type)
+	{
+		case COL_TYPE_INT: {
+			errno = 0;
+			long val = std::strtol(text, &end, 10);
+			if(len == 0 || end != text + len || errno || val < INT_MIN || val > INT_MAX)
+			{
+				bad_row("not an integer", i);
+				return false;
+			}
+
+			int x = (int)val;
+			return tb->set_temp_record(col, &x); }
+		case COL_TYPE_FLOAT: {
+			float x = std::strtof(text, &end);
+			if(len == 0 || end != text + len)
+			{
+				bad_row("not a number", i);
+				return false;
+			}
+
+			return tb->set_temp_record(col, &x); }
+		case COL_TYPE_DATE: {
+			int time;
+			if(!parse_date(text, len, time))
+			{
+				bad_row("not a date", i);
+				return false;
+			}
+
+			return tb->set_temp_record(col, &time); }
+		case COL_TYPE_VARCHAR:
+			return tb->set_temp_record(col, text);
+		default:
+			bad_row("type not supported", i);
+			return false;
+	}
+}
+
+bool bulk_reader::set_binary(int i, int type, uint32_t bits, const char *str, size_t len)
+{
+	expression val;
+	switch(type)
+	{
+		case VALUE_NULL:
+			return tb->set_temp_record(cols[i], nullptr);
+		case VALUE_STRING:
+			// converted as the text of CSV, which needs the `\0`
+			text.assign(str, len);
+			return set_text(i, text.c_str(), len, true);
+		case VALUE_INT:
+			val.type = TERM_INT;
+			std::memcpy(&val.val_i, &bits, 4);
+			break;
+		case VALUE_FLOAT:
+			val.type = TERM_FLOAT;
+			std::memcpy(&val.val_f, &bits, 4);
+			break;
+		case VALUE_DATE:
+			val.type = TERM_DATE;
+			std::memcpy(&val.val_i, &bits, 4);
+			break;
+		default:
+			bad_row("incompatible type", i);
+			return false;
+	}
+
+	int col_type = tb->get_column_type(cols[i]);
+	if(!typecast::type_compatible(col_type, val))
+	{
+		bad_row("incompatible type", i);
+		return false;
+	}
+
+	// a DATE into a VARCHAR column
+	char *db_val = typecast::expr_to_db(val, typecast::column_to_term(col_type));
+	return tb->set_temp_record(cols[i], db_val);
+}
+
+namespace {
+
+/* The bytes of a file, or the text of the blocks of a `.csv.lz` file. */
+class byte_source
+{
+protected:
+	std::FILE *fp;
+
+public:
+	explicit byte_source(std::FILE *fp) : fp(fp) {}
+	virtual ~byte_source() { std::fclose(fp); }
+
+	/* up to `size` bytes into `dst`, 0 at the end, -1 if the file
+	 * cannot be read */
+	virtual long read(char *dst, size_t size)
+	{
+		size_t n = std::fread(dst, 1, size, fp);
+		return n == 0 && std::ferror(fp) ? -1 : (long)n;
+	}
+};
+
+class lz_source : public byte_source
+{
+	std::vector<char> packed, block;
+	size_t pos;
+
+	static uint32_t get_u32(const unsigned char *p)
+	{
+		return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+	}
+
+	/* -1 if broken, 0 at the end */
+	int next_block()
+	{
+		unsigned char head[8];
+		size_t n = std::fread(head, 1, 8, fp);
+		if(n == 0 && !std::ferror(fp))
+			return 0;
+		uint32_t raw = n == 8 ? get_u32(head) : 0, size = n == 8 ? get_u32(head + 4) : 0;
+		if(n != 8 || raw == 0 || raw > result_sink::LZ_BLOCK_SIZE || size > raw)
+			return -1;
+
+		block.resize(raw);
+		pos = 0;
+		if(size == raw)
+			return std::fread(block.data(), 1, raw, fp) == raw ? 1 : -1;
+		packed.resize(size);
+		if(std::fread(packed.data(), 1, size, fp) != size)
+			return -1;
+		return lz_codec::decompress(packed.data(), size, block.data(), raw) == (int)raw ? 1 : -1;
+	}
+
+public:
+	explicit lz_source(std::FILE *fp) : byte_source(fp), pos(0) {}
+
+	virtual long read(char *dst, size_t size) override
+	{
+		if(pos == block.size())
+		{
+			int r = next_block();
+			if(r <= 0) return r;
+		}
+
+		size_t n = std::min(size, block.size() - pos);
+		std::memcpy(dst, block.data() + pos, n);
+		pos += n;
+		return (long)n;
+	}
+};
+
+/* A buffer over a source, read a chunk at a time. */
+class chunk_buffer
+{
+	enum { CHUNK_SIZE = 1 << 20 };
+	std::unique_ptr<byte_source> src;
+
+public:
+	std::vector<char> buf;
+	size_t pos, end;
+	bool eof, error;
+
+	explicit chunk_buffer(byte_source *src)
+		: src(src), buf(CHUNK_SIZE + 1), pos(0), end(0), eof(false), error(false) {}
+
+	/* Keep the bytes from `pos` and read more after them, with one byte
+	 * spare at the end. Returns false at the end or on an error. */
+	bool fill()
+	{
+		if(eof || error) return false;
+		std::memmove(buf.data(), buf.data() + pos, end - pos);
+		end -= pos;
+		pos = 0;
+		if(end + 1 >= buf.size())
+			buf.resize(buf.size() * 2);
+		long n = src->read(buf.data() + end, buf.size() - 1 - end);
+		if(n < 0) error = true;
+		else if(n == 0) eof = true;
+		else end += n;
+		return n > 0;
+	}
+
+	/* the next `size` bytes, false if the file ends before them */
+	bool read(void *dst, size_t size)
+	{
+		while(end - pos < size)
+		{
+			if(!fill()) return false;
+		}
+
+		std::memcpy(dst, buf.data() + pos, size);
+		pos += size;
+		return true;
+	}
+
+	/* the next byte, -1 at the end */
+	int get()
+	{
+		unsigned char c;
+		return read(&c, 1) ? c : -1;
+	}
+
+	bool get_u16(uint32_t &x)
+	{
+		unsigned char b[2];
+		if(!read(b, 2)) return false;
+		x = b[0] | b[1] << 8;
+		return true;
+	}
+
+	bool get_u32(uint32_t &x)
+	{
+		unsigned char b[4];
+		if(!read(b, 4)) return false;
+		x = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+		return true;
+	}
+};
+
+class csv_reader : public bulk_reader
+{
+	struct field_t
+	{
+		char *text;
+		size_t len;
+		bool quoted;
+	};
+
+	chunk_buffer in;
+	std::vector<field_t> fields;
+	long long line;
+	bool first;
+
+	/* split the record of `len` bytes at `rec` into `fields`, each
+	 * ended by `\0` in place, false if a quote is not closed */
+	bool split(char *rec, size_t len)
+	{
+		fields.clear();
+		if(len && rec[len - 1] == '\r')
+			--len;
+
+		char *p = rec, *e = rec + len;
+		bool ok = true;
+		for(;;)
+		{
+			field_t f;
+			if(p != e && *p == '"')
+			{
+				f.quoted = true;
+				f.text = ++p;
+				char *w = p;
+				for(;;)
+				{
+					if(p == e) { ok = false; break; }
+					if(*p == '"')
+					{
+						if(p + 1 != e && p[1] == '"')
+						{
+							*w++ = '"';
+							p += 2;
+							continue;
+						}
+
+						++p;
+						break;
+					}
+
+					*w++ = *p++;
+				}
+
+				f.len = w - f.text;
+				if(p != e && *p != ',')
+					ok = false;
+				p = p != e ? (char*)std::memchr(p, ',', e - p) : e;
+				if(!p) p = e;
+			} else {
+				f.quoted = false;
+				f.text = p;
+				char *c = (char*)std::memchr(p, ',', e - p);
+				p = c ? c : e;
+				f.len = p - f.text;
+			}
+
+			bool last = p == e;
+			f.text[f.len] = 0;
+			fields.push_back(f);
+			if(last) break;
+			++p;
+		}
+
+		return ok;
+	}
+
+	/* the next record into `fields`, ROW_BAD if it is malformed */
+	result_t read_record()
+	{
+		size_t off = 0;
+		bool quoted = false;
+		long long lines = 1;
+		for(;;)
+		{
+			char *begin = in.buf.data() + in.pos;
+			char *p = begin + off, *e = in.buf.data() + in.end;
+			for(; p != e; ++p)
+			{
+				if(*p == '"')
+					quoted = !quoted;
+				else if(*p == '\n' && !quoted)
+					break;
+				else if(*p == '\n')
+					++lines;
+			}
+
+			off = p - begin;
+			if(p != e || (in.eof && off != 0))
+				break;
+			if(in.eof) return ROW_END;
+			if(!in.fill() && in.error)
+			{
+				std::fprintf(stderr, "[Error] Fail to read the file.\n");
+				return ROW_BROKEN;
+			}
+		}
+
+		char *rec = in.buf.data() + in.pos;
+		// the last line may have no `\n`, the byte spare takes the `\0`
+		in.pos = std::min(in.end, in.pos + off + 1);
+		row_num = line;
+		line += lines;
+		if(!split(rec, off))
+		{
+			bad_row("a quote is not closed");
+			return ROW_BAD;
+		}
+
+		return ROW_OK;
+	}
+
+	bool is_header()
+	{
+		std::vector<const char*> names;
+		for(const field_t &f : fields)
+		{
+			if(f.quoted) return false;
+			names.push_back(f.text);
+		}
+
+		return match_header(names);
+	}
+
+public:
+	csv_reader(table_manager *tb, const std::vector<int> &cols, byte_source *src)
+		: bulk_reader(tb, cols), in(src), line(1), first(true)
+	{
+		row_unit = "Line";
+	}
+
+	virtual result_t next() override
+	{
+		for(;;)
+		{
+			result_t r = read_record();
+			if(r != ROW_OK)
+				return r;
+			if(fields.size() == 1 && fields[0].len == 0 && !fields[0].quoted)
+				continue;
+			if(first)
+			{
+				first = false;
+				if(is_header()) continue;
+			}
+
+			if(fields.size() != cols.size())
+			{
+				char reason[64];
+				std::snprintf(reason, sizeof(reason), "%zu value(s) for %zu column(s)",
+					fields.size(), cols.size());
+				bad_row(reason);
+				return ROW_BAD;
+			}
+
+			tb->init_temp_record();
+			for(size_t i = 0; i != fields.size(); ++i)
+			{
+				if(!set_text(i, fields[i].text, fields[i].len, fields[i].quoted))
+					return ROW_BAD;
+			}
+
+			return ROW_OK;
+		}
+	}
+};
+
+/* The results written by the `.bin` and `.col` sinks, see result_sink. */
+class binary_reader : public bulk_reader
+{
+protected:
+	chunk_buffer in;
+	bool in_result;
+
+	result_t broken()
+	{
+		if(in.error)
+			std::fprintf(stderr, "[Error] Fail to read the file.\n");
+		else std::fprintf(stderr, "[Error] The file is broken after row %lld.\n", row_num);
+		return ROW_BROKEN;
+	}
+
+	bool read_header()
+	{
+		uint32_t n, len;
+		if(!in.get_u16(n)) return false;
+		std::vector<std::string> names(n);
+		for(std::string &name : names)
+		{
+			if(!in.get_u16(len)) return false;
+			name.resize(len);
+			if(len && !in.read(&name[0], len)) return false;
+		}
+
+		in_result = true;
+		if(n == cols.size())
+		{
+			std::vector<const char*> texts;
+			for(const std::string &name : names)
+				texts.push_back(name.c_str());
+			match_header(texts);
+			return true;
+		}
+		std::fprintf(stderr, "[Error] The rows of the file have %u column(s), not %zu.\n",
+			n, cols.size());
+		return false;
+	}
+
+	/* the tags between the rows: a header, the end of a result, or the
+	 * end of the file; returns the tag of the rows, or -1 */
+	int next_tag(result_t &r)
+	{
+		for(;;)
+		{
+			int tag = in.get();
+			if(tag < 0)
+			{
+				r = in_result || in.error ? broken() : ROW_END;
+				return -1;
+			}
+
+			if(tag == 'H' && !in_result)
+			{
+				if(!read_header())
+				{
+					// a header of other columns has been told about
+					r = in_result ? ROW_BROKEN : broken();
+					in_result = false;
+					return -1;
+				}
+			} else if(tag == 'E' && in_result) {
+				char count[8];
+				if(!in.read(count, 8))
+				{
+					r = broken();
+					return -1;
+				}
+
+				in_result = false;
+			} else if(in_result) {
+				return tag;
+			} else {
+				r = broken();
+				return -1;
+			}
+		}
+	}
+
+public:
+	binary_reader(table_manager *tb, const std::vector<int> &cols, byte_source *src)
+		: bulk_reader(tb, cols), in(src), in_result(false) {}
+
+	virtual result_t next() override
+	{
+		result_t r;
+		int tag = next_tag(r);
+		if(tag < 0) return r;
+		if(tag != 'R') return broken();
+
+		++row_num;
+		struct value_t { int type; uint32_t bits; size_t at, len; };
+		value_t vals[MAX_COL_NUM];
+		for(size_t i = 0; i != cols.size(); ++i)
+		{
+			value_t &v = vals[i];
+			v.bits = 0;
+			v.at = v.len = 0;
+			if((v.type = in.get()) < 0)
+				return broken();
+			bool ok = true;
+			switch(v.type)
+			{
+				case VALUE_INT: case VALUE_FLOAT: case VALUE_DATE:
+					ok = in.get_u32(v.bits);
+					break;
+				case VALUE_BOOL:
+					ok = in.get() >= 0;
+					break;
+				case VALUE_STRING:
+					ok = in.get_u32(v.bits);
+					v.at = strings.size();
+					v.len = v.bits;
+					strings.resize(v.at + v.len);
+					ok = ok && in.read(&strings[v.at], v.len);
+					break;
+				case VALUE_NULL:
+					break;
+				default:
+					ok = false;
+			}
+
+			if(!ok) return broken();
+		}
+
+		tb->init_temp_record();
+		for(size_t i = 0; i != cols.size(); ++i)
+		{
+			if(!set_binary(i, vals[i].type, vals[i].bits, strings.data() + vals[i].at, vals[i].len))
+			{
+				strings.clear();
+				return ROW_BAD;
+			}
+		}
+
+		strings.clear();
+		return ROW_OK;
+	}
+
+protected:
+	std::string strings;
+};
+
+class columnar_reader : public binary_reader
+{
+	struct column_t
+	{
+		int type;
+		std::vector<unsigned char> valid;
+		std::vector<char> values;
+		std::vector<uint32_t> ends;
+	};
+
+	std::vector<column_t> columns;
+	uint32_t batch_rows, at;
+
+	bool read_batch()
+	{
+		if(!in.get_u32(batch_rows))
+			return false;
+		for(column_t &col : columns)
+		{
+			col.type = in.get();
+			col.valid.resize((batch_rows + 7) / 8);
+			if(col.type < 0 || !in.read(col.valid.data(), col.valid.size()))
+				return false;
+
+			size_t size = 0;
+			switch(col.type)
+			{
+				case VALUE_INT: case VALUE_FLOAT: case VALUE_DATE:
+					size = (size_t)batch_rows * 4;
+					break;
+				case VALUE_BOOL:
+					size = batch_rows;
+					break;
+				case VALUE_STRING:
+					col.ends.resize(batch_rows);
+					for(uint32_t &end : col.ends)
+					{
+						if(!in.get_u32(end)) return false;
+					}
+
+					size = batch_rows ? col.ends.back() : 0;
+					break;
+				case VALUE_NULL:
+					break;
+				default:
+					return false;
+			}
+
+			col.values.resize(size);
+			if(size && !in.read(col.values.data(), size))
+				return false;
+		}
+
+		at = 0;
+		return true;
+	}
+
+public:
+	columnar_reader(table_manager *tb, const std::vector<int> &cols, byte_source *src)
+		: binary_reader(tb, cols, src), columns(cols.size()), batch_rows(0), at(0) {}
+
+	virtual result_t next() override
+	{
+		while(at == batch_rows)
+		{
+			result_t r;
+			int tag = next_tag(r);
+			if(tag < 0) return r;
+			if(tag != 'B' || !read_batch())
+				return broken();
+		}
+
+		++row_num;
+		uint32_t r = at++;
+		tb->init_temp_record();
+		for(size_t i = 0; i != columns.size(); ++i)
+		{
+			column_t &col = columns[i];
+			bool is_null = !((col.valid[r / 8] >> (r % 8)) & 1);
+			uint32_t bits = 0;
+			const char *str = nullptr;
+			size_t len = 0;
+			if(!is_null && (col.type == VALUE_INT || col.type == VALUE_FLOAT || col.type == VALUE_DATE))
+				std::memcpy(&bits, col.values.data() + (size_t)r * 4, 4);
+			else if(!is_null && col.type == VALUE_BOOL)
+				bits = (unsigned char)col.values[r];
+			else if(!is_null && col.type == VALUE_STRING) {
+				uint32_t begin = r ? col.ends[r - 1] : 0;
+				if(begin > col.ends[r] || col.ends[r] > col.values.size())
+					return broken();
+				str = col.values.data() + begin;
+				len = col.ends[r] - begin;
+			}
+
+			if(!set_binary(i, is_null ? VALUE_NULL : col.type, bits, str, len))
+				return ROW_BAD;
+		}
+
+		return ROW_OK;
+	}
+};
+
+}
+
+std::unique_ptr<bulk_reader> bulk_reader::open(const char *filename,
+	table_manager *tb, const std::vector<int> &cols)
+{
+	std::FILE *fp = std::fopen(filename, "rb");
+	if(!fp)
+	{
+		std::fprintf(stderr, "[Error] Fail to open `%s`.\n", filename);
+		return nullptr;
+	}
+
+	bulk_reader *reader;
+	switch(result_format_of(filename))
+	{
+		case RESULT_BINARY:
+			reader = new binary_reader(tb, cols, new byte_source(fp));
+			break;
+		case RESULT_COLUMNAR:
+			reader = new columnar_reader(tb, cols, new byte_source(fp));
+			break;
+		case RESULT_CSV_LZ:
+			reader = new csv_reader(tb, cols, new lz_source(fp));
+			break;
+		default:
+			reader = new csv_reader(tb, cols, new byte_source(fp));
+	}
+
+	return std::unique_ptr<bulk_reader>(reader);
+}
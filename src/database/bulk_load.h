@@ -0,0 +1,90 @@
+#ifndef __TRIVIALDB_BULK_LOAD__
+#define __TRIVIALDB_BULK_LOAD__
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class table_manager;
+
+/* Reads the rows of `COPY table FROM 'file'` into the temp record of the
+ * table, one at a time, without parsing them as SQL. The file is read in
+ * chunks and is in one of the formats written by result_sink, chosen by
+ * its name in the same way:
+ *
+ *   CSV, the fields separated by `,`, `NULL` for NULL. A field may be
+ *   quoted by `"`, with `""` for a `"` in it, to hold `,` or a newline.
+ *   Empty lines are skipped, and so is the first line if its fields are
+ *   the names of the columns, see match_header(), so a file written by
+ *   SELECT is read back. An empty field of a column other than VARCHAR
+ *   is NULL.
+ *   `.csv.lz`, the text compressed in blocks.
+ *   `.bin` and `.col`, the rows or column batches of one or more results.
+ *
+ * The values go to the columns `cols` in order. */
+class bulk_reader
+{
+public:
+	enum result_t
+	{
+		ROW_OK,
+		ROW_BAD,     // the row is skipped, the message has been printed
+		ROW_END,
+		ROW_BROKEN   // the file cannot be read further
+	};
+
+private:
+	enum { DATE_CACHE_SIZE = 64 };
+	struct date_entry_t
+	{
+		int key, time;
+	};
+
+	// the dates parsed, as a column usually has few of them
+	date_entry_t dates[DATE_CACHE_SIZE];
+	std::string text;
+	std::vector<int> given_cols;
+
+	bool parse_date(const char *text, size_t len, int &time);
+
+protected:
+	table_manager *tb;
+	std::vector<int> cols;
+	long long row_num;   // of the row read, from 1, or the line for CSV
+	const char *row_unit;
+
+	bulk_reader(table_manager *tb, const std::vector<int> &cols)
+		: given_cols(cols), tb(tb), cols(cols), row_num(0), row_unit("Row")
+	{
+		for(date_entry_t &e : dates)
+			e.key = -1;
+	}
+
+	const char *column_name(int i);
+	/* If `names` are those of the columns given, in any order and case,
+	 * each as `column` or `table.column` of any table, the values that
+	 * follow go to the columns in the order of `names`. Otherwise they go
+	 * in the order given, and false is returned. */
+	bool match_header(const std::vector<const char*> &names);
+	/* Set column `cols[i]` of the temp record to a value given as text
+	 * (`\0` after it), converted to the type of the column. Returns false
+	 * with the message printed if it is not of the type. */
+	bool set_text(int i, const char *text, size_t len, bool quoted);
+	/* the same for a value of a binary format, see result_sink */
+	bool set_binary(int i, int type, uint32_t bits, const char *str, size_t len);
+	void bad_row(const char *reason, int i = -1);
+
+public:
+	virtual ~bulk_reader() {}
+	/* nullptr if the file cannot be opened, the error has been printed */
+	static std::unique_ptr<bulk_reader> open(const char *filename,
+		table_manager *tb, const std::vector<int> &cols);
+	virtual result_t next() = 0;
+
+	bulk_reader(const bulk_reader&) = delete;
+	bulk_reader& operator = (const bulk_reader&) = delete;
+};
+
+#endif
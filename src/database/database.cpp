@@ -1,10 +1,22 @@
 #include "database.h"
+#include "dbms.h"
 #include <fstream>
 #include <string>
 #include <cstring>
 #include <cstdio>
 
-database::database() : opened(false)
+/* The catalog is [magic, table_num] followed by the names of the
+ * tables, each as [length, name]. One of an older version is the fixed
+ * database_info_t below instead, it is rewritten in the new format. */
+struct database_info_t
+{
+	enum { MAX_TABLE_NUM = 32 };
+	int table_num;
+	char db_name[MAX_NAME_LEN];
+	char table_name[MAX_TABLE_NUM][MAX_NAME_LEN];
+};
+
+database::database() : open_num(0), opened(false)
 {
 }
 
@@ -13,79 +25,178 @@ database::~database()
 	if(is_opened()) close();
 }
 
+bool database::load_catalog(const std::string &filename)
+{
+	std::ifstream ifs(filename, std::ios::binary);
+	uint32_t magic = 0;
+	if(!ifs.read((char*)&magic, sizeof(magic)))
+		return false;
+
+	entries.clear();
+	if(magic != DATABASE_CATALOG_MAGIC)
+	{
+		database_info_t info;
+		std::memset(&info, 0, sizeof(info));
+		ifs.seekg(0);
+		ifs.read((char*)&info, sizeof(info));
+		if(!ifs || info.table_num < 0 || info.table_num > database_info_t::MAX_TABLE_NUM)
+			return false;
+		for(int i = 0; i != info.table_num; ++i)
+			entries.push_back({ info.table_name[i], nullptr, 0 });
+		return true;
+	}
+
+	int table_num = 0;
+	ifs.read((char*)&table_num, sizeof(table_num));
+	for(int i = 0; ifs && i != table_num; ++i)
+	{
+		uint16_t len = 0;
+		ifs.read((char*)&len, sizeof(len));
+		std::string name(len, '\0');
+		ifs.read(&name[0], len);
+		entries.push_back({ name, nullptr, 0 });
+	}
+
+	return (bool)ifs;
+}
+
+void database::save_catalog()
+{
+	std::ofstream ofs(db_name + ".database", std::ios::binary);
+	uint32_t magic = DATABASE_CATALOG_MAGIC;
+	int table_num = entries.size();
+	ofs.write((const char*)&magic, sizeof(magic));
+	ofs.write((const char*)&table_num, sizeof(table_num));
+	for(const table_entry_t &e : entries)
+	{
+		uint16_t len = e.name.size();
+		ofs.write((const char*)&len, sizeof(len));
+		ofs.write(e.name.data(), len);
+	}
+}
+
+void database::index_tables()
+{
+	table_ids.clear();
+	for(int i = 0; i != (int)entries.size(); ++i)
+		table_ids[entries[i].name] = i;
+}
+
+// close the tables used least recently, before another one is opened
+void database::evict_tables()
+{
+	uint64_t statement = dbms::get_instance()->get_statement_num();
+	while(open_num >= DATABASE_MAX_OPEN_TABLES)
+	{
+		table_entry_t *victim = nullptr;
+		for(table_entry_t &e : entries)
+		{
+			if(e.table && e.last_used != statement
+				&& (!victim || e.last_used < victim->last_used))
+				victim = &e;
+		}
+
+		// all of them are used by the statement
+		if(!victim) return;
+		victim->table->close();
+		delete victim->table;
+		victim->table = nullptr;
+		--open_num;
+	}
+}
+
 void database::open(const char *db_name)
 {
 	assert(!is_opened());
-	std::string filename = db_name;
-	filename += ".database";
-	std::ifstream ifs(filename, std::ios::binary);
-	ifs.read((char*)&info, sizeof(info));
-	std::memset(tables, 0, sizeof(tables));
-	for(int i = 0; i < info.table_num; ++i)
+	this->db_name = db_name;
+	if(!load_catalog(this->db_name + ".database"))
 	{
-		tables[i] = new table_manager;
-		tables[i]->open(info.table_name[i]);
+		std::fprintf(stderr, "[Error] Fail to open database `%s`.\n", db_name);
+		entries.clear();
+		return;
 	}
+
+	index_tables();
+	open_num = 0;
 	opened = true;
 }
 
 void database::create(const char *db_name)
 {
 	assert(!is_opened());
-	std::memset(&info, 0, sizeof(info));
-	std::memset(tables, 0, sizeof(tables));
-	std::strncpy(info.db_name, db_name, MAX_NAME_LEN);
+	this->db_name = db_name;
+	entries.clear();
+	table_ids.clear();
+	open_num = 0;
 	opened = true;
 }
 
 void database::close()
 {
 	assert(is_opened());
-	for(table_manager *tb : tables)
+	for(table_entry_t &e : entries)
 	{
-		if(tb != nullptr)
+		if(e.table != nullptr)
 		{
-			tb->close();
-			delete tb;
-			tb = nullptr;
+			e.table->close();
+			delete e.table;
+			e.table = nullptr;
 		}
 	}
 
-	std::string filename = info.db_name;
-	filename += ".database";
-	std::ofstream ofs(filename, std::ios::binary);
-	ofs.write((char*)&info, sizeof(info));
+	open_num = 0;
+	if(!page_fs::get_instance()->is_read_only())
+		save_catalog();
+
 	opened = false;
 }
 
+void database::commit()
+{
+	assert(is_opened());
+	for(table_entry_t &e : entries)
+	{
+		if(e.table != nullptr)
+			e.table->save_meta();
+	}
+
+	page_fs::get_instance()->commit();
+}
+
 void database::create_table(const table_header_t *header)
 {
 	if(!is_opened())
 	{
 		std::fprintf(stderr, "[Error] database not opened.\n");
-	} else if(get_table(header->table_name)) {
+	} else if(get_table_id(header->table_name) >= 0) {
 		std::fprintf(stderr, "[Error] table `%s` already exists.\n", header->table_name);
 	} else {
-		int id = info.table_num++;
-		std::strncpy(info.table_name[id], header->table_name, MAX_NAME_LEN);
-		tables[id] = new table_manager;
-		tables[id]->create(header->table_name, header);
+		evict_tables();
+		table_manager *tb = new table_manager;
+		tb->create(header->table_name, header);
+		table_ids[header->table_name] = entries.size();
+		entries.push_back({ header->table_name, tb,
+			dbms::get_instance()->get_statement_num() });
+		++open_num;
 	}
 }
 
 void database::drop()
 {
 	assert(is_opened());
-	for(int i = 0; i != info.table_num; ++i)
+	for(int i = 0; i != (int)entries.size(); ++i)
 	{
-		tables[i]->drop();
-		delete tables[i];
-		tables[i] = nullptr;
+		// opened one at a time, so as not to hold all of them open
+		table_manager *tb = get_table(i);
+		tb->drop();
+		delete tb;
+		entries[i].table = nullptr;
+		--open_num;
 	}
 
-	info.table_num = 0;
-	std::string filename = info.db_name;
-	filename += ".database";
+	entries.clear();
+	table_ids.clear();
+	std::string filename = db_name + ".database";
 	close();
 	std::remove(filename.c_str());
 }
@@ -94,27 +205,34 @@ table_manager* database::get_table(const char *name)
 {
 	assert(is_opened());
 	int id = get_table_id(name);
-	return id >= 0 ? tables[id] : nullptr;
+	return id >= 0 ? get_table(id) : nullptr;
 }
 
 table_manager* database::get_table(int id)
 {
 	assert(is_opened());
-	if(id >= 0 && id < info.table_num)
-		return tables[id];
-	else return nullptr;
+	if(id < 0 || id >= (int)entries.size())
+		return nullptr;
+
+	table_entry_t &e = entries[id];
+	uint64_t statement = dbms::get_instance()->get_statement_num();
+	if(e.table == nullptr)
+	{
+		evict_tables();
+		e.table = new table_manager;
+		e.table->open(e.name.c_str());
+		++open_num;
+	}
+
+	e.last_used = statement;
+	return e.table;
 }
 
 int database::get_table_id(const char *name)
 {
 	assert(is_opened());
-	for(int i = 0; i < info.table_num; ++i)
-	{
-		if(std::strcmp(name, info.table_name[i]) == 0)
-			return i;
-	}
-
-	return -1;
+	auto it = table_ids.find(name);
+	return it != table_ids.end() ? it->second : -1;
 }
 
 void database::drop_table(const char *name)
@@ -127,24 +245,20 @@ void database::drop_table(const char *name)
 		return;
 	}
 
-	--info.table_num;
-	tables[id]->drop();
-	delete tables[id];
-	for(int i = id; i < info.table_num; ++i)
-	{
-		tables[i] = tables[i + 1];
-		std::strcpy(info.table_name[i], info.table_name[i + 1]);
-	}
-
-	tables[info.table_num] = nullptr;
+	table_manager *tb = get_table(id);
+	tb->drop();
+	delete tb;
+	--open_num;
+	entries.erase(entries.begin() + id);
+	index_tables();
 }
 
 void database::show_info()
 {
 	std::printf("======== Database Info Begin ========\n");
-	std::printf("Database name = %s\n", info.db_name);
-	std::printf("Table number  = %d\n", info.table_num);
-	for(int i = 0; i != info.table_num; ++i)
-		std::printf("  [table] name = %s\n", info.table_name[i]);
+	std::printf("Database name = %s\n", db_name.c_str());
+	std::printf("Table number  = %d\n", (int)entries.size());
+	for(const table_entry_t &e : entries)
+		std::printf("  [table] name = %s\n", e.name.c_str());
 	std::printf("======== Database Info End   ========\n");
 }
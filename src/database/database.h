@@ -3,23 +3,39 @@
 #include "../defs.h"
 #include "../table/table.h"
 #include "../expression/expression.h"
+#include <stdint.h>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+/* The tables of a database are listed in its catalog, the `.database`
+ * file, and each is opened once it is first used. At most
+ * DATABASE_MAX_OPEN_TABLES of them are kept open, beyond that the one
+ * used least recently is closed, but never one used by the current
+ * statement, as its table_manager is valid until the statement ends. */
 class database
 {
-	struct database_info
+	struct table_entry_t
 	{
-		int table_num;
-		char db_name[MAX_NAME_LEN];
-		char table_name[MAX_TABLE_NUM][MAX_NAME_LEN];
-	} info;
+		std::string name;
+		table_manager *table;   // nullptr until opened
+		uint64_t last_used;     // the statement it was used in last
+	};
 
-	table_manager *tables[MAX_TABLE_NUM];
+	std::string db_name;
+	std::vector<table_entry_t> entries;
+	std::unordered_map<std::string, int> table_ids;
+	int open_num;
 
 	bool opened;
+
+	bool load_catalog(const std::string &filename);
+	void save_catalog();
+	void index_tables();
+	void evict_tables();
 public:
 	database();
 	~database();
@@ -28,7 +44,9 @@ public:
 	void create(const char *db_name);
 	void drop();
 	void close();
-	const char *get_name() { return info.db_name; }
+	/* commit the changes made by a statement to all tables */
+	void commit();
+	const char *get_name() { return db_name.c_str(); }
 
 	table_manager *get_table(const char *name);
 	table_manager *get_table(int id);
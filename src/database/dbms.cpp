@@ -5,18 +5,48 @@
 #include "../expression/expression.h"
 #include "../utils/type_cast.h"
 #include "../table/record.h"
+#include "../fs/page_fs.h"
+#include "hash_aggregate.h"
+#include "row_sort.h"
+#include "bulk_load.h"
+#include <cctype>
 #include <vector>
 #include <limits>
 #include <algorithm>
+#include <thread>
+#include <chrono>
 
 struct __cache_clear_guard
 {
 	~__cache_clear_guard() { expression::cache_clear(); }
 };
 
+static void compile_exprs(const std::vector<expr_node_t*> &exprs,
+	arena_vector<compiled_expression> &programs, arena *mem)
+{
+	programs = arena_vector<compiled_expression>(mem);
+	programs.reserve(exprs.size());
+	for(expr_node_t *expr : exprs)
+		programs.emplace_back(expr, mem);
+}
+
+/* the rows of `table` satisfying `and_cond` as the join planner
+ * estimates them, for EXPLAIN */
+static double estimate_rows(table_manager *table, const std::vector<expr_node_t*> &and_cond)
+{
+	std::vector<table_manager*> tables(1, table);
+	std::vector<join_step_t> steps;
+	join_planner planner(tables);
+	return planner.plan(and_cond, steps) ? steps[0].rows : -1;
+}
+
 dbms::dbms()
-	: output_file(stdout), cur_db(nullptr)
+	: output_file(nullptr), output_format(RESULT_CSV), cur_db(nullptr), session(&console),
+	  index_fill_factor(BTREE_BULK_FILL_FACTOR), index_bloom_bits(0), plan(nullptr),
+	  statement_num(1)
 {
+	scan_threads = std::max(1u, std::min<unsigned>(
+		std::thread::hardware_concurrency(), PARALLEL_SCAN_MAX_THREADS));
 }
 
 dbms::~dbms()
@@ -26,18 +56,98 @@ dbms::~dbms()
 
 void dbms::switch_select_output(const char *filename)
 {
-	if(output_file != stdout)
+	if(output_file)
 		std::fclose(output_file);
+	output_format = RESULT_CSV;
 	if(std::strcmp(filename, "stdout") == 0)
-		output_file = stdout;
-	else output_file = std::fopen(filename, "w");
+		output_file = nullptr;
+	else if(!(output_file = std::fopen(filename, "w")))
+		std::fprintf(stderr, "[Error] Fail to open `%s`, the rows go to stdout.\n", filename);
+	else output_format = result_format_of(filename);
+}
+
+void dbms::switch_session(session_t *s)
+{
+	if(s == nullptr)
+		s = &console;
+	session->db = cur_db;
+	session->output_file = output_file;
+	session->output_format = output_format;
+	session = s;
+	cur_db = s->db;
+	++statement_num;
+	output_file = s->output_file;
+	output_format = s->output_format;
+}
+
+void dbms::set_variable(const char *name, int value)
+{
+	if(strcasecmp(name, "buffer_pool_pages") == 0)
+	{
+		if(value <= 0)
+		{
+			std::fprintf(stderr, "[Error] Invalid buffer pool size %d.\n", value);
+		} else if(page_fs::get_instance()->resize(value)) {
+			std::printf("[Info] Buffer pool resized to %d pages.\n",
+				page_fs::get_instance()->get_capacity());
+		}
+	} else if(strcasecmp(name, "index_fill_factor") == 0) {
+		if(value < 50 || value > 100)
+		{
+			std::fprintf(stderr, "[Error] Index fill factor must be between 50 and 100.\n");
+		} else {
+			index_fill_factor = value;
+			std::printf("[Info] Index fill factor set to %d%%.\n", value);
+		}
+	} else if(strcasecmp(name, "index_bloom_bits") == 0) {
+		if(value < 0 || value > INDEX_BLOOM_MAX_BITS)
+		{
+			std::fprintf(stderr, "[Error] Bloom filter bits must be between 0 and %d.\n",
+				INDEX_BLOOM_MAX_BITS);
+		} else if(value == 0) {
+			index_bloom_bits = 0;
+			std::printf("[Info] Bloom filters disabled for new indices.\n");
+		} else {
+			index_bloom_bits = value;
+			std::printf("[Info] Bloom filters of %d bits per key for new indices.\n", value);
+		}
+	} else if(strcasecmp(name, "page_compression") == 0) {
+		page_fs::get_instance()->set_compression(value != 0);
+		std::printf("[Info] Page compression %s for new tables.\n", value ? "enabled" : "disabled");
+	} else if(strcasecmp(name, "scan_threads") == 0) {
+		if(value < 1 || value > PARALLEL_SCAN_MAX_THREADS)
+		{
+			std::fprintf(stderr, "[Error] Scan threads must be between 1 and %d.\n",
+				PARALLEL_SCAN_MAX_THREADS);
+		} else {
+			scan_threads = value;
+			std::printf("[Info] Scan threads set to %d.\n", value);
+		}
+	} else {
+		std::fprintf(stderr, "[Error] Unknown variable `%s`.\n", name);
+	}
+}
+
+void dbms::set_variable(const char *name, const char *value)
+{
+	if(strcasecmp(name, "cache_policy") == 0)
+	{
+		if(page_fs::get_instance()->set_policy(value))
+		{
+			std::printf("[Info] Cache policy switched to %s.\n",
+				page_fs::get_instance()->get_policy());
+		}
+	} else {
+		std::fprintf(stderr, "[Error] Unknown variable `%s`.\n", name);
+	}
 }
 
 template<typename Callback>
 void dbms::iterate(
 	std::vector<table_manager*> required_tables,
 	expr_node_t *cond,
-	Callback callback)
+	Callback callback,
+	uint32_t used_cols)
 {
 	if(required_tables.size() == 1)
 	{
@@ -47,95 +157,235 @@ void dbms::iterate(
 			rm_list[0] = rm;
 			rid_list[0] = rid;
 			return callback(required_tables, rm_list, rid_list);
-		} );
+		}, used_cols);
 	} else {
 		iterate_many_tables(required_tables, cond, callback);
-		std::puts("[Info] Join many tables by enumerating.");
 	}
 }
 
+/* The callback needs only the columns `used_cols` of the cached record,
+ * if they are in the index the records are not read (a covering scan),
+ * and the record passed to the callback is nullptr. */
 template<typename Callback>
 bool dbms::iterate_one_table_with_index(
 		table_manager* table,
 		expr_node_t *cond,
-		Callback callback)
+		Callback callback,
+		uint32_t used_cols)
 {
 	std::vector<expr_node_t*> and_cond;
 	extract_and_cond(cond, and_cond);
-	expr_node_t *index_cond = nullptr;
-	index_manager *index = nullptr;
+	index_range_t range;
+	if(!choose_index_range(table, and_cond, range))
+	{
+		bool batched = iterate_batches(table, cond,
+			[&](batch_scanner &scan, const std::vector<int> &sel) -> bool {
+				for(int i : sel)
+				{
+					record_manager rm(scan.get_pager());
+					rm.open(scan.get_position(i), false);
+					table->cache_record(scan.get_record(i));
+					if(!callback(table, &rm, *(const int*)scan.get_record(i)))
+						return false;
+				}
+
+				return true;
+			} );
 
-	auto get_index = [&](column_ref_t *col) -> index_manager*
+		if(!batched) iterate_one_table(table, cond, callback);
+		return false;
+	}
+
+	iterate_index_range(table, cond, range, callback, used_cols);
+	return true;
+}
+
+/* Scan the entries of `range`, the rest of `cond` is checked on each
+ * row. The rows are visited in the order of rids, as in a scan of the
+ * table, unless index_range_t::key_order asks for the order of the
+ * index. `used_cols` is the same as that of
+ * iterate_one_table_with_index. */
+template<typename Callback>
+void dbms::iterate_index_range(
+		table_manager *table,
+		expr_node_t *cond,
+		const index_range_t &range,
+		Callback callback,
+		uint32_t used_cols)
+{
+	// a hash index keeps no key in order to read the columns from
+	bool hashed = range.index->is_hash();
+	uint32_t index_cols = (1u << range.cid) | (1u << table->get_main_index());
+	bool covering = !hashed && collect_columns(table, cond, used_cols) && !(used_cols & ~index_cols);
+	int node = -1;
+	if(plan)
 	{
-		int cid = table->lookup_column(col->column);
-		if(cid < 0) return nullptr;
-		return table->get_index(cid);
+		std::string detail = std::string("on ") + table->get_table_name()
+			+ (hashed ? " using hash index (" : " using index (")
+			+ table->get_column_name(range.cid) + ")";
+		if(!range.prefix.empty()) detail += " prefix '" + range.prefix + "'";
+		if(covering) detail += " covering";
+		if(cond) detail += " filter " + query_plan::describe(cond);
+		const char *name = hashed ? "Index Lookup"
+			: range.reverse ? "Index Scan Backward" : "Index Scan";
+		node = plan_add(name, detail, range.sel * table->get_record_num());
+		if(plan_only()) return;
+	}
+
+	operator_stats stats(plan, node);
+
+	compiled_expression where(cond, &query_arena);
+	auto visit = [&](record_manager *rm, int rid) -> bool {
+		++stats.examined;
+		bool result = false;
+		try {
+			result = !cond || typecast::expr_to_bool(where.eval());
+		} catch(const char *msg) {
+			std::puts(msg);
+			return false;
+		}
+
+		if(!result) return true;
+		++stats.emitted;
+		return callback(table, covering ? nullptr : rm, rid);
 	};
 
-	for(expr_node_t *expr : and_cond)
+	if(hashed)
 	{
-		if(expr->op == OPERATOR_EQ)
+		// the rids are all found before the callback may change the index
+		std::vector<int> rids;
+		range.index->find(range.key.data(), rids);
+		std::sort(rids.begin(), rids.end());
+		for(int rid : rids)
 		{
-			if(expr->right->term_type == TERM_COLUMN_REF)
-				std::swap(expr->right, expr->left);
+			record_manager rm = table->get_record_ptr(rid);
+			table->cache_record(&rm);
+			if(!visit(&rm, rid))
+				break;
+		}
 
-			if(expr->left->term_type == TERM_COLUMN_REF && expr->right->term_type != TERM_COLUMN_REF)
+		return;
+	}
+
+	arena_vector<compiled_expression> upper_conds;
+	compile_exprs(range.upper_conds, upper_conds, &query_arena);
+	int first_rid = range.with_nulls
+		? std::numeric_limits<int>::min() : std::numeric_limits<int>::max();
+	// the column of the entry is cached for the bounds to be checked
+	auto in_range = [&](std::pair<int, int> pos, int &rid) -> bool {
+		rid = table->cache_record_from_index(pos, range.cid);
+		if(!range.prefix.empty())
+		{
+			const char *val = table->get_cached_column(range.cid);
+			if(!val || std::strncmp(val, range.prefix.data(), range.prefix.size()) != 0)
+				return false;
+		}
+
+		for(compiled_expression &c : upper_conds)
+		{
+			if(!typecast::expr_to_bool(c.eval()))
+				return false;
+		}
+
+		return true;
+	};
+
+	auto it = range.reverse ? range.index->get_iterator_last()
+		: range.key.empty() ? range.index->get_iterator_lower_bound(nullptr, first_rid)
+		: range.index->get_iterator_lower_bound(range.key.data());
+	if(!range.key_order)
+	{
+		/* The entries are all found before the callback may change the
+		 * index, and the rows are visited in the order of rids, whatever
+		 * the order of the keys. A covering scan caches the entries again,
+		 * its callback does not modify the index. */
+		std::vector<std::pair<int, std::pair<int, int>>> entries;
+		int rid;
+		try {
+			for(; !it.is_end() && in_range(it.get(), rid); it.next())
+				entries.push_back({ rid, it.get() });
+		} catch(const char *msg) {
+			std::puts(msg);
+			return;
+		}
+
+		std::sort(entries.begin(), entries.end());
+		for(auto &e : entries)
+		{
+			record_manager rm(it.get_pager());
+			if(covering)
 			{
-				index = get_index(expr->left->column_ref);
-				if(index)
-				{
-					index_cond = expr;
-					break;
-				}
+				table->cache_record_from_index(e.second, range.cid);
+			} else {
+				rm = table->get_record_ptr(e.first);
+				table->cache_record(&rm);
 			}
+
+			if(!visit(&rm, e.first))
+				break;
 		}
-	}
 
-	if(!index_cond)
-	{
-		iterate_one_table(table, cond, callback);
-		return false;
+		return;
 	}
 
-	char *key = nullptr;
-	switch(index_cond->right->term_type)
-	{
-		case TERM_INT:
-		case TERM_DATE:
-			key = (char*)&index_cond->right->val_i;
-			break;
-		case TERM_FLOAT:
-			key = (char*)&index_cond->right->val_f;
-			break;
-		case TERM_STRING:
-			key = index_cond->right->val_s;
-			break;
-		case TERM_BOOL:
-			key = (char*)&index_cond->right->val_b;
-			break;
-		default:
-			break;
-	}
-	
-	auto it = index->get_iterator_lower_bound(key);
-	for(; !it.is_end(); it.next())
+	for(; !it.is_end(); range.reverse ? it.prev() : it.next())
 	{
 		int rid;
-		record_manager rm = table->open_record_from_index_lower_bound(it.get(), &rid);
-		table->cache_record(&rm);
-
-		bool join_ret = false;
+		bool inside = false;
 		try {
-			join_ret = typecast::expr_to_bool(expression::eval(index_cond));
+			inside = in_range(it.get(), rid);
 		} catch(const char *msg) {
 			std::puts(msg);
-			iterate_one_table(table, cond, callback);
-			return false;
+			return;
 		}
 
-		if(!join_ret) break;
+		if(!inside) break;
+		record_manager rm(it.get_pager());
+		if(!covering)
+		{
+			rm = table->get_record_ptr(rid);
+			table->cache_record(&rm);
+		}
 
-		if(!callback(table, &rm, rid))
+		if(!visit(&rm, rid))
+			break;
+	}
+}
+
+/* Scan the table a batch of rows at a time, `callback(scan, sel)` is
+ * called with the rows of each batch satisfying `cond`. Returns false
+ * if `cond` cannot be run by batch_filter, nothing is scanned then. */
+template<typename Callback>
+bool dbms::iterate_batches(table_manager *table, expr_node_t *cond, Callback callback)
+{
+	std::vector<expr_node_t*> and_cond;
+	extract_and_cond(cond, and_cond);
+	batch_filter filter;
+	if(!filter.compile(table, and_cond))
+		return false;
+
+	int node = -1;
+	if(plan)
+	{
+		node = plan_add(table->is_columnar() ? "Columnar Scan" : "Batch Scan",
+			std::string("on ") + table->get_table_name()
+			+ (cond ? " filter " + query_plan::describe(cond) : ""),
+			estimate_rows(table, and_cond));
+		if(plan_only()) return true;
+	}
+
+	operator_stats stats(plan, node);
+	batch_scanner scan(table, &filter);
+	std::vector<int> sel;
+	while(int num = scan.next())
+	{
+		sel.resize(num);
+		for(int i = 0; i != num; ++i)
+			sel[i] = i;
+		filter.apply(scan, sel);
+		stats.examined += num;
+		stats.emitted += sel.size();
+		if(!sel.empty() && !callback(scan, sel))
 			break;
 	}
 
@@ -148,10 +398,24 @@ void dbms::iterate_one_table(
 		expr_node_t *cond,
 		Callback callback)
 {
+	int node = -1;
+	if(plan)
+	{
+		std::vector<expr_node_t*> and_cond;
+		extract_and_cond(cond, and_cond);
+		node = plan_add("Seq Scan", std::string("on ") + table->get_table_name()
+			+ (cond ? " filter " + query_plan::describe(cond) : ""),
+			estimate_rows(table, and_cond));
+		if(plan_only()) return;
+	}
+
+	operator_stats stats(plan, node);
+	compiled_expression where(cond, &query_arena);
 	auto bit = table->get_record_iterator_lower_bound(0);
 	for(; !bit.is_end(); bit.next())
 	{
 		int rid;
+		++stats.examined;
 		record_manager rm(bit.get_pager());
 		rm.open(bit.get(), false);
 		rm.read(&rid, 4);
@@ -160,7 +424,7 @@ void dbms::iterate_one_table(
 		{
 			bool result = false;
 			try {
-				result = typecast::expr_to_bool(expression::eval(cond));
+				result = typecast::expr_to_bool(where.eval());
 			} catch(const char *msg) {
 				std::puts(msg);
 				return;
@@ -169,11 +433,243 @@ void dbms::iterate_one_table(
 			if(!result) continue;
 		}
 
+		++stats.emitted;
 		if(!callback(table, &rm, rid))
 			break;
 	}
 }
 
+/* Choose the most selective of the index ranges of the conjuncts, the
+ * conjuncts on the same column are intersected. Returns false if the
+ * table should be scanned. */
+bool dbms::choose_index_range(table_manager *table,
+	const std::vector<expr_node_t*> &and_cond, index_range_t &range)
+{
+	struct bounds_t
+	{
+		int cid;
+		double lower, upper;
+		bool is_eq;
+		const char *eq_str;
+		std::string prefix;
+		std::vector<expr_node_t*> upper_conds;
+	};
+
+	const double inf = std::numeric_limits<double>::infinity();
+	std::vector<bounds_t> bounds;
+	auto find_bounds = [&](int cid) {
+		auto b = std::find_if(bounds.begin(), bounds.end(),
+			[cid](const bounds_t &b) { return b.cid == cid; } );
+		if(b != bounds.end())
+			return b;
+		bounds.push_back({ cid, -inf, inf, false, nullptr, std::string(), {} });
+		return bounds.end() - 1;
+	};
+
+	for(expr_node_t *expr : and_cond)
+	{
+		operator_type_t op = expr->op;
+		if(op == OPERATOR_LIKE)
+		{
+			// column LIKE 'abc%' scans the entries starting with `abc`
+			expr_node_t *col = expr->left, *val = expr->right;
+			if(col->op != OPERATOR_NONE || col->term_type != TERM_COLUMN_REF
+				|| val->op != OPERATOR_NONE || val->term_type != TERM_STRING)
+				continue;
+			int cid = table->lookup_column(col->column_ref->column);
+			if(cid < 0 || !table->get_index(cid) || table->get_index(cid)->is_hash()
+				|| table->get_column_type(cid) != COL_TYPE_VARCHAR)
+				continue;
+			std::string prefix = like_matcher(val->val_s).get_prefix();
+			if(prefix.empty())
+				continue;
+			auto b = find_bounds(cid);
+			if(prefix.size() > b->prefix.size())
+				b->prefix = prefix;
+			continue;
+		}
+
+		if(op != OPERATOR_EQ && op != OPERATOR_LT && op != OPERATOR_LEQ
+			&& op != OPERATOR_GT && op != OPERATOR_GEQ)
+			continue;
+
+		expr_node_t *col = expr->left, *val = expr->right;
+		if(val->term_type == TERM_COLUMN_REF)
+		{
+			// constant op column
+			std::swap(col, val);
+			switch(op)
+			{
+				case OPERATOR_LT:  op = OPERATOR_GT;  break;
+				case OPERATOR_GT:  op = OPERATOR_LT;  break;
+				case OPERATOR_LEQ: op = OPERATOR_GEQ; break;
+				case OPERATOR_GEQ: op = OPERATOR_LEQ; break;
+				default: break;
+			}
+		}
+
+		if(col->op != OPERATOR_NONE || col->term_type != TERM_COLUMN_REF || val->op != OPERATOR_NONE)
+			continue;
+		int cid = table->lookup_column(col->column_ref->column);
+		if(cid < 0 || !table->get_index(cid))
+			continue;
+		// a hash index finds the equal keys only
+		if(op != OPERATOR_EQ && table->get_index(cid)->is_hash())
+			continue;
+
+		// convert the constant to the type of the column
+		double value = 0;
+		const char *str = nullptr;
+		int type = table->get_column_type(cid);
+		if(type == COL_TYPE_VARCHAR && val->term_type == TERM_STRING) {
+			if(op != OPERATOR_EQ) continue;
+			str = val->val_s;
+		} else if(type == COL_TYPE_DATE && val->term_type == TERM_DATE) {
+			expression date = expression::eval(val);
+			if(date.type != TERM_DATE) continue;
+			value = date.val_i;
+		} else if(type == COL_TYPE_INT && val->term_type == TERM_INT) {
+			value = val->val_i;
+		} else if(type == COL_TYPE_FLOAT && val->term_type == TERM_FLOAT) {
+			value = val->val_f;
+		} else {
+			continue;
+		}
+
+		auto b = find_bounds(cid);
+		if(str)
+		{
+			if(b->eq_str) continue;  // checked on each row
+			b->eq_str = str;
+			b->is_eq = true;
+			b->upper_conds.push_back(expr);
+			continue;
+		}
+
+		if(op == OPERATOR_EQ || op == OPERATOR_GT || op == OPERATOR_GEQ)
+			b->lower = std::max(b->lower, value);
+		if(op == OPERATOR_EQ || op == OPERATOR_LT || op == OPERATOR_LEQ)
+		{
+			b->upper = std::min(b->upper, value);
+			b->upper_conds.push_back(expr);
+		}
+
+		b->is_eq = b->is_eq || op == OPERATOR_EQ;
+	}
+
+	const table_stats_t *stats = table->get_stats();
+	const bounds_t *best = nullptr;
+	for(const bounds_t &b : bounds)
+	{
+		const column_stats_t *cs = stats ? &stats->cols[b.cid] : nullptr;
+		double sel;
+		if(b.is_eq) {
+			sel = cs ? cs->eq_selectivity() : STATS_DEFAULT_EQ_SELECTIVITY;
+		} else if(!b.prefix.empty()) {
+			sel = STATS_DEFAULT_SELECTIVITY;
+		} else if(cs && cs->bucket_num) {
+			sel = cs->range_selectivity(b.lower, b.upper);
+		} else {
+			sel = 1;
+			if(b.lower != -inf) sel *= STATS_DEFAULT_SELECTIVITY;
+			if(b.upper != inf) sel *= STATS_DEFAULT_SELECTIVITY;
+		}
+
+		if(b.lower > b.upper) sel = 0;
+		if(sel < range.sel)
+		{
+			range.sel = sel;
+			best = &b;
+		}
+	}
+
+	if(!best || range.sel > INDEX_SCAN_MAX_SELECTIVITY)
+		return false;
+
+	range.cid = best->cid;
+	range.index = table->get_index(best->cid);
+	range.upper_conds = best->upper_conds;
+	range.key.clear();
+	range.prefix.clear();
+	int length = table->get_column_length(best->cid);
+	if(best->eq_str) {
+		range.key.assign(best->eq_str, best->eq_str + std::strlen(best->eq_str) + 1);
+		range.key.resize(std::max<size_t>(range.key.size(), length));
+	} else if(!best->prefix.empty()) {
+		range.prefix = best->prefix;
+		range.key.assign(range.prefix.begin(), range.prefix.end());
+		range.key.resize(std::max<size_t>(range.key.size() + 1, length));
+	} else if(best->lower != -inf) {
+		range.key.resize(std::max(length, 4));
+		if(table->get_column_type(best->cid) == COL_TYPE_FLOAT) {
+			float key = best->lower;
+			std::memcpy(range.key.data(), &key, sizeof(key));
+		} else {
+			int key = best->lower;
+			std::memcpy(range.key.data(), &key, sizeof(key));
+		}
+	}
+
+	return true;
+}
+
+/* Choose to scan the index of the column of ORDER BY instead of sorting.
+ * The range chosen for the conjuncts is scanned in order if it is on the
+ * same column and ascending. Otherwise the whole index is scanned, only
+ * if there is no range and a LIMIT stops the scan early. */
+bool dbms::choose_index_order(table_manager *table,
+	const std::vector<expr_node_t*> &and_cond, const order_by_item_t *item,
+	bool has_limit, index_range_t &range)
+{
+	const expr_node_t *expr = item->expr;
+	if(expr->op != OPERATOR_NONE || expr->term_type != TERM_COLUMN_REF)
+		return false;
+	const column_ref_t *ref = expr->column_ref;
+	if(ref->table && std::strcmp(ref->table, table->get_table_name()) != 0)
+		return false;
+	int cid = table->lookup_column(ref->column);
+	if(cid < 0 || !table->get_index(cid) || table->get_index(cid)->is_hash())
+		return false;
+
+	bool found = choose_index_range(table, and_cond, range);
+	if(found && range.cid == cid && !item->desc)
+		return range.key_order = true;
+	if(found || !has_limit)
+		return false;
+
+	range = index_range_t();
+	range.index = table->get_index(cid);
+	range.cid = cid;
+	range.reverse = item->desc;
+	range.with_nulls = true;
+	range.key_order = true;
+	return true;
+}
+
+/* Add the columns of `table` which `expr` refers to, returns false if
+ * a column is not found in it. */
+bool dbms::collect_columns(table_manager *table, const expr_node_t *expr, uint32_t &cols)
+{
+	if(!expr) return true;
+	if(expr->op == OPERATOR_NONE)
+	{
+		if(expr->term_type != TERM_COLUMN_REF)
+			return true;
+		const column_ref_t *ref = expr->column_ref;
+		if(ref->table && std::strcmp(ref->table, table->get_table_name()) != 0)
+			return false;
+		int cid = table->lookup_column(ref->column);
+		if(cid < 0) return false;
+		cols |= 1u << cid;
+		return true;
+	}
+
+	bool ret = collect_columns(table, expr->left, cols);
+	if(!(expr->op & OPERATOR_UNARY))
+		ret = collect_columns(table, expr->right, cols) && ret;
+	return ret;
+}
+
 void dbms::extract_and_cond(expr_node_t *cond, std::vector<expr_node_t*> &and_cond)
 {
 	if(!cond) return;
@@ -191,273 +687,310 @@ void dbms::iterate_many_tables(
 	const std::vector<table_manager*> &table_list,
 	expr_node_t *cond, Callback callback)
 {
-	std::vector<record_manager*> record_list(table_list.size());
-	std::vector<int> rid_list(table_list.size());
+	int len = table_list.size();
+	std::vector<record_manager*> record_list(len);
+	std::vector<int> rid_list(len);
 	std::vector<expr_node_t*> and_cond;
 	extract_and_cond(cond, and_cond);
-	auto lookup_table = [&](const char *name) {
-		for(int i = 0; i < (int)table_list.size(); ++i)
-			if(std::strcmp(name, table_list[i]->get_table_name()) == 0)
-				return i;
-		return -1;
-	};
 
-	// edge
-	std::vector<std::vector<int>> E(table_list.size());
-	// join cond
-	std::vector<std::vector<expr_node_t*>> J(table_list.size());
-	for(auto &v : E) v.resize(table_list.size());
-	for(auto &v : J) v.resize(table_list.size());
+	std::vector<join_step_t> steps;
+	join_planner planner(table_list);
+	if(!planner.plan(and_cond, steps))
+		return;
+	debug_printf("Estimated join cost: %g.\n", planner.get_cost());
 
-	// setup join condition graph
-	for(expr_node_t *c : and_cond)
+	int node = -1;
+	if(plan)
 	{
-		if(c->op == OPERATOR_EQ && 
-				c->left->term_type == TERM_COLUMN_REF &&
-				c->right->term_type == TERM_COLUMN_REF)
+		char cost[32];
+		std::snprintf(cost, sizeof(cost), "cost=%.0f", planner.get_cost());
+		node = plan_add("Join", cost, steps.back().rows);
+		plan->enter();
+		for(const join_step_t &step : steps)
 		{
-			int tid1 = lookup_table(c->left->column_ref->table);
-			int tid2 = lookup_table(c->right->column_ref->table);
-			if(tid1 == -1 || tid2 == -1)
-			{
-				std::fprintf(stderr, "[Error] Table not found!\n");
-				return;
-			}
-
-			table_manager *tb1 = table_list[tid1];
-			table_manager *tb2 = table_list[tid2];
-
-			int cid1 = tb1->lookup_column(c->left->column_ref->column);
-			int cid2 = tb2->lookup_column(c->right->column_ref->column);
-			if(cid1 == -1 || cid2 == -1)
+			table_manager *tb = table_list[step.table];
+			std::string detail = std::string("on ") + tb->get_table_name();
+			if(step.access == join_step_t::INDEX)
 			{
-				std::fprintf(stderr, "[Error] Column not found!\n");
-				return;
-			}
-
-			index_manager *idx1 = tb1->get_index(cid1);
-			index_manager *idx2 = tb2->get_index(cid2);
-			if(!idx1 && !idx2)
-				continue;
-
-			if(idx2)
-			{
-				E[tid2][tid1] = 1;
-				J[tid2][tid1] = c;
-			}
-			
-			if(idx1)
-			{
-				E[tid1][tid2] = 1;
-				J[tid1][tid2] = c;
+				detail += std::string(tb->get_index(step.cid)->is_hash() ? " using hash index (" : " using index (")
+					+ tb->get_column_name(step.cid) + ")";
+				if(tb->get_index(step.cid)->get_filter_root())
+					detail += " with bloom filter";
 			}
+			if(step.join_cond)
+				detail += " by " + query_plan::describe(step.join_cond);
+			for(size_t i = 0; i != step.conds.size(); ++i)
+				detail += (i ? " AND " : " filter ") + query_plan::describe(step.conds[i]);
+			const char *name = step.access == join_step_t::HASH ? "Hash Lookup"
+				: step.access == join_step_t::INDEX ? "Index Lookup" : "Seq Scan";
+			plan_add(name, detail, step.rows);
 		}
-	}
 
-	// find the longest path
-	int *mark = new int[table_list.size()];
-	int *path = new int[table_list.size()];
-	int max_depth = 0, start = 0;
-	for(int i = 0; i < (int)table_list.size(); ++i)
-	{
-		int m = 0;
-		std::memset(mark, 0, table_list.size() * sizeof(int));
-		find_longest_path(i, 0, mark, path, E, ~0u >> 1, m);
-		if(m > max_depth)
-		{
-			max_depth = m;
-			start = i;
-		}
+		plan->leave();
+		if(plan_only()) return;
 	}
 
-	int _;
-	std::memset(mark, 0, table_list.size() * sizeof(int));
-	_ = find_longest_path(start, 0, mark, path, E, max_depth, _);
-	assert(_);
-
-	// generate iteration sequence
-	std::memset(mark, 0, table_list.size() * sizeof(int));
-	for(int i = 0; i <= max_depth; ++i)
-		mark[path[i]] = 1;
-
-	int cur = max_depth, len = table_list.size();
+	// setup iteration variable, the conditions are compiled once for all the rows
+	std::vector<join_level_t> levels(len);
 	for(int i = 0; i < len; ++i)
-		if(!mark[i])
-			path[++cur] = i;
-
-	// setup iteration variable
-	index_manager **index_ref = new index_manager*[len];
-	int *index_cid = new int[len];
-	std::fill(index_ref, index_ref + len, nullptr);
-	std::fill(index_cid, index_cid + len, -1);
-
-	for(int i = 0; i < max_depth; ++i)
-	{
-		expr_node_t *join_node = J[path[i]][path[i + 1]];
-		if(std::strcmp(join_node->left->column_ref->table, table_list[path[i]]->get_table_name()) == 0)
-		{
-			index_cid[i] = table_list[path[i + 1]]->lookup_column(
-					join_node->right->column_ref->column);
-			index_ref[i] = table_list[path[i]]->get_index(
-					table_list[path[i]]->lookup_column(
-						join_node->left->column_ref->column)
-					);
-		} else {
-			index_cid[i] = table_list[path[i + 1]]->lookup_column(
-					join_node->left->column_ref->column);
-			index_ref[i] = table_list[path[i]]->get_index(
-					table_list[path[i]]->lookup_column(
-						join_node->right->column_ref->column)
-					);
+	{
+		join_level_t &level = levels[i];
+		level.step = steps[i];
+		table_manager *tb = table_list[level.step.table];
+		if(level.step.access == join_step_t::HASH)
+		{
+			build_join_hash(tb, level.step.cid, level.hash);
+		} else if(level.step.access == join_step_t::INDEX) {
+			level.index = tb->get_index(level.step.cid);
+			assert(level.index);
 		}
 
-		assert(index_ref[i]);
+		level.join_cond = compiled_expression(level.step.join_cond, &query_arena);
+		compile_exprs(level.step.conds, level.conds, &query_arena);
 	}
 
-	iterate_many_tables_impl(
-		table_list, record_list, rid_list,
-		J, path, index_cid, index_ref,
-		cond, callback, len - 1);
+	operator_stats stats(plan, node);
+	iterate_join_levels(table_list, record_list, rid_list, levels, 0, callback);
 
-	// debug info
-	std::printf("[Info] Iteration order: ");
+	// the levels are counted as the rows of the join
 	for(int i = 0; i < len; ++i)
 	{
-		if(i != 0) std::printf(", ");
-		std::printf("%s", table_list[path[len - i - 1]]->get_table_name());
-	}
-
-	std::printf("\n[Info] Index use: ");
-	for(int i = 0; i < max_depth; ++i)
-	{
-		if(i != 0) std::printf(", ");
-		expr_node_t *node = J[path[i]][path[i + 1]];
-		std::printf("%s.%s-%s.%s",
-			node->left->column_ref->table,
-			node->left->column_ref->column,
-			node->right->column_ref->table,
-			node->right->column_ref->column
-		);
+		stats.examined += levels[i].examined;
+		if(node >= 0)
+		{
+			plan->get(node + 1 + i).examined = levels[i].examined;
+			plan->get(node + 1 + i).emitted = levels[i].emitted;
+		}
 	}
 
-	std::puts("");
-
-	delete []mark;
-	delete []path;
-	delete []index_cid;
-	delete []index_ref;
+	stats.emitted = levels[len - 1].emitted;
 }
 
 template<typename Callback>
-bool dbms::iterate_many_tables_impl(
+bool dbms::iterate_join_levels(
 	const std::vector<table_manager*> &table_list,
 	std::vector<record_manager*> &record_list,
 	std::vector<int> &rid_list,
-	std::vector<std::vector<expr_node_t*>> &index_cond,
-	int *iter_order, int *index_cid, index_manager** index,
-	expr_node_t *cond, Callback callback, int now)
+	std::vector<join_level_t> &levels,
+	int now, Callback callback)
 {
-	if(now < 0)
+	if(now == (int)levels.size())
 	{
-		if(cond)
-		{
-			bool result = false;
-			try {
-				result = typecast::expr_to_bool(expression::eval(cond));
-			} catch(const char *msg) {
-				std::puts(msg);
-				return false; // stop
-			}
-
-			if(!result)
-				return true; // continue
-		}
-
 		if(!callback(table_list, record_list, rid_list))
 			return false;  // stop
 		return true;  // continue
+	}
+
+	join_level_t &level = levels[now];
+	int tid = level.step.table;
+	table_manager *tb = table_list[tid];
+
+	// returns -1 if an error occurs
+	auto check = [&]() -> int {
+		try {
+			for(compiled_expression &c : level.conds)
+				if(!typecast::expr_to_bool(c.eval()))
+					return 0;
+		} catch(const char *msg) {
+			std::puts(msg);
+			return -1;
+		}
+
+		return 1;
+	};
+
+	auto eval_join_cond = [&]() -> int {
+		try {
+			return typecast::expr_to_bool(level.join_cond.eval()) ? 1 : 0;
+		} catch(const char *msg) {
+			std::puts(msg);
+			return -1;
+		}
+	};
+
+	if(level.step.access == join_step_t::HASH)
+	{
+		const char *key = table_list[level.step.key_table]->get_cached_column(level.step.key_cid);
+		if(!key) return true;  // NULL equals nothing
+
+		auto &rows = level.hash.rows;
+		uint64_t h = hash_join_key(key, level.hash.type);
+		auto it = std::lower_bound(rows.begin(), rows.end(), h,
+			[](const std::pair<uint64_t, std::pair<int, int>> &row, uint64_t h) {
+				return row.first < h;
+			} );
+		for(; it != rows.end() && it->first == h; ++it)
+		{
+			++level.examined;
+			record_manager rm(level.hash.pg);
+			rm.open(it->second, false);
+			rm.read(&rid_list[tid], 4);
+			tb->cache_record(&rm);
+
+			// the hashes may collide
+			int join_ret = eval_join_cond();
+			if(join_ret < 0) return false;
+			if(!join_ret) continue;
+
+			int ret = check();
+			if(ret < 0) return false;
+			if(!ret) continue;
+
+			++level.emitted;
+			record_list[tid] = &rm;
+			if(!iterate_join_levels(table_list, record_list, rid_list, levels, now + 1, callback))
+				return false;
+		}
+	} else if(level.step.access == join_step_t::INDEX && level.index->is_hash()) {
+		const char *key = table_list[level.step.key_table]->get_cached_column(level.step.key_cid);
+		if(!key) return true;
+
+		// only the rows of the key are found, in no order
+		level.index->find(key, level.rids);
+		for(int rid : level.rids)
+		{
+			++level.examined;
+			record_manager rm = tb->get_record_ptr(rid);
+			tb->cache_record(&rm);
+
+			int join_ret = eval_join_cond();
+			if(join_ret < 0) return false;
+			if(!join_ret) continue;
+
+			int ret = check();
+			if(ret < 0) return false;
+			if(!ret) continue;
+
+			++level.emitted;
+			rid_list[tid] = rid;
+			record_list[tid] = &rm;
+			if(!iterate_join_levels(table_list, record_list, rid_list, levels, now + 1, callback))
+				return false;
+		}
+	} else if(level.step.access == join_step_t::INDEX) {
+		const char *key = table_list[level.step.key_table]->get_cached_column(level.step.key_cid);
+		if(!key) return true;
+		// a key not in the filter joins no row, no need to descend
+		if(!level.index->may_contain(key)) return true;
+
+		auto it = level.index->get_iterator_lower_bound(key);
+		for(; !it.is_end(); it.next())
+		{
+			int rid;
+			++level.examined;
+			record_manager rm = tb->open_record_from_index_lower_bound(it.get(), &rid);
+			tb->cache_record(&rm);
+
+			int join_ret = eval_join_cond();
+			if(join_ret < 0) return false;
+			if(!join_ret) break;
+
+			int ret = check();
+			if(ret < 0) return false;
+			if(!ret) continue;
+
+			++level.emitted;
+			rid_list[tid] = rid;
+			record_list[tid] = &rm;
+			if(!iterate_join_levels(table_list, record_list, rid_list, levels, now + 1, callback))
+				return false;
+		}
 	} else {
-		if(!index[now])
+		auto it = tb->get_record_iterator_lower_bound(0);
+		for(; !it.is_end(); it.next())
 		{
-			auto it = table_list[iter_order[now]]->get_record_iterator_lower_bound(0);
-			for(; !it.is_end(); it.next())
-			{
-				record_manager rm(it.get_pager());
-				rm.open(it.get(), false);
-				rm.read(&rid_list[iter_order[now]], 4);
-				// std::printf("%d\n", rid_list[iter_order[now]]);
-				table_list[iter_order[now]]->cache_record(&rm);
-				record_list[iter_order[now]] = &rm;
-				bool ret = iterate_many_tables_impl(
-					table_list, record_list, rid_list,
-					index_cond, iter_order, index_cid, index,
-					cond, callback, now - 1
-				);
-
-				if(!ret) return false;
-			}
-		} else {
-			const char *tb_col = table_list[iter_order[now + 1]]->get_cached_column(index_cid[now]);
-			table_manager *tb2 = table_list[iter_order[now]];
-			auto tb2_it = index[now]->get_iterator_lower_bound(tb_col);
-			for(; !tb2_it.is_end(); tb2_it.next())
-			{
-				int tb2_rid;
-				record_manager tb2_rm = tb2->open_record_from_index_lower_bound(tb2_it.get(), &tb2_rid);
-				tb2->cache_record(&tb2_rm);
-
-				bool join_ret = false;
-				try {
-					expr_node_t *join_cond = index_cond[iter_order[now]][iter_order[now + 1]];
-					join_ret = typecast::expr_to_bool(expression::eval(join_cond));
-				} catch(const char *msg) {
-					std::puts(msg);
-					return false;
-				}
+			++level.examined;
+			record_manager rm(it.get_pager());
+			rm.open(it.get(), false);
+			rm.read(&rid_list[tid], 4);
+			tb->cache_record(&rm);
+
+			int ret = check();
+			if(ret < 0) return false;
+			if(!ret) continue;
+
+			++level.emitted;
+			record_list[tid] = &rm;
+			if(!iterate_join_levels(table_list, record_list, rid_list, levels, now + 1, callback))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+database *dbms::acquire_database(const char *db_name)
+{
+	auto it = databases.find(db_name);
+	if(it != databases.end())
+	{
+		++it->second.second;
+		return it->second.first;
+	}
 
-				if(!join_ret) break;
+	database *db = new database();
+	db->open(db_name);
+	if(!db->is_opened())
+	{
+		delete db;
+		return nullptr;
+	}
 
-				rid_list[iter_order[now]] = tb2_rid;
-				record_list[iter_order[now]] = &tb2_rm;
-				bool ret = iterate_many_tables_impl(
-					table_list, record_list, rid_list,
-					index_cond, iter_order, index_cid, index,
-					cond, callback, now - 1
-				);
+	databases[db_name] = { db, 1 };
+	return db;
+}
 
-				if(!ret) return false;
+void dbms::release_database(database *db)
+{
+	for(auto it = databases.begin(); it != databases.end(); ++it)
+	{
+		if(it->second.first == db)
+		{
+			if(--it->second.second == 0)
+			{
+				db->close();
+				delete db;
+				databases.erase(it);
 			}
+
+			return;
 		}
 	}
-
-	return true;
 }
 
 void dbms::close_database()
 {
 	if(cur_db) 
 	{
-		cur_db->close();
-		delete cur_db;
+		release_database(cur_db);
 		cur_db = nullptr;
 	}
 }
 
-void dbms::switch_database(const char *db_name)
+void dbms::commit()
 {
-	if(cur_db)
-	{
-		cur_db->close();
-		delete cur_db;
-		cur_db = nullptr;
-	}
+	if(cur_db && cur_db->is_opened())
+		cur_db->commit();
+}
 
-	cur_db = new database();
-	cur_db->open(db_name);
+void dbms::end_query()
+{
+	query_arena.reset();
+	++statement_num;
+	++thread_stats().statements;
+	flush_thread_stats();
+}
+
+void dbms::switch_database(const char *db_name)
+{
+	close_database();
+	cur_db = acquire_database(db_name);
 }
 
 void dbms::create_database(const char *db_name)
 {
+	if(!assert_writable())
+		return;
 	database db;
 	db.create(db_name);
 	db.close();
@@ -465,28 +998,33 @@ void dbms::create_database(const char *db_name)
 
 void dbms::drop_database(const char *db_name)
 {
+	if(!assert_writable())
+		return;
 	if(cur_db && std::strcmp(cur_db->get_name(), db_name) == 0)
+		close_database();
+	if(databases.count(db_name))
 	{
-		cur_db->close();
-		delete cur_db;
-		cur_db = nullptr;
+		std::fprintf(stderr, "[Error] Database `%s` is used by another session.\n", db_name);
+		return;
 	}
 
 	database db;
 	db.open(db_name);
-	db.drop();
+	if(db.is_opened())
+		db.drop();
 }
 
 void dbms::show_database(const char *db_name)
 {
 	database db;
 	db.open(db_name);
-	db.show_info();
+	if(db.is_opened())
+		db.show_info();
 }
 
 void dbms::drop_table(const char *table_name)
 {
-	if(assert_db_open())
+	if(assert_db_open() && assert_writable())
 		cur_db->drop_table(table_name);
 }
 
@@ -504,15 +1042,55 @@ void dbms::show_table(const char* table_name)
 	}
 }
 
+void dbms::analyze_table(const char *table_name)
+{
+	if(!assert_db_open() || !assert_writable())
+		return;
+
+	table_manager *tm = cur_db->get_table(table_name);
+	if(tm == nullptr)
+	{
+		std::fprintf(stderr, "[Error] Table `%s` not found.\n", table_name);
+		return;
+	}
+
+	tm->analyze();
+	std::printf("[Info] Table `%s` analyzed, %d row(s).\n", table_name, tm->get_record_num());
+}
+
+void dbms::vacuum_table(const char *table_name)
+{
+	if(!assert_db_open() || !assert_writable())
+		return;
+
+	table_manager *tm = cur_db->get_table(table_name);
+	if(tm == nullptr)
+	{
+		std::fprintf(stderr, "[Error] Table `%s` not found.\n", table_name);
+		return;
+	}
+
+	int pages = tm->get_pager()->page_num();
+	if(tm->vacuum(index_fill_factor))
+	{
+		std::printf("[Info] Table `%s` vacuumed, %d page(s) -> %d page(s).\n",
+			table_name, pages, tm->get_pager()->page_num());
+	}
+}
+
 void dbms::create_table(const table_header_t *header)
 {
-	if(assert_db_open())
-		cur_db->create_table(header);
+	if(!assert_db_open() || !assert_writable())
+		return;
+	cur_db->create_table(header);
+	table_manager *tb = cur_db->get_table(header->table_name);
+	if(tb && index_bloom_bits)
+		tb->create_filters(index_bloom_bits);
 }
 
 void dbms::update_rows(const update_info_t *info)
 {
-	if(!assert_db_open())
+	if(!assert_db_open() || !assert_writable())
 		return;
 
 	__cache_clear_guard __guard;
@@ -531,19 +1109,24 @@ void dbms::update_rows(const update_info_t *info)
 	}
 
 	int succ_count = 0, fail_count = 0;
+	compiled_expression value(info->value, &query_arena);
 	try {
-		iterate_one_table(tm, info->where, [&](table_manager *tm, record_manager *, int rid) -> bool {
-			expression val = expression::eval(info->value);
+		// the rows are found in a snapshot taken before they are modified,
+		// so that an index or a batch scan visits each of them once
+		snapshot_guard in_snapshot;
+		iterate_one_table_with_index(tm, info->where, [&](table_manager *tm, record_manager *, int rid) -> bool {
+			expression val = value.eval();
 			int col_type = tm->get_column_type(col_id);
 			if(!typecast::type_compatible(col_type, val))
 				throw "[Error] Incompatible data type.";
 			auto term_type = typecast::column_to_term(col_type);
+			snapshot_pause pause;
 			bool ret = tm->modify_record(rid, col_id, typecast::expr_to_db(val, term_type));
 			// if(!ret) return false;
 			succ_count += ret;
 			fail_count += 1 - ret;
 			return true;
-		} );
+		}, ~0u);
 	} catch(const char *msg) {
 		std::puts(msg);
 		return;
@@ -554,12 +1137,43 @@ void dbms::update_rows(const update_info_t *info)
 			succ_count, fail_count);
 }
 
+/* the items of ORDER BY in order, the list is in the reverse order */
+static void get_order_by(const select_info_t *info, std::vector<order_by_item_t*> &items)
+{
+	for(linked_list_t *link_p = info->order_by; link_p; link_p = link_p->next)
+		items.push_back((order_by_item_t*)link_p->data);
+	std::reverse(items.begin(), items.end());
+}
+
+static std::string describe_limit(const limit_info_t *limit)
+{
+	if(!limit) return std::string();
+	std::string ret = "limit " + std::to_string(limit->count);
+	if(limit->offset) ret += " offset " + std::to_string(limit->offset);
+	return ret;
+}
+
+static std::string describe_order_by(const std::vector<order_by_item_t*> &items)
+{
+	std::string ret;
+	for(size_t i = 0; i != items.size(); ++i)
+	{
+		if(i) ret += ", ";
+		ret += query_plan::describe(items[i]->expr);
+		if(items[i]->desc) ret += " DESC";
+	}
+
+	return ret;
+}
+
 void dbms::select_rows(const select_info_t *info)
 {
 	if(!assert_db_open())
 		return;
 
 	__cache_clear_guard __guard;
+	// the statement reads the tables as of the last commit
+	snapshot_guard in_snapshot;
 	
 	// get required tables
 	std::vector<std::shared_ptr<table_manager>> alias_tables;
@@ -596,220 +1210,598 @@ void dbms::select_rows(const select_info_t *info)
 		expr_names.push_back(expression::to_string(expr));
 	}
 
-	// output header info
-	for(size_t i = 0; i < exprs.size(); ++i)
+	// output header info, the rows of EXPLAIN are not output
+	std::unique_ptr<result_sink> sink;
+	if(!plan)
 	{
-		if(i != 0) std::fprintf(output_file, ",");
-		std::fprintf(output_file, "%s", expr_names[i].c_str());
-	}
-
-	if(exprs.size() == 0)
-	{
-		for(size_t i = 0; i < required_tables.size(); ++i)
+		sink = result_sink::create(output_format, get_output(), output_buffer);
+		if(exprs.size() == 0)
 		{
-			if(i != 0) std::fprintf(output_file, ",");
-			required_tables[i]->dump_header(output_file);
+			std::vector<std::string> names;
+			for(table_manager *tm : required_tables)
+				tm->get_column_names(names);
+			sink->begin(names);
+		} else {
+			sink->begin(expr_names);
 		}
 	}
 
-	std::fprintf(output_file, "\n");
-
-	if(is_aggregate)
+	if(is_aggregate || info->group_by)
 	{
 		select_rows_aggregate(
 			info,
 			required_tables,
 			exprs,
-			expr_names
+			expr_names,
+			sink.get()
 		);
 
+		// the header is output even if the query fails
+		if(sink) sink->flush();
 		return;
 	}
 
-	// iterate records
+	// iterate records, `SELECT *` needs the whole record
+	std::vector<order_by_item_t*> order_by;
+	get_order_by(info, order_by);
+	size_t offset = info->limit ? info->limit->offset : 0;
+	size_t limit = info->limit ? info->limit->count : SIZE_MAX;
+
 	int counter = 0;
-	iterate(required_tables, info->where,
-		[&](const std::vector<table_manager*> &tables,
-			const std::vector<record_manager*> &records,
-			const std::vector<int>& )
+	arena_vector<compiled_expression> programs, order_programs(&query_arena);
+	compile_exprs(exprs, programs, &query_arena);
+	std::vector<bool> desc;
+	uint32_t used_cols = exprs.empty() ? ~0u : 0;
+	for(expr_node_t *expr : exprs)
+	{
+		if(!collect_columns(required_tables[0], expr, used_cols))
+			used_cols = ~0u;
+	}
+
+	for(order_by_item_t *item : order_by)
+	{
+		order_programs.emplace_back(item->expr, &query_arena);
+		desc.push_back(item->desc);
+		if(!collect_columns(required_tables[0], item->expr, used_cols))
+			used_cols = ~0u;
+	}
+
+	// the index of the ORDER BY column may give the order already
+	std::vector<expr_node_t*> and_cond;
+	extract_and_cond(info->where, and_cond);
+	index_range_t order_range;
+	bool index_order = required_tables.size() == 1 && order_by.size() == 1
+		&& choose_index_order(required_tables[0], and_cond, order_by[0], info->limit, order_range);
+	bool sorted = !order_by.empty() && !index_order;
+	row_sorter sorter(desc, limit == SIZE_MAX ? SIZE_MAX : offset + limit);
+
+	int select_node = -1, sort_node = -1;
+	if(plan)
+	{
+		select_node = plan_add("Select", describe_limit(info->limit));
+		plan->enter();
+		if(sorted)
 		{
+			sort_node = plan_add(limit == SIZE_MAX ? "Sort" : "Top-N Sort",
+				"by " + describe_order_by(order_by));
+			plan->enter();
+		}
+	}
+
+	size_t row_num = 0, sorted_rows = 0;
+	std::string key, data;
+	std::vector<expression> vals(exprs.size()), record_vals;
+	std::vector<std::string> record_bufs;
+	std::vector<table_manager*> out_tables;
+	auto on_row = [&](const std::vector<table_manager*> &tables,
+		const std::vector<record_manager*> &records,
+		const std::vector<int>& ) -> bool
+	{
+		try {
 			for(size_t i = 0; i < exprs.size(); ++i)
+				vals[i] = programs[i].eval();
+			key.clear();
+			if(sorted)
 			{
-				expression ret;
-				try {
-					ret = expression::eval(exprs[i]);
-				} catch (const char *e) {
-					std::fprintf(stderr, "%s\n", e);
-					return false;
-				}
-				// std::printf("%s\t = ", expr_names[i].c_str());
-				if(i != 0) std::fprintf(output_file, ",");
-				switch(ret.type)
+				for(compiled_expression &program : order_programs)
+					expression::encode(key, program.eval());
+			}
+		} catch (const char *e) {
+			std::fprintf(stderr, "%s\n", e);
+			return false;
+		}
+
+		if(sorted)
+		{
+			// keep the values, or the records for `SELECT *`
+			data.clear();
+			for(const expression &val : vals)
+				expression::encode(data, val);
+			if(exprs.empty())
+			{
+				out_tables = tables;
+				for(size_t i = 0; i < tables.size(); ++i)
 				{
-					case TERM_INT:
-						std::fprintf(output_file, "%d", ret.val_i);
-						break;
-					case TERM_FLOAT:
-						std::fprintf(output_file, "%f", ret.val_f);
-						break;
-					case TERM_STRING:
-						std::fprintf(output_file, "%s", ret.val_s);
-						break;
-					case TERM_BOOL:
-						std::fprintf(output_file, "%s", ret.val_b ? "TRUE" : "FALSE");
-						break;
-					case TERM_DATE: {
-						char date_buf[32];
-						time_t time = ret.val_i;
-						auto tm = std::localtime(&time);
-						std::strftime(date_buf, 32, DATE_TEMPLATE, tm);
-						std::fprintf(output_file, "%s", date_buf);
-						break; }
-					case TERM_NULL:
-						std::fprintf(output_file, "NULL");
-						break;
-					default:
-						debug_puts("[Error] Data type not supported!");
+					size_t at = data.size(), size = tables[i]->get_temp_record_size();
+					data.resize(at + size);
+					records[i]->seek(0);
+					records[i]->read(&data[at], size);
 				}
 			}
 
-			if(exprs.size() == 0)
+			sorter.add(key, data);
+			++sorted_rows;
+			return true;
+		}
+
+		if(row_num++ < offset)
+			return true;
+		if((size_t)counter == limit)
+			return false;
+
+		// the rows of EXPLAIN ANALYZE are counted but not output
+		if(plan)
+			return (size_t)++counter != limit;
+
+		if(exprs.empty())
+		{
+			record_vals.clear();
+			record_bufs.resize(tables.size());
+			for(size_t i = 0; i < tables.size(); ++i)
 			{
-				for(size_t i = 0; i < tables.size(); ++i)
+				record_bufs[i].resize(tables[i]->get_temp_record_size());
+				records[i]->seek(0);
+				records[i]->read(&record_bufs[i][0], record_bufs[i].size());
+				tables[i]->get_record_values(record_bufs[i].data(), record_vals);
+			}
+
+			sink->row(record_vals);
+		} else {
+			sink->row(vals);
+		}
+
+		return (size_t)++counter != limit;
+	};
+
+	if(index_order)
+	{
+		table_manager *table = required_tables[0];
+		std::vector<record_manager*> rm_list(1);
+		std::vector<int> rid_list(1);
+		iterate_index_range(table, info->where, order_range,
+			[&](table_manager *, record_manager *rm, int rid) -> bool {
+				rm_list[0] = rm;
+				rid_list[0] = rid;
+				return on_row(required_tables, rm_list, rid_list);
+			}, used_cols);
+	} else {
+		iterate(required_tables, info->where, on_row, used_cols);
+	}
+
+	if(sorted)
+	{
+		sorter.for_each([&](const char *data, size_t size) -> bool {
+			if(row_num++ < offset)
+				return true;
+			if((size_t)counter == limit)
+				return false;
+
+			if(plan)
+			{
+				++counter;
+				return true;
+			}
+
+			if(exprs.empty())
+			{
+				record_vals.clear();
+				for(size_t i = 0; i < out_tables.size(); ++i)
 				{
-					if(i != 0) std::fprintf(output_file, ",");
-					tables[i]->dump_record(output_file, records[i]);
+					out_tables[i]->get_record_values(data, record_vals);
+					data += out_tables[i]->get_temp_record_size();
 				}
+
+				sink->row(record_vals);
+			} else {
+				expression::decode(data, data + size, vals);
+				sink->row(vals);
 			}
-			std::fprintf(output_file, "\n");
+
 			++counter;
 			return true;
+		} );
+	}
+
+	if(plan)
+	{
+		if(sort_node >= 0)
+		{
+			plan->get(sort_node).examined = sorted_rows;
+			plan->get(sort_node).emitted = row_num;
 		}
-	);
 
+		plan->get(select_node).examined = row_num;
+		plan->get(select_node).emitted = counter;
+		return;
+	}
+
+	sink->flush();
 	std::printf("[Info] %d row(s) selected.\n", counter);
-	std::fprintf(output_file, "\n");
-	std::fflush(output_file);
+	sink->end();
+}
+
+void dbms::explain_select(const select_info_t *info, bool analyze)
+{
+	if(!assert_db_open())
+		return;
+
+	query_plan explained(analyze);
+	plan = &explained;
+	select_rows(info);
+	plan = nullptr;
+	explained.finish();
+	if(explained.empty())
+		return;
+	explained.print(get_output());
+	std::fflush(get_output());
+}
+
+void dbms::show_stats()
+{
+	flush_thread_stats();
+	exec_stats_t s = get_total_stats();
+	page_fs *fs = page_fs::get_instance();
+	uint64_t lookups = s.cache_hits + s.cache_misses;
+	std::printf("Statements: %llu\n", (unsigned long long)s.statements);
+	std::printf("Buffer pool: %d pages (%s), %d dirty, %zu versions\n",
+		fs->get_capacity(), fs->get_policy(), fs->get_dirty_count(), fs->get_version_num());
+	std::printf("  hits=%llu misses=%llu evictions=%llu hit ratio=%.2f%%\n",
+		(unsigned long long)s.cache_hits, (unsigned long long)s.cache_misses,
+		(unsigned long long)s.cache_evictions, lookups ? 100.0 * s.cache_hits / lookups : 0.0);
+	std::printf("  pages read=%llu written=%llu\n",
+		(unsigned long long)s.pages_read, (unsigned long long)s.pages_written);
+	std::printf("B-tree: descents=%llu splits=%llu merges=%llu\n",
+		(unsigned long long)s.btree_descents, (unsigned long long)s.btree_splits,
+		(unsigned long long)s.btree_merges);
+	std::printf("Bloom filters: probes=%llu negatives=%llu\n",
+		(unsigned long long)s.bloom_probes, (unsigned long long)s.bloom_negatives);
+	std::printf("Rows: examined=%llu emitted=%llu\n",
+		(unsigned long long)s.rows_examined, (unsigned long long)s.rows_emitted);
+	std::printf("Expression evaluations: %llu\n", (unsigned long long)s.expr_evals);
 }
 
 void dbms::select_rows_aggregate(
 	const select_info_t *info,
 	const std::vector<table_manager*> &required_tables,
 	const std::vector<expr_node_t*> &exprs,
-	const std::vector<std::string> &)
+	const std::vector<std::string> &expr_names,
+	result_sink *sink)
 {
-	if(exprs.size() != 1)
+	std::vector<expr_node_t*> group_exprs;
+	for(linked_list_t *link_p = info->group_by; link_p; link_p = link_p->next)
+		group_exprs.push_back((expr_node_t*)link_p->data);
+	if(exprs.empty())
 	{
-		std::fprintf(stderr, "[Error] Support only for one select expression for aggregate select.");
+		std::fprintf(stderr, "[Error] `*` cannot be selected by an aggregate select.\n");
 		return;
 	}
 
-	// check aggregate type
-	expr_node_t *expr = exprs[0];
-	int val_i = 0;
-	float val_f = 0;
-	if(expr->op == OPERATOR_MIN)
+	// a select expression is either an aggregate or a GROUP BY expression
+	std::vector<operator_type_t> ops;
+	std::vector<expr_node_t*> operands;
+	std::vector<int> slots;  // an aggregate, or -1 - the GROUP BY expression
+	for(size_t i = 0; i != exprs.size(); ++i)
+	{
+		if(expression::is_aggregate(exprs[i]))
+		{
+			slots.push_back(ops.size());
+			ops.push_back(exprs[i]->op);
+			operands.push_back(exprs[i]->left);
+			continue;
+		}
+
+		size_t j = 0;
+		while(j != group_exprs.size() && expression::to_string(group_exprs[j]) != expr_names[i])
+			++j;
+		if(j == group_exprs.size())
+		{
+			std::fprintf(stderr, "[Error] `%s` is neither aggregated nor in GROUP BY.\n", expr_names[i].c_str());
+			return;
+		}
+
+		slots.push_back(-1 - (int)j);
+	}
+
+	// the rows of the groups are sorted by their GROUP BY values
+	std::vector<order_by_item_t*> order_by;
+	std::vector<int> order_slots;
+	std::vector<bool> desc;
+	get_order_by(info, order_by);
+	for(order_by_item_t *item : order_by)
 	{
-		val_i = std::numeric_limits<int>::max();
-		val_f = std::numeric_limits<float>::max();
-	} else if(expr->op == OPERATOR_MAX) {
-		val_i = std::numeric_limits<int>::min();
-		val_f = std::numeric_limits<float>::min();
+		std::string name = expression::to_string(item->expr);
+		size_t j = 0;
+		while(j != group_exprs.size() && expression::to_string(group_exprs[j]) != name)
+			++j;
+		if(j == group_exprs.size())
+		{
+			std::fprintf(stderr, "[Error] `%s` of ORDER BY is not in GROUP BY.\n", name.c_str());
+			return;
+		}
+
+		order_slots.push_back(j);
+		desc.push_back(item->desc);
 	}
 
-	term_type_t agg_type = TERM_NONE;
+	hash_aggregator aggregator(ops);
+	if(group_exprs.empty())
+		aggregator.group(std::string());
+
+	// the groups are sorted after they are aggregated
+	int sort_node = -1, agg_node = -1;
+	if(plan)
+	{
+		std::string limit = describe_limit(info->limit);
+		if(!order_by.empty())
+		{
+			sort_node = plan_add("Sort", "by " + describe_order_by(order_by)
+				+ (limit.empty() ? "" : " " + limit));
+			plan->enter();
+			limit.clear();
+		}
+
+		std::string detail;
+		for(size_t i = 0; i != group_exprs.size(); ++i)
+			detail += (i ? ", " : "by ") + query_plan::describe(group_exprs[i]);
+		agg_node = plan_add(group_exprs.empty() ? "Aggregate" : "Hash Aggregate",
+			detail + (limit.empty() || detail.empty() ? "" : " ") + limit);
+		plan->enter();
+	}
 
+	// the operands read from the batches, -1 for COUNT(*)
 	int counter = 0;
-	iterate(required_tables, info->where,
+	table_manager *table = required_tables[0];
+	std::vector<int> cids;
+	bool batched = required_tables.size() == 1 && group_exprs.empty();
+	for(size_t i = 0; batched && i != ops.size(); ++i)
+	{
+		int cid = -1;
+		if(operands[i])
+		{
+			column_ref_t *ref = operands[i]->column_ref;
+			if(!ref->table || std::strcmp(ref->table, table->get_table_name()) == 0)
+				cid = table->lookup_column(ref->column);
+			if(cid < 0) batched = false;
+			else if(ops[i] != OPERATOR_COUNT && table->get_column_type(cid) != COL_TYPE_INT
+				&& table->get_column_type(cid) != COL_TYPE_FLOAT)
+				batched = false;
+		}
+
+		cids.push_back(cid);
+	}
+
+	// aggregate whole batches of a scan
+	auto fold = [&](batch_scanner &scan, const std::vector<int> &sel, aggregate_state_t *st) {
+		for(size_t i = 0; i != ops.size(); ++i)
+		{
+			int num = sel.size();
+			if(cids[i] < 0) {
+				st[i].values += num;
+				continue;
+			}
+
+			const column_vector_t &col = scan.get_column(cids[i]);
+			if(ops[i] == OPERATOR_COUNT) {
+				num = 0;
+				for(int k : sel)
+					num += !col.nulls[k];
+			} else if(table->get_column_type(cids[i]) == COL_TYPE_FLOAT) {
+				num = aggregate_vector(ops[i], col.floats, col.nulls, sel, st[i].val_f);
+				if(num) st[i].type = TERM_FLOAT;
+			} else {
+				num = aggregate_vector(ops[i], col.ints, col.nulls, sel, st[i].val_i);
+				if(num) st[i].type = TERM_INT;
+			}
+
+			st[i].values += num;
+		}
+	};
+
+	std::vector<expr_node_t*> and_cond;
+	extract_and_cond(info->where, and_cond);
+	index_range_t range;
+	batch_filter filter;
+	batched = batched && !choose_index_range(table, and_cond, range)
+		&& filter.compile(table, and_cond);
+	bool scanned = false;
+	if(batched && scan_threads > 1)
+	{
+		parallel_scanner scanner(table, scan_threads);
+		if(scanner.get_thread_num() > 1)
+		{
+			int node = -1;
+			if(plan)
+			{
+				node = plan_add(table->is_columnar() ? "Parallel Columnar Scan" : "Parallel Batch Scan",
+					std::string("on ") + table->get_table_name() + " threads="
+					+ std::to_string(scanner.get_thread_num())
+					+ (info->where ? " filter " + query_plan::describe(info->where) : ""),
+					estimate_rows(table, and_cond));
+				if(plan_only()) return;
+			}
+
+			// the scanner counts the rows, the workers' included
+			auto start = std::chrono::steady_clock::now();
+			uint64_t examined = thread_stats().rows_examined;
+			// a state for each morsel, merged in order of the morsels, so
+			// the result does not depend on which thread took which
+			int morsels = scanner.get_morsel_num();
+			std::vector<aggregate_state_t> states(morsels * ops.size());
+			std::vector<int> counters(morsels);
+			for(int m = 0; m != morsels; ++m)
+			{
+				for(size_t i = 0; i != ops.size(); ++i)
+					states[m * ops.size() + i].init(ops[i]);
+			}
+
+			scanner.run(filter, [&](int m, batch_scanner &scan, const std::vector<int> &sel) {
+				counters[m] += sel.size();
+				fold(scan, sel, states.data() + m * ops.size());
+			} );
+
+			aggregate_state_t *st = aggregator.group(std::string());
+			for(int m = 0; m != morsels; ++m)
+			{
+				counter += counters[m];
+				for(size_t i = 0; i != ops.size(); ++i)
+					st[i].merge(ops[i], states[m * ops.size() + i]);
+			}
+
+			if(node >= 0)
+			{
+				plan_node_t &n = plan->get(node);
+				n.examined = thread_stats().rows_examined - examined;
+				n.emitted = counter;
+				n.seconds = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+			}
+
+			scanned = true;
+		}
+	}
+
+	if(batched && !scanned) iterate_batches(table, info->where,
+		[&](batch_scanner &scan, const std::vector<int> &sel) -> bool {
+			counter += sel.size();
+			fold(scan, sel, aggregator.group(std::string()));
+			return true;
+		} );
+
+	arena_vector<compiled_expression> programs, group_programs;
+	compile_exprs(operands, programs, &query_arena);
+	compile_exprs(group_exprs, group_programs, &query_arena);
+	uint32_t used_cols = 0;
+	for(expr_node_t *expr : operands)
+	{
+		if(expr && !collect_columns(table, expr, used_cols))
+			used_cols = ~0u;
+	}
+
+	for(expr_node_t *expr : group_exprs)
+	{
+		if(!collect_columns(table, expr, used_cols))
+			used_cols = ~0u;
+	}
+
+	bool failed = false;
+	std::string key;
+	std::vector<expression> vals(ops.size());
+	if(!batched) iterate(required_tables, info->where,
 		[&](const std::vector<table_manager*> &,
 			const std::vector<record_manager*> &,
 			const std::vector<int>& )
 		{
-			if(expr->op != OPERATOR_COUNT)
-			{
-				expression ret;
-				try {
-					ret = expression::eval(expr->left);
-				} catch (const char *e) {
-					std::fprintf(stderr, "%s\n", e);
-					return false;
-				}
-
-				agg_type = ret.type;
-				if(ret.type == TERM_FLOAT)
+			++counter;
+			try {
+				key.clear();
+				for(compiled_expression &program : group_programs)
+					expression::encode(key, program.eval());
+				for(size_t i = 0; i != ops.size(); ++i)
 				{
-					switch(expr->op)
-					{
-						case OPERATOR_SUM:
-						case OPERATOR_AVG:
-							val_f += ret.val_f;
-							break;
-						case OPERATOR_MIN:
-							if(ret.val_f < val_f)
-								val_f = ret.val_f;
-							break;
-						case OPERATOR_MAX:
-							if(ret.val_f > val_f)
-								val_f = ret.val_f;
-							break;
-						default: break;
-					}
-				} else {
-					switch(expr->op)
-					{
-						case OPERATOR_SUM:
-						case OPERATOR_AVG:
-							val_i += ret.val_i;
-							break;
-						case OPERATOR_MIN:
-							if(ret.val_i < val_i)
-								val_i = ret.val_i;
-							break;
-						case OPERATOR_MAX:
-							if(ret.val_i > val_i)
-								val_i = ret.val_i;
-							break;
-						default: break;
+					if(operands[i]) {
+						vals[i] = programs[i].eval();
+					} else {
+						// COUNT(*) counts every row
+						vals[i].type = TERM_INT;
+						vals[i].val_i = 1;
 					}
 				}
+			} catch (const char *e) {
+				std::fprintf(stderr, "%s\n", e);
+				failed = true;
+				return false;
+			}
+
+			if(!aggregator.add(key, vals.data()))
+			{
+				std::fprintf(stderr, "[Error] Aggregate only support for int and float type.\n");
+				failed = true;
+				return false;
 			}
 
-			++counter;
 			return true;
-		}
+		}, used_cols
 	);
 
-	if(expr->op == OPERATOR_COUNT)
-	{
-		std::fprintf(output_file, "%d\n", counter);
-	} else {
-		if(agg_type != TERM_FLOAT && agg_type != TERM_INT)
+	if(failed) return;
+
+	size_t offset = info->limit ? info->limit->offset : 0;
+	size_t limit = info->limit ? info->limit->count : SIZE_MAX;
+	size_t row_num = 0, out_num = 0;
+	auto output = [&](const std::vector<expression> &row) {
+		if(row_num++ >= offset && out_num != limit)
+		{
+			if(sink) sink->row(row);
+			++out_num;
+		}
+	};
+
+	row_sorter sorter(desc, limit == SIZE_MAX ? SIZE_MAX : offset + limit);
+	std::vector<expression> group_vals, row(exprs.size());
+	std::string order_key, data;
+	size_t groups = 0;
+	aggregator.for_each([&](const std::string &key, const aggregate_state_t *st) {
+		++groups;
+		expression::decode(key.data(), key.data() + key.size(), group_vals);
+		for(size_t i = 0; i != exprs.size(); ++i)
+		{
+			if(slots[i] >= 0)
+				row[i] = st[slots[i]].result(ops[slots[i]]);
+			else row[i] = group_vals[-1 - slots[i]];
+		}
+
+		if(order_by.empty())
 		{
-			std::fprintf(stderr, "[Error] Aggregate only support for int and float type.\n");
+			output(row);
 			return;
 		}
 
-		if(expr->op == OPERATOR_AVG)
+		order_key.clear();
+		data.clear();
+		for(int j : order_slots)
+			expression::encode(order_key, group_vals[j]);
+		for(const expression &val : row)
+			expression::encode(data, val);
+		sorter.add(order_key, data);
+	} );
+
+	sorter.for_each([&](const char *data, size_t size) -> bool {
+		expression::decode(data, data + size, row);
+		output(row);
+		return out_num != limit;
+	} );
+
+	if(plan)
+	{
+		if(sort_node >= 0)
 		{
-			if(agg_type == TERM_INT)
-				val_f = double(val_i) / counter;
-			else val_f /= counter;
-			std::fprintf(output_file, "%f\n", val_f);
-		} else if(agg_type == TERM_FLOAT) {
-			std::fprintf(output_file, "%f\n", val_f);
-		} else if(agg_type == TERM_INT) {
-			std::fprintf(output_file, "%d\n", val_i);
+			plan->get(sort_node).examined = groups;
+			plan->get(sort_node).emitted = out_num;
 		}
+
+		plan->get(agg_node).examined = counter;
+		plan->get(agg_node).emitted = sort_node >= 0 ? groups : out_num;
+		return;
 	}
 
+	sink->flush();
 	std::printf("[Info] %d row(s) selected.\n", counter);
-	std::fprintf(output_file, "\n");
-	std::fflush(output_file);
+	sink->end();
 }
 
 void dbms::delete_rows(const delete_info_t *info)
 {
-	if(!assert_db_open())
+	if(!assert_db_open() || !assert_writable())
 		return;
 	__cache_clear_guard __guard;
 
@@ -825,7 +1817,7 @@ void dbms::delete_rows(const delete_info_t *info)
 		[&delete_list](table_manager*, record_manager*, int rid) -> bool {
 			delete_list.push_back(rid);
 			return true;
-		} );
+		}, 0);
 
 	int counter = 0;
 	for(int rid : delete_list)
@@ -835,7 +1827,7 @@ void dbms::delete_rows(const delete_info_t *info)
 
 void dbms::insert_rows(const insert_info_t *info)
 {
-	if(!assert_db_open())
+	if(!assert_db_open() || !assert_writable())
 		return;
 	__cache_clear_guard __guard;
 
@@ -846,7 +1838,8 @@ void dbms::insert_rows(const insert_info_t *info)
 		return;
 	}
 
-	std::vector<int> cols_id;
+	arena_vector<int> cols_id(&query_arena);
+	cols_id.reserve(tb->get_column_num());
 	if(info->columns == nullptr)
 	{
 		// exclude __rowid__, which has the largest index
@@ -867,7 +1860,19 @@ void dbms::insert_rows(const insert_info_t *info)
 		}
 	}
 
-	int count_succ = 0, count_fail = 0;
+	// the rows are checked and inserted in batches
+	int count_succ = 0, count_fail = 0, batch_num = 0;
+	int record_size = tb->get_temp_record_size();
+	arena_vector<char> batch(&query_arena);
+	auto insert_batch = [&]() {
+		if(batch_num == 0) return;
+		int succ = tb->insert_records(batch.data(), batch_num);
+		count_succ += succ;
+		count_fail += batch_num - succ;
+		batch.clear();
+		batch_num = 0;
+	};
+
 	for(linked_list_t *list = info->values; list; list = list->next)
 	{
 		tb->init_temp_record();
@@ -888,6 +1893,7 @@ void dbms::insert_rows(const insert_info_t *info)
 				v = expression::eval((expr_node_t*)expr_list->data);
 			} catch (const char *e) {
 				std::fprintf(stderr, "%s\n", e);
+				insert_batch();
 				return;
 			}
 
@@ -895,6 +1901,7 @@ void dbms::insert_rows(const insert_info_t *info)
 			if(!typecast::type_compatible(col_type, v))
 			{
 				std::fprintf(stderr, "[Error] incompatible type.\n");
+				insert_batch();
 				return;
 			}
 			
@@ -907,28 +1914,114 @@ void dbms::insert_rows(const insert_info_t *info)
 			}
 		}
 
-		if(succ) succ = (tb->insert_record() > 0);
-		count_succ += succ;
-		count_fail += 1 - succ;
+		if(!succ)
+		{
+			++count_fail;
+			continue;
+		}
+
+		const char *record = tb->get_temp_record();
+		batch.insert(batch.end(), record, record + record_size);
+		if(++batch_num == TABLE_INSERT_BATCH_ROWS)
+			insert_batch();
 	}
 
+	insert_batch();
 	std::printf("[Info] %d row(s) inserted, %d row(s) failed.\n", count_succ, count_fail);
 }
 
+void dbms::copy_rows(const insert_info_t *info, const char *filename)
+{
+	if(!assert_db_open() || !assert_writable())
+		return;
+	__cache_clear_guard __guard;
+
+	table_manager *tb = cur_db->get_table(info->table);
+	if(tb == nullptr)
+	{
+		std::fprintf(stderr, "[Error] table `%s` not found.\n", info->table);
+		return;
+	}
+
+	std::vector<int> cols;
+	if(info->columns == nullptr)
+	{
+		// in the order of CREATE TABLE, as INSERT takes the values
+		for(int i = tb->get_column_num() - 2; i >= 0; --i)
+			cols.push_back(i);
+	} else {
+		for(linked_list_t *link_ptr = info->columns; link_ptr; link_ptr = link_ptr->next)
+		{
+			column_ref_t *column = (column_ref_t*)link_ptr->data;
+			int cid = tb->lookup_column(column->column);
+			if(cid < 0)
+			{
+				std::fprintf(stderr, "[Error] No column `%s` in table `%s`.\n",
+					column->column, tb->get_table_name());
+				return;
+			}
+			cols.push_back(cid);
+		}
+
+		// the list is in the reverse order
+		std::reverse(cols.begin(), cols.end());
+	}
+
+	std::unique_ptr<bulk_reader> reader = bulk_reader::open(filename, tb, cols);
+	if(!reader)
+		return;
+
+	// the rows are read into batches, checked and inserted as by INSERT
+	long long count_succ = 0, count_fail = 0;
+	int batch_num = 0, record_size = tb->get_temp_record_size();
+	std::vector<char> batch;
+	batch.reserve((size_t)TABLE_INSERT_BATCH_ROWS * record_size);
+	auto insert_batch = [&]() {
+		if(batch_num == 0) return;
+		int succ = tb->insert_records(batch.data(), batch_num);
+		count_succ += succ;
+		count_fail += batch_num - succ;
+		batch.clear();
+		batch_num = 0;
+	};
+
+	tb->begin_bulk_insert();
+	for(;;)
+	{
+		bulk_reader::result_t r = reader->next();
+		if(r == bulk_reader::ROW_END || r == bulk_reader::ROW_BROKEN)
+			break;
+		if(r == bulk_reader::ROW_BAD)
+		{
+			++count_fail;
+			continue;
+		}
+
+		const char *record = tb->get_temp_record();
+		batch.insert(batch.end(), record, record + record_size);
+		if(++batch_num == TABLE_INSERT_BATCH_ROWS)
+			insert_batch();
+	}
+
+	insert_batch();
+	tb->end_bulk_insert(index_fill_factor);
+	std::printf("[Info] %lld row(s) loaded, %lld row(s) failed.\n", count_succ, count_fail);
+}
+
 void dbms::drop_index(const char *tb_name, const char *col_name)
 {
 }
 
-void dbms::create_index(const char *tb_name, const char *col_name)
+void dbms::create_index(const char *tb_name, const char *col_name, int index_type)
 {
-	if(!assert_db_open())
+	if(!assert_db_open() || !assert_writable())
 		return;
 	table_manager *tb = cur_db->get_table(tb_name);
 	if(tb == nullptr)
 	{
 		std::fprintf(stderr, "[Error] table `%s` not exists.\n", tb_name);
 	} else {
-		tb->create_index(col_name);
+		tb->create_index(col_name, index_fill_factor, index_bloom_bits, index_type);
 	}
 }
 
@@ -940,6 +2033,14 @@ bool dbms::assert_db_open()
 	return false;
 }
 
+bool dbms::assert_writable()
+{
+	if(!page_fs::get_instance()->is_read_only())
+		return true;
+	std::fprintf(stderr, "[Error] The databases are opened read-only.\n");
+	return false;
+}
+
 expr_node_t *dbms::get_join_cond(expr_node_t *cond)
 {
 	if(!cond) return nullptr;
@@ -951,35 +2052,54 @@ expr_node_t *dbms::get_join_cond(expr_node_t *cond)
 	}
 }
 
-bool dbms::find_longest_path(int now, int depth, int *mark, int *path, std::vector<std::vector<int>> &E, int excepted_len, int &max_depth)
+/* Hash the values of a column such that the values equal by the `=`
+ * operator have the same hash, strings are compared ignoring case. */
+uint64_t dbms::hash_join_key(const char *data, int type)
 {
-	mark[now] = 1;
-	path[depth] = now;
-	if(depth > max_depth)
-		max_depth = depth;
-	if(depth == excepted_len)
-		return true;
-	for(int i = 0; i != (int)E.size(); ++i)
+	uint64_t h = 14695981039346656037ull;
+	auto feed = [&h](unsigned char c) { h = (h ^ c) * 1099511628211ull; };
+	switch(type)
 	{
-		if(!E[now][i] || mark[i]) continue;
-		if(find_longest_path(i, depth + 1, mark, path, E, excepted_len, max_depth))
-			return true;
+		case COL_TYPE_VARCHAR:
+			for(const char *p = data; *p; ++p)
+				feed(std::tolower((unsigned char)*p));
+			break;
+		case COL_TYPE_FLOAT: {
+			float f = *(const float*)data;
+			if(f == 0) f = 0;  // -0 equals 0
+			const char *b = (const char*)&f;
+			for(size_t i = 0; i != sizeof(f); ++i)
+				feed(b[i]);
+			break; }
+		default:
+			for(int i = 0; i != 4; ++i)
+				feed(data[i]);
+			break;
 	}
 
-	mark[now] = 0;
-	return false;
+	return h;
 }
 
-bool dbms::value_exists(const char *table, const char *column, const char *data)
+void dbms::build_join_hash(table_manager *tm, int cid, join_hash_t &hash)
 {
-	if(!assert_db_open())
-		return false;
-	table_manager *tm = cur_db->get_table(table);
-	if(tm == nullptr) 
+	hash.type = tm->get_column_type(cid);
+	hash.rows.clear();
+	hash.rows.reserve(tm->get_record_num());
+	auto it = tm->get_record_iterator_lower_bound(0);
+	hash.pg = it.get_pager();
+	for(; !it.is_end(); it.next())
 	{
-		std::printf("[Error] No table named `%s`\n", table);
-		return false;
+		record_manager rm(hash.pg);
+		rm.open(it.get(), false);
+		tm->cache_record(&rm);
+		const char *key = tm->get_cached_column(cid);
+		if(key) hash.rows.push_back({ hash_join_key(key, hash.type), it.get() });
 	}
 
-	return tm->value_exists(column, data);
+	// keep the rows of the same hash in the order of the table
+	std::stable_sort(hash.rows.begin(), hash.rows.end(),
+		[](const std::pair<uint64_t, std::pair<int, int>> &a,
+			const std::pair<uint64_t, std::pair<int, int>> &b) {
+			return a.first < b.first;
+		} );
 }
@@ -4,19 +4,117 @@
 #include "../table/table.h"
 #include "../parser/defs.h"
 #include "../expression/expression.h"
+#include "join_planner.h"
+#include "batch_scan.h"
+#include "query_plan.h"
+#include "result_sink.h"
+#include "session.h"
 #include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+/* The rows of a table hashed by a join column, for hash joins. The rows
+ * are sorted by the hash, and the rows with the same hash by position. */
+struct join_hash_t
+{
+	pager *pg;
+	int type;
+	std::vector<std::pair<uint64_t, std::pair<int, int>>> rows;
+
+	join_hash_t() : pg(nullptr), type(0) {}
+};
+
+/* A scan of the index of a column bounded by the conjuncts comparing
+ * the column with constants. The scan starts at `key`, or at the first
+ * entry which is not NULL if there is no lower bound, and stops once
+ * one of `upper_conds` is false. */
+struct index_range_t
+{
+	index_manager *index;
+	int cid;
+	double sel;
+	std::vector<char> key;
+	std::vector<expr_node_t*> upper_conds;
+	// the entries scanned start with it, for `LIKE 'abc%'`
+	std::string prefix;
+	// scan from the last entry to the first, for ORDER BY ... DESC
+	bool reverse;
+	// start at the first entry, NULL or not, if there is no `key`
+	bool with_nulls;
+	/* the rows are visited in the order of the index, as ORDER BY needs,
+	 * otherwise in the order of rids */
+	bool key_order;
+
+	index_range_t() : index(nullptr), cid(-1), sel(1), reverse(false),
+		with_nulls(false), key_order(false) {}
+};
+
+/* A table of a join as it is iterated, see join_step_t. */
+struct join_level_t
+{
+	join_step_t step;
+	index_manager *index;
+	join_hash_t hash;
+	// the rids found in a hash index
+	std::vector<int> rids;
+	compiled_expression join_cond;
+	arena_vector<compiled_expression> conds;
+	// the rows looked at and those joined, for the statistics
+	uint64_t examined, emitted;
+
+	join_level_t() : index(nullptr), examined(0), emitted(0) {}
+};
 
 class dbms
 {
-	FILE *output_file;
+	// those of the current session, saved to it when another one runs
+	FILE *output_file;  // nullptr for stdout
+	result_format_t output_format;
 	database *cur_db;
+	session_t console, *session;
+	// the databases opened by the sessions, with the number of them using each
+	std::map<std::string, std::pair<database*, int>> databases;
+	int index_fill_factor;
+	// bits per key of the bloom filters of new indices, 0 for none
+	int index_bloom_bits;
+	int scan_threads;
+	// the temporaries of the statement running, see end_query()
+	arena query_arena;
+	// the rows selected are formatted into it, kept to reuse its memory
+	std::string output_buffer;
+	// of the SELECT run by EXPLAIN, nullptr otherwise
+	query_plan *plan;
+	// the statements run, counted from 1 by end_query()
+	uint64_t statement_num;
 private:
 	dbms();
+	database *acquire_database(const char *db_name);
+	void release_database(database *db);
+	FILE *get_output() { return output_file ? output_file : stdout; }
+	/* add a node to the plan if explaining, returns -1 otherwise */
+	int plan_add(const std::string &name, const std::string &detail, double est_rows = -1)
+	{
+		return plan ? plan->add(name, detail, est_rows) : -1;
+	}
+
+	// the query is explained without being run
+	bool plan_only() { return plan && !plan->is_analyze(); }
 
 public:
 	~dbms();
 
+	/* Run the following statements in session `s`, or the console if
+	 * nullptr. The databases are shared by the sessions using them. */
+	void switch_session(session_t *s);
+	session_t *get_session() { return session; }
+	bool in_console() { return session == &console; }
+
 	void close_database();
+	void commit();
+	arena *get_query_arena() { return &query_arena; }
+	/* free the temporaries of the statement which has been run */
+	void end_query();
 	void show_database(const char *db_name);
 	void switch_database(const char *db_name);
 	void drop_database(const char *db_name);
@@ -25,54 +123,82 @@ public:
 	void create_table(const table_header_t *header);
 	void show_table(const char *table_name);
 	void drop_table(const char *table_name);
+	void analyze_table(const char *table_name);
+	void vacuum_table(const char *table_name);
 
-	void create_index(const char *tb_name, const char *col_name);
+	void create_index(const char *tb_name, const char *col_name, int index_type = INDEX_TYPE_BTREE);
 	void drop_index(const char *tb_name, const char *col_name);
 
 	void insert_rows(const insert_info_t *info);
+	/* COPY: insert the rows of a file into the columns `info->columns`
+	 * (all if nullptr) of `info->table`, see bulk_reader */
+	void copy_rows(const insert_info_t *info, const char *filename);
 	void delete_rows(const delete_info_t *info);
 	void select_rows(const select_info_t *info);
+	/* EXPLAIN [ANALYZE], the plan goes where the rows would */
+	void explain_select(const select_info_t *info, bool analyze);
+	/* the statistics of the process since it started */
+	void show_stats();
 	void update_rows(const update_info_t *info);
 
 	void switch_select_output(const char *filename);
+	void set_variable(const char *name, int value);
+	void set_variable(const char *name, const char *value);
 
 	void select_rows_aggregate(
 		const select_info_t *info,
 		const std::vector<table_manager*> &required_tables,
 		const std::vector<expr_node_t*> &exprs,
-		const std::vector<std::string> &expr_names);
+		const std::vector<std::string> &expr_names,
+		result_sink *sink);
 
-	bool value_exists(const char *table, const char *column, const char *data);
+	/* The table of the current database, nullptr if none. A table found
+	 * stays valid until the statement with `get_statement_num()` ends. */
+	table_manager *find_table(const char *name) { return cur_db ? cur_db->get_table(name) : nullptr; }
+	uint64_t get_statement_num() { return statement_num; }
 
 public:
 	bool assert_db_open();
+	bool assert_writable();
 	void cache_record(table_manager *tm, record_manager *rm);
 
 	template<typename Callback>
-	void iterate(std::vector<table_manager*> required_tables, expr_node_t *cond, Callback callback);
+	void iterate(std::vector<table_manager*> required_tables, expr_node_t *cond,
+			Callback callback, uint32_t used_cols = ~0u);
 
 	template<typename Callback>
 	void iterate_one_table(table_manager* table,
 			expr_node_t *cond, Callback callback);
 	template<typename Callback>
+	bool iterate_batches(table_manager *table, expr_node_t *cond, Callback callback);
+	template<typename Callback>
 	bool iterate_one_table_with_index(table_manager* table,
-			expr_node_t *cond, Callback callback);
+			expr_node_t *cond, Callback callback, uint32_t used_cols = ~0u);
+	template<typename Callback>
+	void iterate_index_range(table_manager *table, expr_node_t *cond,
+			const index_range_t &range, Callback callback, uint32_t used_cols);
 	template<typename Callback>
-	bool iterate_many_tables_impl(
+	bool iterate_join_levels(
 		const std::vector<table_manager*> &table_list,
 		std::vector<record_manager*> &record_list,
 		std::vector<int> &rid_list,
-		std::vector<std::vector<expr_node_t*>> &index_cond,
-		int *iter_order, int *index_cid, index_manager** index,
-		expr_node_t *cond, Callback callback, int now);
+		std::vector<join_level_t> &levels,
+		int now, Callback callback);
 	template<typename Callback>
 	void iterate_many_tables(
 		const std::vector<table_manager*> &table_list,
 		expr_node_t *cond, Callback callback);
 
 	static expr_node_t *get_join_cond(expr_node_t *cond);
+	static bool collect_columns(table_manager *table, const expr_node_t *expr, uint32_t &cols);
+	static bool choose_index_range(table_manager *table,
+		const std::vector<expr_node_t*> &and_cond, index_range_t &range);
+	static bool choose_index_order(table_manager *table,
+		const std::vector<expr_node_t*> &and_cond, const order_by_item_t *item,
+		bool has_limit, index_range_t &range);
+	static uint64_t hash_join_key(const char *data, int type);
+	static void build_join_hash(table_manager *tm, int cid, join_hash_t &hash);
 	static void extract_and_cond(expr_node_t *cond, std::vector<expr_node_t*> &and_cond);
-	static bool find_longest_path(int now, int depth, int *mark, int *path, std::vector<std::vector<int>> &E, int excepted_len, int &max_depth);
 
 public:
 	static dbms* get_instance()
@@ -0,0 +1,256 @@
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdint.h>
+#include "hash_aggregate.h"
+
+static bool can_aggregate(operator_type_t op, const expression &val)
+{
+	return op == OPERATOR_COUNT || val.type == TERM_NULL
+		|| val.type == TERM_INT || val.type == TERM_FLOAT;
+}
+
+void aggregate_state_t::init(operator_type_t op)
+{
+	type = TERM_NONE;
+	values = 0;
+	val_i = 0;
+	val_f = 0;
+	if(op == OPERATOR_MIN)
+	{
+		val_i = std::numeric_limits<int>::max();
+		val_f = std::numeric_limits<float>::max();
+	} else if(op == OPERATOR_MAX) {
+		val_i = std::numeric_limits<int>::min();
+		val_f = std::numeric_limits<float>::lowest();
+	}
+}
+
+bool aggregate_state_t::add(operator_type_t op, const expression &val)
+{
+	if(val.type == TERM_NULL)
+		return true;
+	if(!can_aggregate(op, val))
+		return false;
+
+	++values;
+	if(op == OPERATOR_COUNT)
+		return true;
+
+	type = val.type;
+	if(val.type == TERM_FLOAT)
+	{
+		switch(op)
+		{
+			case OPERATOR_SUM:
+			case OPERATOR_AVG:
+				val_f += val.val_f;
+				break;
+			case OPERATOR_MIN:
+				if(val.val_f < val_f)
+					val_f = val.val_f;
+				break;
+			case OPERATOR_MAX:
+				if(val.val_f > val_f)
+					val_f = val.val_f;
+				break;
+			default: break;
+		}
+	} else {
+		switch(op)
+		{
+			case OPERATOR_SUM:
+			case OPERATOR_AVG:
+				val_i += val.val_i;
+				break;
+			case OPERATOR_MIN:
+				if(val.val_i < val_i)
+					val_i = val.val_i;
+				break;
+			case OPERATOR_MAX:
+				if(val.val_i > val_i)
+					val_i = val.val_i;
+				break;
+			default: break;
+		}
+	}
+
+	return true;
+}
+
+void aggregate_state_t::merge(operator_type_t op, const aggregate_state_t &other)
+{
+	if(other.values == 0)
+		return;
+
+	values += other.values;
+	if(op == OPERATOR_COUNT)
+		return;
+
+	// the field not of `type` keeps its initial value in both
+	type = other.type;
+	switch(op)
+	{
+		case OPERATOR_SUM:
+		case OPERATOR_AVG:
+			val_i += other.val_i;
+			val_f += other.val_f;
+			break;
+		case OPERATOR_MIN:
+			val_i = std::min(val_i, other.val_i);
+			val_f = std::min(val_f, other.val_f);
+			break;
+		case OPERATOR_MAX:
+			val_i = std::max(val_i, other.val_i);
+			val_f = std::max(val_f, other.val_f);
+			break;
+		default: break;
+	}
+}
+
+expression aggregate_state_t::result(operator_type_t op) const
+{
+	expression ret;
+	if(op == OPERATOR_COUNT)
+	{
+		ret.type = TERM_INT;
+		ret.val_i = values;
+	} else if(values == 0) {
+		ret.type = TERM_NULL;
+	} else if(op == OPERATOR_AVG) {
+		ret.type = TERM_FLOAT;
+		if(type == TERM_INT)
+			ret.val_f = double(val_i) / values;
+		else ret.val_f = val_f / values;
+	} else if(type == TERM_FLOAT) {
+		ret.type = TERM_FLOAT;
+		ret.val_f = val_f;
+	} else {
+		ret.type = TERM_INT;
+		ret.val_i = val_i;
+	}
+
+	return ret;
+}
+
+hash_aggregator::~hash_aggregator()
+{
+	for(std::FILE *f : partitions)
+	{
+		if(f) std::fclose(f);
+	}
+}
+
+aggregate_state_t *hash_aggregator::group(const std::string &key)
+{
+	auto ret = groups.emplace(key, (int)order.size());
+	if(ret.second)
+	{
+		order.push_back({ &ret.first->first, ret.first->second });
+		for(operator_type_t op : ops)
+		{
+			states.emplace_back();
+			states.back().init(op);
+		}
+	}
+
+	return states.data() + (size_t)ret.first->second * ops.size();
+}
+
+bool hash_aggregator::add(const std::string &key, const expression *vals)
+{
+	for(size_t i = 0; i != ops.size(); ++i)
+	{
+		if(!can_aggregate(ops[i], vals[i]))
+			return false;
+	}
+
+	auto it = groups.find(key);
+	aggregate_state_t *st;
+	if(it != groups.end())
+	{
+		st = states.data() + (size_t)it->second * ops.size();
+	} else if(groups.size() >= GROUP_AGG_MAX_GROUPS && spill(key, vals)) {
+		return true;
+	} else {
+		st = group(key);
+	}
+
+	for(size_t i = 0; i != ops.size(); ++i)
+		st[i].add(ops[i], vals[i]);
+	return true;
+}
+
+/* A spilled row is the size of the key, the key, and the type and the
+ * value of each operand. Returns false if the row is kept in memory. */
+bool hash_aggregator::spill(const std::string &key, const expression *vals)
+{
+	if(in_memory || depth >= GROUP_AGG_MAX_DEPTH)
+		return false;
+
+	if(partitions.empty())
+	{
+		partitions.assign(GROUP_AGG_PARTITIONS, nullptr);
+		for(std::FILE *&f : partitions)
+		{
+			if((f = std::tmpfile()) != nullptr)
+				continue;
+			std::fprintf(stderr, "[Warning] Fail to create a temporary file for aggregation.\n");
+			for(std::FILE *g : partitions)
+			{
+				if(g) std::fclose(g);
+			}
+
+			partitions.clear();
+			in_memory = true;
+			return false;
+		}
+	}
+
+	// [size, key, (type, value) of each aggregate]
+	uint32_t size = key.size();
+	row.resize(sizeof(size) + size + ops.size() * (1 + sizeof(int)));
+	char *p = row.data();
+	std::memcpy(p, &size, sizeof(size));
+	p += sizeof(size);
+	std::memcpy(p, key.data(), size);
+	p += size;
+	for(size_t i = 0; i != ops.size(); ++i)
+	{
+		*p++ = (char)vals[i].type;
+		std::memcpy(p, &vals[i].val_i, sizeof(int));
+		p += sizeof(int);
+	}
+
+	// a different hash for each depth, or the rows would stay together
+	uint64_t h = std::hash<std::string>()(key) ^ (uint64_t)depth * 0x9e3779b97f4a7c15ull;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	std::fwrite(row.data(), row.size(), 1, partitions[h % GROUP_AGG_PARTITIONS]);
+	return true;
+}
+
+void hash_aggregator::aggregate_partition(std::FILE *f, hash_aggregator &child)
+{
+	std::rewind(f);
+	std::string key;
+	std::vector<expression> vals(ops.size());
+	uint32_t size;
+	while(std::fread(&size, sizeof(size), 1, f) == 1)
+	{
+		key.resize(size);
+		if(size && std::fread(&key[0], size, 1, f) != 1)
+			break;
+		for(expression &val : vals)
+		{
+			char type;
+			if(std::fread(&type, 1, 1, f) != 1 || std::fread(&val.val_i, sizeof(int), 1, f) != 1)
+				return;
+			val.type = (term_type_t)type;
+		}
+
+		child.add(key, vals.data());
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef __TRIVIALDB_HASH_AGGREGATE__
+#define __TRIVIALDB_HASH_AGGREGATE__
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include "../defs.h"
+#include "../parser/defs.h"
+#include "../expression/expression.h"
+
+/* The state of an aggregate over the rows of a group, the NULLs are
+ * skipped. A FLOAT column is folded into `val_f`, others into `val_i`. */
+struct aggregate_state_t
+{
+	term_type_t type;   // TERM_NONE before the first value
+	int values;         // the values folded
+	int val_i;
+	float val_f;
+
+	void init(operator_type_t op);
+	/* returns false if the value cannot be aggregated by `op` */
+	bool add(operator_type_t op, const expression &val);
+	/* fold in the state of the same aggregate over other rows */
+	void merge(operator_type_t op, const aggregate_state_t &other);
+	/* NULL if no value is folded, except for COUNT */
+	expression result(operator_type_t op) const;
+};
+
+/* Aggregate the rows by the keys of their groups in a hash table, the
+ * key of a row is its GROUP BY values by expression::encode. Once
+ * GROUP_AGG_MAX_GROUPS groups are in memory, the rows of the other
+ * groups are written to GROUP_AGG_PARTITIONS temporary files by the
+ * hash of their keys, and each file is aggregated the same way after
+ * the groups in memory are done. */
+class hash_aggregator
+{
+	std::vector<operator_type_t> ops;
+	int depth;
+	bool in_memory;     // no temporary file can be created
+	std::unordered_map<std::string, int> groups;
+	// the keys and states of the groups in the order they are created
+	std::vector<std::pair<const std::string*, int>> order;
+	std::vector<aggregate_state_t> states;
+	std::vector<std::FILE*> partitions;
+	std::vector<char> row;
+
+	bool spill(const std::string &key, const expression *vals);
+	void aggregate_partition(std::FILE *f, hash_aggregator &child);
+
+public:
+	hash_aggregator(const std::vector<operator_type_t> &ops, int depth = 0)
+		: ops(ops), depth(depth), in_memory(false) {}
+	~hash_aggregator();
+
+	/* the states of a group kept in memory, created if not found, they
+	 * are valid until the next group is created */
+	aggregate_state_t *group(const std::string &key);
+	/* `vals` are the operands of the aggregates, returns false if one
+	 * cannot be aggregated */
+	bool add(const std::string &key, const expression *vals);
+
+	/* Call `callback(key, states)` once for each group, the groups are
+	 * consumed, so it can be called only once. */
+	template<typename Callback>
+	void for_each(Callback callback)
+	{
+		for(auto &g : order)
+			callback(*g.first, states.data() + (size_t)g.second * ops.size());
+		groups.clear();
+		order.clear();
+		states.clear();
+
+		for(std::FILE *&f : partitions)
+		{
+			hash_aggregator child(ops, depth + 1);
+			aggregate_partition(f, child);
+			std::fclose(f);
+			f = nullptr;
+			child.for_each(callback);
+		}
+
+		partitions.clear();
+	}
+};
+
+#endif
@@ -0,0 +1,369 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include "join_planner.h"
+#include "../table/table.h"
+#include "../expression/expression.h"
+
+bool join_planner::resolve(const column_ref_t *ref, int *tid, int *cid)
+{
+	*tid = -1;
+	for(int i = 0; i != (int)tables.size(); ++i)
+	{
+		if(ref->table && std::strcmp(ref->table, tables[i]->get_table_name()) != 0)
+			continue;
+		int c = tables[i]->lookup_column(ref->column);
+		if(c < 0) continue;
+		if(*tid != -1)
+			return false;  // not unique
+		*tid = i;
+		*cid = c;
+		if(ref->table) break;
+	}
+
+	return *tid != -1;
+}
+
+/* returns false if a column is not resolved */
+bool join_planner::collect_tables(const expr_node_t *expr, uint32_t &mask)
+{
+	if(expr->op == OPERATOR_NONE)
+	{
+		if(expr->term_type != TERM_COLUMN_REF)
+			return true;
+		int tid, cid;
+		if(!resolve(expr->column_ref, &tid, &cid))
+			return false;
+		mask |= 1u << tid;
+		return true;
+	}
+
+	bool ret = collect_tables(expr->left, mask);
+	if(!(expr->op & OPERATOR_UNARY))
+		ret = collect_tables(expr->right, mask) && ret;
+	return ret;
+}
+
+/* The columns of a table which has not been analyzed are taken as keys,
+ * and the distinct values grow with the rows after it is analyzed. */
+double join_planner::distinct(int tid, int cid)
+{
+	double rows = table_rows[tid];
+	const table_stats_t *stats = tables[tid]->get_stats();
+	double ret = rows;
+	if(stats && stats->records_num > 0)
+		ret = stats->cols[cid].distinct * rows / stats->records_num;
+	return std::max(1.0, std::min(rows, ret));
+}
+
+/* the selectivity of a condition on the table `tid` */
+double join_planner::estimate(const expr_node_t *expr, int tid)
+{
+	if(expr->op == OPERATOR_AND)
+		return estimate(expr->left, tid) * estimate(expr->right, tid);
+	if(expr->op == OPERATOR_OR)
+	{
+		double a = estimate(expr->left, tid), b = estimate(expr->right, tid);
+		return a + b - a * b;
+	}
+
+	const expr_node_t *col = expr->left, *val = expr->right;
+	operator_type_t op = expr->op;
+	if(!(op & OPERATOR_UNARY) && val && val->term_type == TERM_COLUMN_REF)
+	{
+		// value op column
+		std::swap(col, val);
+		switch(op)
+		{
+			case OPERATOR_LT:  op = OPERATOR_GT;  break;
+			case OPERATOR_GT:  op = OPERATOR_LT;  break;
+			case OPERATOR_LEQ: op = OPERATOR_GEQ; break;
+			case OPERATOR_GEQ: op = OPERATOR_LEQ; break;
+			default: break;
+		}
+	}
+
+	int t, cid;
+	if(!col || col->op != OPERATOR_NONE || col->term_type != TERM_COLUMN_REF
+		|| !resolve(col->column_ref, &t, &cid) || t != tid)
+		return STATS_DEFAULT_SELECTIVITY;
+
+	const table_stats_t *stats = tables[tid]->get_stats();
+	const column_stats_t *cs = stats ? &stats->cols[cid] : nullptr;
+	if(op == OPERATOR_ISNULL)
+		return cs ? cs->null_frac : STATS_DEFAULT_NULL_SELECTIVITY;
+	if(op == OPERATOR_NOTNULL)
+		return cs ? 1 - cs->null_frac : 1 - STATS_DEFAULT_NULL_SELECTIVITY;
+	if(!val || val->op != OPERATOR_NONE || val->term_type == TERM_COLUMN_REF)
+		return STATS_DEFAULT_SELECTIVITY;
+
+	double eq = cs ? cs->eq_selectivity() : STATS_DEFAULT_EQ_SELECTIVITY;
+	if(op == OPERATOR_EQ)
+		return eq;
+	if(op == OPERATOR_NEQ)
+		return 1 - eq;
+	if(op == OPERATOR_IN)
+	{
+		int num = 0;
+		for(linked_list_t *l = val->literal_list; l; l = l->next)
+			++num;
+		return std::min(1.0, eq * num);
+	}
+
+	if(op != OPERATOR_LT && op != OPERATOR_LEQ && op != OPERATOR_GT && op != OPERATOR_GEQ)
+		return STATS_DEFAULT_SELECTIVITY;
+	if(!cs || !cs->bucket_num)
+		return STATS_DEFAULT_SELECTIVITY;
+
+	double value;
+	if(val->term_type == TERM_INT)
+	{
+		value = val->val_i;
+	} else if(val->term_type == TERM_FLOAT) {
+		value = val->val_f;
+	} else if(val->term_type == TERM_DATE) {
+		expression date = expression::eval(val);
+		if(date.type != TERM_DATE)
+			return STATS_DEFAULT_SELECTIVITY;
+		value = date.val_i;
+	} else {
+		return STATS_DEFAULT_SELECTIVITY;
+	}
+
+	double less = cs->less_selectivity(value);
+	if(op == OPERATOR_LT || op == OPERATOR_LEQ)
+		return less;
+	return 1 - cs->null_frac - less;
+}
+
+join_planner::state_t join_planner::first(int table)
+{
+	double rows = table_rows[table] * local_sel[table];
+	return { table_rows[table] + rows, rows, 0, table, join_step_t::SCAN, -1 };
+}
+
+/* Join `table` to the tables `mask` joined by `from`. Each access costs
+ * the rows it reads, and the rows it produces are paid for as well. */
+join_planner::state_t join_planner::join(const state_t &from, uint32_t mask, int table)
+{
+	double outer = from.rows, rows = table_rows[table];
+	uint32_t next = mask | (1u << table);
+	double out = outer * rows * local_sel[table];
+	for(const cond_info_t &c : conds)
+	{
+		if(((c.tables >> table) & 1) && (c.tables & mask) && !(c.tables & ~next))
+			out *= c.sel;
+	}
+
+	state_t s = { outer * rows, out, 0, table, join_step_t::SCAN, -1 };
+	for(int i = 0; i != (int)conds.size(); ++i)
+	{
+		const cond_info_t &c = conds[i];
+		if(!c.is_equi) continue;
+		int cid;
+		if(c.t1 == table && ((mask >> c.t2) & 1))
+			cid = c.c1;
+		else if(c.t2 == table && ((mask >> c.t1) & 1))
+			cid = c.c2;
+		else continue;
+
+		double matches = rows / distinct(table, cid);
+		if(index_manager *index = tables[table]->get_index(cid))
+		{
+			// a hash index reads the page of the key, a tree descends to it
+			double descent = index->is_hash() ? 1 : std::log2(rows + 1);
+			double cost = outer * (descent + matches);
+			if(cost < s.cost)
+			{
+				s.cost = cost;
+				s.access = join_step_t::INDEX;
+				s.cond = i;
+			}
+		}
+
+		// building the hash reads each row and sorts it
+		double cost = 2 * rows + outer * (1 + matches);
+		if(cost < s.cost)
+		{
+			s.cost = cost;
+			s.access = join_step_t::HASH;
+			s.cond = i;
+		}
+	}
+
+	s.prev = mask;
+	s.cost += from.cost + out;
+	return s;
+}
+
+/* Dynamic programming over the sets of tables joined. The tables are
+ * listed in the reverse order of FROM, and the last of the plans of the
+ * same cost is kept, so that ties are joined in the order of FROM. */
+void join_planner::order_all(std::vector<state_t> &order)
+{
+	int num = tables.size();
+	uint32_t all = (1u << num) - 1;
+	state_t none = { std::numeric_limits<double>::infinity(), 0, 0, -1, 0, -1 };
+	std::vector<state_t> best(all + 1, none);
+	for(int i = 0; i != num; ++i)
+		best[1u << i] = first(i);
+
+	for(uint32_t mask = 1; mask < all; ++mask)
+	{
+		if(best[mask].table == -1) continue;
+		for(int i = 0; i != num; ++i)
+		{
+			if((mask >> i) & 1) continue;
+			state_t s = join(best[mask], mask, i);
+			uint32_t next = mask | (1u << i);
+			if(s.cost <= best[next].cost)
+				best[next] = s;
+		}
+	}
+
+	for(uint32_t mask = all; mask; mask = best[mask].prev)
+		order.push_back(best[mask]);
+	std::reverse(order.begin(), order.end());
+}
+
+/* add the cheapest table each time, ties are broken as order_all() */
+void join_planner::order_greedy(std::vector<state_t> &order)
+{
+	int num = tables.size();
+	order.push_back(first(0));
+	for(int i = 1; i != num; ++i)
+	{
+		state_t s = first(i);
+		if(s.cost <= order[0].cost)
+			order[0] = s;
+	}
+
+	uint32_t mask = 1u << order[0].table;
+	for(int k = 1; k != num; ++k)
+	{
+		state_t best = { std::numeric_limits<double>::infinity(), 0, 0, -1, 0, -1 };
+		for(int i = 0; i != num; ++i)
+		{
+			if((mask >> i) & 1) continue;
+			state_t s = join(order.back(), mask, i);
+			if(s.cost <= best.cost)
+				best = s;
+		}
+
+		order.push_back(best);
+		mask |= 1u << best.table;
+	}
+}
+
+bool join_planner::plan(const std::vector<expr_node_t*> &and_conds, std::vector<join_step_t> &steps)
+{
+	int num = tables.size();
+	table_rows.resize(num);
+	local_sel.assign(num, 1.0);
+	for(int i = 0; i != num; ++i)
+		table_rows[i] = std::max(1, tables[i]->get_record_num());
+
+	conds.clear();
+	for(expr_node_t *expr : and_conds)
+	{
+		cond_info_t c;
+		c.expr = expr;
+		c.tables = 0;
+		c.sel = STATS_DEFAULT_SELECTIVITY;
+		c.is_equi = false;
+		if(!collect_tables(expr, c.tables))
+			c.tables = 0;
+
+		if(expr->op == OPERATOR_EQ &&
+				expr->left->term_type == TERM_COLUMN_REF &&
+				expr->right->term_type == TERM_COLUMN_REF)
+		{
+			column_ref_t *refs[2] = { expr->left->column_ref, expr->right->column_ref };
+			int tids[2], cids[2];
+			for(int i = 0; i != 2; ++i)
+			{
+				if(resolve(refs[i], tids + i, cids + i) || !refs[i]->table)
+					continue;
+				bool found = false;
+				for(table_manager *tm : tables)
+					found |= std::strcmp(refs[i]->table, tm->get_table_name()) == 0;
+				std::fprintf(stderr, found ? "[Error] Column not found!\n" : "[Error] Table not found!\n");
+				return false;
+			}
+
+			if(c.tables && tids[0] != tids[1] &&
+				tables[tids[0]]->get_column_type(cids[0]) == tables[tids[1]]->get_column_type(cids[1]))
+			{
+				c.is_equi = true;
+				c.t1 = tids[0], c.c1 = cids[0];
+				c.t2 = tids[1], c.c2 = cids[1];
+				c.sel = 1 / std::max(distinct(c.t1, c.c1), distinct(c.t2, c.c2));
+			}
+		}
+
+		// conditions on one table are applied to its rows
+		if(c.tables && !(c.tables & (c.tables - 1)))
+		{
+			int tid = __builtin_ctz(c.tables);
+			c.sel = estimate(expr, tid);
+			local_sel[tid] *= c.sel;
+		}
+
+		conds.push_back(c);
+	}
+
+	std::vector<state_t> order;
+	if(num <= JOIN_DP_MAX_TABLES)
+		order_all(order);
+	else order_greedy(order);
+	plan_cost = order.back().cost;
+
+	std::vector<int> pos(num);
+	std::vector<bool> used(conds.size());
+	steps.resize(num);
+	for(int k = 0; k != num; ++k)
+	{
+		const state_t &s = order[k];
+		join_step_t &step = steps[k];
+		step.table = s.table;
+		step.access = s.access;
+		step.join_cond = nullptr;
+		step.conds.clear();
+		step.rows = s.rows;
+		pos[s.table] = k;
+		if(s.access == join_step_t::SCAN)
+			continue;
+
+		const cond_info_t &c = conds[s.cond];
+		used[s.cond] = true;
+		step.join_cond = c.expr;
+		if(c.t1 == s.table)
+		{
+			step.cid = c.c1;
+			step.key_table = c.t2, step.key_cid = c.c2;
+		} else {
+			step.cid = c.c2;
+			step.key_table = c.t1, step.key_cid = c.c1;
+		}
+	}
+
+	// check a condition as soon as the rows of its tables are known
+	for(int i = 0; i != (int)conds.size(); ++i)
+	{
+		if(used[i]) continue;
+		int k = num - 1;
+		if(conds[i].tables)
+		{
+			k = 0;
+			for(int t = 0; t != num; ++t)
+				if((conds[i].tables >> t) & 1)
+					k = std::max(k, pos[t]);
+		}
+
+		steps[k].conds.push_back(conds[i].expr);
+	}
+
+	return true;
+}
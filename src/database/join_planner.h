@@ -0,0 +1,70 @@
+#ifndef __TRIVIALDB_JOIN_PLANNER__
+#define __TRIVIALDB_JOIN_PLANNER__
+#include <vector>
+#include <stdint.h>
+#include "../parser/defs.h"
+
+class table_manager;
+
+/* How a table of a join is iterated for each row of the tables before
+ * it. For INDEX and HASH, `join_cond` is `table.cid = key_table.key_cid`
+ * and the rows are looked up by the value of the key column. */
+struct join_step_t
+{
+	enum { SCAN, INDEX, HASH };
+
+	int table, access;
+	int cid, key_table, key_cid;
+	expr_node_t *join_cond;
+	// the conditions checked once the row of the table is known
+	std::vector<expr_node_t*> conds;
+	// the rows estimated to be joined once the table is, for EXPLAIN
+	double rows;
+};
+
+/* Order the tables of a join by their estimated cost. The tables are
+ * joined left-deep, so every table is iterated for each row of the
+ * tables before it, by scanning it, by its index, or by a hash table of
+ * it built once. The row counts and selectivities are estimated from
+ * the statistics of ANALYZE, or from defaults if there are none. */
+class join_planner
+{
+	struct cond_info_t
+	{
+		expr_node_t *expr;
+		uint32_t tables;    // 0 if a column is not resolved
+		double sel;
+		// an equi-join of t1.c1 and t2.c2 of the same type
+		bool is_equi;
+		int t1, c1, t2, c2;
+	};
+
+	struct state_t
+	{
+		double cost, rows;
+		int prev, table, access, cond;
+	};
+
+	const std::vector<table_manager*> &tables;
+	std::vector<cond_info_t> conds;
+	std::vector<double> table_rows, local_sel;
+	double plan_cost;
+
+	bool resolve(const column_ref_t *ref, int *tid, int *cid);
+	bool collect_tables(const expr_node_t *expr, uint32_t &mask);
+	double distinct(int tid, int cid);
+	double estimate(const expr_node_t *expr, int tid);
+	state_t first(int table);
+	state_t join(const state_t &from, uint32_t mask, int table);
+	void order_all(std::vector<state_t> &order);
+	void order_greedy(std::vector<state_t> &order);
+
+public:
+	join_planner(const std::vector<table_manager*> &tables)
+		: tables(tables), plan_cost(0) {}
+	/* returns false if a join condition refers to an unknown column */
+	bool plan(const std::vector<expr_node_t*> &and_conds, std::vector<join_step_t> &steps);
+	double get_cost() { return plan_cost; }
+};
+
+#endif
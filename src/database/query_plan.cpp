@@ -0,0 +1,172 @@
+#include "query_plan.h"
+#include <sstream>
+
+query_plan::query_plan(bool analyze)
+	: analyze(analyze), depth(0), seconds(0)
+{
+	stats_before = thread_stats();
+	start = clock::now();
+}
+
+int query_plan::add(const std::string &name, const std::string &detail, double est_rows)
+{
+	nodes.push_back({ depth, name, detail, est_rows, 0, 0, -1 });
+	return nodes.size() - 1;
+}
+
+void query_plan::finish()
+{
+	seconds = std::chrono::duration<double>(clock::now() - start).count();
+	stats = thread_stats().since(stats_before);
+}
+
+void query_plan::print(std::FILE *fp) const
+{
+	std::fprintf(fp, "QUERY PLAN\n");
+	for(const plan_node_t &node : nodes)
+	{
+		std::fprintf(fp, "%*s%s%s", node.depth * 2, "", node.depth ? "-> " : "", node.name.c_str());
+		if(!node.detail.empty())
+			std::fprintf(fp, " %s", node.detail.c_str());
+		if(node.est_rows >= 0)
+			std::fprintf(fp, " (rows=%.0f)", node.est_rows);
+		if(analyze)
+		{
+			std::fprintf(fp, " (actual rows=%llu examined=%llu",
+				(unsigned long long)node.emitted, (unsigned long long)node.examined);
+			if(node.seconds >= 0)
+				std::fprintf(fp, " time=%.3fms", node.seconds * 1e3);
+			std::fprintf(fp, ")");
+		}
+
+		std::fprintf(fp, "\n");
+	}
+
+	if(analyze)
+	{
+		const exec_stats_t &s = stats;
+		std::fprintf(fp, "Execution time: %.3fms\n", seconds * 1e3);
+		std::fprintf(fp, "Buffer pool: hits=%llu misses=%llu evictions=%llu read=%llu written=%llu\n",
+			(unsigned long long)s.cache_hits, (unsigned long long)s.cache_misses,
+			(unsigned long long)s.cache_evictions, (unsigned long long)s.pages_read,
+			(unsigned long long)s.pages_written);
+		std::fprintf(fp, "B-tree: descents=%llu splits=%llu merges=%llu\n",
+			(unsigned long long)s.btree_descents, (unsigned long long)s.btree_splits,
+			(unsigned long long)s.btree_merges);
+		std::fprintf(fp, "Bloom filters: probes=%llu negatives=%llu\n",
+			(unsigned long long)s.bloom_probes, (unsigned long long)s.bloom_negatives);
+		std::fprintf(fp, "Expression evaluations: %llu\n", (unsigned long long)s.expr_evals);
+	}
+
+	std::fprintf(fp, "\n");
+}
+
+static const char *operator_name(int op)
+{
+	switch(op)
+	{
+		case OPERATOR_ADD:   return "+";
+		case OPERATOR_MINUS: return "-";
+		case OPERATOR_DIV:   return "/";
+		case OPERATOR_MUL:   return "*";
+		case OPERATOR_AND:   return "AND";
+		case OPERATOR_OR:    return "OR";
+		case OPERATOR_EQ:    return "=";
+		case OPERATOR_GEQ:   return ">=";
+		case OPERATOR_LEQ:   return "<=";
+		case OPERATOR_NEQ:   return "<>";
+		case OPERATOR_GT:    return ">";
+		case OPERATOR_LT:    return "<";
+		case OPERATOR_IN:    return "IN";
+		case OPERATOR_LIKE:  return "LIKE";
+		case OPERATOR_SUM:   return "SUM";
+		case OPERATOR_AVG:   return "AVG";
+		case OPERATOR_MIN:   return "MIN";
+		case OPERATOR_MAX:   return "MAX";
+		case OPERATOR_COUNT: return "COUNT";
+		default: return "?";
+	}
+}
+
+std::string query_plan::describe(const expr_node_t *expr)
+{
+	std::ostringstream ss;
+	if(!expr) return "*";
+	if(expr->op == OPERATOR_NONE)
+	{
+		switch(expr->term_type)
+		{
+			case TERM_INT:
+				ss << expr->val_i;
+				break;
+			case TERM_FLOAT:
+				ss << expr->val_f;
+				break;
+			case TERM_BOOL:
+				ss << (expr->val_b ? "TRUE" : "FALSE");
+				break;
+			case TERM_STRING:
+			case TERM_DATE:
+				ss << '\'' << expr->val_s << '\'';
+				break;
+			case TERM_COLUMN_REF:
+				if(expr->column_ref->table)
+					ss << expr->column_ref->table << '.';
+				ss << expr->column_ref->column;
+				break;
+			case TERM_NULL:
+				ss << "NULL";
+				break;
+			case TERM_PARAM:
+				ss << '?';
+				break;
+			case TERM_LITERAL_LIST: {
+				// the list is kept in the reverse order
+				std::vector<std::string> items;
+				for(linked_list_t *l = expr->literal_list; l; l = l->next)
+					items.push_back(describe((const expr_node_t*)l->data));
+				ss << '(';
+				for(size_t i = items.size(); i-- != 0; )
+					ss << items[i] << (i ? ", " : "");
+				ss << ')';
+				break; }
+			default:
+				break;
+		}
+
+		return ss.str();
+	}
+
+	// the operands of a binary operator are parenthesized if they are
+	auto operand = [](const expr_node_t *e) {
+		std::string str = describe(e);
+		bool binary = e && e->op != OPERATOR_NONE && !(e->op & OPERATOR_UNARY);
+		return binary ? "(" + str + ")" : str;
+	};
+
+	switch(expr->op)
+	{
+		case OPERATOR_NEGATE:
+			ss << '-' << operand(expr->left);
+			break;
+		case OPERATOR_ISNULL:
+			ss << operand(expr->left) << " IS NULL";
+			break;
+		case OPERATOR_NOTNULL:
+			ss << operand(expr->left) << " IS NOT NULL";
+			break;
+		case OPERATOR_NOT:
+			ss << "NOT " << operand(expr->left);
+			break;
+		case OPERATOR_SUM: case OPERATOR_AVG: case OPERATOR_MIN:
+		case OPERATOR_MAX: case OPERATOR_COUNT:
+			ss << operator_name(expr->op) << '(' << describe(expr->left) << ')';
+			break;
+		default:
+			ss << operand(expr->left) << ' ' << operator_name(expr->op)
+				<< ' ' << operand(expr->right);
+			break;
+	}
+
+	return ss.str();
+}
@@ -0,0 +1,97 @@
+#ifndef __TRIVIALDB_QUERY_PLAN__
+#define __TRIVIALDB_QUERY_PLAN__
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "../utils/exec_stats.h"
+#include "../parser/defs.h"
+
+/* An operator of a query as it is run, for EXPLAIN. The children of a
+ * node follow it with a larger depth. The rows are counted only by
+ * EXPLAIN ANALYZE, and the time a node is timed for includes that of
+ * its children. */
+struct plan_node_t
+{
+	int depth;
+	std::string name, detail;
+	double est_rows;     // < 0 if not estimated
+	uint64_t examined, emitted;
+	double seconds;      // < 0 if not timed
+};
+
+/* The plan of a query, built by dbms as it decides how to run it. By
+ * EXPLAIN, the decisions are made but no row is read, by EXPLAIN
+ * ANALYZE, the query runs without its rows being output, and the plan
+ * is shown with what each operator did, and the work of the whole
+ * query counted by exec_stats_t. */
+class query_plan
+{
+	typedef std::chrono::steady_clock clock;
+
+	bool analyze;
+	int depth;
+	std::vector<plan_node_t> nodes;
+	exec_stats_t stats_before, stats;
+	clock::time_point start;
+	double seconds;
+
+public:
+	explicit query_plan(bool analyze);
+
+	bool is_analyze() const { return analyze; }
+	bool empty() const { return nodes.empty(); }
+	/* add a node as a child of the nodes entered, returns its id */
+	int add(const std::string &name, const std::string &detail, double est_rows = -1);
+	plan_node_t &get(int id) { return nodes[id]; }
+	/* the nodes added until leave() are children of the last one */
+	void enter() { ++depth; }
+	void leave() { --depth; }
+
+	/* the query has been run, the work of the thread since the plan
+	 * was made is that of the query */
+	void finish();
+	void print(std::FILE *fp) const;
+
+	/* an expression as it is written, unlike expression::to_string,
+	 * which names the columns selected */
+	static std::string describe(const expr_node_t *expr);
+};
+
+/* Counts the rows examined and emitted by an operator while it runs.
+ * They are added to the statistics of the thread, and to node `id` of
+ * `plan` if any, which is timed then. */
+class operator_stats
+{
+	query_plan *plan;
+	int id;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	uint64_t examined, emitted;
+
+	operator_stats(query_plan *plan, int id)
+		: plan(id < 0 ? nullptr : plan), id(id), examined(0), emitted(0)
+	{
+		if(this->plan) start = std::chrono::steady_clock::now();
+	}
+
+	~operator_stats()
+	{
+		thread_stats().rows_examined += examined;
+		thread_stats().rows_emitted += emitted;
+		if(!plan) return;
+		plan_node_t &node = plan->get(id);
+		node.examined += examined;
+		node.emitted += emitted;
+		if(node.seconds < 0) node.seconds = 0;
+		node.seconds += std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	}
+
+	operator_stats(const operator_stats&) = delete;
+	operator_stats& operator = (const operator_stats&) = delete;
+};
+
+#endif
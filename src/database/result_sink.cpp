@@ -0,0 +1,467 @@
+#include "result_sink.h"
+#include "../defs.h"
+#include "../utils/lz_codec.h"
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+static bool ends_with(const char *str, const char *suffix)
+{
+	size_t len = std::strlen(str), suffix_len = std::strlen(suffix);
+	return len >= suffix_len && std::strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+result_format_t result_format_of(const char *filename)
+{
+	if(ends_with(filename, ".bin"))
+		return RESULT_BINARY;
+	if(ends_with(filename, ".col"))
+		return RESULT_COLUMNAR;
+	if(ends_with(filename, ".csv.lz"))
+		return RESULT_CSV_LZ;
+	return RESULT_CSV;
+}
+
+value_formatter::value_formatter()
+{
+	for(date_entry_t &e : dates)
+		e.valid = false;
+}
+
+void value_formatter::append_int(std::string &out, int x)
+{
+	char tmp[16], *p = tmp + sizeof(tmp);
+	uint32_t v = x < 0 ? 0u - (uint32_t)x : (uint32_t)x;
+	do {
+		*--p = '0' + v % 10;
+		v /= 10;
+	} while(v);
+	if(x < 0) *--p = '-';
+	out.append(p, tmp + sizeof(tmp) - p);
+}
+
+void value_formatter::append_float(std::string &out, float x)
+{
+	/* As printf("%f"). A float times 10^6 (2^6 * 15625) needs at most
+	 * 24 + 14 bits, so it is exact as a double and is rounded once,
+	 * to the nearest and to even on ties as printf does. */
+	double d = x;
+	if(!(std::fabs(d) < 9e12))
+	{
+		char tmp[64];
+		int len = std::snprintf(tmp, sizeof(tmp), "%f", d);
+		out.append(tmp, len);
+		return;
+	}
+
+	uint64_t v = (uint64_t)std::nearbyint(std::fabs(d) * 1e6);
+	char tmp[32], *p = tmp + sizeof(tmp);
+	for(int i = 0; i != 6; ++i, v /= 10)
+		*--p = '0' + v % 10;
+	*--p = '.';
+	do {
+		*--p = '0' + v % 10;
+		v /= 10;
+	} while(v);
+	if(std::signbit(d)) *--p = '-';
+	out.append(p, tmp + sizeof(tmp) - p);
+}
+
+void value_formatter::append_date(std::string &out, int time)
+{
+	date_entry_t &e = dates[(uint32_t)time / 86400 % DATE_CACHE_SIZE];
+	if(!e.valid || e.time != time)
+	{
+		time_t t = time;
+		std::tm tm;
+		localtime_r(&t, &tm);
+		if(!std::strftime(e.text, sizeof(e.text), DATE_TEMPLATE, &tm))
+			e.text[0] = 0;
+		e.time = time;
+		e.valid = true;
+	}
+
+	out.append(e.text);
+}
+
+void value_formatter::append(std::string &out, const expression &val)
+{
+	switch(val.type)
+	{
+		case TERM_INT:
+			append_int(out, val.val_i);
+			break;
+		case TERM_FLOAT:
+			append_float(out, val.val_f);
+			break;
+		case TERM_STRING:
+			out.append(val.val_s);
+			break;
+		case TERM_BOOL:
+			out.append(val.val_b ? "TRUE" : "FALSE");
+			break;
+		case TERM_DATE:
+			append_date(out, val.val_i);
+			break;
+		case TERM_NULL:
+			out.append("NULL");
+			break;
+		default:
+			debug_puts("[Error] Data type not supported!");
+	}
+}
+
+void result_sink::put_u16(uint16_t x)
+{
+	char b[2] = { (char)x, (char)(x >> 8) };
+	buf.append(b, 2);
+}
+
+void result_sink::put_u32(uint32_t x)
+{
+	char b[4];
+	for(int i = 0; i != 4; ++i)
+		b[i] = (char)(x >> (i * 8));
+	buf.append(b, 4);
+}
+
+void result_sink::put_u64(uint64_t x)
+{
+	put_u32((uint32_t)x);
+	put_u32((uint32_t)(x >> 32));
+}
+
+void result_sink::write_out(bool)
+{
+	if(!buf.empty())
+		std::fwrite(buf.data(), 1, buf.size(), fp);
+	buf.clear();
+}
+
+void result_sink::flush()
+{
+	write_out(true);
+	std::fflush(fp);
+}
+
+result_value_type_t result_value_type(term_type_t type)
+{
+	switch(type)
+	{
+		case TERM_INT:    return VALUE_INT;
+		case TERM_FLOAT:  return VALUE_FLOAT;
+		case TERM_STRING: return VALUE_STRING;
+		case TERM_BOOL:   return VALUE_BOOL;
+		case TERM_DATE:   return VALUE_DATE;
+		default:          return VALUE_NULL;
+	}
+}
+
+namespace {
+
+class csv_sink : public result_sink
+{
+	value_formatter formatter;
+
+public:
+	using result_sink::result_sink;
+
+	virtual void begin(const std::vector<std::string> &names) override
+	{
+		for(size_t i = 0; i != names.size(); ++i)
+		{
+			if(i != 0) buf.push_back(',');
+			buf.append(names[i]);
+		}
+
+		buf.push_back('\n');
+	}
+
+	virtual void row(const std::vector<expression> &vals) override
+	{
+		for(size_t i = 0; i != vals.size(); ++i)
+		{
+			if(i != 0) buf.push_back(',');
+			formatter.append(buf, vals[i]);
+		}
+
+		buf.push_back('\n');
+		++rows;
+		if(buf.size() >= OUTPUT_BUFFER_SIZE)
+			write_out(false);
+	}
+
+	virtual void end() override
+	{
+		buf.push_back('\n');
+		flush();
+	}
+};
+
+class csv_lz_sink : public csv_sink
+{
+	enum { BLOCK_SIZE = LZ_BLOCK_SIZE };
+	char block[BLOCK_SIZE];
+
+	virtual void write_out(bool all) override
+	{
+		size_t pos = 0;
+		while(buf.size() - pos >= BLOCK_SIZE || (all && pos != buf.size()))
+		{
+			int size = (int)std::min<size_t>(BLOCK_SIZE, buf.size() - pos);
+			int packed = lz_codec::compress(buf.data() + pos, size, block, size - 1);
+			char head[8];
+			for(int i = 0; i != 4; ++i)
+			{
+				head[i] = (char)(size >> (i * 8));
+				head[4 + i] = (char)((packed ? packed : size) >> (i * 8));
+			}
+
+			std::fwrite(head, 1, 8, fp);
+			std::fwrite(packed ? block : buf.data() + pos, 1, packed ? packed : size, fp);
+			pos += size;
+		}
+
+		buf.erase(0, pos);
+	}
+
+public:
+	using csv_sink::csv_sink;
+};
+
+class binary_sink : public result_sink
+{
+protected:
+	void put_header(const std::vector<std::string> &names)
+	{
+		put_u8('H');
+		put_u16((uint16_t)names.size());
+		for(const std::string &name : names)
+		{
+			put_u16((uint16_t)name.size());
+			put_bytes(name.data(), name.size());
+		}
+	}
+
+	void put_value(const expression &val)
+	{
+		int type = result_value_type(val.type);
+		put_u8(type);
+		switch(type)
+		{
+			case VALUE_INT:
+			case VALUE_DATE:
+				put_u32((uint32_t)val.val_i);
+				break;
+			case VALUE_FLOAT: {
+				uint32_t bits;
+				std::memcpy(&bits, &val.val_f, 4);
+				put_u32(bits);
+				break; }
+			case VALUE_STRING: {
+				size_t len = std::strlen(val.val_s);
+				put_u32((uint32_t)len);
+				put_bytes(val.val_s, len);
+				break; }
+			case VALUE_BOOL:
+				put_u8(val.val_b);
+				break;
+			default:
+				break;
+		}
+	}
+
+public:
+	using result_sink::result_sink;
+
+	virtual void begin(const std::vector<std::string> &names) override
+	{
+		put_header(names);
+	}
+
+	virtual void row(const std::vector<expression> &vals) override
+	{
+		put_u8('R');
+		for(const expression &val : vals)
+			put_value(val);
+		++rows;
+		if(buf.size() >= OUTPUT_BUFFER_SIZE)
+			write_out(false);
+	}
+
+	virtual void end() override
+	{
+		put_u8('E');
+		put_u64(rows);
+		flush();
+	}
+};
+
+class columnar_sink : public binary_sink
+{
+	enum { BATCH_ROWS = 1024 };
+
+	/* a value of a batch, the bytes of a string are in `chars` */
+	struct cell_t
+	{
+		int type;
+		uint32_t bits;
+		uint32_t offset, length;
+	};
+
+	struct column_t
+	{
+		std::vector<cell_t> cells;
+		std::string chars;
+	};
+
+	std::vector<column_t> columns;
+	size_t batch_rows;
+	value_formatter formatter;
+	std::string text;
+
+	void put_column(column_t &col)
+	{
+		int type = VALUE_NULL;
+		for(const cell_t &c : col.cells)
+		{
+			if(c.type == VALUE_NULL || c.type == type)
+				continue;
+			type = type == VALUE_NULL ? c.type : VALUE_STRING;
+			if(type == VALUE_STRING) break;
+		}
+
+		put_u8(type);
+		std::string::size_type at = buf.size();
+		buf.append((batch_rows + 7) / 8, 0);
+		for(size_t i = 0; i != batch_rows; ++i)
+		{
+			if(col.cells[i].type != VALUE_NULL)
+				buf[at + i / 8] |= (char)(1 << (i % 8));
+		}
+
+		switch(type)
+		{
+			case VALUE_INT:
+			case VALUE_FLOAT:
+			case VALUE_DATE:
+				for(const cell_t &c : col.cells)
+					put_u32(c.bits);
+				break;
+			case VALUE_BOOL:
+				for(const cell_t &c : col.cells)
+					put_u8(c.bits);
+				break;
+			case VALUE_STRING:
+				put_strings(col);
+				break;
+			default:
+				break;
+		}
+	}
+
+	void put_strings(column_t &col)
+	{
+		// one more pass, for the values of a mixed column which are not strings
+		text.clear();
+		std::vector<uint32_t> ends;
+		for(const cell_t &c : col.cells)
+		{
+			if(c.type == VALUE_STRING)
+			{
+				text.append(col.chars, c.offset, c.length);
+			} else if(c.type != VALUE_NULL) {
+				expression val;
+				val.type = c.type == VALUE_INT ? TERM_INT : c.type == VALUE_FLOAT ? TERM_FLOAT
+					: c.type == VALUE_BOOL ? TERM_BOOL : TERM_DATE;
+				if(c.type == VALUE_BOOL) val.val_b = c.bits;
+				else std::memcpy(&val.val_i, &c.bits, 4);
+				formatter.append(text, val);
+			}
+
+			ends.push_back((uint32_t)text.size());
+		}
+
+		for(uint32_t end : ends)
+			put_u32(end);
+		put_bytes(text.data(), text.size());
+	}
+
+	void put_batch()
+	{
+		if(!batch_rows) return;
+		put_u8('B');
+		put_u32((uint32_t)batch_rows);
+		for(column_t &col : columns)
+		{
+			put_column(col);
+			col.cells.clear();
+			col.chars.clear();
+		}
+
+		batch_rows = 0;
+		if(buf.size() >= OUTPUT_BUFFER_SIZE)
+			write_out(false);
+	}
+
+public:
+	columnar_sink(std::FILE *fp, std::string &buf)
+		: binary_sink(fp, buf), batch_rows(0) {}
+
+	virtual void begin(const std::vector<std::string> &names) override
+	{
+		put_header(names);
+		columns.resize(names.size());
+	}
+
+	virtual void row(const std::vector<expression> &vals) override
+	{
+		for(size_t i = 0; i != columns.size() && i != vals.size(); ++i)
+		{
+			column_t &col = columns[i];
+			const expression &val = vals[i];
+			cell_t c = { result_value_type(val.type), 0, 0, 0 };
+			if(c.type == VALUE_STRING)
+			{
+				c.offset = (uint32_t)col.chars.size();
+				c.length = (uint32_t)std::strlen(val.val_s);
+				col.chars.append(val.val_s, c.length);
+			} else if(c.type == VALUE_BOOL) {
+				c.bits = val.val_b;
+			} else if(c.type != VALUE_NULL) {
+				std::memcpy(&c.bits, &val.val_i, 4);
+			}
+
+			col.cells.push_back(c);
+		}
+
+		++rows;
+		if(++batch_rows == BATCH_ROWS)
+			put_batch();
+	}
+
+	virtual void end() override
+	{
+		put_batch();
+		binary_sink::end();
+	}
+};
+
+}
+
+std::unique_ptr<result_sink> result_sink::create(result_format_t format,
+	std::FILE *fp, std::string &buf)
+{
+	switch(format)
+	{
+		case RESULT_BINARY:
+			return std::unique_ptr<result_sink>(new binary_sink(fp, buf));
+		case RESULT_COLUMNAR:
+			return std::unique_ptr<result_sink>(new columnar_sink(fp, buf));
+		case RESULT_CSV_LZ:
+			return std::unique_ptr<result_sink>(new csv_lz_sink(fp, buf));
+		default:
+			return std::unique_ptr<result_sink>(new csv_sink(fp, buf));
+	}
+}
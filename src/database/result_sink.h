@@ -0,0 +1,118 @@
+#ifndef __TRIVIALDB_RESULT_SINK__
+#define __TRIVIALDB_RESULT_SINK__
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "../expression/expression.h"
+
+/* How the rows selected are written, chosen by the name of the file of
+ * `SET OUTPUT`, see result_format_of(). */
+enum result_format_t
+{
+	RESULT_CSV,       // text, the default
+	RESULT_BINARY,    // `.bin`, a row at a time
+	RESULT_COLUMNAR,  // `.col`, the columns of 1024 rows at a time
+	RESULT_CSV_LZ     // `.csv.lz`, the text compressed by lz_codec
+};
+
+result_format_t result_format_of(const char *filename);
+
+/* the type bytes of the values of the binary formats */
+enum result_value_type_t
+{
+	VALUE_NULL, VALUE_INT, VALUE_FLOAT, VALUE_STRING, VALUE_BOOL, VALUE_DATE
+};
+
+result_value_type_t result_value_type(term_type_t type);
+
+/* Where a SELECT writes its rows. The output goes into `buf` and is
+ * written to the file as it grows past OUTPUT_BUFFER_SIZE, `buf` is
+ * kept by dbms so that its memory is reused by the next statement.
+ *
+ * The binary formats are little-endian. A value is a type byte, 0 for
+ * NULL, 1 INT, 2 FLOAT, 3 VARCHAR, 4 BOOL and 5 DATE, followed by 4
+ * bytes of INT, FLOAT and DATE (in seconds), 1 of BOOL, or the length
+ * of a VARCHAR in 4 bytes then its bytes. A result is
+ *
+ *   'H', the number of columns in 2 bytes, each name as a 2-byte length
+ *        and the bytes,
+ *   the rows, or the batches of the columnar format,
+ *   'E', the number of rows in 8 bytes.
+ *
+ * Each row of RESULT_BINARY is 'R' and its values. A batch of
+ * RESULT_COLUMNAR is 'B' and the number of rows in 4 bytes,
+ * then for each column its type byte, a bitmap of the rows not NULL
+ * (the low bit of the first byte for the first row), and the values of
+ * all the rows, 0 for NULL: 4 or 1 bytes each, or for VARCHAR the end of
+ * each string in 4 bytes, followed by the strings. A column of only
+ * NULL in a batch has type 0 and no values, one of more than one type
+ * is sent as VARCHAR, the values as in CSV.
+ *
+ * RESULT_CSV_LZ is the CSV text in blocks of up to 64 KB, each the size
+ * of the text and of the block in 4 bytes, then the block, which is
+ * stored as is if it does not compress. */
+class result_sink
+{
+public:
+	enum { OUTPUT_BUFFER_SIZE = 256 * 1024, LZ_BLOCK_SIZE = 65536 };
+
+protected:
+	std::FILE *fp;
+	std::string &buf;
+	uint64_t rows;
+
+	virtual void write_out(bool all);
+	void put_u8(uint8_t x) { buf.push_back((char)x); }
+	void put_u16(uint16_t x);
+	void put_u32(uint32_t x);
+	void put_u64(uint64_t x);
+	void put_bytes(const char *data, size_t size) { buf.append(data, size); }
+
+public:
+	result_sink(std::FILE *fp, std::string &buf) : fp(fp), buf(buf), rows(0)
+	{
+		buf.clear();
+	}
+
+	virtual ~result_sink() {}
+
+	static std::unique_ptr<result_sink> create(result_format_t format,
+		std::FILE *fp, std::string &buf);
+
+	virtual void begin(const std::vector<std::string> &names) = 0;
+	virtual void row(const std::vector<expression> &vals) = 0;
+	/* write what is buffered to the file */
+	virtual void flush();
+	/* the result is done, after the message of the rows selected */
+	virtual void end() = 0;
+
+	result_sink(const result_sink&) = delete;
+	result_sink& operator = (const result_sink&) = delete;
+};
+
+/* Formats values as CSV does, without stdio. The dates formatted are
+ * kept, as a column usually has few of them. */
+class value_formatter
+{
+	enum { DATE_CACHE_SIZE = 64 };
+	struct date_entry_t
+	{
+		int time;
+		char text[24];
+		bool valid;
+	};
+
+	date_entry_t dates[DATE_CACHE_SIZE];
+
+public:
+	value_formatter();
+	void append(std::string &out, const expression &val);
+	static void append_int(std::string &out, int x);
+	static void append_float(std::string &out, float x);
+	void append_date(std::string &out, int time);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include <cstring>
+#include <algorithm>
+#include "row_sort.h"
+#include "../parser/defs.h"
+
+static size_t value_size(term_type_t type, const char *p)
+{
+	switch(type)
+	{
+		case TERM_NULL:   return 0;
+		case TERM_STRING: return std::strlen(p) + 1;
+		case TERM_BOOL:   return 1;
+		default:          return sizeof(int);
+	}
+}
+
+/* Strings are compared as the index compares them, so that the order
+ * of a sort is the same as that of an index scan. */
+static int compare_value(term_type_t type, const char *a, const char *b)
+{
+	switch(type)
+	{
+		case TERM_STRING:
+			return std::strcmp(a, b);
+		case TERM_BOOL:
+			return (int)*a - (int)*b;
+		case TERM_FLOAT: {
+			float x, y;
+			std::memcpy(&x, a, sizeof(float));
+			std::memcpy(&y, b, sizeof(float));
+			return (x > y) - (x < y); }
+		default: {
+			int x, y;
+			std::memcpy(&x, a, sizeof(int));
+			std::memcpy(&y, b, sizeof(int));
+			return (x > y) - (x < y); }
+	}
+}
+
+row_sorter::row_sorter(const std::vector<bool> &desc, size_t limit)
+	: desc(desc), limit(limit), used(0), seq(0)
+{
+	if(limit > ORDER_BY_TOP_N_MAX)
+		this->limit = SIZE_MAX;
+}
+
+row_sorter::~row_sorter()
+{
+	for(std::FILE *f : runs)
+		std::fclose(f);
+}
+
+int row_sorter::compare(const std::string &a, const std::string &b) const
+{
+	const char *p = a.data() + sizeof(uint32_t);
+	const char *q = b.data() + sizeof(uint32_t);
+	for(bool d : desc)
+	{
+		term_type_t ta = (term_type_t)*p++, tb = (term_type_t)*q++;
+		int ret;
+		if(ta == TERM_NULL || tb == TERM_NULL)
+			ret = (ta != TERM_NULL) - (tb != TERM_NULL);
+		else if(ta != tb)
+			ret = ta < tb ? -1 : 1;
+		else ret = compare_value(ta, p, q);
+
+		if(ret) return d ? -ret : ret;
+		p += value_size(ta, p);
+		q += value_size(tb, q);
+	}
+
+	return 0;
+}
+
+const char *row_sorter::payload(const std::string &data, size_t *size)
+{
+	uint32_t key_size;
+	std::memcpy(&key_size, data.data(), sizeof(key_size));
+	size_t offset = sizeof(key_size) + key_size;
+	*size = data.size() - offset;
+	return data.data() + offset;
+}
+
+void row_sorter::add(const std::string &key, const std::string &data)
+{
+	row_t row;
+	row.seq = seq++;
+	uint32_t key_size = key.size();
+	row.data.reserve(sizeof(key_size) + key.size() + data.size());
+	row.data.append((const char*)&key_size, sizeof(key_size));
+	row.data.append(key);
+	row.data.append(data);
+
+	auto cmp = [this](const row_t &a, const row_t &b) { return less(a, b); };
+	if(limit != SIZE_MAX)
+	{
+		// a max-heap of the first `limit` rows
+		if(limit == 0)
+			return;
+		if(rows.size() == limit)
+		{
+			if(!less(row, rows.front()))
+				return;
+			std::pop_heap(rows.begin(), rows.end(), cmp);
+			rows.pop_back();
+		}
+
+		rows.push_back(std::move(row));
+		std::push_heap(rows.begin(), rows.end(), cmp);
+		return;
+	}
+
+	used += row.data.size() + sizeof(row_t);
+	rows.push_back(std::move(row));
+	if(used >= ORDER_BY_SORT_MEMORY)
+		write_run();
+}
+
+void row_sorter::sort_rows()
+{
+	auto cmp = [this](const row_t &a, const row_t &b) { return less(a, b); };
+	if(limit != SIZE_MAX)
+		std::sort_heap(rows.begin(), rows.end(), cmp);
+	else std::sort(rows.begin(), rows.end(), cmp);
+}
+
+void row_sorter::write_run()
+{
+	std::FILE *f = std::tmpfile();
+	if(!f)
+	{
+		// keep the rows in memory then
+		std::fprintf(stderr, "[Warning] Fail to create a temporary file for sorting.\n");
+		used = 0;
+		return;
+	}
+
+	sort_rows();
+	for(const row_t &row : rows)
+	{
+		uint32_t size = row.data.size();
+		std::fwrite(&size, sizeof(size), 1, f);
+		std::fwrite(row.data.data(), size, 1, f);
+	}
+
+	std::rewind(f);
+	runs.push_back(f);
+	rows.clear();
+	used = 0;
+}
+
+bool row_sorter::read_row(std::FILE *f, std::string &data)
+{
+	uint32_t size;
+	if(std::fread(&size, sizeof(size), 1, f) != 1)
+		return false;
+	data.resize(size);
+	return size == 0 || std::fread(&data[0], size, 1, f) == 1;
+}
@@ -0,0 +1,103 @@
+#ifndef __TRIVIALDB_ROW_SORT__
+#define __TRIVIALDB_ROW_SORT__
+#include <cstdio>
+#include <queue>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "../defs.h"
+
+/* Sort the rows of a SELECT by their keys, the values of ORDER BY by
+ * expression::encode, NULL is the smallest value. A row is a key and
+ * the data to output. With a limit, only the first `limit` rows are
+ * kept, in a bounded heap. Otherwise the rows are sorted in runs of at
+ * most ORDER_BY_SORT_MEMORY bytes, each run is written to a temporary
+ * file, and the runs are merged when they are read back. The rows of
+ * the same key are kept in the order they are added. */
+class row_sorter
+{
+	struct row_t
+	{
+		uint64_t seq;
+		std::string data;  // the size of the key, the key, the data
+	};
+
+	std::vector<bool> desc;
+	size_t limit, used;
+	uint64_t seq;
+	std::vector<row_t> rows;
+	std::vector<std::FILE*> runs;
+
+	int compare(const std::string &a, const std::string &b) const;
+	bool less(const row_t &a, const row_t &b) const
+	{
+		int ret = compare(a.data, b.data);
+		return ret < 0 || (ret == 0 && a.seq < b.seq);
+	}
+
+	void sort_rows();
+	void write_run();
+	static bool read_row(std::FILE *f, std::string &data);
+	static const char *payload(const std::string &data, size_t *size);
+
+public:
+	/* `desc` for each ORDER BY item, `limit` is SIZE_MAX if there is none */
+	row_sorter(const std::vector<bool> &desc, size_t limit);
+	~row_sorter();
+
+	void add(const std::string &key, const std::string &data);
+
+	/* Call `callback(data, size)` with each row in order until it returns
+	 * false, the rows are consumed, so it can be called only once. */
+	template<typename Callback>
+	void for_each(Callback callback)
+	{
+		if(runs.empty())
+		{
+			sort_rows();
+			for(const row_t &row : rows)
+			{
+				size_t size;
+				const char *data = payload(row.data, &size);
+				if(!callback(data, size))
+					break;
+			}
+
+			rows.clear();
+			return;
+		}
+
+		if(!rows.empty())
+			write_run();
+
+		// merge the runs with a heap of their first rows, the earlier
+		// runs first for the same key
+		int num = runs.size();
+		std::vector<std::string> heads(num);
+		auto greater = [&](int a, int b) {
+			int ret = compare(heads[a], heads[b]);
+			return ret > 0 || (ret == 0 && a > b);
+		};
+
+		std::priority_queue<int, std::vector<int>, decltype(greater)> heap(greater);
+		for(int i = 0; i != num; ++i)
+		{
+			if(read_row(runs[i], heads[i]))
+				heap.push(i);
+		}
+
+		while(!heap.empty())
+		{
+			int i = heap.top();
+			heap.pop();
+			size_t size;
+			const char *data = payload(heads[i], &size);
+			if(!callback(data, size))
+				break;
+			if(read_row(runs[i], heads[i]))
+				heap.push(i);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __TRIVIALDB_SESSION__
+#define __TRIVIALDB_SESSION__
+#include "../parser/defs.h"
+#include "result_sink.h"
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+class arena;
+class database;
+
+/* A prepared statement keeps its parsed tree, its placeholders are the
+ * nodes of the tree, which are overwritten by the values of each
+ * EXECUTE, so the statement runs without being parsed again. The tree
+ * is in `mem`, the strings bound are in the tree of the EXECUTE. */
+struct prepared_stmt_t
+{
+	int type;
+	void *info;
+	arena *mem;
+	std::vector<expr_node_t*> params;
+};
+
+/* The state of a client: its current database, where the rows selected
+ * go and its prepared statements. The console is a session as well, and
+ * each client of the server has one, see dbms::switch_session. */
+struct session_t
+{
+	database *db;
+	FILE *output_file;  // nullptr for stdout
+	result_format_t output_format;
+	std::map<std::string, prepared_stmt_t> prepared_stmts;
+	bool closed;        // EXIT has been run
+
+	session_t() : db(nullptr), output_file(nullptr), output_format(RESULT_CSV), closed(false) {}
+};
+
+#endif
@@ -3,11 +3,33 @@
 
 /* filesystem */
 #define PAGE_SIZE 4096
-#define PAGE_CACHE_CAPACITY 8192
+#define PAGE_CACHE_CAPACITY 8192     // default, see page_fs::resize
+#define PAGE_CACHE_SHARD_NUM 16
+#define PAGE_CACHE_MIN_SHARD_CAPACITY 16
+#define PAGE_CACHE_HUGE_PAGE_SIZE (2 << 20)
+#define PAGE_CACHE_DEFAULT_POLICY "2q"  // or "lru"
+#define PAGE_READ_AHEAD_PAGES 32     // leaves read ahead by a scan, 0 to disable
+#define PAGE_READ_AHEAD_QUEUE 16     // pending read-ahead requests
+#define PAGE_READ_AHEAD_STAGE 256    // pages staged by read-ahead
+#define PAGE_IO_DEFAULT_BACKEND "pread"  // or "direct"
 #define MAX_FILE_ID 1024
+#define PAGE_WRITEBACK_MAX_RUN 64     // pages coalesced into one write
+#define PAGE_FLUSH_INTERVAL_MS 200    // background flusher period
+#define PAGE_FLUSH_DIRTY_HIGH 20      // % of cache, wakes up the flusher
+#define PAGE_FLUSH_DIRTY_LOW  10      // % of cache, the flusher stops here
+#define PAGE_WAL_DEFAULT 1            // write-ahead log, see --wal
+#define PAGE_WAL_BUFFER_SIZE (1 << 20)        // log buffered in memory
+#define PAGE_WAL_CHECKPOINT_SIZE (64 << 20)   // log size to checkpoint at
+#define PAGE_META_OFFSET 64           // metadata stored in the header page
+#define PAGE_META_SIZE   512
+#define PAGE_COMPRESS_DEFAULT 0       // compress new files, see page_fs::set_compression
+#define PAGE_COMPRESS_SECTOR 512      // unit of space of compressed pages
+#define PAGE_COMPRESS_SEARCH 4096     // sectors searched for free space
+#define PAGE_COMPRESS_MAP_MAGIC 0x50414d43
 
 /* database info */
-#define MAX_TABLE_NUM   32
+#define DATABASE_CATALOG_MAGIC   0x54414344
+#define DATABASE_MAX_OPEN_TABLES 256   // the least recently used are closed beyond
 
 /* page info */
 #define PAGE_FREEBLOCK  0x45455246
@@ -19,9 +41,26 @@
 
 /* page type (2 bytes) */
 #define PAGE_FIXED      0x4946
-#define PAGE_INDEX_LEAF 0x4947
+#define PAGE_INDEX_LEAF 0x494c
 #define PAGE_VARIANT    0x4156
 #define PAGE_OVERFLOW   0x564f
+#define PAGE_BLOOM      0x4c42
+#define PAGE_BLOOM_BITS 0x4242
+#define PAGE_HASH_DIR   0x4448
+#define PAGE_HASH_BUCKET 0x4248
+
+/* b-tree */
+#define BTREE_BULK_FILL_FACTOR 90         // % of page filled by bulk loading
+#define BTREE_BULK_SORT_MEMORY (64 << 20) // memory to sort index entries in
+#define INDEX_SCAN_MAX_SELECTIVITY 0.5 // scan the table if more rows match
+#define INDEX_BLOOM_MAX_BITS   32     // bits per key of a bloom filter
+#define INDEX_BLOOM_MIN_KEYS   1024   // keys a new bloom filter is sized for
+#define INDEX_TYPE_BTREE       0
+#define INDEX_TYPE_HASH        1      // equality lookups only, see hash_index
+#define HASH_INDEX_MAX_LOAD    75     // % of the buckets filled before one is split
+
+/* table meta in the header page */
+#define TABLE_META_MAGIC 0x4154454d
 
 /* table info */
 #define MAX_COL_NUM     32
@@ -29,6 +68,33 @@
 #define MAX_DEFAULT_LEN   256
 #define MAX_CHECK_CONSTRAINT_NUM  16
 #define MAX_CHECK_CONSTRAINT_LEN  1024
+#define TABLE_INSERT_BATCH_ROWS   4096  // rows of an INSERT inserted together
+#define FOREIGN_KEY_CACHE_SLOTS   1024  // keys referred to kept per foreign key
+#define TABLE_STATS_MAGIC 0x54415453
+#define STATS_HISTOGRAM_BUCKETS 16     // equi-depth buckets of a column
+#define STATS_HISTOGRAM_SAMPLE  16384  // values sampled for the histogram
+#define STATS_DISTINCT_HASHES   1024   // hashes kept to estimate distinct values
+#define JOIN_DP_MAX_TABLES      10     // larger joins are ordered greedily
+#define SCAN_BATCH_ROWS         1024   // rows read together by batch scans
+#define GROUP_AGG_MAX_GROUPS    (1 << 16)  // groups in memory, others are spilled
+#define GROUP_AGG_PARTITIONS    16     // files the spilled rows are hashed into
+#define GROUP_AGG_MAX_DEPTH     4      // times a partition is spilled again
+#define ORDER_BY_SORT_MEMORY    (64 << 20) // rows sorted in memory by ORDER BY
+#define ORDER_BY_TOP_N_MAX      65536  // larger LIMITs are sorted fully
+#define PARALLEL_SCAN_MORSEL_PAGES 16  // leaves taken by a thread at a time
+#define PARALLEL_SCAN_MAX_THREADS  64  // threads of a parallel scan
+
+/* server */
+#define SERVER_WORKER_THREADS   4      // threads running the requests
+#define SERVER_MAX_CONNECTIONS  1024
+#define SERVER_MAX_REQUEST      (16 << 20) // bytes of the statements of a request
+#define SERVER_BACKLOG          128
+
+/* table engines */
+#define TABLE_ENGINE_ROW      0
+#define TABLE_ENGINE_COLUMNAR 1
+#define COLUMN_STORE_MAGIC    0x4c4f4354
+#define COLUMN_DICT_MAX_SIZE  256    // distinct values of a dictionary segment
 
 #define COL_FLAG_PRIMARY   1
 #define COL_FLAG_INDEX     2
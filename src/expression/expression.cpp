@@ -1,76 +1,102 @@
+#include <algorithm>
 #include <cassert>
-#include <unordered_map>
+#include <cstring>
 #include <sstream>
 #include <string>
 #include <iomanip>
 #include "expression.h"
 #include "../defs.h"
 #include "../utils/comparer.h"
+#include "../utils/type_cast.h"
+#include "../utils/exec_stats.h"
+#include "../table/table_header.h"
 
 #define THROW_UNSUPPORTED_OPERATOR throw "[Error] unsupported operator.";
 #define THROW_COLUMN_NOT_CACHED    throw "[Error] column not cached.";
 #define THROW_COLUMN_NOT_UNIQUE    throw "[Error] column not unique.";
 #define THROW_TYPE_INCOMPATIBLE    throw "[Error] operand type incompatible.";
 
-static std::unordered_multimap<
-	std::string,   // col_name
-	std::pair<std::string, expression>  // table_name, expression
-> __expr_column_cache;
+struct cached_table_t
+{
+	const char *name;
+	const table_header_t *header;
+	record_view_t *view;
+};
+
+static std::vector<cached_table_t> __expr_cached_tables;
 
 void expression::cache_clear()
 {
-	__expr_column_cache.clear();
+	__expr_cached_tables.clear();
 }
 
-void expression::cache_clear(const char *table)
+void expression::cache_table(const char *table, const table_header_t *header, record_view_t *view)
 {
-	for(auto it = __expr_column_cache.begin(); it != __expr_column_cache.end(); )
+	for(const cached_table_t &t : __expr_cached_tables)
 	{
-		if(it->second.first == table)
-			it = __expr_column_cache.erase(it);
-		else ++it;
+		if(t.view == view)
+			return;
 	}
+
+	__expr_cached_tables.push_back({ table, header, view });
 }
 
-void expression::cache_replace(const char *table, const char *col, expression expr)
+/* Find the cached column `ref` refers to, returns its column id. */
+static int find_cached_column(const column_ref_t *ref, const cached_table_t **table)
 {
-	auto range = __expr_column_cache.equal_range(col);
-	for(auto it = range.first; it != range.second; ++it)
+	int num = 0, cid = -1;
+	*table = nullptr;
+	for(const cached_table_t &t : __expr_cached_tables)
 	{
-		if(it->second.first == table)
-			it->second.second = expr;
+		const table_header_t &header = *t.header;
+		for(int i = 0; i < header.col_num; ++i)
+		{
+			if(i == header.main_index && header.is_main_index_additional)
+				continue;
+			if(std::strcmp(header.col_name[i], ref->column) != 0)
+				continue;
+
+			++num;
+			if(!*table && (!ref->table || std::strcmp(t.name, ref->table) == 0))
+			{
+				*table = &t;
+				cid = i;
+			}
+		}
 	}
+
+	if(!num)
+	{
+		THROW_COLUMN_NOT_CACHED;
+	} else if(num > 1 && !ref->table) {
+		THROW_COLUMN_NOT_UNIQUE;
+	} else if(!*table) {
+		THROW_COLUMN_NOT_CACHED;
+	}
+
+	return cid;
 }
 
-void expression::cache_column(const char *table, const char *col, const expression &expr)
+/* the column at [offset, end) of the record, the null mark is always
+ * in the part of `view` at hand */
+static expression read_column(record_view_t *view, int offset, int end, int type, int null_bit)
 {
-	__expr_column_cache.insert(
-		std::make_pair(
-			std::string(col),
-			std::make_pair( std::string(table), expr )
-		)
-	);
+	int null_mark = ((const int*)view->data)[1];
+	if((null_mark >> null_bit) & 1)
+		return typecast::column_to_expr(nullptr, type);
+	if(end > view->size)
+		view->load(view);
+	return typecast::column_to_expr(const_cast<char*>(view->data) + offset, type);
 }
 
 inline expression eval_terminal_column_ref(const expr_node_t *expr)
 {
 	assert(expr->term_type == TERM_COLUMN_REF);
-	std::string col = expr->column_ref->column;
-	auto num = __expr_column_cache.count(col);
-	if(!num)
-	{
-		THROW_COLUMN_NOT_CACHED;
-	} else if(num > 1 && !expr->column_ref->table) {
-		THROW_COLUMN_NOT_UNIQUE;
-	} else {
-		for(auto it = __expr_column_cache.find(col); it != __expr_column_cache.end(); ++it)
-		{
-			if(!expr->column_ref->table || it->second.first == expr->column_ref->table)
-				return it->second.second;
-		}
-	}
-
-	THROW_COLUMN_NOT_CACHED;
+	const cached_table_t *table;
+	int cid = find_cached_column(expr->column_ref, &table);
+	const table_header_t &header = *table->header;
+	return read_column(table->view, header.col_offset[cid],
+		header.col_offset[cid] + header.col_length[cid], header.col_type[cid], cid);
 }
 
 inline int eval_date(const char *str)
@@ -460,22 +486,9 @@ bool eval_in_expression(expression left, linked_list_t *literal_list)
 	return false;
 }
 
-expression expression::eval(const expr_node_t *expr)
+static expression eval_operator(operator_type_t op, const expression &left, const expression &right)
 {
-	assert(expr != nullptr);
-	if(expr->op == OPERATOR_NONE)
-	{
-		// terminator
-		return eval_terminal(expr);
-	}
-
-	assert(expr->term_type == TERM_NONE);
-
-	// non-terminator
-	bool is_unary = (expr->op & OPERATOR_UNARY);
-	expression left  = eval(expr->left);
-	expression right = is_unary ? expression() : eval(expr->right);
-
+	bool is_unary = (op & OPERATOR_UNARY);
 	if(!is_unary && right.type == TERM_NULL)
 	{
 		expression ret;
@@ -483,13 +496,12 @@ expression expression::eval(const expr_node_t *expr)
 		return ret;
 	}
 
-	if(expr->op == OPERATOR_IN)
+	if(op == OPERATOR_IN)
 	{
-		bool ret = eval_in_expression(left, right.literal_list);
-		expression expr;
-		expr.type = TERM_BOOL;
-		expr.val_b = ret;
-		return expr;
+		expression ret;
+		ret.type = TERM_BOOL;
+		ret.val_b = eval_in_expression(left, right.literal_list);
+		return ret;
 	}
 
 	if(!is_unary && left.type != right.type && left.type != TERM_NULL)
@@ -498,23 +510,230 @@ expression expression::eval(const expr_node_t *expr)
 	switch(left.type)
 	{
 		case TERM_INT:
-			return eval_int_operands(expr->op, left.val_i, right.val_i);
+			return eval_int_operands(op, left.val_i, right.val_i);
 		case TERM_FLOAT:
-			return eval_float_operands(expr->op, left.val_f, right.val_f);
+			return eval_float_operands(op, left.val_f, right.val_f);
 		case TERM_DATE:
-			return eval_date_operands(expr->op, left.val_i, right.val_i);
+			return eval_date_operands(op, left.val_i, right.val_i);
 		case TERM_BOOL:
-			return eval_bool_operands(expr->op, left.val_b, right.val_b);
+			return eval_bool_operands(op, left.val_b, right.val_b);
 		case TERM_STRING:
-			return eval_string_operands(expr->op, left.val_s, right.val_s);
+			return eval_string_operands(op, left.val_s, right.val_s);
 		case TERM_NULL:
-			return eval_null_operands(expr->op);
+			return eval_null_operands(op);
 		default:
 			throw "[Error] unknown type.";
 			return expression();
 	}
 }
 
+expression expression::eval(const expr_node_t *expr)
+{
+	assert(expr != nullptr);
+	if(expr->op == OPERATOR_NONE)
+	{
+		// terminator
+		return eval_terminal(expr);
+	}
+
+	assert(expr->term_type == TERM_NONE);
+
+	// non-terminator
+	bool is_unary = (expr->op & OPERATOR_UNARY);
+	expression left  = eval(expr->left);
+	expression right = is_unary ? expression() : eval(expr->right);
+	return eval_operator(expr->op, left, right);
+}
+
+// whether `expr` is evaluated the same for each row
+static bool is_constant(const expr_node_t *expr)
+{
+	if(expr->op == OPERATOR_NONE)
+		return expr->term_type != TERM_COLUMN_REF && expr->term_type != TERM_PARAM;
+	if(expression::is_aggregate(expr))
+		return false;
+	return is_constant(expr->left)
+		&& ((expr->op & OPERATOR_UNARY) || is_constant(expr->right));
+}
+
+static bool literal_less(const expression &x, const expression &y)
+{
+	switch(x.type)
+	{
+		case TERM_INT:
+		case TERM_DATE:
+			return x.val_i < y.val_i;
+		case TERM_FLOAT:
+			return x.val_f < y.val_f;
+		default:
+			return std::strcmp(x.val_s, y.val_s) < 0;
+	}
+}
+
+/* Returns false if the literals are not all of one type of INT, FLOAT,
+ * STRING or DATE, then they are compared one by one. */
+bool compiled_expression::literal_set_t::build(const linked_list_t *literal_list)
+{
+	if(!literal_list) return false;
+	type = ((const expr_node_t*)literal_list->data)->term_type;
+	if(type != TERM_INT && type != TERM_FLOAT && type != TERM_STRING && type != TERM_DATE)
+		return false;
+	for(const linked_list_t *l_ptr = literal_list; l_ptr; l_ptr = l_ptr->next)
+	{
+		const expr_node_t *val = (const expr_node_t*)l_ptr->data;
+		if(val->op != OPERATOR_NONE || val->term_type != type)
+			return false;
+		expression lit = eval_terminal(val);
+		// an invalid date equals no date, but is still compared as a string
+		if(lit.type == type)
+			values.push_back(lit);
+		if(type == TERM_DATE)
+			texts.push_back(val->val_s);
+	}
+
+	std::sort(values.begin(), values.end(), literal_less);
+	std::sort(texts.begin(), texts.end(), [](const char *x, const char *y) {
+		return std::strcmp(x, y) < 0;
+	} );
+	return true;
+}
+
+// as eval_in_expression() for the literals of the set
+bool compiled_expression::literal_set_t::contains(const expression &val) const
+{
+	if(val.type == TERM_NULL)
+		return false;
+	if(val.type == TERM_STRING && type == TERM_DATE)
+	{
+		return std::binary_search(texts.begin(), texts.end(), val.val_s,
+			[](const char *x, const char *y) { return std::strcmp(x, y) < 0; } );
+	}
+
+	if(val.type != type)
+		THROW_TYPE_INCOMPATIBLE;
+	return std::binary_search(values.begin(), values.end(), val, literal_less);
+}
+
+void compiled_expression::compile(const expr_node_t *node)
+{
+	instr_t ins;
+	std::memset(&ins, 0, sizeof(ins));
+	ins.op = node->op;
+	const expr_node_t *pattern = node->right;
+	if(node->op != OPERATOR_NONE && is_constant(node))
+	{
+		// evaluated once for the query rather than for each row
+		try {
+			ins.kind  = PUSH_VALUE;
+			ins.value = expression::eval(node);
+		} catch(const char *msg) {
+			ins.kind  = THROW;
+			ins.error = msg;
+		}
+	} else if(node->op == OPERATOR_IN && pattern->op == OPERATOR_NONE
+		&& pattern->term_type == TERM_LITERAL_LIST) {
+		literal_set_t set;
+		if(set.build(pattern->literal_list))
+		{
+			compile(node->left);
+			ins.kind = IN;
+			ins.set  = sets.size();
+			sets.push_back(std::move(set));
+		} else {
+			compile(node->left);
+			compile(node->right);
+			ins.kind = OPERATOR;
+		}
+	} else if(node->op == OPERATOR_LIKE && pattern->op == OPERATOR_NONE
+		&& pattern->term_type == TERM_STRING) {
+		// the pattern is compiled once rather than for each row
+		compile(node->left);
+		ins.kind    = LIKE;
+		ins.value   = eval_terminal(pattern);
+		ins.matcher = matchers.size();
+		matchers.emplace_back(pattern->val_s);
+	} else if(node->op != OPERATOR_NONE) {
+		// operands are evaluated from left to right, as eval() does
+		compile(node->left);
+		if(!(node->op & OPERATOR_UNARY))
+			compile(node->right);
+		ins.kind = OPERATOR;
+	} else if(node->term_type == TERM_COLUMN_REF) {
+		try {
+			const cached_table_t *table;
+			int cid = find_cached_column(node->column_ref, &table);
+			ins.kind     = PUSH_COLUMN;
+			ins.view     = table->view;
+			ins.offset   = table->header->col_offset[cid];
+			ins.end      = ins.offset + table->header->col_length[cid];
+			ins.type     = table->header->col_type[cid];
+			ins.null_bit = cid;
+		} catch(const char *msg) {
+			// report it when the column is evaluated
+			ins.kind  = THROW;
+			ins.error = msg;
+		}
+	} else {
+		ins.kind  = PUSH_VALUE;
+		ins.value = eval_terminal(node);
+	}
+
+	code.push_back(ins);
+}
+
+expression compiled_expression::eval()
+{
+	assert(expr != nullptr);
+	if(!compiled)
+	{
+		compile(expr);
+		compiled = true;
+	}
+
+	++thread_stats().expr_evals;
+	stack.clear();
+	for(const instr_t &ins : code)
+	{
+		switch(ins.kind)
+		{
+			case PUSH_VALUE:
+				stack.push_back(ins.value);
+				break;
+			case PUSH_COLUMN:
+				stack.push_back(read_column(ins.view, ins.offset, ins.end, ins.type, ins.null_bit));
+				break;
+			case THROW:
+				throw ins.error;
+			case LIKE:
+				if(stack.back().type == TERM_STRING)
+				{
+					bool ret = matchers[ins.matcher].match(stack.back().val_s);
+					stack.back().type  = TERM_BOOL;
+					stack.back().val_b = ret;
+				} else {
+					stack.back() = eval_operator(ins.op, stack.back(), ins.value);
+				}
+				break;
+			case IN:
+				stack.back().val_b = sets[ins.set].contains(stack.back());
+				stack.back().type  = TERM_BOOL;
+				break;
+			case OPERATOR:
+				if(ins.op & OPERATOR_UNARY)
+				{
+					stack.back() = eval_operator(ins.op, stack.back(), expression());
+				} else {
+					expression right = stack.back();
+					stack.pop_back();
+					stack.back() = eval_operator(ins.op, stack.back(), right);
+				}
+				break;
+		}
+	}
+
+	return stack.back();
+}
+
 bool expression::is_aggregate(const expr_node_t* expr)
 {
 	return expr->op == OPERATOR_COUNT
@@ -524,6 +743,58 @@ bool expression::is_aggregate(const expr_node_t* expr)
 		|| expr->op == OPERATOR_MAX;
 }
 
+void expression::encode(std::string &buf, const expression &val)
+{
+	buf.push_back((char)val.type);
+	switch(val.type)
+	{
+		case TERM_NULL:
+			break;
+		case TERM_STRING:
+			buf.append(val.val_s, std::strlen(val.val_s) + 1);
+			break;
+		case TERM_BOOL:
+			buf.push_back(val.val_b);
+			break;
+		case TERM_FLOAT: {
+			// -0.0 is encoded as 0.0, they are equal
+			float f = val.val_f == 0 ? 0.0f : val.val_f;
+			buf.append((const char*)&f, sizeof(float));
+			break; }
+		default:
+			buf.append((const char*)&val.val_i, sizeof(int));
+			break;
+	}
+}
+
+void expression::decode(const char *p, const char *end, std::vector<expression> &vals)
+{
+	vals.clear();
+	while(p != end)
+	{
+		expression val;
+		val.type = (term_type_t)*p++;
+		switch(val.type)
+		{
+			case TERM_NULL:
+				break;
+			case TERM_STRING:
+				val.val_s = const_cast<char*>(p);
+				p += std::strlen(p) + 1;
+				break;
+			case TERM_BOOL:
+				val.val_b = *p++;
+				break;
+			default:
+				std::memcpy(&val.val_i, p, sizeof(int));
+				p += sizeof(int);
+				break;
+		}
+
+		vals.push_back(val);
+	}
+}
+
 std::string expression::to_string(const expr_node_t *expr)
 {
 	if(!expr) return "*";
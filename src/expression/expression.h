@@ -2,9 +2,25 @@
 #define __TRIVIALDB_EXPRESSION__
 
 #include "../parser/defs.h"
+#include "../utils/like_matcher.h"
+#include "../utils/arena.h"
 #include <string>
+#include <vector>
 #include <iostream>
 
+struct table_header_t;
+
+/* A record of a cached table, read where it is. Only the first `size`
+ * bytes of it are at `data`, before a column past them is read,
+ * `load(view)` points `data` at a copy of the whole record. */
+struct record_view_t
+{
+	const char *data;
+	int size;
+	void (*load)(record_view_t *view);
+	void *owner;
+};
+
 struct expression
 {
 	union {
@@ -20,14 +36,69 @@ struct expression
 	static expression eval(const expr_node_t *expr);
 	static std::string to_string(const expr_node_t *expr);
 	static bool is_aggregate(const expr_node_t *expr);
+	/* Encode a value as a type byte followed by the value, so that it
+	 * is kept apart from the record it is read from. The strings decoded
+	 * point into the encoded bytes. */
+	static void encode(std::string &buf, const expression &val);
+	static void decode(const char *data, const char *end, std::vector<expression> &vals);
 	static void cache_clear();
-	static void cache_clear(const char *table);
-	static void cache_replace(const char *table, const char* col, expression expr);
-	static void cache_column(const char *table, const char *col, const expression &expr);
+	/* make the columns of the record of `view` visible to column
+	 * references, it is read when an expression is evaluated */
+	static void cache_table(const char *table, const table_header_t *header, record_view_t *view);
 
 	static void dump_exprnode(std::ostream &os, const expr_node_t *expr);
 	static expr_node_t* load_exprnode(std::istream &is);
 	static void free_exprnode(expr_node_t *expr);
 };
 
+/* An expression compiled into a postfix program when it is first
+ * evaluated. The column references are bound to the cached tables at
+ * that time, and the columns are then read from the records directly.
+ * The subtrees without columns are evaluated once while compiling, and
+ * the literals of IN are sorted to be searched. The program and its
+ * stack are in `mem` if given, which must outlive it, e.g. the memory
+ * of the query, see dbms::get_query_arena(). */
+class compiled_expression
+{
+	enum { PUSH_VALUE, PUSH_COLUMN, THROW, OPERATOR, LIKE, IN };
+
+	struct instr_t
+	{
+		int kind;
+		operator_type_t op;
+		expression value;
+		record_view_t *view;
+		int offset, end, type, null_bit;
+		int matcher;       // the pattern of LIKE in `matchers`
+		int set;           // the literals of IN in `sets`
+		const char *error;
+	};
+
+	/* The literals of an IN list of one type, sorted. The dates are
+	 * parsed, and their strings kept to be compared with strings. */
+	struct literal_set_t
+	{
+		term_type_t type;
+		std::vector<expression> values;
+		std::vector<const char*> texts;
+
+		bool build(const linked_list_t *literal_list);
+		bool contains(const expression &val) const;
+	};
+
+	const expr_node_t *expr;
+	bool compiled;
+	std::vector<instr_t, arena_allocator<instr_t>> code;
+	std::vector<expression, arena_allocator<expression>> stack;
+	std::vector<like_matcher> matchers;
+	std::vector<literal_set_t> sets;
+
+	void compile(const expr_node_t *node);
+
+public:
+	compiled_expression(const expr_node_t *expr = nullptr, arena *mem = nullptr)
+		: expr(expr), compiled(false), code(mem), stack(mem) {}
+	expression eval();
+};
+
 #endif
@@ -19,6 +19,7 @@ void expression::dump_exprnode(std::ostream &os, const expr_node_t *expr)
 				os << expr->val_f << " ";
 				break;
 			case TERM_STRING:
+			case TERM_DATE:
 				os << expr->val_s << " ";
 				break;
 			case TERM_BOOL:
@@ -83,6 +84,7 @@ expr_node_t* expression::load_exprnode(std::istream &is)
 				is >> expr->val_f;
 				break;
 			case TERM_STRING:
+			case TERM_DATE:
 				expr->val_s = load_string(is);
 				break;
 			case TERM_BOOL:
@@ -125,3 +127,41 @@ expr_node_t* expression::load_exprnode(std::istream &is)
 
 	return expr;
 }
+
+/* the trees of the parser are freed with the statement, only those
+ * loaded are freed here */
+void expression::free_exprnode(expr_node_t *expr)
+{
+	if(!expr) return;
+	if(expr->op == OPERATOR_NONE)
+	{
+		switch(expr->term_type)
+		{
+			case TERM_STRING:
+			case TERM_DATE:
+				free(expr->val_s);
+				break;
+			case TERM_COLUMN_REF:
+				free(expr->column_ref->table);
+				free(expr->column_ref->column);
+				free(expr->column_ref);
+				break;
+			case TERM_LITERAL_LIST:
+				for(linked_list_t *l_ptr = expr->literal_list; l_ptr; )
+				{
+					free_exprnode((expr_node_t*)l_ptr->data);
+					linked_list_t *tmp = l_ptr;
+					l_ptr = l_ptr->next;
+					free(tmp);
+				}
+				break;
+			default:
+				break;
+		}
+	} else {
+		free_exprnode(expr->left);
+		free_exprnode(expr->right);
+	}
+
+	free(expr);
+}
@@ -1,75 +1,104 @@
 #ifndef __TRIVIALDB_CACHE_MANAGER__
 #define __TRIVIALDB_CACHE_MANAGER__
 #include <assert.h>
+#include <stdint.h>
 #include <cstring>
+#include <vector>
+#include <iterator>
 
 #include "../defs.h"
 
+/* Replacement policy of one cache shard. Frames are numbered from 0
+ * to capacity - 1, and a frame is either free or holds one page. */
 class cache_manager
 {
-private:
-	int head;
+public:
+	virtual ~cache_manager() {}
+
+	/* a page cached in frame `id` is used again */
+	virtual void access(int id) = 0;
+	/* a page is loaded into frame `id`, `key` identifies the page
+	 * and `sequential` is set if it is read by a sequential scan */
+	virtual void admit(int id, uint64_t key, bool sequential) = 0;
+	/* frame `id` does not hold any page now */
+	virtual void remove(int id) = 0;
+	/* the frame to be replaced, frames with non-zero pin count
+	 * are skipped and -1 is returned if all of them are pinned */
+	virtual int victim(const int *pin_count) = 0;
+	virtual int size() const = 0;
+	virtual const char *name() const = 0;
+};
+
+/* Doubly linked lists sharing one node array, node `capacity + k`
+ * is the sentinel of the k-th list. */
+class frame_lists
+{
 	struct node_t
 	{
 		int prev, next;
 	} *nodes;
+	int capacity;
 public:
-	cache_manager()
+	frame_lists(int capacity, int list_num) : capacity(capacity)
 	{
-		head = 0;
-		nodes = new node_t[PAGE_CACHE_CAPACITY];
-		for(int i = 0; i != PAGE_CACHE_CAPACITY; ++i)
-		{
-			nodes[i].next = (i + 1 == PAGE_CACHE_CAPACITY) ? 0 : i + 1;
-			nodes[i].prev = i ? i - 1 : PAGE_CACHE_CAPACITY - 1;
-		}
+		nodes = new node_t[capacity + list_num];
+		for(int i = 0; i != capacity; ++i)
+			nodes[i].prev = nodes[i].next = -1;
+		for(int i = capacity; i != capacity + list_num; ++i)
+			nodes[i].prev = nodes[i].next = i;
 	}
 
-	~cache_manager()
-	{
-		delete[] nodes;
-	}
+	~frame_lists() { delete[] nodes; }
 
-public:
-	void access(int id)
-	{
-		assert(0 <= id && id < PAGE_CACHE_CAPACITY);
+	frame_lists(const frame_lists&) = delete;
+	frame_lists& operator = (const frame_lists&) = delete;
 
-		if(id == head) return;
+	int sentinel(int list) const { return capacity + list; }
+	bool linked(int id) const { return nodes[id].next != -1; }
+	int front(int list) const { return nodes[sentinel(list)].next; }
+	int back(int list) const { return nodes[sentinel(list)].prev; }
+	int prev(int id) const { return nodes[id].prev; }
 
-		// remove
+	void unlink(int id)
+	{
+		assert(0 <= id && id < capacity && linked(id));
 		nodes[nodes[id].prev].next = nodes[id].next;
 		nodes[nodes[id].next].prev = nodes[id].prev;
-
-		// insert
-		nodes[nodes[head].prev].next = id;
-		nodes[id].next   = head;
-		nodes[id].prev   = nodes[head].prev;
-		nodes[head].prev = id;
-
-		head = id;
-
-		assert(_check_valid());
+		nodes[id].prev = nodes[id].next = -1;
 	}
 
-	int last() const 
+	void push_front(int list, int id)
 	{
-		return nodes[head].prev;
+		assert(0 <= id && id < capacity && !linked(id));
+		int s = sentinel(list);
+		nodes[id].prev = s;
+		nodes[id].next = nodes[s].next;
+		nodes[nodes[s].next].prev = id;
+		nodes[s].next = id;
 	}
 
-private:
-	int _check_valid() const
+	/* the last frame of `list` (walking backward from the tail)
+	 * which is not pinned, -1 if not found */
+	int last_unpinned(int list, const int *pin_count) const
 	{
-		char *mark = new char[PAGE_CACHE_CAPACITY];
-		std::memset(mark, 0, PAGE_CACHE_CAPACITY);
-		for(int i = 0, k = head; i != PAGE_CACHE_CAPACITY; ++i, k = nodes[k].next)
-			mark[k] = 1;
-		int ret = 1;
-		for(int i = 0; i != PAGE_CACHE_CAPACITY; ++i)
-			ret &= mark[i];
-		delete[] mark;
-		return ret;
+		for(int id = back(list); id != sentinel(list); id = prev(id))
+			if(!pin_count[id]) return id;
+		return -1;
 	}
 };
 
+/* Take frame `id` out of the free frame stack, the victim is
+ * usually the top one so the stack is searched from the top. */
+inline void take_free_frame(std::vector<int> &free_frames, int id)
+{
+	for(auto it = free_frames.rbegin(); it != free_frames.rend(); ++it)
+	{
+		if(*it == id)
+		{
+			free_frames.erase(std::next(it).base());
+			return;
+		}
+	}
+}
+
 #endif
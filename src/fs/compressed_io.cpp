@@ -0,0 +1,329 @@
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "compressed_io.h"
+#include "../defs.h"
+#include "../utils/lz_codec.h"
+
+/* The map file is a header followed by the extent of each page. */
+struct compressed_map_header_t
+{
+	uint32_t magic;
+	uint32_t page_num;
+	uint32_t sector_num;
+	uint32_t reserved;
+	uint64_t inode;
+};
+
+std::string compressed_io_backend::map_filename(const char *filename)
+{
+	return std::string(filename) + ".cmap";
+}
+
+bool compressed_io_backend::is_compressed(const char *filename)
+{
+	std::string name = map_filename(filename);
+	return access(name.c_str(), F_OK) == 0
+		|| access((name + ".new").c_str(), F_OK) == 0;
+}
+
+int compressed_io_backend::sectors_of(uint32_t bytes)
+{
+	return (bytes + PAGE_COMPRESS_SECTOR - 1) / PAGE_COMPRESS_SECTOR;
+}
+
+/* The map of a replacing file is only valid with the file, see `replace`. */
+static uint64_t pending_map_inode(const std::string &name)
+{
+	compressed_map_header_t header;
+	std::FILE *f = std::fopen(name.c_str(), "rb");
+	if(!f) return 0;
+	bool ok = std::fread(&header, sizeof(header), 1, f) == 1
+		&& header.magic == PAGE_COMPRESS_MAP_MAGIC;
+	std::fclose(f);
+	return ok ? header.inode : 0;
+}
+
+bool compressed_io_backend::replace(const char *from, const char *to)
+{
+	std::string pending = map_filename(to) + ".new";
+	return std::rename(map_filename(from).c_str(), pending.c_str()) == 0
+		&& std::rename(from, to) == 0
+		&& std::rename(pending.c_str(), map_filename(to).c_str()) == 0;
+}
+
+int compressed_io_backend::open(const char *filename)
+{
+	map_name = map_filename(filename);
+	fd = read_only ? ::open(filename, O_RDONLY) : io_backend::open(filename);
+	if(fd < 0) return -1;
+
+	struct stat st;
+	inode = fstat(fd, &st) == 0 ? st.st_ino : 0;
+	std::string pending = map_name + ".new";
+	if(access(pending.c_str(), F_OK) == 0)
+	{
+		bool valid = inode && pending_map_inode(pending) == inode;
+		if(read_only) {
+			if(valid) map_name = pending;
+		} else if(valid) {
+			std::rename(pending.c_str(), map_name.c_str());
+		} else {
+			std::remove(pending.c_str());
+		}
+	}
+
+	bool exists = access(map_name.c_str(), F_OK) == 0;
+	if(exists ? !load_map() : read_only || !save_map(pages))
+	{
+		std::fprintf(stderr, "[Error] Fail to %s the page map `%s`.\n",
+			exists ? "load" : "create", map_name.c_str());
+		io_backend::close(fd);
+		return fd = -1;
+	}
+
+	return fd;
+}
+
+void compressed_io_backend::close(int fd)
+{
+	assert(fd == this->fd);
+	if(!read_only && !sync(fd))
+		std::fprintf(stderr, "[Error] Fail to save the page map `%s`.\n", map_name.c_str());
+	io_backend::close(fd);
+	this->fd = -1;
+}
+
+bool compressed_io_backend::load_map()
+{
+	std::FILE *f = std::fopen(map_name.c_str(), "rb");
+	if(!f) return false;
+
+	compressed_map_header_t header;
+	bool ok = std::fread(&header, sizeof(header), 1, f) == 1
+		&& header.magic == PAGE_COMPRESS_MAP_MAGIC;
+	if(ok)
+	{
+		pages.resize(header.page_num);
+		ok = header.page_num == 0 || std::fread(pages.data(),
+			sizeof(extent_t), header.page_num, f) == header.page_num;
+	}
+
+	std::fclose(f);
+	if(!ok) return false;
+
+	used.assign(header.sector_num, 0);
+	for(const extent_t &e : pages)
+	{
+		if(!e.bytes) continue;
+		uint32_t end = e.sector + sectors_of(e.bytes);
+		if(end > used.size())
+			used.resize(end, 0);
+		std::fill(used.begin() + e.sector, used.begin() + end, 1);
+	}
+
+	return true;
+}
+
+/* The map is written to a new file renamed over the old one, so that
+ * either of them is complete after a crash. */
+bool compressed_io_backend::save_map(const std::vector<extent_t> &map)
+{
+	std::string tmp_name = map_name + ".tmp";
+	std::FILE *f = std::fopen(tmp_name.c_str(), "wb");
+	if(!f) return false;
+
+	compressed_map_header_t header;
+	header.magic = PAGE_COMPRESS_MAP_MAGIC;
+	header.page_num = map.size();
+	header.sector_num = 0;
+	header.reserved = 0;
+	header.inode = inode;
+	for(const extent_t &e : map)
+		header.sector_num = std::max<uint32_t>(header.sector_num, e.sector + sectors_of(e.bytes));
+
+	bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1
+		&& (map.empty() || std::fwrite(map.data(), sizeof(extent_t), map.size(), f) == map.size())
+		&& std::fflush(f) == 0 && fsync(fileno(f)) == 0;
+	ok = std::fclose(f) == 0 && ok;
+	return ok && std::rename(tmp_name.c_str(), map_name.c_str()) == 0;
+}
+
+/* Take the first run of `num` free sectors within PAGE_COMPRESS_SEARCH
+ * sectors from `cursor`, or extend the file. `lock` must be held. */
+uint32_t compressed_io_backend::allocate_sectors(int num)
+{
+	uint32_t n = used.size(), s = cursor < n ? cursor : 0;
+	int run = 0;
+	for(int i = 0; i < PAGE_COMPRESS_SEARCH && n; ++i, ++s)
+	{
+		if(s == n)
+		{
+			s = 0;
+			run = 0;
+		}
+
+		if(used[s])
+		{
+			run = 0;
+		} else if(++run == num) {
+			uint32_t base = s + 1 - num;
+			std::fill(used.begin() + base, used.begin() + s + 1, 1);
+			cursor = s + 1;
+			return base;
+		}
+	}
+
+	used.resize(n + num, 1);
+	cursor = n + num;
+	return n;
+}
+
+void compressed_io_backend::free_sectors(const extent_t &e)
+{
+	int num = sectors_of(e.bytes);
+	std::fill(used.begin() + e.sector, used.begin() + e.sector + num, 0);
+	cursor = std::min(cursor, e.sector);
+}
+
+bool compressed_io_backend::read(int fd, char *data, size_t size, off_t offset)
+{
+	assert(fd == this->fd && size % PAGE_SIZE == 0 && offset % PAGE_SIZE == 0);
+	uint32_t first = offset / PAGE_SIZE;
+	char buf[PAGE_SIZE];
+	for(size_t i = 0; i != size / PAGE_SIZE; ++i, data += PAGE_SIZE)
+	{
+		extent_t e;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if(first + i >= pages.size() || !pages[first + i].bytes)
+				return false;
+			e = pages[first + i];
+			++readers;
+		}
+
+		off_t pos = (off_t)e.sector * PAGE_COMPRESS_SECTOR;
+		bool ok;
+		if(e.bytes == PAGE_SIZE)
+		{
+			ok = io_backend::read(fd, data, PAGE_SIZE, pos);
+		} else {
+			ok = io_backend::read(fd, buf, e.bytes, pos)
+				&& lz_codec::decompress(buf, e.bytes, data, PAGE_SIZE) == PAGE_SIZE;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			--readers;
+		}
+
+		if(!ok)
+		{
+			std::fprintf(stderr, "[Error] Fail to read compressed page %u.\n", first + (uint32_t)i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* The pages are compressed into one buffer and written with one pwrite,
+ * then the map refers to them. */
+bool compressed_io_backend::write(int fd, const char *data, size_t size, off_t offset)
+{
+	assert(fd == this->fd && size % PAGE_SIZE == 0 && offset % PAGE_SIZE == 0);
+	if(read_only) return false;
+	uint32_t first = offset / PAGE_SIZE;
+	int num = size / PAGE_SIZE;
+	std::vector<char> buf(size);
+	std::vector<extent_t> extents(num);
+	int total = 0;
+	for(int i = 0; i != num; ++i)
+	{
+		const char *page = data + (size_t)i * PAGE_SIZE;
+		char *out = buf.data() + (size_t)total * PAGE_COMPRESS_SECTOR;
+		// kept compressed only if it saves a sector
+		int bytes = lz_codec::compress(page, PAGE_SIZE, out, PAGE_SIZE - PAGE_COMPRESS_SECTOR);
+		if(bytes == 0)
+		{
+			std::memcpy(out, page, PAGE_SIZE);
+			bytes = PAGE_SIZE;
+		}
+
+		extents[i] = { (uint32_t)total, (uint32_t)bytes };
+		total += sectors_of(bytes);
+	}
+
+	uint32_t base;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		base = allocate_sectors(total);
+	}
+
+	bool ok = io_backend::write(fd, buf.data(),
+		(size_t)total * PAGE_COMPRESS_SECTOR, (off_t)base * PAGE_COMPRESS_SECTOR);
+
+	std::lock_guard<std::mutex> guard(lock);
+	if(!ok)
+	{
+		free_sectors({ base, (uint32_t)total * PAGE_COMPRESS_SECTOR });
+		return false;
+	}
+
+	if(pages.size() < first + num)
+		pages.resize(first + num, { 0, 0 });
+	for(int i = 0; i != num; ++i)
+	{
+		extent_t &e = pages[first + i];
+		if(e.bytes) freed.push_back(e);
+		e = extents[i];
+		e.sector += base;
+	}
+
+	return true;
+}
+
+void compressed_io_backend::read_batch(io_request_t *reqs, int num)
+{
+	for(int i = 0; i != num; ++i)
+		reqs[i].ok = read(reqs[i].fd, reqs[i].data, reqs[i].size, reqs[i].offset);
+}
+
+/* The map is taken before the pages are synced, so that it refers only
+ * to the pages written before. The runs freed before that are no longer
+ * referred to by the map file once it is saved, unless being read. */
+bool compressed_io_backend::sync(int fd)
+{
+	if(read_only) return true;
+	std::vector<extent_t> map;
+	size_t freed_num;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		map = pages;
+		freed_num = freed.size();
+	}
+
+	if(!io_backend::sync(fd) || !save_map(map))
+		return false;
+
+	std::lock_guard<std::mutex> guard(lock);
+	if(readers == 0)
+	{
+		for(size_t i = 0; i != freed_num; ++i)
+			free_sectors(freed[i]);
+		freed.erase(freed.begin(), freed.begin() + freed_num);
+
+		// the free sectors at the end are cut off the file
+		size_t n = used.size();
+		while(n && !used[n - 1]) --n;
+		if(n != used.size() && ftruncate(fd, (off_t)n * PAGE_COMPRESS_SECTOR) == 0)
+			used.resize(n);
+	}
+
+	return true;
+}
@@ -0,0 +1,71 @@
+#ifndef __TRIVIALDB_COMPRESSED_IO__
+#define __TRIVIALDB_COMPRESSED_IO__
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "io_backend.h"
+
+/* The backend of one compressed file. Each page is compressed and
+ * stored in a run of PAGE_COMPRESS_SECTOR byte sectors of the file
+ * (a page which does not compress is stored as it is), and the map
+ * from the pages to their runs is kept in `<filename>.cmap`. The pages
+ * read and written are still of PAGE_SIZE bytes at their own offsets.
+ *
+ * A written page goes to free sectors rather than its old ones, which
+ * are freed only after the next `sync`, when the map is saved by
+ * replacing the map file. So the map file always refers to the pages
+ * synced, like a file of plain pages which is not synced. While pages
+ * are being read, the sectors stay until a later `sync`.
+ *
+ * The file is read and written with pread and pwrite, O_DIRECT is not
+ * used since the runs are not aligned to PAGE_SIZE. A read-only backend
+ * neither writes the file nor its map. */
+class compressed_io_backend : public io_backend
+{
+	struct extent_t
+	{
+		uint32_t sector;
+		uint32_t bytes;  // 0 if not written, PAGE_SIZE if not compressed
+	};
+
+	std::mutex lock;
+	std::string map_name;
+	int fd;
+	uint64_t inode;            // of the file, the map file refers to it
+	std::vector<extent_t> pages;
+	std::vector<char> used;    // the sectors taken
+	// runs to be freed after the next sync, the pages no longer refer to them
+	std::vector<extent_t> freed;
+	uint32_t cursor;           // where to search for free sectors
+	int readers;
+	bool read_only;
+
+	static int sectors_of(uint32_t bytes);
+	uint32_t allocate_sectors(int num);
+	void free_sectors(const extent_t &e);
+	bool load_map();
+	bool save_map(const std::vector<extent_t> &map);
+
+public:
+	explicit compressed_io_backend(bool read_only = false)
+		: fd(-1), inode(0), cursor(0), readers(0), read_only(read_only) {}
+
+	int open(const char *filename) override;
+	void close(int fd) override;
+	bool read(int fd, char *data, size_t size, off_t offset) override;
+	bool write(int fd, const char *data, size_t size, off_t offset) override;
+	void read_batch(io_request_t *reqs, int num) override;
+	bool sync(int fd) override;
+	const char *name() const override { return "compressed"; }
+
+	static std::string map_filename(const char *filename);
+	static bool is_compressed(const char *filename);
+	/* Rename the compressed file `from` and its map to `to`. The map
+	 * is renamed to `<to>.cmap.new` first, and taken by `open` if it
+	 * refers to the file, so that a crash leaves either file whole. */
+	static bool replace(const char *from, const char *to);
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <mutex>
+#include <algorithm>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "io_backend.h"
+#include "../defs.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define TRIVIALDB_IO_URING
+#endif
+#endif
+
+/* io_backend code */
+int io_backend::open(const char *filename)
+{
+	return ::open(filename, O_RDWR | O_CREAT, 0644);
+}
+
+void io_backend::close(int fd)
+{
+	::close(fd);
+}
+
+bool io_backend::read(int fd, char *data, size_t size, off_t offset)
+{
+	while(size)
+	{
+		ssize_t ret = pread(fd, data, size, offset);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return false;
+		data += ret;
+		offset += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+bool io_backend::write(int fd, const char *data, size_t size, off_t offset)
+{
+	while(size)
+	{
+		ssize_t ret = pwrite(fd, data, size, offset);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return false;
+		data += ret;
+		offset += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+void io_backend::read_batch(io_request_t *reqs, int num)
+{
+	for(int i = 0; i != num; ++i)
+		reqs[i].ok = read(reqs[i].fd, reqs[i].data, reqs[i].size, reqs[i].offset);
+}
+
+bool io_backend::sync(int fd)
+{
+	return fdatasync(fd) == 0;
+}
+
+/* mmap_io_backend code */
+int mmap_io_backend::open(const char *filename)
+{
+	int fd = ::open(filename, O_RDONLY);
+	if(fd < 0) return -1;
+	off_t end = lseek(fd, 0, SEEK_END);
+	if(end > 0)
+	{
+		void *addr = mmap(nullptr, end, PROT_READ, MAP_SHARED, fd, 0);
+		if(addr == MAP_FAILED)
+		{
+			::close(fd);
+			return -1;
+		}
+
+		data = (char*)addr;
+		size = end;
+		madvise(data, size, MADV_RANDOM);
+	}
+
+	return fd;
+}
+
+void mmap_io_backend::close(int fd)
+{
+	if(data) munmap(data, size);
+	data = nullptr;
+	size = 0;
+	::close(fd);
+}
+
+bool mmap_io_backend::read(int, char *dst, size_t len, off_t offset)
+{
+	if(offset < 0 || (size_t)offset + len > size)
+		return false;
+	std::memcpy(dst, data + offset, len);
+	return true;
+}
+
+void mmap_io_backend::advise(off_t offset, size_t len, int advice)
+{
+	// madvise takes addresses aligned to the system page
+	static const size_t sys_page = sysconf(_SC_PAGESIZE);
+	if(offset < 0 || (size_t)offset >= size)
+		return;
+	len = std::min(len, size - offset);
+	size_t begin = offset / sys_page * sys_page;
+	madvise(data + begin, offset + len - begin, advice);
+}
+
+bool io_backend::is_valid(const char *name)
+{
+	return strcasecmp(name, "pread") == 0 || strcasecmp(name, "direct") == 0;
+}
+
+io_backend* io_backend::create(const char *name)
+{
+	if(strcasecmp(name, "direct") == 0)
+		return new direct_io_backend;
+	return new io_backend;
+}
+
+/* A minimal io_uring driven by raw system calls, reads in one batch are
+ * submitted together and reaped before `read_batch` returns. */
+struct direct_io_backend::uring_t
+{
+#ifdef TRIVIALDB_IO_URING
+	enum { ENTRIES = 64 };
+
+	std::mutex lock;
+	bool broken;
+	int ring_fd;
+	unsigned *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	io_uring_sqe *sqes;
+	io_uring_cqe *cqes;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_size, cq_size, sqes_size;
+
+	uring_t() : broken(false), ring_fd(-1), sqes(nullptr),
+		sq_ptr(MAP_FAILED), cq_ptr(MAP_FAILED) {}
+
+	bool init()
+	{
+		io_uring_params p;
+		std::memset(&p, 0, sizeof(p));
+		ring_fd = (int)syscall(__NR_io_uring_setup, ENTRIES, &p);
+		if(ring_fd < 0)
+			return false;
+
+		sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		if(p.features & IORING_FEAT_SINGLE_MMAP)
+			sq_size = cq_size = std::max(sq_size, cq_size);
+		sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		if(sq_ptr == MAP_FAILED)
+			return false;
+		if(p.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			cq_ptr = sq_ptr;
+		} else {
+			cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+			if(cq_ptr == MAP_FAILED)
+				return false;
+		}
+
+		sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+		void *addr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+		if(addr == MAP_FAILED)
+			return false;
+		sqes = (io_uring_sqe*)addr;
+
+		char *sq = (char*)sq_ptr, *cq = (char*)cq_ptr;
+		sq_tail  = (unsigned*)(sq + p.sq_off.tail);
+		sq_mask  = (unsigned*)(sq + p.sq_off.ring_mask);
+		sq_array = (unsigned*)(sq + p.sq_off.array);
+		cq_head  = (unsigned*)(cq + p.cq_off.head);
+		cq_tail  = (unsigned*)(cq + p.cq_off.tail);
+		cq_mask  = (unsigned*)(cq + p.cq_off.ring_mask);
+		cqes     = (io_uring_cqe*)(cq + p.cq_off.cqes);
+		return true;
+	}
+
+	~uring_t()
+	{
+		if(sqes) munmap(sqes, sqes_size);
+		if(cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+		if(sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+		if(ring_fd >= 0) ::close(ring_fd);
+	}
+
+	/* Returns false if the ring fails (it is not used any more then),
+	 * the requests which are not completed yet have `ok` unset. */
+	bool read_batch(io_request_t *reqs, int num)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if(broken) return false;
+		for(int base = 0; base < num; base += ENTRIES)
+		{
+			int n = std::min(num - base, (int)ENTRIES);
+			unsigned tail = *sq_tail;
+			for(int i = 0; i != n; ++i)
+			{
+				io_request_t &req = reqs[base + i];
+				unsigned index = (tail + i) & *sq_mask;
+				io_uring_sqe *sqe = sqes + index;
+				std::memset(sqe, 0, sizeof(*sqe));
+				sqe->opcode = IORING_OP_READ;
+				sqe->fd = req.fd;
+				sqe->addr = (unsigned long)req.data;
+				sqe->len = (unsigned)req.size;
+				sqe->off = req.offset;
+				sqe->user_data = base + i;
+				sq_array[index] = index;
+				req.ok = false;
+			}
+
+			__atomic_store_n(sq_tail, tail + n, __ATOMIC_RELEASE);
+
+			int submitted = 0, completed = 0;
+			while(completed < n)
+			{
+				int ret = (int)syscall(__NR_io_uring_enter, ring_fd,
+					n - submitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+				if(ret < 0)
+				{
+					if(errno == EINTR) continue;
+					std::fprintf(stderr, "[Error] io_uring failed, falling back to pread.\n");
+					broken = true;
+					return false;
+				}
+
+				submitted += ret;
+				unsigned head = *cq_head;
+				while(head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+				{
+					io_uring_cqe *cqe = cqes + (head & *cq_mask);
+					io_request_t &req = reqs[cqe->user_data];
+					req.ok = cqe->res == (int)req.size;
+					++head, ++completed;
+				}
+
+				__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+			}
+		}
+
+		return true;
+	}
+#endif
+};
+
+direct_io_backend::direct_io_backend() : ring(nullptr)
+{
+#ifdef TRIVIALDB_IO_URING
+	ring = new uring_t;
+	if(!ring->init())
+	{
+		debug_puts("io_uring is not available, reads are not batched.");
+		delete ring;
+		ring = nullptr;
+	}
+#endif
+}
+
+direct_io_backend::~direct_io_backend()
+{
+	delete ring;
+}
+
+int direct_io_backend::open(const char *filename)
+{
+	int fd = ::open(filename, O_RDWR | O_CREAT | O_DIRECT, 0644);
+	if(fd < 0 && errno == EINVAL)
+	{
+		// the file system does not support O_DIRECT
+		std::fprintf(stderr, "[Warning] Direct I/O is not supported for `%s`.\n", filename);
+		fd = io_backend::open(filename);
+	}
+
+	return fd;
+}
+
+void direct_io_backend::read_batch(io_request_t *reqs, int num)
+{
+	for(int i = 0; i != num; ++i)
+		reqs[i].ok = false;
+#ifdef TRIVIALDB_IO_URING
+	if(ring) ring->read_batch(reqs, num);
+#endif
+
+	// without io_uring, or short reads
+	for(int i = 0; i != num; ++i)
+	{
+		if(!reqs[i].ok)
+			reqs[i].ok = read(reqs[i].fd, reqs[i].data, reqs[i].size, reqs[i].offset);
+	}
+}
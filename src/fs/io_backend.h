@@ -0,0 +1,83 @@
+#ifndef __TRIVIALDB_IO_BACKEND__
+#define __TRIVIALDB_IO_BACKEND__
+
+#include <cstddef>
+#include <sys/types.h>
+#include "../defs.h"
+
+struct io_request_t
+{
+	int fd;
+	char *data;
+	size_t size;
+	off_t offset;
+	bool ok;
+};
+
+/* Positional file I/O used by page_fs. Every call is independent of
+ * the others, so the same file can be read and written concurrently. */
+class io_backend
+{
+public:
+	virtual ~io_backend() {}
+
+	/* open or create a file, returns -1 on failure */
+	virtual int open(const char *filename);
+	virtual void close(int fd);
+	virtual bool read(int fd, char *data, size_t size, off_t offset);
+	virtual bool write(int fd, const char *data, size_t size, off_t offset);
+	/* Do all the reads and set `ok` of each request, the backend
+	 * may keep them in flight together. */
+	virtual void read_batch(io_request_t *reqs, int num);
+	virtual bool sync(int fd);
+	virtual const char *name() const { return "pread"; }
+
+	static io_backend* create(const char *name);
+	static bool is_valid(const char *name);
+};
+
+/* O_DIRECT I/O bypassing the kernel page cache, batched reads are
+ * submitted through io_uring when the kernel supports it. Buffers,
+ * offsets and sizes must be aligned to PAGE_SIZE. */
+class direct_io_backend : public io_backend
+{
+	struct uring_t;
+	uring_t *ring;
+public:
+	direct_io_backend();
+	~direct_io_backend();
+
+	int open(const char *filename) override;
+	void read_batch(io_request_t *reqs, int num) override;
+	const char *name() const override { return "direct"; }
+};
+
+/* A read-only file mapped into memory, for the read-only mode of
+ * page_fs, which reads the pages in place rather than copying them into
+ * its cache. One backend maps one file. The pages are read at random
+ * unless advised otherwise. */
+class mmap_io_backend : public io_backend
+{
+	char *data;
+	size_t size;
+public:
+	mmap_io_backend() : data(nullptr), size(0) {}
+
+	int open(const char *filename) override;
+	void close(int fd) override;
+	bool read(int fd, char *data, size_t size, off_t offset) override;
+	bool write(int, const char*, size_t, off_t) override { return false; }
+	bool sync(int) override { return true; }
+	const char *name() const override { return "mmap"; }
+
+	/* the page at `offset`, nullptr if it is beyond the file */
+	char *get_page(off_t offset) const
+	{
+		return offset >= 0 && (size_t)offset + PAGE_SIZE <= size ? data + offset : nullptr;
+	}
+
+	/* pass a hint of madvise for `size` bytes from `offset` */
+	void advise(off_t offset, size_t size, int advice);
+};
+
+#endif
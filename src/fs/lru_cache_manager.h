@@ -0,0 +1,56 @@
+#ifndef __TRIVIALDB_LRU_CACHE_MANAGER__
+#define __TRIVIALDB_LRU_CACHE_MANAGER__
+
+#include <vector>
+#include "cache_manager.h"
+
+/* Plain LRU, the least recently used frame is replaced. */
+class lru_cache_manager : public cache_manager
+{
+	enum { LIST_USED = 0 };
+	frame_lists lists;
+	std::vector<int> free_frames;
+	int capacity;
+public:
+	lru_cache_manager(int capacity)
+		: lists(capacity, 1), capacity(capacity)
+	{
+		for(int i = capacity - 1; i >= 0; --i)
+			free_frames.push_back(i);
+	}
+
+	void access(int id) override
+	{
+		lists.unlink(id);
+		lists.push_front(LIST_USED, id);
+	}
+
+	void admit(int id, uint64_t, bool) override
+	{
+		if(lists.linked(id))
+			lists.unlink(id);
+		else take_free_frame(free_frames, id);
+		lists.push_front(LIST_USED, id);
+	}
+
+	void remove(int id) override
+	{
+		if(lists.linked(id))
+		{
+			lists.unlink(id);
+			free_frames.push_back(id);
+		}
+	}
+
+	int victim(const int *pin_count) override
+	{
+		if(!free_frames.empty())
+			return free_frames.back();
+		return lists.last_unpinned(LIST_USED, pin_count);
+	}
+
+	int size() const override { return capacity; }
+	const char *name() const override { return "lru"; }
+};
+
+#endif
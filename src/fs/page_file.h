@@ -9,6 +9,8 @@ class page_file
 public:
 	page_file() : fid(0) {}
 	page_file(const char* filename) : fid(0) { open(filename); }
+	// a new file is compressed if `compressed` is set, see page_fs::open
+	page_file(const char* filename, bool compressed) : fid(0) { open(filename, compressed); }
 	~page_file() { close(); }
 	
 	bool open(const char* filename)
@@ -19,6 +21,19 @@ public:
 		return fid;
 	}
 
+	bool open(const char* filename, bool compressed)
+	{
+		page_fs *fs = page_fs::get_instance();
+		if(fid) fs->close(fid);
+		fid = fs->open(filename, compressed);
+		return fid;
+	}
+
+	bool is_compressed()
+	{
+		return page_fs::get_instance()->is_compressed(fid);
+	}
+
 	void close()
 	{
 		if(fid) 
@@ -31,9 +46,25 @@ public:
 		page_fs::get_instance()->writeback(fid);
 	}
 
-	int new_page()
+	void set_meta(const void *data, int size)
+	{
+		page_fs::get_instance()->set_meta(fid, data, size);
+	}
+
+	void get_meta(void *data, int size)
+	{
+		page_fs::get_instance()->get_meta(fid, data, size);
+	}
+
+	/* `near` is a page the new one is read along with, if any */
+	int new_page(int near = 0)
 	{
-		return page_fs::get_instance()->allocate(fid);
+		return page_fs::get_instance()->allocate(fid, near);
+	}
+
+	int page_num()
+	{
+		return page_fs::get_instance()->get_page_num(fid);
 	}
 
 	void free_page(int page_id)
@@ -41,9 +72,9 @@ public:
 		page_fs::get_instance()->deallocate(fid, page_id);
 	}
 
-	char* read(int page_id)
+	char* read(int page_id, bool sequential = false)
 	{
-		return page_fs::get_instance()->read(fid, page_id);
+		return page_fs::get_instance()->read(fid, page_id, sequential);
 	}
 
 	char* read_for_write(int page_id)
@@ -55,6 +86,66 @@ public:
 	{
 		page_fs::get_instance()->mark_dirty(fid, page_id);
 	}
+
+	char* pin(int page_id, bool for_write = false)
+	{
+		return page_fs::get_instance()->pin(fid, page_id, for_write);
+	}
+
+	void unpin(int page_id)
+	{
+		page_fs::get_instance()->unpin(fid, page_id);
+	}
+
+	void prefetch(const int *page_ids, int num, bool sequential = false)
+	{
+		page_fs::get_instance()->prefetch(fid, page_ids, num, sequential);
+	}
+
+	void read_ahead(int page_id, int num, bool forward, page_fs::chain_walker_t walker)
+	{
+		page_fs::get_instance()->read_ahead(fid, page_id, num, forward, walker);
+	}
+};
+
+/* A page pinned for the lifetime of the guard, so that its buffer stays
+ * valid while other pages are read, see page_fs::pin. */
+class page_pin
+{
+	page_file *pf;
+	int pid;
+	char *buf;
+public:
+	page_pin() : pf(nullptr), pid(0), buf(nullptr) {}
+	page_pin(page_file *pf, int pid, bool for_write = false)
+		: pf(pf), pid(pid), buf(pf->pin(pid, for_write)) {}
+	page_pin(page_pin &&other) : pf(other.pf), pid(other.pid), buf(other.buf)
+	{
+		other.pf = nullptr;
+	}
+
+	page_pin &operator = (page_pin &&other)
+	{
+		if(this != &other)
+		{
+			release();
+			pf = other.pf, pid = other.pid, buf = other.buf;
+			other.pf = nullptr;
+		}
+
+		return *this;
+	}
+
+	page_pin(const page_pin &) = delete;
+	page_pin &operator = (const page_pin &) = delete;
+	~page_pin() { release(); }
+
+	char *get() const { return buf; }
+	void release()
+	{
+		if(pf) pf->unpin(pid);
+		pf = nullptr;
+	}
 };
 
 #endif
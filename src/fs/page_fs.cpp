@@ -1,175 +1,1518 @@
 #include <cstring>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <sys/mman.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "page_fs.h"
+#include "lru_cache_manager.h"
+#include "twoq_cache_manager.h"
+#include "../utils/exec_stats.h"
+
+/* Frames are mapped lazily by the kernel, so a large cache costs
+ * nothing until it is used. Huge pages are preferred to save TLB. */
+static char* allocate_frames(size_t size)
+{
+	void *addr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	if(size % PAGE_CACHE_HUGE_PAGE_SIZE == 0)
+	{
+		addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+#endif
+	if(addr == MAP_FAILED)
+	{
+		addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(addr == MAP_FAILED)
+			return nullptr;
+#ifdef MADV_HUGEPAGE
+		madvise(addr, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	return (char*)addr;
+}
+
+static void release_frames(char *addr, size_t size)
+{
+	if(addr) munmap(addr, size);
+}
+
+static cache_manager* create_cache_manager(const char *policy, int capacity)
+{
+	if(strcasecmp(policy, "lru") == 0)
+		return new lru_cache_manager(capacity);
+	return new twoq_cache_manager(capacity);
+}
+
+bool page_fs::is_valid_policy(const char *name)
+{
+	return strcasecmp(name, "lru") == 0 || strcasecmp(name, "2q") == 0;
+}
+
+void page_fs::cache_shard_t::init(char *buf, int capacity, const char *policy)
+{
+	this->capacity = capacity;
+	buffer = buf;
+	dirty = new char[capacity];
+	pin_count = new int[capacity];
+	loading = new char[capacity];
+	write_gen = new unsigned[capacity];
+	dirty_round = new unsigned[capacity];
+	index2page = new file_page_t[capacity];
+	cm = create_cache_manager(policy, capacity);
+	std::memset(dirty, 0, capacity);
+	std::memset(loading, 0, capacity);
+	std::memset(pin_count, 0, capacity * sizeof(int));
+	std::memset(write_gen, 0, capacity * sizeof(unsigned));
+	std::memset(dirty_round, 0, capacity * sizeof(unsigned));
+	std::fill(index2page, index2page + capacity, file_page_t(0, 0));
+	page2index.clear();
+#ifndef NDEBUG
+	evictions = 0;
+	read_evictions = new unsigned[capacity];
+	std::memset(read_evictions, 0, capacity * sizeof(unsigned));
+#endif
+}
+
+void page_fs::cache_shard_t::clear()
+{
+	delete[] dirty;
+	delete[] pin_count;
+	delete[] loading;
+	delete[] write_gen;
+	delete[] dirty_round;
+	delete[] index2page;
+	delete cm;
+	dirty = nullptr;
+	pin_count = nullptr;
+	loading = nullptr;
+	write_gen = nullptr;
+	dirty_round = nullptr;
+	index2page = nullptr;
+	cm = nullptr;
+	buffer = nullptr;
+	capacity = 0;
+	page2index.clear();
+#ifndef NDEBUG
+	delete[] read_evictions;
+	read_evictions = nullptr;
+#endif
+}
+
+// read in place of a page beyond the end of a mapped file
+alignas(PAGE_SIZE) static char zero_page[PAGE_SIZE];
 
 /* page_fs code */
+thread_local uint64_t page_fs::thread_snapshot = page_fs::NO_SNAPSHOT;
+
 page_fs::page_fs()
+	: buffer(nullptr), buffer_size(0), capacity(0),
+	  policy(PAGE_CACHE_DEFAULT_POLICY), dirty_count(0),
+	  flusher_stop(false), flusher_wanted(false), flush_round(0),
+	  read_ahead_stop(false), stage_next(0),
+	  stage_key(PAGE_READ_AHEAD_STAGE), stage_state(PAGE_READ_AHEAD_STAGE, STAGE_FREE),
+	  wal_enabled(PAGE_WAL_DEFAULT), compress(PAGE_COMPRESS_DEFAULT),
+	  read_only(false), commit_seq(0), snapshot_count(0)
+{
+	std::fill(fds, fds + MAX_FILE_ID + 1, -1);
+	std::fill(mapped, mapped + MAX_FILE_ID + 1, nullptr);
+	std::fill(file_io, file_io + MAX_FILE_ID + 1, nullptr);
+	std::fill(wal, wal + MAX_FILE_ID + 1, nullptr);
+	std::fill(txn_header, txn_header + MAX_FILE_ID + 1, false);
+	io = io_backend::create(PAGE_IO_DEFAULT_BACKEND);
+	flush_buffer = allocate_frames((size_t)PAGE_WRITEBACK_MAX_RUN * PAGE_SIZE);
+	stage_buffer = allocate_frames((size_t)PAGE_READ_AHEAD_STAGE * PAGE_SIZE);
+	assert(flush_buffer && stage_buffer);
+	resize(PAGE_CACHE_CAPACITY);
+	flusher = std::thread(&page_fs::flusher_main, this);
+	read_ahead_worker = std::thread(&page_fs::read_ahead_main, this);
+}
+
+bool page_fs::resize(int new_capacity)
+{
+	return rebuild(new_capacity, policy);
+}
+
+bool page_fs::set_policy(const char *name)
+{
+	if(!is_valid_policy(name))
+	{
+		std::fprintf(stderr, "[Error] Unknown cache policy `%s`.\n", name);
+		return false;
+	}
+
+	return rebuild(capacity, strcasecmp(name, "lru") == 0 ? "lru" : "2q");
+}
+
+bool page_fs::rebuild(int new_capacity, const char *new_policy)
 {
-	std::memset(dirty, 0, sizeof(dirty));
-	std::memset(index2page, 0, sizeof(index2page));
+	int shard_capacity = std::max(PAGE_CACHE_MIN_SHARD_CAPACITY,
+		new_capacity / PAGE_CACHE_SHARD_NUM);
+	size_t shard_size = (size_t)shard_capacity * PAGE_SIZE;
+	size_t size = shard_size * PAGE_CACHE_SHARD_NUM;
+	size = (size + PAGE_CACHE_HUGE_PAGE_SIZE - 1)
+		/ PAGE_CACHE_HUGE_PAGE_SIZE * PAGE_CACHE_HUGE_PAGE_SIZE;
+
+	std::lock_guard<std::mutex> read_ahead_guard(read_ahead_lock);
+	std::lock_guard<std::mutex> flush_guard(flush_lock);
+	std::unique_lock<std::mutex> guards[PAGE_CACHE_SHARD_NUM];
+	for(int i = 0; i != PAGE_CACHE_SHARD_NUM; ++i)
+		guards[i] = std::unique_lock<std::mutex>(shards[i].lock);
+
+	for(cache_shard_t &shard : shards)
+	{
+		for(int i = 0; i != shard.capacity; ++i)
+		{
+			if(shard.pin_count[i])
+			{
+				std::fprintf(stderr, "[Error] Cannot resize page cache while pages are pinned.\n");
+				return false;
+			}
+		}
+	}
+
+	char *new_buffer = allocate_frames(size);
+	if(!new_buffer)
+	{
+		std::fprintf(stderr, "[Error] Fail to allocate %zu bytes for page cache.\n", size);
+		return false;
+	}
+
+	// pages of running transactions are written below
+	for(int i = 1; i <= MAX_FILE_ID; ++i)
+	{
+		if(wal[i]) wal[i]->force();
+	}
+
+	for(cache_shard_t &shard : shards)
+	{
+		for(int i = 0; i != shard.capacity; ++i)
+		{
+			file_page_t info = shard.index2page[i];
+			if(info.first != 0 && shard.dirty[i])
+				write_page_to_file(info.first, info.second, shard.buffer + i * PAGE_SIZE);
+		}
+
+		shard.clear();
+	}
+
+	for(int i = 1; i <= MAX_FILE_ID; ++i)
+	{
+		std::lock_guard<std::mutex> dirty_guard(dirty_lock[i]);
+		dirty_pages[i].clear();
+	}
+
+	dirty_count = 0;
+	release_frames(buffer, buffer_size);
+	buffer = new_buffer;
+	buffer_size = size;
+	capacity = shard_capacity * PAGE_CACHE_SHARD_NUM;
+	policy = new_policy;
+	for(int i = 0; i != PAGE_CACHE_SHARD_NUM; ++i)
+		shards[i].init(buffer + i * shard_size, shard_capacity, policy);
+	debug_printf("Page cache resized: %d pages, policy %s.\n", capacity, policy);
+	return true;
 }
 
 inline bool file_exists(const char* filename)
 {
-	FILE *f = std::fopen(filename, "r");
-	if(f) std::fclose(f);
-	return f;
+	return access(filename, F_OK) == 0;
 }
 
-int page_fs::open(const char* filename)
+int page_fs::open(const char* filename, bool compressed)
 {
+	std::lock_guard<std::mutex> flush_guard(flush_lock);
+	std::lock_guard<std::mutex> guard(fs_lock);
+
 	// allocate file id and open file
 	int fid = fm.allocate();
 	if(!fid) return 0;   // fail
 
 	bool exists = file_exists(filename);
-	FILE *f = std::fopen(filename, exists ? "rb+" : "wb+");
-	if(!f) return 0;
+	if(read_only && !exists)
+	{
+		std::fprintf(stderr, "[Error] `%s` does not exist.\n", filename);
+		fm.deallocate(fid);
+		return 0;
+	}
+
+	if(!exists)
+		std::remove(compressed_io_backend::map_filename(filename).c_str());
+	if(exists) compressed = compressed_io_backend::is_compressed(filename);
+	mmap_io_backend *map = read_only && !compressed ? new mmap_io_backend : nullptr;
+	io_backend *fio = map ? map : compressed ? new compressed_io_backend(read_only) : io;
+	int fd = fio->open(filename);
+	if(fd < 0)
+	{
+		if(read_only)
+			std::fprintf(stderr, "[Error] Fail to open `%s` read-only.\n", filename);
+		if(fio != io) delete fio;
+		fm.deallocate(fid);
+		return 0;
+	}
 
-	// setup file header
+	// setup file header, the whole page is read and written for O_DIRECT
+	alignas(PAGE_SIZE) char page_buf[PAGE_SIZE];
 	page_fs_header_t header;
 	if(!exists)
 	{
 		header.page_num       = 0;
 		header.first_freepage = 0;
-		std::memset(tmp_buffer, 0, PAGE_SIZE);
-		std::memcpy(tmp_buffer, &header, sizeof(header));
-		std::fwrite(tmp_buffer, PAGE_SIZE, 1, f);
+		std::memset(page_buf, 0, PAGE_SIZE);
+		std::memcpy(page_buf, &header, sizeof(header));
+		if(!fio->write(fd, page_buf, PAGE_SIZE, 0))
+			std::fprintf(stderr, "[Error] Fail to write header of `%s`.\n", filename);
+	} else if(fio->read(fd, page_buf, PAGE_SIZE, 0)) {
+		std::memcpy(&header, page_buf, sizeof(header));
 	} else {
-		std::fread(&header, sizeof(header), 1, f);
+		std::fprintf(stderr, "[Error] Fail to read header of `%s`.\n", filename);
+		header.page_num       = 0;
+		header.first_freepage = 0;
+		std::memset(page_buf, 0, PAGE_SIZE);
 	}
 
-	files[fid] = f;
+	fds[fid] = fd;
+	file_io[fid] = fio;
+	mapped[fid] = map;
 	file_info[fid] = header;
+	free_map[fid].clear();
+	std::memcpy(file_meta[fid], page_buf + PAGE_META_OFFSET, PAGE_META_SIZE);
+	if(read_only)
+	{
+		struct stat st;
+		std::string log_name = std::string(filename) + ".wal";
+		if(stat(log_name.c_str(), &st) == 0 && st.st_size > 0)
+			std::fprintf(stderr, "[Error] `%s` has a log to recover, which is not done read-only.\n", filename);
+	} else if(wal_enabled) {
+		recover(fid, filename);
+	}
+
+	{
+		std::lock_guard<std::mutex> dirty_guard(dirty_lock[fid]);
+		txn_base_page_num[fid] = file_info[fid].page_num;
+	}
+
 	return fid;
 }
 
+/* Bring the file back to its last commit with the log left by a crash,
+ * then start an empty log. `flush_lock` must be held by the caller. */
+void page_fs::recover(int file_id, const char *filename)
+{
+	std::string log_name = filename;
+	log_name += ".wal";
+	wal[file_id] = new write_ahead_log;
+	if(!wal[file_id]->open(log_name.c_str()))
+	{
+		delete wal[file_id];
+		wal[file_id] = nullptr;
+		return;
+	}
+
+	if(wal[file_id]->size() == 0)
+		return;
+
+	int fd = fds[file_id];
+	auto ret = wal[file_id]->recover([&](int page_id, const char *page) {
+		if(page_id == 0)
+		{
+			std::memcpy(file_info + file_id, page, sizeof(page_fs_header_t));
+			std::memcpy(file_meta[file_id], page + PAGE_META_OFFSET, PAGE_META_SIZE);
+		}
+
+		if(!file_io[file_id]->write(fd, page, PAGE_SIZE, (off_t)PAGE_SIZE * page_id))
+			std::fprintf(stderr, "[Error] Fail to recover page %d of `%s`.\n", page_id, filename);
+	} );
+
+	if(!file_io[file_id]->sync(fd))
+	{
+		std::fprintf(stderr, "[Error] Fail to sync `%s`, the log is kept.\n", filename);
+		return;
+	}
+
+	wal[file_id]->truncate();
+	std::printf("[Info] Recovered `%s`: %d page(s) redone, %d page(s) undone.\n",
+		filename, ret.first, ret.second);
+}
+
 void page_fs::close(int file_id)
 {
 	assert(fm.is_used(file_id));
+	if(wal[file_id])
+		commit_file(file_id);
+
+	{
+		// drop pending read-ahead and wait for the one being served
+		std::unique_lock<std::mutex> queue_guard(read_ahead_queue_lock);
+		for(auto it = read_ahead_queue.begin(); it != read_ahead_queue.end(); )
+		{
+			if(it->file_id == file_id)
+				it = read_ahead_queue.erase(it);
+			else ++it;
+		}
+
+		queue_guard.unlock();
+		std::lock_guard<std::mutex> read_ahead_guard(read_ahead_lock);
+		{
+			std::lock_guard<std::mutex> stage_guard(stage_lock);
+			for(int i = 0; i != PAGE_READ_AHEAD_STAGE; ++i)
+			{
+				if(stage_state[i] == STAGE_READY && stage_key[i].first == file_id)
+				{
+					staged.erase(stage_key[i]);
+					stage_state[i] = STAGE_FREE;
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> flush_guard(flush_lock);
+		if(!read_only)
+		{
+			flush_file(file_id, false, -1);
+			write_header(file_id);
+		}
+
+		if(wal[file_id])
+		{
+			// the log is not needed once the file is synced
+			if(file_io[file_id]->sync(fds[file_id]))
+				std::remove(wal[file_id]->get_filename());
+			delete wal[file_id];
+			wal[file_id] = nullptr;
+		}
+
+		{
+			std::lock_guard<std::mutex> dirty_guard(dirty_lock[file_id]);
+			txn_pages[file_id].clear();
+		}
+
+		txn_header[file_id] = false;
+		free_map[file_id].clear();
+		drop_versions(file_id);
+
+		// drop the clean pages as well, the file id will be reused
+		for(cache_shard_t &shard : shards)
+		{
+			std::lock_guard<std::mutex> guard(shard.lock);
+			for(int i = 0; i != shard.capacity; ++i)
+			{
+				file_page_t info = shard.index2page[i];
+				if(info.first == file_id)
+				{
+					assert(shard.pin_count[i] == 0);
+					set_frame_clean(shard, i);
+					shard.page2index.erase(info);
+					shard.index2page[i] = { 0, 0 };
+					shard.pin_count[i] = 0;
+					shard.cm->remove(i);
+				}
+			}
+		}
+
+		file_io[file_id]->close(fds[file_id]);
+		if(file_io[file_id] != io)
+			delete file_io[file_id];
+		file_io[file_id] = nullptr;
+		mapped[file_id] = nullptr;
+		fds[file_id] = -1;
+	}
 
-	writeback(file_id);
+	std::lock_guard<std::mutex> guard(fs_lock);
 	fm.deallocate(file_id);
-	std::fclose(files[file_id]);
 }
 
 void page_fs::writeback(int file_id)
 {
 	assert(fm.is_used(file_id));
-	FILE *file = files[file_id];
-	for(int i = 0; i != PAGE_CACHE_CAPACITY; ++i)
+	if(read_only)
+		return;
+	if(wal[file_id])
+		commit_file(file_id);
+	checkpoint(file_id);
+}
+
+/* Write back all pages of a committed file, and empty its log. */
+void page_fs::checkpoint(int file_id)
+{
+	std::lock_guard<std::mutex> flush_guard(flush_lock);
+	flush_file(file_id, false, -1);
+	write_header(file_id);
+	if(!wal[file_id])
+		return;
+
+	if(file_io[file_id]->sync(fds[file_id]))
+		wal[file_id]->truncate();
+	else std::fprintf(stderr, "[Error] Fail to sync file %d, the log is kept.\n", file_id);
+}
+
+void page_fs::write_header(int file_id)
+{
+	alignas(PAGE_SIZE) char page_buf[PAGE_SIZE];
+	std::lock_guard<std::mutex> alloc_guard(alloc_lock[file_id]);
+	fill_header_page(file_id, page_buf);
+	if(!file_io[file_id]->write(fds[file_id], page_buf, PAGE_SIZE, 0))
+	{
+		std::fprintf(stderr, "[Error] Fail to write file header.\n");
+	}
+}
+
+/* `alloc_lock` of the file must be held by the caller. */
+void page_fs::fill_header_page(int file_id, char *page)
+{
+	std::memset(page, 0, PAGE_SIZE);
+	std::memcpy(page, file_info + file_id, sizeof(page_fs_header_t));
+	std::memcpy(page + PAGE_META_OFFSET, file_meta[file_id], PAGE_META_SIZE);
+}
+
+void page_fs::set_meta(int file_id, const void *data, int size)
+{
+	assert(fm.is_used(file_id));
+	assert(size <= PAGE_META_SIZE);
+	std::lock_guard<std::mutex> guard(alloc_lock[file_id]);
+	if(std::memcmp(file_meta[file_id], data, size) != 0)
+	{
+		std::memcpy(file_meta[file_id], data, size);
+		txn_header[file_id] = true;
+	}
+}
+
+void page_fs::get_meta(int file_id, void *data, int size)
+{
+	assert(fm.is_used(file_id));
+	assert(size <= PAGE_META_SIZE);
+	std::lock_guard<std::mutex> guard(alloc_lock[file_id]);
+	std::memcpy(data, file_meta[file_id], size);
+}
+
+void page_fs::commit()
+{
+	for(int fid = 1; fid <= MAX_FILE_ID; ++fid)
+	{
+		if(wal[fid])
+			commit_file(fid);
+	}
+
+	std::lock_guard<std::mutex> guard(version_lock);
+	++commit_seq;
+	prune_versions();
+}
+
+uint64_t page_fs::begin_snapshot()
+{
+	std::lock_guard<std::mutex> guard(version_lock);
+	snapshots.insert(commit_seq);
+	++snapshot_count;
+	return commit_seq;
+}
+
+void page_fs::end_snapshot(uint64_t snapshot)
+{
+	std::lock_guard<std::mutex> guard(version_lock);
+	auto it = snapshots.find(snapshot);
+	assert(it != snapshots.end());
+	snapshots.erase(it);
+	--snapshot_count;
+	prune_versions();
+}
+
+size_t page_fs::get_version_num()
+{
+	std::lock_guard<std::mutex> guard(version_lock);
+	size_t num = 0;
+	for(auto &p : versions)
+		num += p.second.size();
+	return num;
+}
+
+/* Keep the image of a page before the running transaction modifies it,
+ * if an open snapshot may read it. `version_lock` must be held. */
+void page_fs::save_version(file_page_t key, const char *frame)
+{
+	uint64_t running = commit_seq + 1;
+	auto alloc_it = allocated.find(key);
+	if(alloc_it != allocated.end() && *snapshots.rbegin() < alloc_it->second)
+		return;  // allocated after all of them began
+
+	std::vector<page_version_t> &list = versions[key];
+	if(!list.empty() && list.back().until == running)
+		return;
+
+	char *image = new char[PAGE_SIZE];
+	std::memcpy(image, frame, PAGE_SIZE);
+	list.push_back({ running, image });
+}
+
+/* The page as of commit `snapshot` if it has been modified since, or
+ * nullptr. `version_lock` must be held. */
+char *page_fs::find_version(file_page_t key, uint64_t snapshot)
+{
+	auto it = versions.find(key);
+	if(it == versions.end())
+		return nullptr;
+	for(page_version_t &v : it->second)
+	{
+		if(v.until > snapshot)
+			return v.image;
+	}
+
+	return nullptr;
+}
+
+/* Drop the versions no open snapshot can read, and the allocations
+ * every snapshot opened later comes after. `version_lock` must be held. */
+void page_fs::prune_versions()
+{
+	uint64_t oldest = snapshots.empty() ? commit_seq : *snapshots.begin();
+	for(auto it = versions.begin(); it != versions.end(); )
+	{
+		std::vector<page_version_t> &list = it->second;
+		size_t n = 0;
+		while(n != list.size() && (snapshots.empty() || list[n].until <= oldest))
+			delete [] list[n++].image;
+		list.erase(list.begin(), list.begin() + n);
+		if(list.empty())
+			it = versions.erase(it);
+		else ++it;
+	}
+
+	for(auto it = allocated.begin(); it != allocated.end(); )
+	{
+		if(it->second <= oldest)
+			it = allocated.erase(it);
+		else ++it;
+	}
+}
+
+void page_fs::drop_versions(int file_id)
+{
+	std::lock_guard<std::mutex> guard(version_lock);
+	for(auto it = versions.begin(); it != versions.end(); )
+	{
+		if(it->first.first == file_id)
+		{
+			for(page_version_t &v : it->second)
+				delete [] v.image;
+			it = versions.erase(it);
+		} else ++it;
+	}
+
+	for(auto it = allocated.begin(); it != allocated.end(); )
+	{
+		if(it->first.first == file_id)
+			it = allocated.erase(it);
+		else ++it;
+	}
+}
+
+/* Log the images of the pages modified by the running transaction and
+ * the header page, and force the log. The pages stay in the transaction
+ * until the log is durable, so the flusher does not write them before. */
+bool page_fs::commit_file(int file_id)
+{
+	write_ahead_log *log = wal[file_id];
+	std::vector<int> pids;
+	{
+		std::lock_guard<std::mutex> guard(dirty_lock[file_id]);
+		pids.assign(txn_pages[file_id].begin(), txn_pages[file_id].end());
+	}
+
+	alignas(PAGE_SIZE) char page_buf[PAGE_SIZE];
+	int page_num;
+	{
+		std::lock_guard<std::mutex> alloc_guard(alloc_lock[file_id]);
+		if(pids.empty() && !txn_header[file_id])
+			return true;
+		page_num = file_info[file_id].page_num;
+		fill_header_page(file_id, page_buf);
+		txn_header[file_id] = false;
+	}
+
+	log->append(write_ahead_log::RECORD_HEADER, 0, page_buf);
+	for(int pid : pids)
+	{
+		cache_shard_t &shard = get_shard(file_id, pid);
+		std::unique_lock<std::mutex> guard(shard.lock);
+		auto it = shard.page2index.find({ file_id, pid });
+		if(it != shard.page2index.end())
+		{
+			log->append(write_ahead_log::RECORD_REDO, pid, shard.buffer + it->second * PAGE_SIZE);
+		} else {
+			// it has been written back since
+			guard.unlock();
+			read_page_from_file(file_id, pid, page_buf);
+			log->append(write_ahead_log::RECORD_REDO, pid, page_buf);
+		}
+	}
+
+	if(!log->commit())
+		return false;
+
 	{
-		file_page_t info = index2page[i];
-		if(info.first == file_id && dirty[i])
+		std::lock_guard<std::mutex> guard(dirty_lock[file_id]);
+		txn_pages[file_id].clear();
+		txn_base_page_num[file_id] = page_num;
+	}
+
+	if(log->size() >= PAGE_WAL_CHECKPOINT_SIZE)
+		checkpoint(file_id);
+	return true;
+}
+
+/* Log the image of a page before the running transaction modifies it,
+ * unless the transaction allocated it at the end of the file, which the
+ * header of the last commit does not reach. The shard of the page must
+ * be locked by the caller. */
+void page_fs::log_before_image(file_page_t key, const char *frame)
+{
+	std::lock_guard<std::mutex> guard(dirty_lock[key.first]);
+	if(txn_pages[key.first].insert(key.second).second
+		&& key.second <= txn_base_page_num[key.first])
+		wal[key.first]->append(write_ahead_log::RECORD_UNDO, key.second, frame);
+}
+
+bool page_fs::in_transaction(file_page_t key)
+{
+	std::lock_guard<std::mutex> guard(dirty_lock[key.first]);
+	return txn_pages[key.first].count(key.second) != 0;
+}
+
+bool page_fs::set_read_only(bool enabled)
+{
+	std::lock_guard<std::mutex> flush_guard(flush_lock);
+	for(int i = 1; i <= MAX_FILE_ID; ++i)
+	{
+		if(fds[i] >= 0)
 		{
-			// debug_printf("Writeback: fid = %d, pid = %d\n", file_id, info.second);
-			std::fseek(file, (long)PAGE_SIZE * info.second, SEEK_SET);
-			std::fwrite(buffer + i * PAGE_SIZE, PAGE_SIZE, 1, file);
-			page2index.erase(page2index.find(info));
-			index2page[i] = { 0, 0 };
+			std::fprintf(stderr, "[Error] Cannot change the read-only mode while files are opened.\n");
+			return false;
 		}
 	}
 
-	std::fseek(file, 0, SEEK_SET);
-	std::fwrite(file_info + file_id, sizeof(page_fs_header_t), 1, file);
+	read_only = enabled;
+	return true;
 }
 
-int page_fs::allocate(int file_id)
+bool page_fs::set_wal(bool enabled)
 {
-	assert(fm.is_used(file_id));
+	std::lock_guard<std::mutex> flush_guard(flush_lock);
+	for(int i = 1; i <= MAX_FILE_ID; ++i)
+	{
+		if(fds[i] >= 0)
+		{
+			std::fprintf(stderr, "[Error] Cannot change the log while files are opened.\n");
+			return false;
+		}
+	}
+
+	wal_enabled = enabled;
+	return true;
+}
 
+/* Write back the dirty pages of a file in page id order, adjacent pages
+ * are written with one call. If `aged_only` is set, pages modified
+ * in this or the last flusher round are skipped, and it stops once no
+ * more than `target` pages are dirty (never if `target` < 0). Pages of
+ * a run are copied out under the shard lock and stay pinned until they
+ * are written, so they are neither torn nor evicted and written again
+ * meanwhile. `flush_lock` must be held by the caller. */
+int page_fs::flush_file(int file_id, bool aged_only, int target)
+{
+	std::vector<int> pids;
+	{
+		std::lock_guard<std::mutex> guard(dirty_lock[file_id]);
+		pids.assign(dirty_pages[file_id].begin(), dirty_pages[file_id].end());
+	}
+
+	int written = 0;
+	std::vector<std::pair<int, unsigned>> run;  // (page id, write gen)
+	auto submit = [&]() {
+		if(run.empty()) return;
+		write_page_to_file(file_id, run[0].first, flush_buffer, (int)run.size());
+		for(auto &p : run)
+		{
+			cache_shard_t &shard = get_shard(file_id, p.first);
+			std::lock_guard<std::mutex> guard(shard.lock);
+			int index = shard.page2index[{ file_id, p.first }];
+			// keep it dirty if it is modified again while being written
+			if(shard.write_gen[index] == p.second)
+				set_frame_clean(shard, index);
+			--shard.pin_count[index];
+		}
+
+		written += (int)run.size();
+		run.clear();
+	};
+
+	for(int pid : pids)
+	{
+		if(target >= 0 && dirty_count <= target)
+			break;
+		if(!run.empty() && (pid != run.back().first + 1
+			|| run.size() == PAGE_WRITEBACK_MAX_RUN))
+		{
+			submit();
+		}
+
+		cache_shard_t &shard = get_shard(file_id, pid);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		auto it = shard.page2index.find({ file_id, pid });
+		if(it == shard.page2index.end() || !shard.dirty[it->second])
+			continue;
+		int index = it->second;
+		if(aged_only && flush_round - shard.dirty_round[index] < 2)
+			continue;
+		if(wal[file_id] && in_transaction({ file_id, pid }))
+		{
+			// the flusher leaves it to the commit
+			if(aged_only) continue;
+			wal[file_id]->force();
+		}
+
+		++shard.pin_count[index];
+		std::memcpy(flush_buffer + run.size() * PAGE_SIZE,
+			shard.buffer + index * PAGE_SIZE, PAGE_SIZE);
+		run.push_back({ pid, shard.write_gen[index] });
+	}
+
+	submit();
+	return written;
+}
+
+void page_fs::flusher_main()
+{
+	std::unique_lock<std::mutex> lock(flusher_lock);
+	while(!flusher_stop)
+	{
+		flusher_cv.wait_for(lock, std::chrono::milliseconds(PAGE_FLUSH_INTERVAL_MS),
+			[this] { return flusher_stop || flusher_wanted; });
+		if(flusher_stop) break;
+		flusher_wanted = false;
+		lock.unlock();
+
+		++flush_round;
+		{
+			std::lock_guard<std::mutex> flush_guard(flush_lock);
+			int target = capacity * PAGE_FLUSH_DIRTY_LOW / 100;
+			for(int fid = 1; fid <= MAX_FILE_ID && dirty_count > target; ++fid)
+			{
+				if(fds[fid] >= 0)
+					flush_file(fid, true, target);
+			}
+		}
+
+		flush_thread_stats();
+
+		lock.lock();
+	}
+}
+
+void page_fs::read_ahead(int file_id, int page_id, int num, bool forward, chain_walker_t walker)
+{
+	if(!page_id || num <= 0) return;
+	std::lock_guard<std::mutex> guard(read_ahead_queue_lock);
+	if(read_ahead_queue.size() >= PAGE_READ_AHEAD_QUEUE)
+		return;
+	read_ahead_queue.push_back({ file_id, page_id, num, forward, walker });
+	read_ahead_cv.notify_one();
+}
+
+void page_fs::read_ahead_main()
+{
+	std::unique_lock<std::mutex> queue_guard(read_ahead_queue_lock);
+	while(true)
+	{
+		read_ahead_cv.wait(queue_guard, [this] {
+			return read_ahead_stop || !read_ahead_queue.empty(); });
+		if(read_ahead_stop) break;
+
+		// take `read_ahead_lock` before the request is visible as taken,
+		// so that `close` either drops it or waits for it
+		std::unique_lock<std::mutex> guard(read_ahead_lock, std::try_to_lock);
+		if(!guard.owns_lock())
+		{
+			queue_guard.unlock();
+			guard.lock();
+			queue_guard.lock();
+			if(read_ahead_queue.empty()) continue;
+		}
+
+		read_ahead_t req = read_ahead_queue.front();
+		read_ahead_queue.pop_front();
+		queue_guard.unlock();
+		serve_read_ahead(req);
+		flush_thread_stats();
+		guard.unlock();
+		queue_guard.lock();
+	}
+}
+
+/* The chain is read one page after another, because the next page id
+ * is known only after the page is read, while the extra pages of each
+ * of them are read in one batch. */
+void page_fs::serve_read_ahead(const read_ahead_t &req)
+{
+	// pages staged by one request, or the oldest ones (which are to be
+	// read first) would be replaced before they are read
+	int budget = PAGE_READ_AHEAD_STAGE / 2;
+	std::vector<int> chain, next_ids, extra, next_extra;
+	int page_id = req.page_id;
+	for(int i = 0; i != req.num && page_id && budget > 0; ++i)
+	{
+		chain.assign(1, page_id);
+		extra.clear();
+		budget -= walk_pages(req, chain, next_ids, extra);
+		page_id = next_ids[0];
+
+		while(!extra.empty() && budget > 0)
+		{
+			if((int)extra.size() > budget)
+				extra.resize(budget);
+			next_extra.clear();
+			budget -= walk_pages(req, extra, next_ids, next_extra);
+			extra.swap(next_extra);
+		}
+	}
+}
+
+/* Read the pages which are neither cached nor staged into the staging
+ * area with one batch, and walk all of them. Frames in the cache are
+ * pinned while being walked, and a staged page becomes ready after it
+ * is walked. The page following each page is put into `next_ids`, and
+ * the number of pages read is returned. */
+int page_fs::walk_pages(const read_ahead_t &req, const std::vector<int> &pids,
+	std::vector<int> &next_ids, std::vector<int> &extra)
+{
+	enum { SKIP, CACHED, STAGED, LOADING };
+	struct item_t { int kind; int index; };
+
+	int fid = req.file_id;
+	if(mapped[fid])
+	{
+		// the kernel reads them all, walking them waits for each
+		for(int pid : pids)
+			mapped[fid]->advise((off_t)PAGE_SIZE * pid, PAGE_SIZE, MADV_WILLNEED);
+		next_ids.assign(pids.size(), 0);
+		for(size_t i = 0; i != pids.size(); ++i)
+		{
+			const char *page = pids[i] >= 1 && pids[i] <= file_info[fid].page_num
+				? mapped[fid]->get_page((off_t)PAGE_SIZE * pids[i]) : nullptr;
+			if(page) next_ids[i] = req.walker(page, req.forward, extra);
+		}
+
+		return (int)pids.size();
+	}
+
+	std::vector<item_t> items(pids.size(), item_t { SKIP, -1 });
+	std::vector<io_request_t> reqs;
+	for(size_t i = 0; i != pids.size(); ++i)
+	{
+		int pid = pids[i];
+		if(pid < 1 || pid > file_info[fid].page_num)
+			continue;
+
+		file_page_t key = { fid, pid };
+		cache_shard_t &shard = get_shard(fid, pid);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		auto it = shard.page2index.find(key);
+		if(it != shard.page2index.end())
+		{
+			if(shard.loading[it->second])
+				continue;
+			++shard.pin_count[it->second];
+			items[i] = { CACHED, it->second };
+			continue;
+		}
+
+		std::lock_guard<std::mutex> stage_guard(stage_lock);
+		auto sit = staged.find(key);
+		if(sit != staged.end())
+		{
+			items[i] = { STAGED, sit->second };
+			continue;
+		}
+
+		int slot = allocate_stage_slot();
+		if(slot < 0) continue;
+		staged[key] = slot;
+		stage_key[slot] = key;
+		stage_state[slot] = STAGE_LOADING;
+		items[i] = { LOADING, slot };
+		reqs.push_back({ fds[fid], stage_buffer + slot * PAGE_SIZE,
+			PAGE_SIZE, (off_t)PAGE_SIZE * pid, false });
+	}
+
+	if(!reqs.empty())
+		file_io[fid]->read_batch(reqs.data(), (int)reqs.size());
+	thread_stats().pages_read += reqs.size();
+
+	next_ids.assign(pids.size(), 0);
+	for(size_t i = 0, r = 0; i != pids.size(); ++i)
+	{
+		item_t &item = items[i];
+		if(item.kind == CACHED)
+		{
+			cache_shard_t &shard = get_shard(fid, pids[i]);
+			next_ids[i] = req.walker(shard.buffer + item.index * PAGE_SIZE, req.forward, extra);
+			std::lock_guard<std::mutex> guard(shard.lock);
+			--shard.pin_count[item.index];
+		} else if(item.kind == LOADING) {
+			bool ok = reqs[r++].ok;
+			if(ok) next_ids[i] = req.walker(stage_buffer + item.index * PAGE_SIZE, req.forward, extra);
+			std::lock_guard<std::mutex> stage_guard(stage_lock);
+			if(ok) {
+				stage_state[item.index] = STAGE_READY;
+			} else {
+				staged.erase(stage_key[item.index]);
+				stage_state[item.index] = STAGE_FREE;
+			}
+
+			stage_cv.notify_all();
+		} else if(item.kind == STAGED) {
+			// staged by an early request, only the walker is needed
+			std::lock_guard<std::mutex> stage_guard(stage_lock);
+			if(stage_state[item.index] == STAGE_READY
+				&& stage_key[item.index] == file_page_t(fid, pids[i]))
+			{
+				next_ids[i] = req.walker(stage_buffer + item.index * PAGE_SIZE, req.forward, extra);
+			}
+		}
+	}
+
+	return (int)reqs.size();
+}
+
+/* Slots are reused in FIFO order, `stage_lock` must be held. */
+int page_fs::allocate_stage_slot()
+{
+	for(int i = 0; i != PAGE_READ_AHEAD_STAGE; ++i)
+	{
+		int slot = stage_next;
+		stage_next = (stage_next + 1) % PAGE_READ_AHEAD_STAGE;
+		if(stage_state[slot] == STAGE_LOADING)
+			continue;
+		if(stage_state[slot] == STAGE_READY)
+			staged.erase(stage_key[slot]);
+		stage_state[slot] = STAGE_FREE;
+		return slot;
+	}
+
+	return -1;
+}
+
+bool page_fs::is_staged_loading(file_page_t key)
+{
+	std::lock_guard<std::mutex> stage_guard(stage_lock);
+	auto it = staged.find(key);
+	return it != staged.end() && stage_state[it->second] == STAGE_LOADING;
+}
+
+void page_fs::wait_staged_page(file_page_t key)
+{
+	std::unique_lock<std::mutex> stage_guard(stage_lock);
+	stage_cv.wait(stage_guard, [&] {
+		auto it = staged.find(key);
+		return it == staged.end() || stage_state[it->second] != STAGE_LOADING;
+	} );
+}
+
+/* Move a staged page into a frame on a cache miss, the shard of the
+ * page must be locked by the caller, so it cannot be being loaded. */
+bool page_fs::take_staged_page(file_page_t key, char *frame)
+{
+	std::lock_guard<std::mutex> stage_guard(stage_lock);
+	auto it = staged.find(key);
+	if(it == staged.end() || stage_state[it->second] != STAGE_READY)
+		return false;
+
+	int slot = it->second;
+	std::memcpy(frame, stage_buffer + slot * PAGE_SIZE, PAGE_SIZE);
+	staged.erase(it);
+	stage_state[slot] = STAGE_FREE;
+	return true;
+}
+
+/* Walk the chain of free pages of the file into its free-space map,
+ * the pages are read as a sequential scan to keep the hot pages. */
+void page_fs::load_free_map(int file_id)
+{
 	page_fs_header_t &info = file_info[file_id];
+	free_map_t &map = free_map[file_id];
+	map.bits.assign(info.page_num / 64 + 1, 0);
+	map.prev.assign(info.page_num + 1, 0);
+	map.count = 0;
+	map.loaded = true;
+
+	int prev = 0;
+	for(int page_id = info.first_freepage; page_id; )
+	{
+		if(page_id < 1 || page_id > info.page_num || map.test(page_id))
+		{
+			// cut the chain rather than loop or read past the file
+			std::fprintf(stderr, "[Error] Broken free page list of file %d.\n", file_id);
+			if(prev) reinterpret_cast<int*>(read_for_write(file_id, prev))[1] = 0;
+			else info.first_freepage = 0;
+			txn_header[file_id] = true;
+			break;
+		}
+
+		map.bits[page_id / 64] |= uint64_t(1) << (page_id % 64);
+		map.prev[page_id] = prev;
+		++map.count;
+		prev = page_id;
+		page_id = reinterpret_cast<const int*>(read(file_id, page_id, true))[1];
+	}
+}
+
+/* the free page nearest to `near`, or the lowest one if `near` is 0 */
+int page_fs::find_free_page(int file_id, int near)
+{
+	const std::vector<uint64_t> &bits = free_map[file_id].bits;
+	int words = bits.size();
+	if(near <= 0)
+	{
+		for(int i = 0; i != words; ++i)
+		{
+			if(bits[i]) return i * 64 + __builtin_ctzll(bits[i]);
+		}
+
+		return 0;
+	}
+
+	// the first free page from `near` on and the last one before it
+	int w = std::min(near / 64, words - 1);
+	int b = near - w * 64;
+	int after = 0, before = 0;
+	uint64_t high = b < 64 ? bits[w] & (~uint64_t(0) << b) : 0;
+	uint64_t low = b < 64 ? bits[w] & ((uint64_t(1) << b) - 1) : bits[w];
+	if(high) after = w * 64 + __builtin_ctzll(high);
+	if(low) before = w * 64 + 63 - __builtin_clzll(low);
+	for(int d = 1; !after || !before; ++d)
+	{
+		// stop once the words left cannot hold a nearer page
+		bool ahead = w + d < words && !(before && (w + d) * 64 - near > near - before);
+		bool behind = w - d >= 0 && !(after && near - (w - d) * 64 - 63 >= after - near);
+		if(!after && ahead && bits[w + d])
+			after = (w + d) * 64 + __builtin_ctzll(bits[w + d]);
+		if(!before && behind && bits[w - d])
+			before = (w - d) * 64 + 63 - __builtin_clzll(bits[w - d]);
+		if(!ahead && !behind)
+			break;
+	}
+
+	if(!before) return after;
+	if(!after) return before;
+	return after - near <= near - before ? after : before;
+}
+
+/* Unlink a free page from the chain, the page before it in the chain
+ * is modified to skip it, both the page and the header are logged. */
+void page_fs::take_free_page(int file_id, int page_id)
+{
+	free_map_t &map = free_map[file_id];
+	const char *data = pin(file_id, page_id);
+	int next = reinterpret_cast<const int*>(data)[1];
+	unpin(file_id, page_id);
+
+	int prev = map.prev[page_id];
+	if(prev) reinterpret_cast<int*>(read_for_write(file_id, prev))[1] = next;
+	else file_info[file_id].first_freepage = next;
+	if(next) map.prev[next] = prev;
+
+	map.bits[page_id / 64] &= ~(uint64_t(1) << (page_id % 64));
+	--map.count;
+}
+
+int page_fs::allocate(int file_id, int near)
+{
+	assert(fm.is_used(file_id) && !read_only);
+
+	std::lock_guard<std::mutex> guard(alloc_lock[file_id]);
+	page_fs_header_t &info = file_info[file_id];
+	free_map_t &map = free_map[file_id];
+	if(!map.loaded && info.first_freepage)
+		load_free_map(file_id);
+
 	int page_id;
 	if(info.first_freepage == 0)
 	{
+		alignas(PAGE_SIZE) char page_buf[PAGE_SIZE];
 		page_id = ++info.page_num;
-		std::memset(tmp_buffer, 0, PAGE_SIZE);
-		std::fseek(files[file_id], 0, SEEK_END);
-		std::fwrite(tmp_buffer, PAGE_SIZE, 1, files[file_id]);
+		std::memset(page_buf, 0, PAGE_SIZE);
+		write_page_to_file(file_id, page_id, page_buf);
 		read(file_id, page_id);
 	} else {
-		page_id = info.first_freepage;
-		const char *data = read(file_id, info.first_freepage);
-		info.first_freepage = reinterpret_cast<const int*>(data)[1];
+		page_id = find_free_page(file_id, near);
+		assert(page_id && map.test(page_id));
+		take_free_page(file_id, page_id);
+	}
+
+	if(snapshot_count)
+	{
+		std::lock_guard<std::mutex> version_guard(version_lock);
+		allocated[{ file_id, page_id }] = commit_seq + 1;
 	}
 
+	txn_header[file_id] = true;
 	return page_id;
 }
 
 void page_fs::deallocate(int file_id, int page_id)
 {
-	assert(fm.is_used(file_id));
+	assert(fm.is_used(file_id) && !read_only);
 	assert(1 <= page_id && page_id <= file_info[file_id].page_num);
 
+	std::lock_guard<std::mutex> guard(alloc_lock[file_id]);
 	page_fs_header_t &info = file_info[file_id];
 	char *page_buf = read_for_write(file_id, page_id);
 	int data[2] = { PAGE_FREEBLOCK, info.first_freepage };
 	std::memcpy(page_buf, data, sizeof(data));
+
+	free_map_t &map = free_map[file_id];
+	if(map.loaded)
+	{
+		if(map.bits.size() * 64 <= (size_t)info.page_num)
+			map.bits.resize(info.page_num / 64 + 1, 0);
+		if(map.prev.size() <= (size_t)info.page_num)
+			map.prev.resize(info.page_num + 1, 0);
+		map.bits[page_id / 64] |= uint64_t(1) << (page_id % 64);
+		map.prev[page_id] = 0;
+		if(info.first_freepage)
+			map.prev[info.first_freepage] = page_id;
+		++map.count;
+	}
+
 	info.first_freepage = page_id;
+	txn_header[file_id] = true;
 }
 
-char* page_fs::read(int file_id, int page_id, int& index)
+char* page_fs::fetch(int file_id, int page_id, bool for_write, bool pin, bool sequential)
 {
 	assert(fm.is_used(file_id));
 	assert(1 <= page_id && page_id <= file_info[file_id].page_num);
+	assert(!for_write || !read_only);
+	if(mapped[file_id])
+	{
+		// read in place, there is no frame to pin
+		char *page = mapped[file_id]->get_page((off_t)PAGE_SIZE * page_id);
+		if(page && !for_write)
+		{
+			++thread_stats().cache_hits;
+			return page;
+		}
+		std::fprintf(stderr, "[Error] Fail to %s page %d of a read-only file.\n",
+			for_write ? "write" : "read", page_id);
+		return for_write ? nullptr : zero_page;
+	}
 
 	file_page_t key = { file_id, page_id };
-	auto it = page2index.find(key);
-	if(it == page2index.end())
+	cache_shard_t &shard = get_shard(file_id, page_id);
+	std::unique_lock<std::mutex> guard(shard.lock);
+
+	int index;
+	auto it = shard.page2index.find(key);
+	while(it == shard.page2index.end() && is_staged_loading(key))
+	{
+		// being read ahead, the worker may need the shard lock
+		guard.unlock();
+		wait_staged_page(key);
+		guard.lock();
+		it = shard.page2index.find(key);
+	}
+
+	if(it == shard.page2index.end())
 	{
 		// not in cache
-		free_last_cache();
-		index = cm.last();
-		cm.access(index);
-		dirty[index] = 0;
-		page2index[key] = index;
-		assert(!index2page[index].first && !index2page[index].second);
-		index2page[index] = key;
+		++thread_stats().cache_misses;
+		index = free_last_cache(shard);
+		if(index < 0)
+		{
+			std::fprintf(stderr, "[Error] All pages in cache shard are pinned.\n");
+			return nullptr;
+		}
+
+		shard.cm->admit(index, (uint64_t)file_id << 32 | (unsigned)page_id, sequential);
+		shard.dirty[index] = 0;
+		shard.page2index[key] = index;
+		assert(!shard.index2page[index].first && !shard.index2page[index].second);
+		shard.index2page[index] = key;
+		if(!take_staged_page(key, shard.buffer + index * PAGE_SIZE))
+			read_page_from_file(file_id, page_id, shard.buffer + index * PAGE_SIZE);
+	} else {
+		++thread_stats().cache_hits;
+		shard.cm->access(index = it->second);
+		// being read by `prefetch`, the frame is pinned meanwhile
+		while(shard.loading[index])
+			shard.loaded.wait(guard);
+	}
+
+	if(for_write) set_frame_dirty(shard, index);
+	if(pin) ++shard.pin_count[index];
+#ifndef NDEBUG
+	shard.read_evictions[index] = shard.evictions;
+#endif
+	if(!for_write && thread_snapshot != NO_SNAPSHOT && snapshot_count)
+	{
+		// the frame is still pinned, so that `unpin` finds it
+		std::lock_guard<std::mutex> version_guard(version_lock);
+		char *image = find_version(key, thread_snapshot);
+		if(image) return image;
+	}
 
-		std::fseek(files[file_id], (long)PAGE_SIZE * page_id, SEEK_SET);
-		std::fread(buffer + index * PAGE_SIZE, PAGE_SIZE, 1, files[file_id]);
-	} else cm.access(index = it->second);
-	return buffer + index * PAGE_SIZE;
+	return shard.buffer + index * PAGE_SIZE;
 }
 
-void page_fs::mark_dirty(int file_id, int page_id)
+void page_fs::prefetch(int file_id, const int *page_ids, int num, bool sequential)
 {
 	assert(fm.is_used(file_id));
+	if(mapped[file_id])
+	{
+		// adjacent pages are advised together
+		for(int i = 0, j; i < num; i = j)
+		{
+			for(j = i + 1; j != num && page_ids[j] == page_ids[j - 1] + 1; ++j);
+			mapped[file_id]->advise((off_t)PAGE_SIZE * page_ids[i],
+				(size_t)PAGE_SIZE * (j - i), MADV_WILLNEED);
+		}
+
+		return;
+	}
+
+	std::vector<io_request_t> reqs;
+	std::vector<int> pids;
+	for(int i = 0; i != num; ++i)
+	{
+		int page_id = page_ids[i];
+		if(page_id < 1 || page_id > file_info[file_id].page_num)
+			continue;
+
+		file_page_t key = { file_id, page_id };
+		cache_shard_t &shard = get_shard(file_id, page_id);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		if(shard.page2index.count(key))
+			continue;
+		{
+			// it will be taken from the staging area when it is read
+			std::lock_guard<std::mutex> stage_guard(stage_lock);
+			if(staged.count(key))
+				continue;
+		}
+
+		int index = free_last_cache(shard);
+		if(index < 0)
+			continue;
+
+		shard.cm->admit(index, (uint64_t)file_id << 32 | (unsigned)page_id, sequential);
+		shard.dirty[index] = 0;
+		shard.page2index[key] = index;
+		shard.index2page[index] = key;
+		shard.loading[index] = 1;
+		++shard.pin_count[index];
+		reqs.push_back({ fds[file_id], shard.buffer + index * PAGE_SIZE,
+			PAGE_SIZE, (off_t)PAGE_SIZE * page_id, false });
+		pids.push_back(page_id);
+	}
+
+	if(reqs.empty()) return;
+	file_io[file_id]->read_batch(reqs.data(), (int)reqs.size());
+	thread_stats().pages_read += reqs.size();
+
+	for(size_t i = 0; i != reqs.size(); ++i)
+	{
+		cache_shard_t &shard = get_shard(file_id, pids[i]);
+		std::lock_guard<std::mutex> guard(shard.lock);
+		int index = shard.page2index[{ file_id, pids[i] }];
+		if(!reqs[i].ok)
+			std::memset(shard.buffer + index * PAGE_SIZE, 0, PAGE_SIZE);
+		shard.loading[index] = 0;
+		--shard.pin_count[index];
+		shard.loaded.notify_all();
+	}
+}
+
+bool page_fs::set_io_backend(const char *name)
+{
+	if(!io_backend::is_valid(name))
+	{
+		std::fprintf(stderr, "[Error] Unknown I/O backend `%s`.\n", name);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> flush_guard(flush_lock);
+	for(int i = 1; i <= MAX_FILE_ID; ++i)
+	{
+		if(fds[i] >= 0)
+		{
+			std::fprintf(stderr, "[Error] Cannot change I/O backend while files are opened.\n");
+			return false;
+		}
+	}
+
+	delete io;
+	io = io_backend::create(name);
+	return true;
+}
+
+void page_fs::unpin(int file_id, int page_id)
+{
+	if(mapped[file_id])
+		return;
+	cache_shard_t &shard = get_shard(file_id, page_id);
+	std::lock_guard<std::mutex> guard(shard.lock);
+	auto it = shard.page2index.find({ file_id, page_id });
+	if(it == shard.page2index.end())
+		return;  // file has been closed
+	assert(shard.pin_count[it->second] > 0);
+	--shard.pin_count[it->second];
+}
+
+void page_fs::mark_dirty(int file_id, int page_id)
+{
+	assert(fm.is_used(file_id) && !read_only);
 	assert(1 <= page_id && page_id <= file_info[file_id].page_num);
-	dirty[page2index[ file_page_t(file_id, page_id) ]] = 1;
+
+	cache_shard_t &shard = get_shard(file_id, page_id);
+	std::lock_guard<std::mutex> guard(shard.lock);
+	auto it = shard.page2index.find({ file_id, page_id });
+	assert(it != shard.page2index.end());
+	// the pointer read is stale if the frame may have been evicted
+	assert(shard.pin_count[it->second]
+		|| shard.read_evictions[it->second] == shard.evictions);
+	if(it != shard.page2index.end())
+		set_frame_dirty(shard, it->second);
 }
 
-void page_fs::write_page_to_file(int file_id, int page_id, const char* data)
+/* The shard must be locked by the caller, and the frame must not be
+ * modified yet, because its image is logged before the transaction. */
+void page_fs::set_frame_dirty(cache_shard_t &shard, int index)
+{
+	file_page_t info = shard.index2page[index];
+	if(wal[info.first])
+		log_before_image(info, shard.buffer + index * PAGE_SIZE);
+	if(snapshot_count)
+	{
+		std::lock_guard<std::mutex> guard(version_lock);
+		if(!snapshots.empty())
+			save_version(info, shard.buffer + index * PAGE_SIZE);
+	}
+
+	++shard.write_gen[index];
+	shard.dirty_round[index] = flush_round;
+	if(shard.dirty[index])
+		return;
+
+	shard.dirty[index] = 1;
+	{
+		std::lock_guard<std::mutex> guard(dirty_lock[info.first]);
+		dirty_pages[info.first].insert(info.second);
+	}
+
+	if(++dirty_count == capacity * PAGE_FLUSH_DIRTY_HIGH / 100)
+	{
+		std::lock_guard<std::mutex> guard(flusher_lock);
+		flusher_wanted = true;
+		flusher_cv.notify_one();
+	}
+}
+
+/* The shard must be locked by the caller. */
+void page_fs::set_frame_clean(cache_shard_t &shard, int index)
+{
+	if(!shard.dirty[index])
+		return;
+
+	shard.dirty[index] = 0;
+	file_page_t info = shard.index2page[index];
+	{
+		std::lock_guard<std::mutex> guard(dirty_lock[info.first]);
+		dirty_pages[info.first].erase(info.second);
+	}
+
+	--dirty_count;
+}
+
+void page_fs::write_page_to_file(int file_id, int page_id, const char* data, int num)
 {
 	assert(fm.is_used(file_id));
-	assert(1 <= page_id && page_id <= file_info[file_id].page_num);
+	assert(1 <= page_id && page_id + num - 1 <= file_info[file_id].page_num);
+
+	thread_stats().pages_written += num;
+	if(!file_io[file_id]->write(fds[file_id], data, (size_t)PAGE_SIZE * num, (off_t)PAGE_SIZE * page_id))
+		std::fprintf(stderr, "[Error] Fail to write page %d of file %d.\n", page_id, file_id);
+}
 
-	std::fseek(files[file_id], (long)PAGE_SIZE * page_id, SEEK_SET);
-	std::fwrite(data, PAGE_SIZE, 1, files[file_id]);
+void page_fs::read_page_from_file(int file_id, int page_id, char* data)
+{
+	++thread_stats().pages_read;
+	if(!file_io[file_id]->read(fds[file_id], data, PAGE_SIZE, (off_t)PAGE_SIZE * page_id))
+		std::memset(data, 0, PAGE_SIZE);
 }
 
-void page_fs::free_last_cache()
+/* Find the frame to be replaced by the policy, write it back if
+ * it is dirty and return its index (-1 if all are pinned).
+ * The shard must be locked by the caller. */
+int page_fs::free_last_cache(cache_shard_t &shard)
 {
-	int last = cm.last();
-	file_page_t key = index2page[last];
+	int last = shard.cm->victim(shard.pin_count);
+	if(last < 0) return -1;
+
+	file_page_t key = shard.index2page[last];
 	if(key.first != 0)
 	{
-		if(dirty[last])
+		if(shard.dirty[last])
 		{
 			debug_printf("Free cache and writeback: fid = %d, pid = %d\n", key.first, key.second);
-			write_page_to_file(key.first, key.second, buffer + last * PAGE_SIZE);
+			if(wal[key.first] && in_transaction(key))
+				wal[key.first]->force();
+			write_page_to_file(key.first, key.second, shard.buffer + last * PAGE_SIZE);
+			set_frame_clean(shard, last);
 		}
 
-		page2index.erase(page2index.find(key));
-		index2page[last] = { 0, 0 };
+		shard.page2index.erase(shard.page2index.find(key));
+		shard.index2page[last] = { 0, 0 };
+		shard.cm->remove(last);
+		++thread_stats().cache_evictions;
+#ifndef NDEBUG
+		++shard.evictions;
+#endif
 	}
+
+	return last;
 }
 
 page_fs::~page_fs()
 {
+	{
+		std::lock_guard<std::mutex> guard(flusher_lock);
+		flusher_stop = true;
+		flusher_cv.notify_one();
+	}
+
+	flusher.join();
+
+	{
+		std::lock_guard<std::mutex> guard(read_ahead_queue_lock);
+		read_ahead_stop = true;
+		read_ahead_cv.notify_one();
+	}
+
+	read_ahead_worker.join();
+
 	for(int i = 1; i <= MAX_FILE_ID; ++i)
 	{
 		if(fm.is_used(i))
 			close(i);
 	}
+
+	for(cache_shard_t &shard : shards)
+		shard.clear();
+	release_frames(buffer, buffer_size);
+	release_frames(flush_buffer, (size_t)PAGE_WRITEBACK_MAX_RUN * PAGE_SIZE);
+	release_frames(stage_buffer, (size_t)PAGE_READ_AHEAD_STAGE * PAGE_SIZE);
+	delete io;
 }
@@ -2,24 +2,110 @@
 #define __TRIVIALDB_PAGE_FS__
 
 #include <utility>
+#include <algorithm>
 #include <cstdio>
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <unordered_map>
 
 #include "../defs.h"
 #include "fid_manager.h"
 #include "cache_manager.h"
+#include "io_backend.h"
+#include "compressed_io.h"
+#include "write_ahead_log.h"
 
 /* The first page is file info, not counted into `page_num`
  * `first_freepage` indicates the first freepage if it is not zero
- * and there is no freepage if it is zero */
+ * and there is no freepage if it is zero. The metadata of the user
+ * is stored at PAGE_META_OFFSET of the first page. */
 struct page_fs_header_t
 {
 	int page_num;
 	int first_freepage;
 };
 
+/* The page cache is split into PAGE_CACHE_SHARD_NUM shards. A page
+ * (file_id, page_id) always lives in the shard selected by its hash,
+ * and each shard has its own lock, frame table and replacement policy,
+ * so threads touching different shards never contend.
+ *
+ * A frame with non-zero pin count is never evicted: the pointer returned
+ * by `pin` stays valid until the matching `unpin` (page_pin does both).
+ * Only pinned pointers survive other reads. The pointer returned by
+ * `read` is valid until the next page is read or allocated, since a
+ * cache miss may evict its frame, so a caller holding it across other
+ * reads pins the page instead. In debug builds, `mark_dirty` of a page
+ * which is not pinned checks that its shard has evicted no frame since
+ * the page was read.
+ *
+ * Dirty pages of each file are kept in a set sorted by page id, so
+ * `writeback` costs time proportional to the dirty pages and writes
+ * runs of adjacent pages with one `pwrite`. Pages stay cached after
+ * they are written back. A background flusher writes back pages which
+ * have not been modified for a flush interval once more than
+ * PAGE_FLUSH_DIRTY_HIGH percent of the cache is dirty.
+ *
+ * File I/O goes through an io_backend: positional pread/pwrite, or
+ * O_DIRECT without double buffering in the kernel page cache. So every
+ * buffer handed to the backend is aligned to PAGE_SIZE.
+ *
+ * Read-ahead requests are served by a worker thread, which follows a
+ * chain of pages (e.g. B-tree leaves) and reads the pages they refer to
+ * (e.g. overflow pages) in batches, while the scan goes on. The pages
+ * are read into a small staging area rather than the cache, because
+ * evicting a frame behind the back of a caller would invalidate its
+ * pointer returned by `read`. A cache miss takes the page from there.
+ *
+ * With the write-ahead log, the pages modified since the last `commit`
+ * form a transaction of their file. A page may be written to the file
+ * before it commits only after its image before the transaction is in
+ * the log, and `open` recovers the file to the last commit.
+ *
+ * A file may be compressed, then it has its own compressed_io_backend,
+ * and the cache still keeps the pages as they are.
+ *
+ * In read-only mode the files are not written, nor their logs. A file
+ * which is not compressed is mapped by its own mmap_io_backend, and its
+ * pages are read in place, bypassing the cache. Reading ahead and
+ * prefetching only ask the kernel to read the pages.
+ *
+ * A thread may read in a snapshot, which sees the pages as of the last
+ * commit when it began. While snapshots are open, the image of a page
+ * before a transaction first modifies it is kept as a version, which
+ * is valid until that transaction, and a read in a snapshot returns
+ * the oldest version valid after the snapshot, if any, instead of the
+ * page in cache. A page allocated after every open snapshot began is
+ * not reachable from them, so it is not versioned. The versions are
+ * dropped once no open snapshot is older than them.
+ *
+ * Lock order: read_ahead_lock -> flush_lock -> alloc_lock[fid]
+ *             -> shard.lock -> stage_lock, dirty_lock[fid], version_lock. */
 class page_fs
 {
+public:
+	/* Returns the page following `page` in the chain (0 at the end), in
+	 * backward direction if `forward` is not set. Other pages to be read
+	 * along are pushed into `extra`, they are walked again later. */
+	typedef int (*chain_walker_t)(const char *page, bool forward, std::vector<int> &extra);
+
+private:
+	typedef std::pair<int, int> file_page_t;
+
+	struct read_ahead_t
+	{
+		int file_id, page_id, num;
+		bool forward;
+		chain_walker_t walker;
+	};
+
 	struct pair_hash
 	{
 		template<typename T1, typename T2>
@@ -27,28 +113,182 @@ class page_fs
 			return std::hash<T1>{}(p.first) ^ (std::hash<T2>{}(p.second) << 1);
 		}
 	};
+
+	struct cache_shard_t
+	{
+		std::mutex lock;
+		int capacity;
+		char *buffer;
+		char *dirty;
+		int *pin_count;
+		// being read by `prefetch`, `loaded` is notified when it is done
+		char *loading;
+		std::condition_variable loaded;
+		// bumped whenever the frame is modified
+		unsigned *write_gen;
+		// flusher round in which the frame was last modified
+		unsigned *dirty_round;
+#ifndef NDEBUG
+		// the frames evicted, and their number when the frame was read
+		unsigned evictions;
+		unsigned *read_evictions;
+#endif
+		cache_manager *cm;
+		std::unordered_map<file_page_t, int, pair_hash> page2index;
+		// cache is used if `first` != 0
+		file_page_t *index2page;
+
+		cache_shard_t()
+			: capacity(0), buffer(nullptr), dirty(nullptr),
+			  pin_count(nullptr), loading(nullptr), write_gen(nullptr), dirty_round(nullptr),
+			  cm(nullptr), index2page(nullptr)
+		{
+#ifndef NDEBUG
+			evictions = 0;
+			read_evictions = nullptr;
+#endif
+		}
+
+		void init(char *buf, int capacity, const char *policy);
+		void clear();
+	};
+
 private:
-	/* cache */
-	char dirty[PAGE_CACHE_CAPACITY];
-	char buffer[PAGE_CACHE_CAPACITY * PAGE_SIZE];
-	char tmp_buffer[PAGE_SIZE];
-	cache_manager cm;
+	/* cache, `buffer` is mmapped and thus page aligned */
+	char *buffer;
+	size_t buffer_size;
+	int capacity;
+	const char *policy;
+	cache_shard_t shards[PAGE_CACHE_SHARD_NUM];
 
-	typedef std::pair<int, int> file_page_t;
-	std::unordered_map<file_page_t, int, pair_hash> page2index;
+	/* dirty pages */
+	std::mutex dirty_lock[MAX_FILE_ID + 1];
+	std::set<int> dirty_pages[MAX_FILE_ID + 1];
+	std::atomic<int> dirty_count;
 
-	// cache is used if `first` != 0
-	file_page_t index2page[PAGE_CACHE_CAPACITY];
+	/* background flusher, `flush_buffer` holds the pages of one run */
+	char *flush_buffer;
+	std::mutex flush_lock;
+	std::mutex flusher_lock;
+	std::condition_variable flusher_cv;
+	bool flusher_stop, flusher_wanted;
+	std::atomic<unsigned> flush_round;
+	std::thread flusher;
+
+	/* read-ahead worker, `read_ahead_lock` is held while serving */
+	std::mutex read_ahead_lock;
+	std::mutex read_ahead_queue_lock;
+	std::condition_variable read_ahead_cv;
+	std::deque<read_ahead_t> read_ahead_queue;
+	bool read_ahead_stop;
+	std::thread read_ahead_worker;
+
+	/* read-ahead staging area of PAGE_READ_AHEAD_STAGE pages */
+	enum { STAGE_FREE = 0, STAGE_LOADING, STAGE_READY };
+	std::mutex stage_lock;
+	std::condition_variable stage_cv;
+	char *stage_buffer;
+	int stage_next;
+	std::vector<file_page_t> stage_key;
+	std::vector<char> stage_state;
+	std::unordered_map<file_page_t, int, pair_hash> staged;
+
+	/* write-ahead log, `wal[fid]` is null if the file is not logged */
+	bool wal_enabled;
+	write_ahead_log *wal[MAX_FILE_ID + 1];
+	// pages of the running transaction, guarded by `dirty_lock`
+	std::set<int> txn_pages[MAX_FILE_ID + 1];
+	/* the page number as of the last commit, guarded by `dirty_lock`,
+	 * the pages after it are new to the file, so they have no image
+	 * before the transaction to log */
+	int txn_base_page_num[MAX_FILE_ID + 1];
+	// the header or metadata is modified, guarded by `alloc_lock`
+	bool txn_header[MAX_FILE_ID + 1];
 
 	/* file */
+	std::mutex fs_lock;
+	std::mutex alloc_lock[MAX_FILE_ID + 1];
+	io_backend *io;
+	io_backend *file_io[MAX_FILE_ID + 1];  // `io` or the backend of a compressed file
+	bool compress;
+	bool read_only;
+	mmap_io_backend *mapped[MAX_FILE_ID + 1];  // the backend of a mapped file
 	fid_manager fm;
-	FILE *files[MAX_FILE_ID];
-	page_fs_header_t file_info[MAX_FILE_ID];
+	int fds[MAX_FILE_ID + 1];
+	page_fs_header_t file_info[MAX_FILE_ID + 1];
+	char file_meta[MAX_FILE_ID + 1][PAGE_META_SIZE];
+
+	/* Free-space map of each file, guarded by `alloc_lock`. It is built
+	 * from the chain of free pages on the first allocation, so that any
+	 * free page can be taken, not only the first one of the chain. */
+	struct free_map_t
+	{
+		bool loaded;
+		int count;
+		std::vector<uint64_t> bits;  // bit p is set if page p is free
+		std::vector<int> prev;       // the page before p in the chain, 0 if first
+
+		free_map_t() : loaded(false), count(0) {}
+		bool test(int p) const { return (size_t)p < bits.size() * 64 && (bits[p / 64] >> (p % 64) & 1); }
+		void clear() { loaded = false; count = 0; bits.clear(); prev.clear(); }
+	};
+	free_map_t free_map[MAX_FILE_ID + 1];
+
+	/* versions of the pages for the snapshots, guarded by `version_lock` */
+	struct page_version_t
+	{
+		uint64_t until;  // the transaction which modified the page
+		char *image;
+	};
+
+	std::mutex version_lock;
+	uint64_t commit_seq;  // the number of commits, the last transaction
+	std::multiset<uint64_t> snapshots;
+	std::atomic<int> snapshot_count;
+	std::unordered_map<file_page_t, std::vector<page_version_t>, pair_hash> versions;
+	// the transaction in which a page is allocated, of the recent ones
+	std::unordered_map<file_page_t, uint64_t, pair_hash> allocated;
+	static thread_local uint64_t thread_snapshot;
 
 private:
-	char* read(int file_id, int page_id, int& index);
-	void free_last_cache();
-	void write_page_to_file(int file_id, int page_id, const char* data);
+	cache_shard_t& get_shard(int file_id, int page_id)
+	{
+		// consecutive pages of one file are spread over all shards
+		unsigned h = (unsigned)page_id * 2654435761u ^ (unsigned)file_id * 40503u;
+		return shards[h % PAGE_CACHE_SHARD_NUM];
+	}
+
+	char* fetch(int file_id, int page_id, bool for_write, bool pin, bool sequential);
+	bool rebuild(int capacity, const char *policy);
+	int free_last_cache(cache_shard_t &shard);
+	void set_frame_dirty(cache_shard_t &shard, int index);
+	void set_frame_clean(cache_shard_t &shard, int index);
+	int flush_file(int file_id, bool aged_only, int target);
+	void flusher_main();
+	void read_ahead_main();
+	void serve_read_ahead(const read_ahead_t &req);
+	int walk_pages(const read_ahead_t &req, const std::vector<int> &pids,
+		std::vector<int> &next_ids, std::vector<int> &extra);
+	int allocate_stage_slot();
+	bool is_staged_loading(file_page_t key);
+	void wait_staged_page(file_page_t key);
+	bool take_staged_page(file_page_t key, char *frame);
+	void write_page_to_file(int file_id, int page_id, const char* data, int num = 1);
+	void read_page_from_file(int file_id, int page_id, char* data);
+	void write_header(int file_id);
+	void fill_header_page(int file_id, char *page);
+	void log_before_image(file_page_t key, const char *frame);
+	bool in_transaction(file_page_t key);
+	void recover(int file_id, const char *filename);
+	bool commit_file(int file_id);
+	void checkpoint(int file_id);
+	void load_free_map(int file_id);
+	int find_free_page(int file_id, int near);
+	void take_free_page(int file_id, int page_id);
+	void save_version(file_page_t key, const char *frame);
+	char *find_version(file_page_t key, uint64_t snapshot);
+	void prune_versions();
+	void drop_versions(int file_id);
 
 private:
 	page_fs();
@@ -56,29 +296,110 @@ private:
 public:
 	~page_fs();
 
-	int open(const char* filename);
+	/* A new file is compressed if `compressed` is set, or if set by
+	 * `set_compression` when not given, an existing one is opened as
+	 * it is created. */
+	int open(const char* filename) { return open(filename, compress); }
+	int open(const char* filename, bool compressed);
 	void close(int file_id);
+	/* write back all dirty pages and the header of the file,
+	 * the running transaction of the file is committed before */
 	void writeback(int file_id);
 
-	/* allocate a new page */
-	int allocate(int file_id);
+	/* Commit the running transactions of all files: their pages are
+	 * logged and the log of each file is forced once. */
+	void commit();
+
+	/* at most PAGE_META_SIZE bytes, logged along with the pages */
+	void set_meta(int file_id, const void *data, int size);
+	void get_meta(int file_id, void *data, int size);
+
+	/* Allocate a new page, the free page nearest to `near` is taken if
+	 * it is given, or the lowest one, and the file is extended only if
+	 * there is no free page. */
+	int allocate(int file_id, int near = 0);
 	/* free an existed page */
 	void deallocate(int file_id, int page_id);
 
+	/* the number of pages of the file, the free ones included */
+	int get_page_num(int file_id) { return file_info[file_id].page_num; }
+
 	void mark_dirty(int file_id, int page_id);
+	int get_dirty_count() { return dirty_count; }
+
+	/* Resize the cache to (about) `capacity` pages. Dirty pages are
+	 * written back and the cache is emptied, it fails if any page
+	 * is pinned. */
+	bool resize(int capacity);
+	int get_capacity() { return capacity; }
 
-	char* read(int file_id, int page_id) {
-		int index;
-		return read(file_id, page_id, index);
+	/* Change the replacement policy ("lru" or "2q"), the cache
+	 * is emptied as `resize` does. */
+	bool set_policy(const char *name);
+	const char *get_policy() { return policy; }
+	static bool is_valid_policy(const char *name);
+
+	/* `sequential` hints that the page is read by a sequential scan,
+	 * and the policy may keep it from flushing out the hot pages. */
+	char* read(int file_id, int page_id, bool sequential = false) {
+		return fetch(file_id, page_id, false, false, sequential);
 	}
 
 	char* read_for_write(int file_id, int page_id) {
-		int index;
-		char *buf = read(file_id, page_id, index);
-		dirty[index] = 1;
-		return buf;
+		return fetch(file_id, page_id, true, false, false);
+	}
+
+	/* Read a page and keep it in cache until `unpin` is called,
+	 * pins are counted, so a page can be pinned more than once. */
+	char* pin(int file_id, int page_id, bool for_write = false) {
+		return fetch(file_id, page_id, for_write, true, false);
 	}
 
+	void unpin(int file_id, int page_id);
+
+	/* Read the pages not in cache with one batch of I/O, so that
+	 * they are kept in flight together. */
+	void prefetch(int file_id, const int *page_ids, int num, bool sequential = false);
+
+	/* Read `num` pages of the chain starting at `page_id` in background,
+	 * dropped if too many requests are pending. */
+	void read_ahead(int file_id, int page_id, int num, bool forward, chain_walker_t walker);
+	/* the number of pages a scan should read ahead */
+	int get_read_ahead_window()
+	{
+		return std::min(PAGE_READ_AHEAD_PAGES, capacity / 16);
+	}
+
+	enum : uint64_t { NO_SNAPSHOT = ~0ull };
+
+	/* Open a snapshot of the pages as of the last commit. The pages
+	 * modified by the running transaction before are seen as they are,
+	 * so it is opened between the transactions of a writer. */
+	uint64_t begin_snapshot();
+	void end_snapshot(uint64_t snapshot);
+	// NO_SNAPSHOT if the reads of the thread are not in a snapshot
+	static uint64_t get_thread_snapshot() { return thread_snapshot; }
+	static void set_thread_snapshot(uint64_t snapshot) { thread_snapshot = snapshot; }
+	// the number of page versions kept
+	size_t get_version_num();
+
+	/* "pread" or "direct", only when no file is opened */
+	bool set_io_backend(const char *name);
+	const char *get_io_backend() { return io->name(); }
+
+	/* compress the new files or not, see compressed_io_backend */
+	void set_compression(bool enabled) { compress = enabled; }
+	bool get_compression() { return compress; }
+	bool is_compressed(int file_id) { return file_io[file_id] != io && !mapped[file_id]; }
+
+	/* enable or disable the write-ahead log, only when no file is opened */
+	bool set_wal(bool enabled);
+	bool get_wal() { return wal_enabled; }
+
+	/* open the files read-only and map them, only when no file is opened */
+	bool set_read_only(bool enabled);
+	bool is_read_only() { return read_only; }
+
 public:
 	static page_fs* get_instance()
 	{
@@ -87,4 +408,52 @@ public:
 	}
 };
 
+/* The reads of the thread are in a snapshot of its own until the guard
+ * is destroyed, or in `snapshot` if given, which is kept open by the
+ * owner, e.g. by the workers of a parallel scan. */
+class snapshot_guard
+{
+	uint64_t snapshot, saved;
+	bool owned;
+public:
+	snapshot_guard() : saved(page_fs::get_thread_snapshot()), owned(true)
+	{
+		snapshot = page_fs::get_instance()->begin_snapshot();
+		page_fs::set_thread_snapshot(snapshot);
+	}
+
+	explicit snapshot_guard(uint64_t snapshot)
+		: snapshot(snapshot), saved(page_fs::get_thread_snapshot()), owned(false)
+	{
+		page_fs::set_thread_snapshot(snapshot);
+	}
+
+	~snapshot_guard()
+	{
+		page_fs::set_thread_snapshot(saved);
+		if(owned) page_fs::get_instance()->end_snapshot(snapshot);
+	}
+
+	snapshot_guard(const snapshot_guard&) = delete;
+	snapshot_guard& operator = (const snapshot_guard&) = delete;
+};
+
+/* The reads of the thread see the pages as they are until the guard is
+ * destroyed, e.g. those of a statement modifying the rows it scans in a
+ * snapshot, which have to see its own writes. */
+class snapshot_pause
+{
+	uint64_t saved;
+public:
+	snapshot_pause() : saved(page_fs::get_thread_snapshot())
+	{
+		page_fs::set_thread_snapshot(page_fs::NO_SNAPSHOT);
+	}
+
+	~snapshot_pause() { page_fs::set_thread_snapshot(saved); }
+
+	snapshot_pause(const snapshot_pause&) = delete;
+	snapshot_pause& operator = (const snapshot_pause&) = delete;
+};
+
 #endif
@@ -0,0 +1,129 @@
+#ifndef __TRIVIALDB_TWOQ_CACHE_MANAGER__
+#define __TRIVIALDB_TWOQ_CACHE_MANAGER__
+
+#include <vector>
+#include <unordered_map>
+#include "cache_manager.h"
+
+/* The 2Q replacement policy (Johnson and Shasha, VLDB'94).
+ *
+ * A page read for the first time goes to the FIFO `A1in`, and hits inside
+ * A1in are regarded as correlated references and ignored. The keys of pages
+ * evicted from A1in are remembered in the ghost queue `A1out`, and a page
+ * found in A1out when it is read again is hot enough to enter the LRU list
+ * `Am`. Pages read by sequential scans are never remembered in A1out, so
+ * a full table scan only recycles the frames of A1in. */
+class twoq_cache_manager : public cache_manager
+{
+	enum { LIST_A1IN = 0, LIST_AM = 1 };
+	enum { FRAME_FREE = 0, FRAME_A1IN, FRAME_AM };
+
+	frame_lists lists;
+	int capacity, kin, kout, in_size;
+	std::vector<int> free_frames;
+	std::vector<char> where, sequential;
+	std::vector<uint64_t> frame_key;
+
+	// ghost queue: ring of (key, serial number)
+	std::vector<std::pair<uint64_t, uint64_t>> ghost_ring;
+	std::unordered_map<uint64_t, uint64_t> ghost;
+	uint64_t ghost_serial;
+
+	void remember(uint64_t key)
+	{
+		auto &slot = ghost_ring[ghost_serial % kout];
+		if(ghost_serial >= (uint64_t)kout)
+		{
+			auto it = ghost.find(slot.first);
+			if(it != ghost.end() && it->second == slot.second)
+				ghost.erase(it);
+		}
+
+		slot = { key, ghost_serial };
+		ghost[key] = ghost_serial++;
+	}
+
+	bool forget(uint64_t key)
+	{
+		auto it = ghost.find(key);
+		if(it == ghost.end()) return false;
+		ghost.erase(it);
+		return true;
+	}
+
+public:
+	twoq_cache_manager(int capacity)
+		: lists(capacity, 2), capacity(capacity),
+		  kin(capacity / 4 ? capacity / 4 : 1),
+		  kout(capacity / 2 ? capacity / 2 : 1),
+		  in_size(0), where(capacity, FRAME_FREE),
+		  sequential(capacity, 0), frame_key(capacity, 0),
+		  ghost_ring(kout), ghost_serial(0)
+	{
+		for(int i = capacity - 1; i >= 0; --i)
+			free_frames.push_back(i);
+	}
+
+	void access(int id) override
+	{
+		if(where[id] == FRAME_AM)
+		{
+			lists.unlink(id);
+			lists.push_front(LIST_AM, id);
+		}
+	}
+
+	void admit(int id, uint64_t key, bool seq) override
+	{
+		remove(id);
+		take_free_frame(free_frames, id);
+
+		frame_key[id] = key;
+		sequential[id] = seq;
+		if(forget(key) && !seq)
+		{
+			where[id] = FRAME_AM;
+			lists.push_front(LIST_AM, id);
+		} else {
+			where[id] = FRAME_A1IN;
+			lists.push_front(LIST_A1IN, id);
+			++in_size;
+		}
+	}
+
+	void remove(int id) override
+	{
+		if(where[id] == FRAME_FREE)
+			return;
+		if(where[id] == FRAME_A1IN)
+		{
+			--in_size;
+			if(!sequential[id])
+				remember(frame_key[id]);
+		}
+
+		lists.unlink(id);
+		where[id] = FRAME_FREE;
+		free_frames.push_back(id);
+	}
+
+	int victim(const int *pin_count) override
+	{
+		if(!free_frames.empty())
+			return free_frames.back();
+
+		int id = -1;
+		if(in_size > kin)
+			id = lists.last_unpinned(LIST_A1IN, pin_count);
+		if(id == -1)
+			id = lists.last_unpinned(LIST_AM, pin_count);
+		if(id == -1)
+			id = lists.last_unpinned(LIST_A1IN, pin_count);
+		return id;
+	}
+
+	int size() const override { return capacity; }
+	const char *name() const override { return "2q"; }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <set>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "write_ahead_log.h"
+#include "../defs.h"
+
+static size_t record_size(int type)
+{
+	size_t size = sizeof(write_ahead_log::record_header_t);
+	if(type != write_ahead_log::RECORD_COMMIT)
+		size += PAGE_SIZE;
+	return size;
+}
+
+static bool read_all(int fd, char *data, size_t size, off_t offset)
+{
+	while(size)
+	{
+		ssize_t ret = pread(fd, data, size, offset);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return false;
+		data += ret;
+		offset += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+/* FNV-1a of the record with `checksum` cleared */
+uint32_t write_ahead_log::checksum(const record_header_t &header, const char *page)
+{
+	record_header_t h = header;
+	h.checksum = 0;
+	uint32_t sum = 2166136261u;
+	auto feed = [&](const char *data, size_t size) {
+		for(size_t i = 0; i != size; ++i)
+			sum = (sum ^ (unsigned char)data[i]) * 16777619u;
+	};
+
+	feed((const char*)&h, sizeof(h));
+	if(page) feed(page, PAGE_SIZE);
+	return sum;
+}
+
+bool write_ahead_log::open(const char *filename)
+{
+	close();
+	this->filename = filename;
+	fd = ::open(filename, O_RDWR | O_CREAT, 0644);
+	if(fd < 0)
+	{
+		std::fprintf(stderr, "[Error] Fail to open log `%s`.\n", filename);
+		return false;
+	}
+
+	off_t size = lseek(fd, 0, SEEK_END);
+	end_lsn = written_lsn = durable_lsn = size < 0 ? 0 : size;
+	txn = 0;
+	return true;
+}
+
+void write_ahead_log::close()
+{
+	if(fd < 0) return;
+	std::lock_guard<std::mutex> guard(lock);
+	write_buffer();
+	::close(fd);
+	fd = -1;
+}
+
+uint64_t write_ahead_log::append(int type, int page_id, const char *page)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	record_header_t header { (uint32_t)type, page_id, txn, 0 };
+	header.checksum = checksum(header, page);
+
+	const char *h = (const char*)&header;
+	buffer.insert(buffer.end(), h, h + sizeof(header));
+	if(page) buffer.insert(buffer.end(), page, page + PAGE_SIZE);
+
+	uint64_t lsn = end_lsn;
+	end_lsn += record_size(type);
+	if(buffer.size() >= PAGE_WAL_BUFFER_SIZE)
+		write_buffer();
+	return lsn;
+}
+
+/* `lock` must be held by the caller. */
+bool write_ahead_log::write_buffer()
+{
+	const char *data = buffer.data();
+	size_t size = buffer.size();
+	off_t offset = written_lsn;
+	while(size)
+	{
+		ssize_t ret = pwrite(fd, data, size, offset);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+		{
+			std::fprintf(stderr, "[Error] Fail to write the log.\n");
+			return false;
+		}
+
+		data += ret;
+		offset += ret;
+		size -= ret;
+	}
+
+	written_lsn += buffer.size();
+	buffer.clear();
+	return true;
+}
+
+bool write_ahead_log::force(uint64_t lsn)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if(durable_lsn >= std::min(lsn, end_lsn))
+		return true;
+	if(!write_buffer())
+		return false;
+	if(fdatasync(fd) != 0)
+	{
+		std::fprintf(stderr, "[Error] Fail to sync the log.\n");
+		return false;
+	}
+
+	durable_lsn = written_lsn;
+	return true;
+}
+
+bool write_ahead_log::commit()
+{
+	append(RECORD_COMMIT, 0, nullptr);
+	bool ok = force();
+	std::lock_guard<std::mutex> guard(lock);
+	++txn;
+	return ok;
+}
+
+bool write_ahead_log::truncate()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	buffer.clear();
+	end_lsn = written_lsn = durable_lsn = 0;
+	return ftruncate(fd, 0) == 0 && fdatasync(fd) == 0;
+}
+
+std::pair<int, int> write_ahead_log::recover(apply_t apply)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	alignas(PAGE_SIZE) char page[PAGE_SIZE];
+	record_header_t header;
+
+	// find the end of the last committed transaction
+	uint64_t lsn = 0, committed_end = 0;
+	auto next_record = [&]() -> bool {
+		if(!read_all(fd, (char*)&header, sizeof(header), lsn))
+			return false;
+		if(header.type < RECORD_UNDO || header.type > RECORD_COMMIT)
+			return false;
+		bool has_page = header.type != RECORD_COMMIT;
+		if(has_page && !read_all(fd, page, PAGE_SIZE, lsn + sizeof(header)))
+			return false;
+		return checksum(header, has_page ? page : nullptr) == header.checksum;
+	};
+
+	for(; next_record(); lsn += record_size(header.type))
+	{
+		if(header.type == RECORD_COMMIT)
+			committed_end = lsn + record_size(header.type);
+	}
+
+	uint64_t valid_end = lsn;
+	int redone = 0, undone = 0;
+	std::set<int> undone_pages;
+	for(lsn = 0; lsn < valid_end && next_record(); lsn += record_size(header.type))
+	{
+		if(lsn < committed_end)
+		{
+			if(header.type == RECORD_REDO || header.type == RECORD_HEADER)
+			{
+				apply(header.page_id, page);
+				++redone;
+			}
+		} else if(header.type == RECORD_UNDO) {
+			// the first image is the one before the transaction
+			if(undone_pages.insert(header.page_id).second)
+			{
+				apply(header.page_id, page);
+				++undone;
+			}
+		}
+	}
+
+	return { redone, undone };
+}
@@ -0,0 +1,81 @@
+#ifndef __TRIVIALDB_WRITE_AHEAD_LOG__
+#define __TRIVIALDB_WRITE_AHEAD_LOG__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+
+/* The log of one page file, made of full page images. A transaction
+ * logs the image of a page before it is first modified (undo) and the
+ * images of all its pages and the header page when it commits (redo),
+ * followed by a commit record. The log is forced at commit, and before
+ * a page of the running transaction is written to the file.
+ *
+ * A transaction is one statement, so the rows of a statement share one
+ * force, but the commits of different sessions are not grouped: the
+ * statements of the server run one at a time, and each forces the logs
+ * of the files it modified.
+ *
+ * A page the transaction appended to the file is not logged before it
+ * is modified, as the file did not reach it before the transaction.
+ *
+ * A record is addressed by its offset in the log (LSN). The log is
+ * truncated after a checkpoint has written all pages to the file, which
+ * is only done between transactions, so the log of one transaction is
+ * about twice the size of the existing pages it modifies, plus the
+ * pages it appends. */
+class write_ahead_log
+{
+public:
+	enum { RECORD_UNDO = 1, RECORD_REDO, RECORD_HEADER, RECORD_COMMIT };
+
+	struct record_header_t
+	{
+		uint32_t type;
+		int32_t page_id;
+		uint32_t txn;
+		uint32_t checksum;
+	};
+
+	/* called with the page id and the image which must be written */
+	typedef std::function<void (int, const char *)> apply_t;
+
+private:
+	std::mutex lock;
+	std::string filename;
+	int fd;
+	uint32_t txn;
+	uint64_t end_lsn, written_lsn, durable_lsn;
+	std::vector<char> buffer;
+
+	bool write_buffer();
+	static uint32_t checksum(const record_header_t &header, const char *page);
+
+public:
+	write_ahead_log() : fd(-1), txn(0), end_lsn(0), written_lsn(0), durable_lsn(0) {}
+	~write_ahead_log() { close(); }
+
+	bool open(const char *filename);
+	void close();
+
+	/* Append a record and return its LSN, `page` is PAGE_SIZE bytes
+	 * unless it is a commit record. */
+	uint64_t append(int type, int page_id, const char *page);
+	/* make the log durable up to `lsn` (the whole log by default) */
+	bool force(uint64_t lsn = UINT64_MAX);
+	/* append the commit record and force the log, returns false if
+	 * the transaction is not durable */
+	bool commit();
+	bool truncate();
+	uint64_t size() { return end_lsn; }
+	const char *get_filename() { return filename.c_str(); }
+
+	/* Redo the committed transactions and undo the last one if it has
+	 * not committed, a torn record ends the log. Returns the number of
+	 * pages written by `apply` (redo, undo). */
+	std::pair<int, int> recover(apply_t apply);
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "bloom_filter.h"
+#include "../page/bloom_page.h"
+#include "key_hash.h"
+#include "../utils/exec_stats.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+static const int BLOCK_BITS = bloom_bits_page::block_size() * 8;
+
+bloom_filter::bloom_filter(pager *pg, int root_pid, int type, int size, int bits_per_key)
+	: pg(pg), root_pid(root_pid), type(type), size(size), capacity(0), count(0)
+{
+	if(root_pid == 0)
+	{
+		this->bits_per_key = bits_per_key;
+		this->root_pid = pg->new_page();
+		bloom_page { pg->read_for_write(this->root_pid), pg }.init(bits_per_key);
+		clear(INDEX_BLOOM_MIN_KEYS);
+	} else {
+		bloom_page page { pg->read(root_pid), pg };
+		assert(page.magic() == PAGE_BLOOM);
+		this->bits_per_key = page.bits_per_key();
+		capacity = page.capacity();
+		count = page.count();
+		pids.assign(page.pages(), page.pages() + page.page_num());
+	}
+
+	// about ln 2 bits of a key are set per bit it takes
+	hash_num = std::max(1, std::min(16, (this->bits_per_key * 69 + 50) / 100));
+}
+
+void bloom_filter::save()
+{
+	bloom_page page { pg->read_for_write(root_pid), pg };
+	page.page_num_ref() = pids.size();
+	page.capacity_ref() = capacity;
+	page.count_ref() = count;
+	std::copy(pids.begin(), pids.end(), page.pages());
+}
+
+bool bloom_filter::is_full()
+{
+	return count >= capacity && (int)pids.size() < bloom_page::max_pages();
+}
+
+/* The block of a key is taken by the high half of its hash, and the
+ * bits in the block from the low half, a step apart each, the step
+ * mixed from the whole hash. */
+static uint32_t bit_step(uint64_t h)
+{
+	return (uint32_t)((h * 0x9e3779b97f4a7c15ull) >> 40) | 1;
+}
+
+uint64_t *bloom_filter::block_of(uint64_t h, bool for_write)
+{
+	int block_num = pids.size() * bloom_bits_page::block_num();
+	int block = ((h >> 32) * block_num) >> 32;
+	int pid = pids[block / bloom_bits_page::block_num()];
+	bloom_bits_page page { for_write ? pg->read_for_write(pid) : pg->read(pid), pg };
+	return page.block(block % bloom_bits_page::block_num());
+}
+
+void bloom_filter::add(const char *key)
+{
+	uint64_t h = hash_index_key(key, type, size);
+	uint64_t *words = block_of(h, true);
+	uint32_t bit = (uint32_t)h, step = bit_step(h);
+	for(int i = 0; i != hash_num; ++i, bit += step)
+		words[bit % BLOCK_BITS / 64] |= 1ull << (bit % 64);
+
+	++count;
+	bloom_page { pg->read_for_write(root_pid), pg }.count_ref() = count;
+}
+
+bool bloom_filter::may_contain(const char *key)
+{
+	uint64_t h = hash_index_key(key, type, size);
+	const uint64_t *words = block_of(h, false);
+	uint32_t bit = (uint32_t)h, step = bit_step(h);
+	++thread_stats().bloom_probes;
+	for(int i = 0; i != hash_num; ++i, bit += step)
+	{
+		if(!(words[bit % BLOCK_BITS / 64] >> (bit % 64) & 1))
+		{
+			++thread_stats().bloom_negatives;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void bloom_filter::clear(int keys)
+{
+	for(int pid : pids)
+		pg->free_page(pid);
+
+	int64_t blocks = ((int64_t)std::max(keys, INDEX_BLOOM_MIN_KEYS) * bits_per_key
+		+ BLOCK_BITS - 1) / BLOCK_BITS;
+	int64_t page_num = (blocks + bloom_bits_page::block_num() - 1) / bloom_bits_page::block_num();
+	page_num = std::min<int64_t>(page_num, bloom_page::max_pages());
+
+	pids.clear();
+	for(int i = 0; i != page_num; ++i)
+	{
+		int pid = pg->new_page(pids.empty() ? root_pid : pids.back());
+		bloom_bits_page { pg->read_for_write(pid), pg }.init();
+		pids.push_back(pid);
+	}
+
+	capacity = page_num * bloom_bits_page::block_num() * BLOCK_BITS / bits_per_key;
+	count = 0;
+	save();
+}
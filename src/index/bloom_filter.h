@@ -0,0 +1,45 @@
+#ifndef __TRIVIALDB_BLOOM_FILTER__
+#define __TRIVIALDB_BLOOM_FILTER__
+
+#include <stdint.h>
+#include <vector>
+#include "../page/pager.h"
+
+/* A blocked bloom filter of the keys of an index, kept in pages of the
+ * file of the index, so it is logged and recovered with it. The bits of
+ * a key are all in one block of 64 bytes, a lookup reads one page and
+ * one cache line. A key is never removed, the keys erased are only
+ * dropped when the filter is cleared. `may_contain` is false only for a
+ * key never added since. */
+class bloom_filter
+{
+	pager *pg;
+	int root_pid, type, size;
+	int bits_per_key, hash_num;
+	int capacity, count;
+	std::vector<int> pids;
+
+	// the words of the block of a key of hash `h`
+	uint64_t *block_of(uint64_t h, bool for_write);
+	void save();
+
+public:
+	/* Open the filter at `root_pid`, or create a new empty one with
+	 * `bits_per_key` bits per key if it is 0. The keys are of `size`
+	 * bytes and of the column type `type`. */
+	bloom_filter(pager *pg, int root_pid, int type, int size, int bits_per_key = 0);
+
+	int get_root_pid() { return root_pid; }
+	int get_bits_per_key() { return bits_per_key; }
+	int get_count() { return count; }
+	/* whether more keys than it is sized for have been added, while
+	 * it can still grow */
+	bool is_full();
+
+	void add(const char *key);
+	bool may_contain(const char *key);
+	// remove all the keys, the bits are sized for `keys` keys
+	void clear(int keys);
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "hash_index.h"
+#include "key_hash.h"
+#include "../utils/comparer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+hash_index::hash_index(pager *pg, int root_pid, int type, int size)
+	: pg(pg), root_pid(root_pid), type(type), size(size)
+{
+	// rounded up to keep the hashes and rids aligned
+	entry_size = sizeof(uint32_t) + sizeof(int) + (size + 3) / 4 * 4;
+	per_page = hash_bucket_page::capacity(entry_size);
+	entry_buf.assign(entry_size, 0);
+	switch(type)
+	{
+		case COL_TYPE_INT:
+		case COL_TYPE_DATE:
+			compare = integer_bin_comparer;
+			break;
+		case COL_TYPE_FLOAT:
+			compare = float_bin_comparer;
+			break;
+		default:
+			assert(type == COL_TYPE_VARCHAR);
+			compare = string_comparer;
+			break;
+	}
+
+	if(root_pid == 0)
+	{
+		level = split = count = 0;
+		this->root_pid = pg->new_page();
+		hash_dir_page { pg->read_for_write(this->root_pid), pg }.init();
+		dir_pids.push_back(this->root_pid);
+		int pid = pg->new_page(this->root_pid);
+		hash_bucket_page { pg->read_for_write(pid), pg }.init();
+		add_bucket(pid);
+		save();
+	} else {
+		hash_dir_page root { pg->read(root_pid), pg };
+		assert(root.magic() == PAGE_HASH_DIR);
+		level = root.level();
+		split = root.split();
+		count = root.count();
+		for(int pid = root_pid; pid; )
+		{
+			hash_dir_page page { pg->read(pid), pg };
+			dir_pids.push_back(pid);
+			buckets.insert(buckets.end(), page.pids(), page.pids() + page.size());
+			pid = page.next();
+		}
+	}
+}
+
+uint32_t hash_index::hash(const char *key)
+{
+	return (uint32_t)hash_index_key(key, type, size);
+}
+
+int hash_index::bucket_of(uint32_t h)
+{
+	uint32_t mask = (1u << level) - 1;
+	int bucket = h & mask;
+	if(bucket < split)
+		bucket = h & (mask << 1 | 1);
+	return bucket;
+}
+
+bool hash_index::match(const char *entry, uint32_t h, const char *key)
+{
+	return *(const uint32_t*)entry == h
+		&& compare(entry + sizeof(uint32_t) + sizeof(int), key) == 0;
+}
+
+void hash_index::save()
+{
+	hash_dir_page root { pg->read_for_write(root_pid), pg };
+	root.level_ref() = level;
+	root.split_ref() = split;
+	root.count_ref() = count;
+}
+
+void hash_index::add_bucket(int pid)
+{
+	int id = buckets.size();
+	if(id / hash_dir_page::max_size() == (int)dir_pids.size())
+	{
+		int dir_pid = pg->new_page(dir_pids.back());
+		hash_dir_page { pg->read_for_write(dir_pid), pg }.init();
+		hash_dir_page { pg->read_for_write(dir_pids.back()), pg }.next_ref() = dir_pid;
+		dir_pids.push_back(dir_pid);
+	}
+
+	hash_dir_page page { pg->read_for_write(dir_pids.back()), pg };
+	page.pids()[id % hash_dir_page::max_size()] = pid;
+	page.size_ref() = id % hash_dir_page::max_size() + 1;
+	buckets.push_back(pid);
+}
+
+// the first entry of the page with a hash not less than `h`
+int hash_index::lower_bound(hash_bucket_page &page, uint32_t h)
+{
+	int lo = 0, hi = page.size();
+	while(lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if(*(const uint32_t*)page.entry(mid, entry_size) < h)
+			lo = mid + 1;
+		else hi = mid;
+	}
+
+	return lo;
+}
+
+// into the first page of the bucket with room, a new one is chained if none
+void hash_index::append(int bucket, const char *entry)
+{
+	int pid = buckets[bucket];
+	for(;;)
+	{
+		hash_bucket_page page { pg->read(pid), pg };
+		if(page.size() < per_page)
+			break;
+		int next = page.next();
+		if(!next)
+		{
+			next = pg->new_page(pid);
+			hash_bucket_page { pg->read_for_write(next), pg }.init();
+			hash_bucket_page { pg->read_for_write(pid), pg }.next_ref() = next;
+			pid = next;
+			break;
+		}
+
+		pid = next;
+	}
+
+	hash_bucket_page page { pg->read_for_write(pid), pg };
+	int pos = lower_bound(page, *(const uint32_t*)entry);
+	char *dest = page.entry(pos, entry_size);
+	std::memmove(dest + entry_size, dest, (page.size() - pos) * entry_size);
+	std::memcpy(dest, entry, entry_size);
+	++page.size_ref();
+}
+
+// into the empty bucket `bucket`, the pages are filled one by one
+void hash_index::fill(int bucket, std::vector<const char*> &entries)
+{
+	std::stable_sort(entries.begin(), entries.end(), [](const char *x, const char *y) {
+		return *(const uint32_t*)x < *(const uint32_t*)y;
+	} );
+
+	int pid = buckets[bucket];
+	size_t i = 0;
+	for(;;)
+	{
+		hash_bucket_page page { pg->read_for_write(pid), pg };
+		for(; i != entries.size() && page.size() < per_page; ++i)
+		{
+			std::memcpy(page.entry(page.size(), entry_size), entries[i], entry_size);
+			++page.size_ref();
+		}
+
+		if(i == entries.size())
+			break;
+		int next = pg->new_page(pid);
+		hash_bucket_page { pg->read_for_write(next), pg }.init();
+		hash_bucket_page { pg->read_for_write(pid), pg }.next_ref() = next;
+		pid = next;
+	}
+}
+
+/* The entries of bucket `split` are parted between it and the new bucket
+ * after the last one by the next bit of their hashes. */
+void hash_index::split_bucket()
+{
+	int from = split;
+	std::vector<char> entries;
+	std::vector<int> overflow;
+	for(int pid = buckets[from]; pid; )
+	{
+		hash_bucket_page page { pg->read(pid), pg };
+		entries.insert(entries.end(), page.entry(0, entry_size),
+			page.entry(page.size(), entry_size));
+		if(pid != buckets[from])
+			overflow.push_back(pid);
+		pid = page.next();
+	}
+
+	for(int pid : overflow)
+		pg->free_page(pid);
+	hash_bucket_page { pg->read_for_write(buckets[from]), pg }.init();
+
+	assert((int)buckets.size() == (1 << level) + split);
+	int pid = pg->new_page(buckets.back());
+	hash_bucket_page { pg->read_for_write(pid), pg }.init();
+	add_bucket(pid);
+
+	std::vector<const char*> kept, moved;
+	for(size_t i = 0; i < entries.size(); i += entry_size)
+	{
+		const char *entry = &entries[i];
+		if((*(const uint32_t*)entry >> level) & 1)
+			moved.push_back(entry);
+		else kept.push_back(entry);
+	}
+
+	if(++split == (1 << level))
+	{
+		++level;
+		split = 0;
+	}
+
+	fill(from, kept);
+	fill(buckets.size() - 1, moved);
+}
+
+void hash_index::insert(const char *key, int rid)
+{
+	if(!key) return;
+	uint32_t h = hash(key);
+	char *entry = entry_buf.data();
+	*(uint32_t*)entry = h;
+	*(int*)(entry + sizeof(uint32_t)) = rid;
+	std::memcpy(entry + sizeof(uint32_t) + sizeof(int), key, size);
+	append(bucket_of(h), entry);
+
+	++count;
+	if((int64_t)count * 100 > (int64_t)buckets.size() * per_page * HASH_INDEX_MAX_LOAD)
+		split_bucket();
+	save();
+}
+
+bool hash_index::erase(const char *key, int rid)
+{
+	if(!key) return true;
+	uint32_t h = hash(key);
+	int prev = 0;
+	for(int pid = buckets[bucket_of(h)]; pid; )
+	{
+		hash_bucket_page page { pg->read(pid), pg };
+		int pos = lower_bound(page, h);
+		for(; pos != page.size() && *(const uint32_t*)page.entry(pos, entry_size) == h; ++pos)
+		{
+			const char *entry = page.entry(pos, entry_size);
+			if(*(const int*)(entry + sizeof(uint32_t)) == rid && match(entry, h, key))
+				break;
+		}
+
+		if(pos == page.size() || *(const uint32_t*)page.entry(pos, entry_size) != h)
+		{
+			prev = pid;
+			pid = page.next();
+			continue;
+		}
+
+		page = hash_bucket_page { pg->read_for_write(pid), pg };
+		char *dest = page.entry(pos, entry_size);
+		std::memmove(dest, dest + entry_size, (page.size() - pos - 1) * entry_size);
+		--page.size_ref();
+		if(page.size() == 0 && prev)
+		{
+			// an empty overflow page is unchained
+			int next = page.next();
+			hash_bucket_page { pg->read_for_write(prev), pg }.next_ref() = next;
+			pg->free_page(pid);
+		}
+
+		--count;
+		save();
+		return true;
+	}
+
+	return false;
+}
+
+void hash_index::find(const char *key, std::vector<int> &rids)
+{
+	rids.clear();
+	uint32_t h = hash(key);
+	for(int pid = buckets[bucket_of(h)]; pid; )
+	{
+		hash_bucket_page page { pg->read(pid), pg };
+		int pos = lower_bound(page, h);
+		for(; pos != page.size(); ++pos)
+		{
+			const char *entry = page.entry(pos, entry_size);
+			if(*(const uint32_t*)entry != h)
+				break;
+			if(match(entry, h, key))
+				rids.push_back(*(const int*)(entry + sizeof(uint32_t)));
+		}
+
+		pid = page.next();
+	}
+}
+
+bool hash_index::contains(const char *key)
+{
+	uint32_t h = hash(key);
+	for(int pid = buckets[bucket_of(h)]; pid; )
+	{
+		hash_bucket_page page { pg->read(pid), pg };
+		int pos = lower_bound(page, h);
+		for(; pos != page.size(); ++pos)
+		{
+			const char *entry = page.entry(pos, entry_size);
+			if(*(const uint32_t*)entry != h)
+				break;
+			if(match(entry, h, key))
+				return true;
+		}
+
+		pid = page.next();
+	}
+
+	return false;
+}
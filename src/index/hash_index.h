@@ -0,0 +1,59 @@
+#ifndef __TRIVIALDB_HASH_INDEX__
+#define __TRIVIALDB_HASH_INDEX__
+
+#include <stdint.h>
+#include <vector>
+#include "../page/pager.h"
+#include "../page/hash_page.h"
+
+/* An index of the keys by linear hashing, for the lookups of equal keys
+ * only. The buckets are numbered from 0, there are 2^level of them and
+ * `split` more, the low `level` bits of the hash of a key choose its
+ * bucket, or the low `level + 1` bits if that one is already split.
+ * Once the entries fill HASH_INDEX_MAX_LOAD percent of the buckets, the
+ * next bucket is split, so that they grow one at a time. The first page
+ * of each bucket is listed in the directory, which is read in memory,
+ * so a lookup reads only the page of the bucket unless the bucket has
+ * overflowed, and searches it by the hashes the entries are sorted by
+ * within each page. The NULL keys are not kept, since they equal nothing, and
+ * the pages of the buckets are not merged as entries are erased. */
+class hash_index
+{
+	typedef int(*comparer_t)(const char*, const char*);
+
+	pager *pg;
+	int root_pid, type, size;
+	// an entry is [hash, rid, key]
+	int entry_size, per_page;
+	int level, split, count;
+	comparer_t compare;
+	std::vector<int> buckets;
+	std::vector<int> dir_pids;
+	std::vector<char> entry_buf;
+
+	uint32_t hash(const char *key);
+	int bucket_of(uint32_t h);
+	bool match(const char *entry, uint32_t h, const char *key);
+	void save();
+	int lower_bound(hash_bucket_page &page, uint32_t h);
+	void add_bucket(int pid);
+	void append(int bucket, const char *entry);
+	void fill(int bucket, std::vector<const char*> &entries);
+	void split_bucket();
+
+public:
+	/* Open the index at `root_pid`, or create an empty one if it is 0.
+	 * The keys are of `size` bytes and of the column type `type`. */
+	hash_index(pager *pg, int root_pid, int type, int size);
+
+	int get_root_pid() { return root_pid; }
+	bool empty() { return count == 0; }
+	void insert(const char *key, int rid);
+	// returns false if there is no such entry
+	bool erase(const char *key, int rid);
+	// the rids of the entries of `key`, in no order
+	void find(const char *key, std::vector<int> &rids);
+	bool contains(const char *key);
+};
+
+#endif
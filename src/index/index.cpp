@@ -1,40 +1,64 @@
 #include "index.h"
 #include "../utils/comparer.h"
+#include <algorithm>
 #include <cstring>
+#include <limits>
 
-index_manager::index_manager(pager *pg, int size, int root_pid, comparer_t comparer)
+index_manager::index_manager(pager *pg, int size, int root_pid, int type,
+	int filter_root, int index_type)
 {
 	this->pg = pg;
 	this->size = size;
+	this->type = type;
+	this->var_size = type == COL_TYPE_VARCHAR;
+	this->sorter = nullptr;
+	this->bulk_num = 0;
+	this->filter = filter_root ? new bloom_filter(pg, filter_root, type, size) : nullptr;
+	this->hash = nullptr;
+	this->btr = nullptr;
 	// [rid, nullmark, data]
 	buf = new char[size + sizeof(int) + 1];
-	btr = new index_btree(pg, root_pid, size + sizeof(int) + 1,
-		[comparer](const char *a, const char *b) -> int {
-			if(a[4] != b[4])
-			{
-				// one of A and B is NULL
-				return a[4] ? -1 : 1;
-			} else if(!a[4]) {
-				// A and B are not NULL
-				int r = comparer(a + sizeof(int) + 1, b + sizeof(int) + 1);
-				if(r != 0) return r;
-			}
-
-			return integer_comparer(*(int*)a, *(int*)b);
-		} );
+	int field_size = size + sizeof(int) + 1;
+	if(index_type == INDEX_TYPE_HASH)
+	{
+		assert(!filter);
+		hash = new hash_index(pg, root_pid, type, size);
+		return;
+	}
+
+	switch(type)
+	{
+		case COL_TYPE_INT:
+		case COL_TYPE_DATE:
+			compare = __impl::index_entry_comparer<__impl::int_data_comparer>();
+			btr = new typed_index_btree<__impl::int_data_comparer>(pg, root_pid, field_size);
+			break;
+		case COL_TYPE_FLOAT:
+			compare = __impl::index_entry_comparer<__impl::float_data_comparer>();
+			btr = new typed_index_btree<__impl::float_data_comparer>(pg, root_pid, field_size);
+			break;
+		default:
+			assert(type == COL_TYPE_VARCHAR);
+			compare = __impl::index_entry_comparer<__impl::string_data_comparer>();
+			btr = new typed_index_btree<__impl::string_data_comparer>(pg, root_pid, field_size);
+			break;
+	}
 }
 
 index_manager::~index_manager()
 {
 	delete []buf;
 	delete btr;
+	delete sorter;
+	delete filter;
+	delete hash;
 	buf = nullptr;
 	btr = nullptr;
 }
 
 int index_manager::get_root_pid()
 {
-	return btr->get_root_page_id();
+	return hash ? hash->get_root_pid() : btr->get_root_page_id();
 }
 
 void index_manager::fill_buf(const char *key, int rid)
@@ -50,22 +74,140 @@ void index_manager::fill_buf(const char *key, int rid)
 	}
 }
 
+// a NULL keeps no data, a string keeps the bytes up to its terminator
+int index_manager::entry_size(const char *entry)
+{
+	const int head = sizeof(int) + 1;
+	if(entry[4]) return head;
+	if(!var_size) return head + size;
+	return head + strnlen(entry + head, size - 1) + 1;
+}
+
+// a hash index reads the page of the key anyway
+void index_manager::create_filter(int bits_per_key)
+{
+	if(filter || hash) return;
+	filter = new bloom_filter(pg, 0, type, size, bits_per_key);
+	if(!btr->empty())
+		rebuild_filter(INDEX_BLOOM_MIN_KEYS);
+}
+
+void index_manager::add_to_filter(const char *entry)
+{
+	if(!filter || entry[4]) return;
+	// the filter grows twice as large, which drops the keys erased
+	if(filter->is_full())
+		rebuild_filter(filter->get_count() * 2);
+	else filter->add(entry + sizeof(int) + 1);
+}
+
+void index_manager::rebuild_filter(int keys)
+{
+	filter->clear(keys);
+	auto it = get_iterator_lower_bound(nullptr, std::numeric_limits<int>::min());
+	for(; !it.is_end(); it.next())
+	{
+		auto pos = it.get();
+		index_btree::leaf_page page { pg->read(pos.first), pg };
+		const char *entry = page.get_key(pos.second);
+		if(!entry[4])
+			filter->add(entry + sizeof(int) + 1);
+	}
+}
+
+void index_manager::find(const char *key, std::vector<int> &rids)
+{
+	assert(hash);
+	if(key) hash->find(key, rids);
+	else rids.clear();
+}
+
+bool index_manager::contains(const char *key)
+{
+	assert(hash);
+	return key && hash->contains(key);
+}
+
 void index_manager::insert(const char *key, int rid)
 {
+	if(hash)
+	{
+		hash->insert(key, rid);
+		return;
+	}
+
 	fill_buf(key, rid);
-	btr->insert(buf, rid);
+	btr->insert(buf, entry_size(buf));
+	add_to_filter(buf);
 }
 
+void index_manager::insert_sorted(const char *key, int rid)
+{
+	if(hash)
+	{
+		hash->insert(key, rid);
+		return;
+	}
+
+	fill_buf(key, rid);
+	btr->insert_sorted(buf, entry_size(buf));
+	add_to_filter(buf);
+}
+
+// the key is left in the filter, it cannot tell the other entries of it
 void index_manager::erase(const char *key, int rid)
 {
 	fill_buf(key, rid);
-	bool ret = btr->erase(buf);
+	bool ret = hash ? hash->erase(key, rid) : btr->erase(buf);
 	assert(ret);
 	UNUSED(ret);
 }
 
+// the entries of a hash index need no order, they are inserted at once
+void index_manager::bulk_load_add(const char *key, int rid)
+{
+	if(hash)
+	{
+		hash->insert(key, rid);
+		return;
+	}
+
+	if(!sorter)
+	{
+		sorter = new external_sorter<entry_comparer_t>(
+			size + sizeof(int) + 1, BTREE_BULK_SORT_MEMORY, compare);
+	}
+
+	fill_buf(key, rid);
+	sorter->add(buf);
+	++bulk_num;
+}
+
+void index_manager::bulk_load_end(int fill_factor)
+{
+	if(hash) return;
+	// the tree is empty, so is the filter of it
+	if(filter)
+		filter->clear(std::min<int64_t>(bulk_num, std::numeric_limits<int>::max()));
+	btr->bulk_load_begin(fill_factor);
+	if(sorter)
+	{
+		sorter->for_each([this](const char *entry) {
+			btr->bulk_load_append(entry, entry_size(entry));
+			if(filter && !entry[4])
+				filter->add(entry + sizeof(int) + 1);
+		} );
+	}
+
+	btr->bulk_load_end();
+	delete sorter;
+	sorter = nullptr;
+	bulk_num = 0;
+}
+
 index_btree::search_result index_manager::lower_bound(const char *key, int rid)
 {
+	assert(!hash);
 	fill_buf(key, rid);
 	return btr->lower_bound(buf);
 }
@@ -75,3 +217,10 @@ btree_iterator<index_btree::leaf_page> index_manager::get_iterator_lower_bound(c
 	auto ret = lower_bound(key, rid);
 	return { pg, ret.first, ret.second };
 }
+
+btree_iterator<index_btree::leaf_page> index_manager::get_iterator_last()
+{
+	assert(!hash);
+	auto ret = btr->last();
+	return { pg, ret.first, ret.second };
+}
@@ -3,27 +3,79 @@
 #include <functional>
 #include "../btree/btree.h"
 #include "../btree/iterator.h"
+#include "../algo/external_sort.h"
+#include "bloom_filter.h"
+#include "hash_index.h"
 
 class index_manager
 {
+	typedef std::function<int(const char*, const char*)> entry_comparer_t;
 	char *buf;
 	index_btree *btr;
-	int size;
+	int size, type;
+	bool var_size;
 	pager *pg;
+	entry_comparer_t compare;
+	external_sorter<entry_comparer_t> *sorter;
+	// the entries added to the sorter
+	int64_t bulk_num;
+	bloom_filter *filter;
+	// the entries are kept here instead of the tree for a hash index
+	hash_index *hash;
 
 	void fill_buf(const char *key, int rid);
+	int entry_size(const char *entry);
+	// add the key of an entry inserted to the filter, if any
+	void add_to_filter(const char *entry);
+	// clear the filter and add the keys in the tree to it
+	void rebuild_filter(int keys);
 
 public:
 	typedef int(*comparer_t)(const char*, const char*);
 
-	index_manager(pager *pg, int size, int root_pid, comparer_t comparer);
+	/* The keys are of `size` bytes and of the column type `type`, a
+	 * VARCHAR key takes only its own bytes in leaves. The bloom filter
+	 * of the keys is at `filter_root`, 0 if there is none. An index of
+	 * INDEX_TYPE_HASH serves the lookups of equal keys only, by `find`
+	 * and `contains`, and has no filter. */
+	index_manager(pager *pg, int size, int root_pid, int type,
+		int filter_root = 0, int index_type = INDEX_TYPE_BTREE);
 	~index_manager();
 
 	int get_root_pid();
+	int get_filter_root() { return filter ? filter->get_root_pid() : 0; }
+	int get_filter_bits() { return filter ? filter->get_bits_per_key() : 0; }
+	/* Keep a bloom filter of `bits_per_key` bits per key of the keys,
+	 * not NULL, in the index. The filter grows as keys are added, and
+	 * the keys erased stay in it until it grows. */
+	void create_filter(int bits_per_key);
+	/* false only if no entry of the index has `key`, nullptr for NULL */
+	bool may_contain(const char *key)
+	{
+		return !filter || !key || filter->may_contain(key);
+	}
+
+	bool is_hash() { return hash != nullptr; }
+	// the rids of the entries of `key`, in no order, for a hash index
+	void find(const char *key, std::vector<int> &rids);
+	// whether an entry has `key`, for a hash index
+	bool contains(const char *key);
+
 	void insert(const char *key, int rid);
+	// for entries inserted in ascending order, see `btree::insert_sorted`
+	void insert_sorted(const char *key, int rid);
 	void erase(const char *key, int rid);
+
+	/* Build an empty index from many entries at once: the entries are
+	 * sorted (on disk if they do not fit in BTREE_BULK_SORT_MEMORY),
+	 * and the tree is built bottom up with pages filled to
+	 * `fill_factor` percent when `bulk_load_end` is called. */
+	void bulk_load_add(const char *key, int rid);
+	void bulk_load_end(int fill_factor);
+	bool empty() { return hash ? hash->empty() : btr->empty(); }
 	index_btree::search_result lower_bound(const char *key, int rid = 0);
 	btree_iterator<index_btree::leaf_page> get_iterator_lower_bound(const char *key, int rid = 0);
+	btree_iterator<index_btree::leaf_page> get_iterator_last();
 
 };
 
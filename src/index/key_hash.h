@@ -0,0 +1,34 @@
+#ifndef __TRIVIALDB_KEY_HASH__
+#define __TRIVIALDB_KEY_HASH__
+
+#include <stdint.h>
+#include <cstring>
+#include "../defs.h"
+
+/* The hash of a key of `size` bytes of the column type `type`. The keys
+ * equal by the comparer of an index hash equally: a string up to its
+ * terminator, and -0 as 0. */
+inline uint64_t hash_index_key(const char *key, int type, int size)
+{
+	int len = size;
+	float f;
+	if(type == COL_TYPE_VARCHAR)
+	{
+		len = strnlen(key, size);
+	} else if(type == COL_TYPE_FLOAT) {
+		std::memcpy(&f, key, sizeof(f));
+		if(f == 0) f = 0;
+		key = (const char*)&f;
+		len = sizeof(f);
+	}
+
+	uint64_t h = 14695981039346656037ull;
+	for(int i = 0; i != len; ++i)
+		h = (h ^ (unsigned char)key[i]) * 1099511628211ull;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return h;
+}
+
+#endif
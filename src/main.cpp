@@ -1,14 +1,121 @@
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "defs.h"
+#include "fs/page_fs.h"
+#include "server/server.h"
 
 extern "C" char run_parser(const char *input);
 
+/* parse a size such as `4096`, `64K`, `32M` or `1G` into bytes */
+static long long parse_size(const char *str)
+{
+	char *end;
+	long long size = strtoll(str, &end, 10);
+	switch(*end)
+	{
+		case 'g': case 'G': size <<= 10; // fall through
+		case 'm': case 'M': size <<= 10; // fall through
+		case 'k': case 'K': size <<= 10; ++end; break;
+		default: break;
+	}
+
+	return *end ? -1 : size;
+}
+
+static void print_usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [--buffer-pool=SIZE] [--cache-policy=POLICY] [--io=BACKEND] [--wal=on|off]\n"
+		"       [--read-only] [--listen=[ADDRESS:]PORT] [--workers=N]\n", prog);
+	fprintf(stderr, "  --buffer-pool=SIZE     size of the page cache, e.g. 512M (default %dM)\n",
+		PAGE_CACHE_CAPACITY * (PAGE_SIZE >> 10) >> 10);
+	fprintf(stderr, "  --cache-policy=POLICY  page replacement policy, lru or 2q (default %s)\n",
+		PAGE_CACHE_DEFAULT_POLICY);
+	fprintf(stderr, "  --io=BACKEND           page I/O, pread or direct (O_DIRECT, default %s)\n",
+		PAGE_IO_DEFAULT_BACKEND);
+	fprintf(stderr, "  --wal=on|off           write-ahead log for crash recovery (default %s)\n",
+		PAGE_WAL_DEFAULT ? "on" : "off");
+	fprintf(stderr, "  --read-only            map the files read-only, nothing is modified\n");
+	fprintf(stderr, "  --listen=[ADDRESS:]PORT serve the clients at PORT instead of reading stdin\n");
+	fprintf(stderr, "  --workers=N            threads running the requests of the server (default %d)\n",
+		SERVER_WORKER_THREADS);
+}
+
 int main(int argc, char *argv[])
 {
-	if(argc < 2)
+	const char *listen_at = nullptr;
+	int workers = SERVER_WORKER_THREADS;
+	for(int i = 1; i < argc; ++i)
 	{
-		return run_parser(nullptr);
-	} else {
-		return 0;
+		if(strncmp(argv[i], "--buffer-pool=", 14) == 0)
+		{
+			long long size = parse_size(argv[i] + 14);
+			if(size < PAGE_SIZE)
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+
+			if(!page_fs::get_instance()->resize(size / PAGE_SIZE))
+				return 1;
+		} else if(strncmp(argv[i], "--cache-policy=", 15) == 0) {
+			if(!page_fs::is_valid_policy(argv[i] + 15))
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+
+			if(!page_fs::get_instance()->set_policy(argv[i] + 15))
+				return 1;
+		} else if(strncmp(argv[i], "--io=", 5) == 0) {
+			if(!io_backend::is_valid(argv[i] + 5))
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+
+			if(!page_fs::get_instance()->set_io_backend(argv[i] + 5))
+				return 1;
+		} else if(strcmp(argv[i], "--wal=on") == 0 || strcmp(argv[i], "--wal=off") == 0) {
+			if(!page_fs::get_instance()->set_wal(argv[i][6] == 'n'))
+				return 1;
+		} else if(strcmp(argv[i], "--read-only") == 0) {
+			if(!page_fs::get_instance()->set_read_only(true))
+				return 1;
+		} else if(strncmp(argv[i], "--listen=", 9) == 0) {
+			listen_at = argv[i] + 9;
+		} else if(strncmp(argv[i], "--workers=", 10) == 0) {
+			workers = atoi(argv[i] + 10);
+			if(workers <= 0)
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if(listen_at)
+	{
+		// ADDRESS:PORT or PORT
+		char address[64] = { 0 };
+		const char *colon = strrchr(listen_at, ':');
+		const char *port_str = colon ? colon + 1 : listen_at;
+		char *end;
+		long port = strtol(port_str, &end, 10);
+		if(colon && (size_t)(colon - listen_at) < sizeof(address))
+			memcpy(address, listen_at, colon - listen_at);
+		if(*end || port <= 0 || port > 65535 || (colon && !address[0]))
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+
+		server srv;
+		return srv.run(colon ? address : nullptr, port, workers) ? 0 : 1;
 	}
-	return 0;
+
+	return run_parser(nullptr);
 }
@@ -0,0 +1,53 @@
+#ifndef __TRIVIALDB_BLOOM_PAGE__
+#define __TRIVIALDB_BLOOM_PAGE__
+
+#include <cstring>
+#include "page_defs.h"
+
+/* The first page of a bloom filter, it lists the pages of the bits. */
+class bloom_page : public general_page
+{
+public:
+	using general_page::general_page;
+
+	PAGE_FIELD_REF(magic,        uint16_t, 0);
+	PAGE_FIELD_REF(bits_per_key, uint16_t, 2);
+	PAGE_FIELD_REF(page_num,     int,      4);   // pages of the bits
+	PAGE_FIELD_REF(capacity,     int,      8);   // keys the bits are sized for
+	PAGE_FIELD_REF(count,        int,      12);  // keys added since cleared
+	PAGE_FIELD_PTR(pages,        int,      16);
+	static constexpr int header_size() { return 16; }
+	static constexpr int max_pages() { return (PAGE_SIZE - header_size()) / sizeof(int); }
+
+	void init(int bits_per_key)
+	{
+		std::memset(buf, 0, PAGE_SIZE);
+		magic_ref() = PAGE_BLOOM;
+		bits_per_key_ref() = bits_per_key;
+	}
+};
+
+/* A page of the bits, split into blocks of a cache line, all the bits
+ * of a key are in one block. */
+class bloom_bits_page : public general_page
+{
+public:
+	using general_page::general_page;
+
+	PAGE_FIELD_REF(magic, uint16_t, 0);
+	static constexpr int header_size() { return 64; }
+	static constexpr int block_size() { return 64; }
+	static constexpr int block_num() { return (PAGE_SIZE - header_size()) / block_size(); }
+	uint64_t *block(int id)
+	{
+		return reinterpret_cast<uint64_t*>(buf + header_size() + id * block_size());
+	}
+
+	void init()
+	{
+		std::memset(buf, 0, PAGE_SIZE);
+		magic_ref() = PAGE_BLOOM_BITS;
+	}
+};
+
+#endif
@@ -93,10 +93,11 @@ void fixed_page<T>::erase(int pos)
 {
 	assert(0 <= pos && pos < size());
 
-	int* ch_ptr = children() + pos;
-	for(int i = size(); i > pos; --i, ++ch_ptr)
-		*ch_ptr = *(ch_ptr + 1);
-	*ch_ptr = 0;
+	// children()[size()] may be the first key of a full page
+	int* ch_ptr = children();
+	for(int i = pos; i + 1 < size(); ++i)
+		ch_ptr[i] = ch_ptr[i + 1];
+	ch_ptr[size() - 1] = 0;
 
 	std::memmove(
 		reinterpret_cast<char*>(end()) - (size() - 1) * field_size(),
@@ -113,18 +114,20 @@ std::pair<int, fixed_page<T>> fixed_page<T>::split(int cur_id)
 	if(size() < PAGE_BLOCK_MIN_NUM)
 		return { 0, { nullptr, nullptr } };
 
-	int page_id = pg->new_page();
+	int page_id = pg->new_page(cur_id);
 	if(!page_id) return { 0, { nullptr, nullptr } };
-	fixed_page upper_page { pg->read_for_write(page_id), pg };
-	upper_page.init(field_size());
-	upper_page.magic_ref() = magic();
 
+	// the upper page is read last, so that no other read evicts it
 	if(next_page())
 	{
 		fixed_page page { pg->read_for_write(next_page()), pg };
 		assert(page.magic() == magic());
 		page.prev_page_ref() = page_id;
 	}
+
+	fixed_page upper_page { pg->read_for_write(page_id), pg };
+	upper_page.init(field_size());
+	upper_page.magic_ref() = magic();
 	upper_page.next_page_ref() = next_page();
 	upper_page.prev_page_ref() = cur_id;
 	next_page_ref() = page_id;
@@ -155,6 +158,12 @@ bool fixed_page<T>::merge(fixed_page page, int cur_id)
 	if(size() + page.size() > capacity())
 		return false;
 
+	std::memcpy(children() + size(), page.children(), 4 * page.size());
+	std::memmove(begin() - page.size() * field_size(), begin(), field_size() * size());
+	std::memcpy(end() - page.size() * field_size(), page.begin(), field_size() * page.size());
+	size_ref() += page.size();
+
+	// the next page is read after `page` is copied, which it may evict
 	next_page_ref() = page.next_page_ref();
 	if(next_page())
 	{
@@ -163,11 +172,6 @@ bool fixed_page<T>::merge(fixed_page page, int cur_id)
 		page.prev_page_ref() = cur_id;
 	}
 
-	std::memcpy(children() + size(), page.children(), 4 * page.size());
-	std::memmove(begin() - page.size() * field_size(), begin(), field_size() * page.size());
-	std::memcpy(end() - page.size() * field_size(), page.begin(), field_size() * page.size());
-	size_ref() += page.size();
-
 	return true;
 }
 
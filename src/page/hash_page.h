@@ -0,0 +1,54 @@
+#ifndef __TRIVIALDB_HASH_PAGE__
+#define __TRIVIALDB_HASH_PAGE__
+
+#include <cstring>
+#include "page_defs.h"
+
+/* A page of the directory of a hash index, which lists the first page
+ * of each bucket. The state of the index is kept in the first one. */
+class hash_dir_page : public general_page
+{
+public:
+	using general_page::general_page;
+
+	PAGE_FIELD_REF(magic, uint16_t, 0);
+	PAGE_FIELD_REF(level, int,      4);   // 2^level buckets, before the ones split
+	PAGE_FIELD_REF(split, int,      8);   // the next bucket to split
+	PAGE_FIELD_REF(count, int,      12);  // number of entries
+	PAGE_FIELD_REF(next,  int,      16);  // the next page of the directory
+	PAGE_FIELD_REF(size,  int,      20);  // buckets listed in this page
+	PAGE_FIELD_PTR(pids,  int,      24);
+	static constexpr int header_size() { return 24; }
+	static constexpr int max_size() { return (PAGE_SIZE - header_size()) / sizeof(int); }
+
+	void init()
+	{
+		std::memset(buf, 0, header_size());
+		magic_ref() = PAGE_HASH_DIR;
+	}
+};
+
+/* A page of a bucket, the entries are [hash, rid, key] of a fixed size,
+ * in the order of their hashes. The pages of a bucket are chained by `next`. */
+class hash_bucket_page : public general_page
+{
+public:
+	using general_page::general_page;
+
+	PAGE_FIELD_REF(magic, uint16_t, 0);
+	PAGE_FIELD_REF(size,  uint16_t, 2);  // number of entries
+	PAGE_FIELD_REF(next,  int,      4);
+	static constexpr int header_size() { return 8; }
+	static constexpr int capacity(int entry_size) { return (PAGE_SIZE - header_size()) / entry_size; }
+
+	char *entry(int id, int entry_size) { return buf + header_size() + id * entry_size; }
+
+	void init()
+	{
+		magic_ref() = PAGE_HASH_BUCKET;
+		size_ref()  = 0;
+		next_ref()  = 0;
+	}
+};
+
+#endif
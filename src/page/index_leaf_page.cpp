@@ -0,0 +1,113 @@
+#include <cstdlib>
+#include "index_leaf_page.h"
+
+bool index_leaf_page::insert(int pos, const char *data, int data_size)
+{
+	assert(0 <= pos && pos <= size());
+	assert(data_size <= field_size());
+	if(data_size + 2 > free_size())
+		return false;
+
+	int start = pos < size() ? *slot(pos) : used_end();
+	std::memmove(buf + start + data_size, buf + start, used_end() - start);
+	std::memcpy(buf + start, data, data_size);
+	for(int i = size(); i > pos; --i)
+		*slot(i) = *slot(i - 1) + data_size;
+	*slot(pos) = start;
+
+	used_end_ref() += data_size;
+	++size_ref();
+	return true;
+}
+
+void index_leaf_page::erase(int pos)
+{
+	assert(0 <= pos && pos < size());
+	int start = *slot(pos), len = get_size(pos);
+	std::memmove(buf + start, buf + start + len, used_end() - start - len);
+	for(int i = pos; i + 1 < size(); ++i)
+		*slot(i) = *slot(i + 1) - len;
+
+	used_end_ref() -= len;
+	--size_ref();
+}
+
+std::pair<int, index_leaf_page> index_leaf_page::split(int cur_id)
+{
+	if(size() < PAGE_BLOCK_MIN_NUM)
+		return { 0, { nullptr, nullptr } };
+
+	// the lower part takes the entries before `mid`
+	int total = used_size() + size() * 2, mid = 0, best = total;
+	for(int i = PAGE_BLOCK_MIN_NUM / 2; i <= size() - PAGE_BLOCK_MIN_NUM / 2; ++i)
+	{
+		int lower = *slot(i) - header_size() + i * 2;
+		int diff = std::abs(total - lower * 2);
+		if(diff < best)
+		{
+			best = diff;
+			mid = i;
+		}
+	}
+
+	int page_id = pg->new_page(cur_id);
+	if(!page_id) return { 0, { nullptr, nullptr } };
+
+	// the upper page is read last, so that no other read evicts it
+	if(next_page())
+	{
+		index_leaf_page page { pg->read_for_write(next_page()), pg };
+		assert(page.magic() == magic());
+		page.prev_page_ref() = page_id;
+	}
+
+	index_leaf_page upper_page { pg->read_for_write(page_id), pg };
+	upper_page.init(field_size());
+
+	int base = *slot(mid), upper_size = size() - mid;
+	std::memcpy(upper_page.buf + header_size(), buf + base, used_end() - base);
+	for(int i = 0; i != upper_size; ++i)
+		*upper_page.slot(i) = *slot(mid + i) - base + header_size();
+	upper_page.used_end_ref() = header_size() + used_end() - base;
+	upper_page.size_ref() = upper_size;
+	used_end_ref() = base;
+	size_ref() = mid;
+	upper_page.next_page_ref() = next_page();
+	upper_page.prev_page_ref() = cur_id;
+	next_page_ref() = page_id;
+	return { page_id, upper_page };
+}
+
+bool index_leaf_page::merge(index_leaf_page page, int cur_id)
+{
+	if(page.used_size() + page.size() * 2 > free_size())
+		return false;
+
+	int base = used_end() - header_size();
+	std::memcpy(buf + used_end(), page.buf + header_size(), page.used_size());
+	for(int i = 0; i != page.size(); ++i)
+		*slot(size() + i) = *page.slot(i) + base;
+	used_end_ref() += page.used_size();
+	size_ref() += page.size();
+
+	next_page_ref() = page.next_page();
+	if(next_page())
+	{
+		index_leaf_page page { pg->read_for_write(next_page()), pg };
+		assert(page.magic() == magic());
+		page.prev_page_ref() = cur_id;
+	}
+
+	return true;
+}
+
+void index_leaf_page::move_from(index_leaf_page page, int src_pos, int dest_pos)
+{
+	assert(page.magic() == magic());
+	bool succ_ins = insert(dest_pos,
+		page.get_key(src_pos),
+		page.get_size(src_pos));
+	page.erase(src_pos);
+	assert(succ_ins);
+	UNUSED(succ_ins);
+}
@@ -1,27 +1,90 @@
 #ifndef __TRIVIALDB_INDEX_LEAF_PAGE__
 #define __TRIVIALDB_INDEX_LEAF_PAGE__
 
-#include "fixed_page.h"
+#include <cstring>
+#include <cassert>
+#include <utility>
+#include "page_defs.h"
+#include "pager.h"
 
-template<typename T>
-class index_leaf_page : public fixed_page<T>
+/* A leaf of a secondary index, whose entries are of variable length, at
+ * most `field_size` bytes each, so that a short string takes only the
+ * bytes it has. The entries are packed in key order right after the
+ * header, and the offset of entry i is kept in slot i, the slots going
+ * down from the end of the page. The end of entry i is the start of
+ * entry i + 1. `field_size` bytes are always kept free, since a key is
+ * copied by the b-tree in full, so that an entry is never read past the
+ * page. */
+class index_leaf_page : public general_page
 {
+	uint16_t *slot(int id)
+	{
+		return reinterpret_cast<uint16_t*>(buf + PAGE_SIZE) - id - 1;
+	}
+
+	int entry_end(int id) { return id + 1 < size() ? *slot(id + 1) : used_end(); }
+	int used_size() { return used_end() - header_size(); }
+
 public:
-	using fixed_page<T>::fixed_page;
+	using general_page::general_page;
+	PAGE_FIELD_REF(magic,       uint16_t, 0);   // page type
+	PAGE_FIELD_REF(field_size,  uint16_t, 2);   // the largest size of entries
+	PAGE_FIELD_REF(size,        uint16_t, 4);   // number of entries
+	PAGE_FIELD_REF(used_end,    uint16_t, 6);   // end of the entries
+	PAGE_FIELD_REF(next_page,   int,      8);
+	PAGE_FIELD_REF(prev_page,   int,      12);
+	static constexpr int header_size() { return 16; }
+
+	int free_size()
+	{
+		return PAGE_SIZE - used_end() - size() * 2 - field_size();
+	}
+
+	bool empty() { return size() == 0; }
+	bool underflow()
+	{
+		return free_size() > PAGE_FREE_SPACE_MAX
+			|| size() < PAGE_BLOCK_MIN_NUM / 2;
+	}
+
+	bool underflow_if_remove(int pos)
+	{
+		return free_size() + get_size(pos) + 2 > PAGE_FREE_SPACE_MAX
+			|| size() - 1 < PAGE_BLOCK_MIN_NUM / 2;
+	}
+
 	void init(int field_size)
 	{
-		fixed_page<T>::init(field_size);
-		this->magic_ref() = PAGE_INDEX_LEAF;
+		magic_ref() = PAGE_INDEX_LEAF;
+		field_size_ref() = field_size;
+		size_ref() = 0;
+		used_end_ref() = header_size();
+		next_page_ref() = prev_page_ref() = 0;
 	}
 
-	std::pair<int, index_leaf_page> split(int cur_id)
+	const char *get_key(int id)
 	{
-		auto pw = fixed_page<T>::split(cur_id);
-		auto page = *reinterpret_cast<index_leaf_page*>(&pw.second);
-		return { pw.first,
-			*reinterpret_cast<index_leaf_page*>(&pw.second)
-		};
+		assert(0 <= id && id < size());
+		return buf + *slot(id);
 	}
+
+	int get_size(int id)
+	{
+		assert(0 <= id && id < size());
+		return entry_end(id) - *slot(id);
+	}
+
+	// an entry starts with the rid
+	int get_rid(int id) { return *reinterpret_cast<const int*>(get_key(id)); }
+
+	// `data_size` is the size of the entry, returns false if it does not fit
+	bool insert(int pos, const char *data, int data_size);
+	void erase(int pos);
+	/* Split the page into two parts of about the same used size, each
+	 * of which has at least (PAGE_BLOCK_MIN_NUM / 2) entries. */
+	std::pair<int, index_leaf_page> split(int cur_id);
+	bool merge(index_leaf_page page, int cur_id);
+	void move_from(index_leaf_page page, int src_pos, int dest_pos);
 };
 
 #endif
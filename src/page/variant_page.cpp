@@ -78,8 +78,9 @@ bool variant_page::insert(int pos, const char *data, int data_size)
 	{
 		header->ov_page = 0;
 	} else {
-		auto create_and_copy = [&](const char *src, int size) {
-			int pid = pg->new_page();
+		// each overflow page is placed near the one before it
+		auto create_and_copy = [&](const char *src, int size, int near) {
+			int pid = pg->new_page(near);
 			overflow_page page = overflow_page(pg->read_for_write(pid), pg);
 			page.init();
 			page.size_ref() = size;
@@ -91,18 +92,19 @@ bool variant_page::insert(int pos, const char *data, int data_size)
 		int remain = data_size - copied_size;
 		int to_copy = std::min(overflow_page::block_size(), remain);
 
-		auto ret = create_and_copy(data, to_copy);
-		overflow_page ov_page = ret.second;
+		auto ret = create_and_copy(data, to_copy, 0);
 		data   += to_copy;
 		remain -= to_copy;
 		header->ov_page = ret.first;
+		int last_pid = ret.first;
 
 		while(remain > 0)
 		{
 			to_copy = std::min(overflow_page::block_size(), remain);
-			auto ret = create_and_copy(data, to_copy);
-			ov_page.next_ref() = ret.first;
-			ov_page = ret.second;
+			auto ret = create_and_copy(data, to_copy, last_pid);
+			// read again, the new page may have evicted the one before it
+			overflow_page(pg->read_for_write(last_pid), pg).next_ref() = ret.first;
+			last_pid = ret.first;
 			data   += to_copy;
 			remain -= to_copy;
 		}
@@ -115,18 +117,20 @@ std::pair<int, variant_page> variant_page::split(int cur_id)
 {
 	if(size() < PAGE_BLOCK_MIN_NUM)
 		return { 0, { nullptr, nullptr } };
-	int page_id = pg->new_page();
+	int page_id = pg->new_page(cur_id);
 	if(!page_id) return { 0, { nullptr, nullptr } };
-	variant_page upper_page { pg->read_for_write(page_id), pg };
-	upper_page.init();
-	upper_page.flags_ref() = flags();
 
+	// the upper page is read last, so that no other read evicts it
 	if(next_page())
 	{
 		variant_page page { pg->read_for_write(next_page()), pg };
 		assert(page.magic() == magic());
 		page.prev_page_ref() = page_id;
 	}
+
+	variant_page upper_page { pg->read_for_write(page_id), pg };
+	upper_page.init();
+	upper_page.flags_ref() = flags();
 	upper_page.next_page_ref() = next_page();
 	upper_page.prev_page_ref() = cur_id;
 	next_page_ref() = page_id;
@@ -172,14 +176,6 @@ bool variant_page::merge(variant_page page, int cur_id)
 	if(space_req > free_size())
 		return false;
 
-	next_page_ref() = page.next_page_ref();
-	if(next_page())
-	{
-		variant_page page { pg->read_for_write(next_page()), pg };
-		assert(page.magic() == magic());
-		page.prev_page_ref() = cur_id;
-	}
-
 	defragment();
 	uint16_t *src_slot = page.slots();
 	uint16_t *dest_slot = slots() + size();
@@ -197,6 +193,15 @@ bool variant_page::merge(variant_page page, int cur_id)
 	size_ref() += page.size();
 	free_size_ref() -= space_req;
 
+	// the next page is read after `page` is copied, which it may evict
+	next_page_ref() = page.next_page_ref();
+	if(next_page())
+	{
+		variant_page page { pg->read_for_write(next_page()), pg };
+		assert(page.magic() == magic());
+		page.prev_page_ref() = cur_id;
+	}
+
 	return true;
 }
 
@@ -66,6 +66,8 @@ public:
 
 	void init(int = 0);
 	void erase(int pos) { erase(pos, true); }
+	/* An element too large for the page goes to overflow pages, which
+	 * are allocated and read meanwhile, so the page must be pinned. */
 	bool insert(int pos, const char *data, int data_size);
 	void move_from(variant_page page, int src_pos, int dest_pos);
 
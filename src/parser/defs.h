@@ -75,9 +75,17 @@ typedef enum {
 	TERM_FLOAT,
 	TERM_BOOL,
 	TERM_LITERAL_LIST,
-	TERM_NULL
+	TERM_NULL,
+	TERM_PARAM         /* `?` of a prepared statement, val_i is its index */
 } term_type_t;
 
+typedef enum {
+	PREPARED_SELECT,
+	PREPARED_INSERT,
+	PREPARED_UPDATE,
+	PREPARED_DELETE
+} prepared_type_t;
+
 typedef struct field_item_t {
 	char *name;
 	int type, width, flags;
@@ -99,6 +107,7 @@ typedef struct table_def_t {
 	char *name;
 	struct field_item_t *fields;
 	struct linked_list_t *constraints;
+	char *engine;  // NULL for the row engine
 } table_def_t;
 
 typedef struct insert_info_t {
@@ -125,6 +134,7 @@ typedef struct table_constraint_t {
 	int type;
 	column_ref_t *column_ref, *foreign_column_ref;
 	expr_node_t *check_cond;
+	char *index_method;  // USING of PRIMARY KEY and UNIQUE, NULL for none
 } table_constraint_t;
 
 typedef struct delete_info_t {
@@ -138,9 +148,20 @@ typedef struct update_info_t {
 	expr_node_t *where, *value;
 } update_info_t;
 
+typedef struct order_by_item_t {
+	expr_node_t *expr;
+	int desc;
+} order_by_item_t;
+
+typedef struct limit_info_t {
+	int offset, count;
+} limit_info_t;
+
 typedef struct select_info_t {
 	linked_list_t *tables, *exprs;
 	expr_node_t *where;
+	linked_list_t *group_by, *order_by;
+	limit_info_t *limit;
 } select_info_t;
 
 typedef struct table_join_info_t {
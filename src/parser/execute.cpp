@@ -1,69 +1,63 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
 #include "execute.h"
 #include "../database/dbms.h"
 #include "../table/table_header.h"
 #include "../expression/expression.h"
+#include "../utils/arena.h"
 
-template<typename T, typename DataDeleter>
-void free_linked_list(linked_list_t *linked_list, DataDeleter data_deleter)
+/* The parse tree of a statement and the strings in it are taken from
+ * `parse_arena`, and are all freed once the statement is executed. A
+ * prepared statement takes the memory of its tree with it. */
+static arena parse_arena;
+
+void *parser_alloc(size_t size)
 {
-	for(linked_list_t *l_ptr = linked_list; l_ptr; )
-	{
-		T* data = (T*)l_ptr->data;
-		data_deleter(data);
-		linked_list_t *tmp = l_ptr;
-		l_ptr = l_ptr->next;
-		free(tmp);
-	}
+	return parse_arena.allocate(size);
 }
 
-void expression::free_exprnode(expr_node_t *expr)
+void *parser_calloc(size_t size)
 {
-	if(!expr) return;
-	if(expr->op == OPERATOR_NONE)
-	{
-		switch(expr->term_type)
-		{
-			case TERM_STRING:
-				free(expr->val_s);
-				break;
-			case TERM_COLUMN_REF:
-				free(expr->column_ref->table);
-				free(expr->column_ref->column);
-				free(expr->column_ref);
-				break;
-			case TERM_LITERAL_LIST:
-				free_linked_list<expr_node_t>(
-					expr->literal_list,
-					expression::free_exprnode
-				);
-				break;
-			default:
-				break;
-		}
-	} else {
-		free_exprnode(expr->left);
-		free_exprnode(expr->right);
-	}
+	return parse_arena.allocate_zero(size);
+}
 
-	free(expr);
+char *parser_strdup(const char *str)
+{
+	return parse_arena.strdup(str);
 }
 
-void free_column_ref(column_ref_t *cref)
+char *parser_strndup(const char *str, size_t len)
 {
-	if(!cref) return;
-	free(cref->column);
-	free(cref->table);
-	free(cref);
+	return parse_arena.strndup(str, len);
+}
+
+void execute_end_statement()
+{
+	parse_arena.reset();
+	dbms::get_instance()->end_query();
 }
 
 bool fill_table_header(table_header_t *header, const table_def_t *table);
+int lookup_index_type(const char *method);
 
 void execute_switch_output(const char *output_filename)
 {
 	dbms::get_instance()->switch_select_output(output_filename);
-	free((void*)output_filename);
+}
+
+void execute_set_variable(const char *name, int value)
+{
+	dbms::get_instance()->set_variable(name, value);
+}
+
+void execute_set_string_variable(const char *name, const char *value)
+{
+	dbms::get_instance()->set_variable(name, value);
 }
 
 void execute_create_table(const table_def_t *table)
@@ -72,129 +66,337 @@ void execute_create_table(const table_def_t *table)
 	if(fill_table_header(header, table))
 		dbms::get_instance()->create_table(header);
 	else std::fprintf(stderr, "[Error] Fail to create table!\n");
+	dbms::get_instance()->commit();
 	delete header;
-
-	free(table->name);
-	free_linked_list<table_constraint_t>(table->constraints, [](table_constraint_t *data) {
-		expression::free_exprnode(data->check_cond);
-		free_column_ref(data->column_ref);
-		free_column_ref(data->foreign_column_ref);
-		free(data);
-	} );
-
-	for(field_item_t *it = table->fields; it; )
-	{
-		field_item_t *tmp = it;
-		free(it->name);
-		expression::free_exprnode(it->default_value);
-		it = it->next;
-		free(tmp);
-	}
-
-	free((void*)table);
 }
 
 void execute_create_database(const char *db_name)
 {
 	dbms::get_instance()->create_database(db_name);
-	free((char*)db_name);
 }
 
 void execute_use_database(const char *db_name)
 {
 	dbms::get_instance()->switch_database(db_name);
-	free((char*)db_name);
 }
 
 void execute_drop_database(const char *db_name)
 {
 	dbms::get_instance()->drop_database(db_name);
-	free((char*)db_name);
 }
 
 void execute_show_database(const char *db_name)
 {
 	dbms::get_instance()->show_database(db_name);
-	free((void*)db_name);
 }
 
 void execute_drop_table(const char *table_name)
 {
 	dbms::get_instance()->drop_table(table_name);
-	free((void*)table_name);
 }
 
 void execute_show_table(const char *table_name)
 {
 	dbms::get_instance()->show_table(table_name);
-	free((void*)table_name);
+}
+
+void execute_analyze(const char *table_name)
+{
+	dbms::get_instance()->analyze_table(table_name);
+}
+
+void execute_show_stats()
+{
+	dbms::get_instance()->show_stats();
+}
+
+void execute_vacuum(const char *table_name)
+{
+	dbms::get_instance()->vacuum_table(table_name);
+}
+
+/* the placeholders of an expression by their indices */
+static void collect_params(expr_node_t *expr, std::vector<expr_node_t*> &params)
+{
+	if(!expr) return;
+	if(expr->op != OPERATOR_NONE)
+	{
+		collect_params(expr->left, params);
+		collect_params(expr->right, params);
+	} else if(expr->term_type == TERM_LITERAL_LIST) {
+		for(linked_list_t *l = expr->literal_list; l; l = l->next)
+			collect_params((expr_node_t*)l->data, params);
+	} else if(expr->term_type == TERM_PARAM) {
+		if((size_t)expr->val_i >= params.size())
+			params.resize(expr->val_i + 1);
+		params[expr->val_i] = expr;
+	}
+}
+
+static void collect_params(linked_list_t *exprs, std::vector<expr_node_t*> &params)
+{
+	for(linked_list_t *l = exprs; l; l = l->next)
+		collect_params((expr_node_t*)l->data, params);
+}
+
+static void collect_params(int type, const void *info, std::vector<expr_node_t*> &params)
+{
+	switch(type)
+	{
+		case PREPARED_SELECT: {
+			const select_info_t *select_info = (const select_info_t*)info;
+			collect_params(select_info->where, params);
+			collect_params(select_info->exprs, params);
+			collect_params(select_info->group_by, params);
+			for(linked_list_t *l = select_info->order_by; l; l = l->next)
+				collect_params(((order_by_item_t*)l->data)->expr, params);
+			for(linked_list_t *l = select_info->tables; l; l = l->next)
+				collect_params(((table_join_info_t*)l->data)->cond, params);
+			break; }
+		case PREPARED_INSERT:
+			for(linked_list_t *l = ((const insert_info_t*)info)->values; l; l = l->next)
+				collect_params((linked_list_t*)l->data, params);
+			break;
+		case PREPARED_UPDATE:
+			collect_params(((const update_info_t*)info)->where, params);
+			collect_params(((const update_info_t*)info)->value, params);
+			break;
+		case PREPARED_DELETE:
+			collect_params(((const delete_info_t*)info)->where, params);
+			break;
+	}
+}
+
+/* `?` has no value outside a prepared statement */
+static bool check_no_params(int type, const void *info)
+{
+	std::vector<expr_node_t*> params;
+	collect_params(type, info, params);
+	if(params.empty())
+		return true;
+	std::fprintf(stderr, "[Error] Placeholders can only be used in PREPARE.\n");
+	return false;
 }
 
 void execute_insert(const insert_info_t *insert_info)
 {
-	dbms::get_instance()->insert_rows(insert_info);
-	free(insert_info->table);
-	free_linked_list<column_ref_t>(insert_info->columns, free_column_ref);
-	free_linked_list<linked_list_t>(insert_info->values, [](linked_list_t *expr_list) {
-		free_linked_list<expr_node_t>(expr_list, expression::free_exprnode);
-	} );
-	free((void*)insert_info);
+	if(check_no_params(PREPARED_INSERT, insert_info))
+	{
+		dbms::get_instance()->insert_rows(insert_info);
+		dbms::get_instance()->commit();
+	}
+}
+
+void execute_copy(const insert_info_t *copy_info, const char *filename)
+{
+	dbms::get_instance()->copy_rows(copy_info, filename);
+	dbms::get_instance()->commit();
 }
 
 void execute_delete(const delete_info_t *delete_info)
 {
-	dbms::get_instance()->delete_rows(delete_info);
-	free(delete_info->table);
-	expression::free_exprnode(delete_info->where);
-	free((void*)delete_info);
+	if(check_no_params(PREPARED_DELETE, delete_info))
+	{
+		dbms::get_instance()->delete_rows(delete_info);
+		dbms::get_instance()->commit();
+	}
 }
 
 void execute_select(const select_info_t *select_info)
 {
-	dbms::get_instance()->select_rows(select_info);
-	expression::free_exprnode(select_info->where);
-	free_linked_list<expr_node_t>(select_info->exprs, expression::free_exprnode);
-	free_linked_list<table_join_info_t>(select_info->tables, [](table_join_info_t *data) {
-		free(data->table);
-		if(data->join_table)
-			free(data->join_table);
-		if(data->alias)
-			free(data->alias);
-		expression::free_exprnode(data->cond);
-		free(data);
-	} );
+	if(check_no_params(PREPARED_SELECT, select_info))
+		dbms::get_instance()->select_rows(select_info);
+}
 
-	free((void*)select_info);
+void execute_explain(const select_info_t *select_info, int analyze)
+{
+	if(check_no_params(PREPARED_SELECT, select_info))
+		dbms::get_instance()->explain_select(select_info, analyze != 0);
 }
 
 void execute_update(const update_info_t *update_info)
 {
-	dbms::get_instance()->update_rows(update_info);
-	free(update_info->table);
-	free_column_ref(update_info->column_ref);
-	expression::free_exprnode(update_info->where);
-	expression::free_exprnode(update_info->value);
-	free((void*)update_info);
+	if(check_no_params(PREPARED_UPDATE, update_info))
+	{
+		dbms::get_instance()->update_rows(update_info);
+		dbms::get_instance()->commit();
+	}
+}
+
+/* the prepared statements of the current session */
+static std::map<std::string, prepared_stmt_t> &session_stmts()
+{
+	return dbms::get_instance()->get_session()->prepared_stmts;
+}
+
+static void free_prepared(prepared_stmt_t &stmt)
+{
+	delete stmt.mem;
+	stmt.mem = nullptr;
+}
+
+void execute_prepare(const char *name, int type, void *info)
+{
+	prepared_stmt_t stmt;
+	stmt.type = type;
+	stmt.info = info;
+	stmt.mem  = new arena;
+	parse_arena.move_to(*stmt.mem);
+	collect_params(type, info, stmt.params);
+
+	std::map<std::string, prepared_stmt_t> &prepared_stmts = session_stmts();
+	auto it = prepared_stmts.find(name);
+	if(it != prepared_stmts.end())
+	{
+		free_prepared(it->second);
+		it->second = stmt;
+	} else {
+		prepared_stmts[name] = stmt;
+	}
+
+	std::printf("[Info] Statement `%s` prepared with %d parameter(s).\n",
+		name, (int)stmt.params.size());
+}
+
+/* Set a placeholder to a value, which must be a constant expression. */
+static bool bind_param(expr_node_t *param, const expr_node_t *value)
+{
+	expression val;
+	bool literal = value->op == OPERATOR_NONE
+		&& (value->term_type == TERM_STRING || value->term_type == TERM_DATE);
+	if(!literal)
+	{
+		try {
+			val = expression::eval(value);
+		} catch(const char *msg) {
+			std::fprintf(stderr, "%s\n", msg);
+			return false;
+		}
+
+		if(val.type != TERM_INT && val.type != TERM_FLOAT
+			&& val.type != TERM_BOOL && val.type != TERM_NULL)
+		{
+			std::fprintf(stderr, "[Error] Parameter is not a constant.\n");
+			return false;
+		}
+	}
+
+	if(literal)
+	{
+		// in the tree of EXECUTE, which is kept until it is done
+		param->term_type = value->term_type;
+		param->val_s = value->val_s;
+		return true;
+	}
+
+	param->term_type = val.type;
+	switch(val.type)
+	{
+		case TERM_INT:   param->val_i = val.val_i; break;
+		case TERM_FLOAT: param->val_f = val.val_f; break;
+		case TERM_BOOL:  param->val_b = val.val_b; break;
+		default: break;
+	}
+
+	return true;
+}
+
+void execute_prepared(const char *name, linked_list_t *values)
+{
+	std::vector<expr_node_t*> vals;
+	for(linked_list_t *l = values; l; l = l->next)
+		vals.push_back((expr_node_t*)l->data);
+	std::reverse(vals.begin(), vals.end());
+
+	std::map<std::string, prepared_stmt_t> &prepared_stmts = session_stmts();
+	auto it = prepared_stmts.find(name);
+	bool ok = true;
+	if(it == prepared_stmts.end()) {
+		std::fprintf(stderr, "[Error] Statement `%s` is not prepared.\n", name);
+		ok = false;
+	} else if(vals.size() != it->second.params.size()) {
+		std::fprintf(stderr, "[Error] Statement `%s` takes %d parameter(s), %d given.\n",
+			name, (int)it->second.params.size(), (int)vals.size());
+		ok = false;
+	}
+
+	for(size_t i = 0; ok && i != vals.size(); ++i)
+		ok = bind_param(it->second.params[i], vals[i]);
+
+	if(ok)
+	{
+		dbms *db = dbms::get_instance();
+		prepared_stmt_t &stmt = it->second;
+		switch(stmt.type)
+		{
+			case PREPARED_SELECT:
+				db->select_rows((select_info_t*)stmt.info);
+				break;
+			case PREPARED_INSERT:
+				db->insert_rows((insert_info_t*)stmt.info);
+				db->commit();
+				break;
+			case PREPARED_UPDATE:
+				db->update_rows((update_info_t*)stmt.info);
+				db->commit();
+				break;
+			case PREPARED_DELETE:
+				db->delete_rows((delete_info_t*)stmt.info);
+				db->commit();
+				break;
+		}
+	}
+}
+
+void execute_deallocate(const char *name)
+{
+	std::map<std::string, prepared_stmt_t> &prepared_stmts = session_stmts();
+	auto it = prepared_stmts.find(name);
+	if(it == prepared_stmts.end()) {
+		std::fprintf(stderr, "[Error] Statement `%s` is not prepared.\n", name);
+	} else {
+		free_prepared(it->second);
+		prepared_stmts.erase(it);
+	}
 }
 
-void execute_create_index(const char *table_name, const char *col_name)
+void execute_create_index(const char *table_name, const char *col_name, const char *method)
 {
-	dbms::get_instance()->create_index(table_name, col_name);
-	free((char*)table_name);
-	free((char*)col_name);
+	int index_type = lookup_index_type(method);
+	if(index_type < 0) return;
+	dbms::get_instance()->create_index(table_name, col_name, index_type);
+	dbms::get_instance()->commit();
 }
 
 void execute_drop_index(const char *table_name, const char *col_name)
 {
 	dbms::get_instance()->drop_index(table_name, col_name);
-	free((char*)table_name);
-	free((char*)col_name);
 }
 
-void execute_quit()
+void execute_close_session()
 {
+	std::map<std::string, prepared_stmt_t> &prepared_stmts = session_stmts();
+	for(auto &it : prepared_stmts)
+		free_prepared(it.second);
+	prepared_stmts.clear();
+	dbms::get_instance()->switch_select_output("stdout");
 	dbms::get_instance()->close_database();
+}
+
+void execute_quit()
+{
+	execute_close_session();
 	printf("[exit] good bye!\n");
 }
 
+int execute_exit()
+{
+	execute_quit();
+	dbms *db = dbms::get_instance();
+	if(db->in_console())
+		return 1;
+	db->get_session()->closed = true;
+	return 0;
+}
+
 
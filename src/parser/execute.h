@@ -7,6 +7,14 @@
 extern "C" {
 #endif
 
+/* The parse trees are taken from the memory of the statement, which is
+ * freed all at once by execute_end_statement() after it is executed. */
+void *parser_alloc(size_t size);
+void *parser_calloc(size_t size);
+char *parser_strdup(const char *str);
+char *parser_strndup(const char *str, size_t len);
+void execute_end_statement();
+
 void execute_create_database(const char *db_name);
 void execute_use_database(const char *db_name);
 void execute_drop_database(const char *db_name);
@@ -14,14 +22,31 @@ void execute_show_database(const char *db_name);
 void execute_create_table(const table_def_t *table);
 void execute_drop_table(const char *table_name);
 void execute_show_table(const char *table_name);
+void execute_analyze(const char *table_name);
+void execute_show_stats();
+void execute_vacuum(const char *table_name);
 void execute_insert(const insert_info_t *insert_info);
+void execute_copy(const insert_info_t *copy_info, const char *filename);
 void execute_delete(const delete_info_t *delete_info);
 void execute_select(const select_info_t *select_info);
+/* EXPLAIN shows the plan, EXPLAIN ANALYZE runs the query as well */
+void execute_explain(const select_info_t *select_info, int analyze);
 void execute_update(const update_info_t *update_info);
-void execute_create_index(const char *table_name, const char *col_name);
+void execute_create_index(const char *table_name, const char *col_name, const char *method);
 void execute_drop_index(const char *table_name, const char *col_name);
 void execute_switch_output(const char *output_filename);
+void execute_set_variable(const char *name, int value);
+void execute_set_string_variable(const char *name, const char *value);
+/* `info` is one of the statements of prepared_type_t, it is kept to
+ * be executed later with the values of its placeholders */
+void execute_prepare(const char *name, int type, void *info);
+void execute_prepared(const char *name, linked_list_t *values);
+void execute_deallocate(const char *name);
 void execute_quit();
+/* free the prepared statements of the session, and leave its database */
+void execute_close_session();
+/* EXIT, returns nonzero if the process should exit, i.e. in the console */
+int execute_exit();
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,9 @@
 
 void yyerror(const char *s);
 
+/* the placeholders of the statement being parsed */
+static int param_num = 0;
+
 #include "sql.yy.c"
 
 %}
@@ -30,6 +33,8 @@ void yyerror(const char *s);
 	struct delete_info_t      *delete_info;
 	struct select_info_t      *select_info;
 	struct table_join_info_t  *join_info;
+	struct order_by_item_t    *order_item;
+	struct limit_info_t       *limit_info;
 	struct expr_node_t        *expr;
 }
 
@@ -37,10 +42,12 @@ void yyerror(const char *s);
 %token LIKE IS OR AND NOT NEQ GEQ LEQ
 %token INTEGER DOUBLE FLOAT CHAR VARCHAR DATE
 %token INTO FROM WHERE VALUES JOIN INNER OUTER
-%token LEFT RIGHT FULL ASC DESC ORDER BY IN ON AS
+%token LEFT RIGHT FULL ASC DESC ORDER BY IN ON AS LIMIT
 %token DISTINCT GROUP USING INDEX TABLE DATABASE
 %token DEFAULT UNIQUE PRIMARY FOREIGN REFERENCES CHECK KEY OUTPUT
-%token USE CREATE DROP SELECT INSERT UPDATE DELETE SHOW SET EXIT
+%token USE CREATE DROP SELECT INSERT UPDATE DELETE SHOW SET EXIT ANALYZE VACUUM ENGINE
+%token EXPLAIN STATS COPY
+%token PREPARE EXECUTE DEALLOCATE
 
 %token IDENTIFIER
 %token DATE_LITERAL
@@ -53,7 +60,7 @@ void yyerror(const char *s);
 %type <val_i> INT_LITERAL
 
 %type <val_i> field_type field_width field_flag field_flags
-%type <val_s> table_name database_name
+%type <val_s> table_name database_name table_engine index_method
 %type <val_s> create_database_stmt use_database_stmt drop_database_stmt show_database_stmt 
 %type <val_s> drop_table_stmt show_table_stmt
 
@@ -70,15 +77,17 @@ void yyerror(const char *s);
 %type <expr> expr factor term condition cond_term where_clause literal literal_list_expr
 %type <expr> aggregate_expr aggregate_term select_expr default_expr
 %type <val_i> logical_op compare_op aggregate_op
-%type <list> select_expr_list select_expr_list_s table_refs
+%type <list> select_expr_list select_expr_list_s table_refs group_clause order_clause order_list
+%type <order_item> order_item
+%type <limit_info> limit_clause
 %type <join_info> table_item
 
 %start sql_stmts
 
 %%
 
-sql_stmts  :  sql_stmt
-		   |  sql_stmts sql_stmt
+sql_stmts  :  sql_stmt            { param_num = 0; execute_end_statement(); }
+		   |  sql_stmts sql_stmt  { param_num = 0; execute_end_statement(); }
 		   ;
 
 sql_stmt   :  create_table_stmt ';'    { execute_create_table($1); }
@@ -89,23 +98,48 @@ sql_stmt   :  create_table_stmt ';'    { execute_create_table($1); }
 		   |  show_table_stmt ';'      { execute_show_table($1); }
 		   |  drop_table_stmt ';'      { execute_drop_table($1); }
 		   |  insert_stmt ';'          { execute_insert($1); }
+		   |  COPY insert_columns FROM STRING_LITERAL ';' { execute_copy($2, $4); }
 		   |  update_stmt ';'          { execute_update($1); }
 		   |  delete_stmt ';'          { execute_delete($1); }
 		   |  select_stmt ';'          { execute_select($1); }
-		   |  EXIT ';'                 { execute_quit(); exit(0); }
+		   |  EXPLAIN select_stmt ';'  { execute_explain($2, 0); }
+		   |  EXPLAIN ANALYZE select_stmt ';' { execute_explain($3, 1); }
+		   |  SHOW STATS ';'           { execute_show_stats(); }
+		   |  EXIT ';'                 { if(execute_exit()) exit(0); YYACCEPT; }
 		   |  SET OUTPUT '=' STRING_LITERAL ';'  { execute_switch_output($4); }
-		   |  CREATE INDEX table_name '(' IDENTIFIER ')' ';' { execute_create_index($3, $5); }
+		   |  SET IDENTIFIER '=' INT_LITERAL ';' { execute_set_variable($2, $4); }
+		   |  SET IDENTIFIER '=' STRING_LITERAL ';' { execute_set_string_variable($2, $4); }
+		   |  CREATE INDEX table_name '(' IDENTIFIER ')' index_method ';' { execute_create_index($3, $5, $7); }
 		   |  DROP   INDEX table_name '(' IDENTIFIER ')' ';' { execute_drop_index($3, $5); }
+		   |  ANALYZE table_name ';'   { execute_analyze($2); }
+		   |  VACUUM table_name ';'    { execute_vacuum($2); }
+		   |  PREPARE IDENTIFIER AS select_stmt ';' { execute_prepare($2, PREPARED_SELECT, $4); }
+		   |  PREPARE IDENTIFIER AS insert_stmt ';' { execute_prepare($2, PREPARED_INSERT, $4); }
+		   |  PREPARE IDENTIFIER AS update_stmt ';' { execute_prepare($2, PREPARED_UPDATE, $4); }
+		   |  PREPARE IDENTIFIER AS delete_stmt ';' { execute_prepare($2, PREPARED_DELETE, $4); }
+		   |  EXECUTE IDENTIFIER ';'   { execute_prepared($2, NULL); }
+		   |  EXECUTE IDENTIFIER USING expr_list ';' { execute_prepared($2, $4); }
+		   |  DEALLOCATE IDENTIFIER ';'         { execute_deallocate($2); }
+		   |  DEALLOCATE PREPARE IDENTIFIER ';' { execute_deallocate($3); }
 		   ;
 
-create_table_stmt : CREATE TABLE table_name '(' table_fields table_extra_options ')' {
-				  	$$ = (table_def_t*)malloc(sizeof(table_def_t));
+create_table_stmt : CREATE TABLE table_name '(' table_fields table_extra_options ')' table_engine {
+				  	$$ = (table_def_t*)parser_alloc(sizeof(table_def_t));
 					$$->name = $3;
 					$$->fields = $5;
 					$$->constraints = $6;
+					$$->engine = $8;
 				  }
 				  ;
 
+table_engine : /* empty */             { $$ = NULL; }
+			 | ENGINE '=' IDENTIFIER   { $$ = $3; }
+			 ;
+
+index_method : /* empty */             { $$ = NULL; }
+			 | USING IDENTIFIER        { $$ = $2; }
+			 ;
+
 create_database_stmt : CREATE DATABASE database_name   { $$ = $3; };
 use_database_stmt    : USE database_name               { $$ = $2; };
 drop_database_stmt   : DROP DATABASE database_name     { $$ = $3; };
@@ -119,25 +153,25 @@ insert_stmt          : INSERT INTO insert_columns VALUES insert_values {
 					 ;
 
 insert_values        : '(' expr_list ')' {
-					 	$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+					 	$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 						$$->data = $2;
 						$$->next = NULL;
 					 }
 					 | insert_values ',' '(' expr_list ')' {
-					 	$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+					 	$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 						$$->data = $4;
 						$$->next = $1;
 					 }
 					 ;
 
 insert_columns       : table_name {
-					 	$$ = (insert_info_t*)malloc(sizeof(insert_info_t));
+					 	$$ = (insert_info_t*)parser_alloc(sizeof(insert_info_t));
 						$$->table   = $1;
 						$$->columns = NULL;
 						$$->values  = NULL;
 					 }
 					 | table_name '(' column_list ')' {
-					 	$$ = (insert_info_t*)malloc(sizeof(insert_info_t));
+					 	$$ = (insert_info_t*)parser_alloc(sizeof(insert_info_t));
 						$$->table   = $1;
 						$$->columns = $3;
 						$$->values  = NULL;
@@ -145,14 +179,14 @@ insert_columns       : table_name {
 					 ;
 
 delete_stmt         : DELETE FROM table_name where_clause {
-					 	$$ = (delete_info_t*)malloc(sizeof(delete_info_t));
+					 	$$ = (delete_info_t*)parser_alloc(sizeof(delete_info_t));
 						$$->table = $3;
 						$$->where = $4;
 					}
 					;
 
 update_stmt         : UPDATE table_name SET column_ref '=' expr where_clause {
-					 	$$ = (update_info_t*)malloc(sizeof(update_info_t));
+					 	$$ = (update_info_t*)parser_alloc(sizeof(update_info_t));
 						$$->table = $2;
 						$$->value = $6;
 						$$->where = $7;
@@ -160,33 +194,86 @@ update_stmt         : UPDATE table_name SET column_ref '=' expr where_clause {
 					}
 					;
 
-select_stmt         : SELECT select_expr_list_s FROM table_refs where_clause {
-					 	$$ = (select_info_t*)malloc(sizeof(select_info_t));
+select_stmt         : SELECT select_expr_list_s FROM table_refs where_clause group_clause order_clause limit_clause {
+					 	$$ = (select_info_t*)parser_alloc(sizeof(select_info_t));
 						$$->tables = $4;
 						$$->exprs  = $2;
 						$$->where  = $5;
+						$$->group_by = $6;
+						$$->order_by = $7;
+						$$->limit  = $8;
+					}
+					;
+
+group_clause        : GROUP BY expr_list { $$ = $3; }
+					| /* empty */        { $$ = NULL; }
+					;
+
+order_clause        : ORDER BY order_list { $$ = $3; }
+					| /* empty */         { $$ = NULL; }
+					;
+
+order_list          : order_list ',' order_item {
+						$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
+						$$->data = $3;
+						$$->next = $1;
+					}
+					| order_item {
+						$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
+						$$->data = $1;
+						$$->next = NULL;
 					}
 					;
 
+order_item          : expr {
+						$$ = (order_by_item_t*)parser_alloc(sizeof(order_by_item_t));
+						$$->expr = $1;
+						$$->desc = 0;
+					}
+					| expr ASC {
+						$$ = (order_by_item_t*)parser_alloc(sizeof(order_by_item_t));
+						$$->expr = $1;
+						$$->desc = 0;
+					}
+					| expr DESC {
+						$$ = (order_by_item_t*)parser_alloc(sizeof(order_by_item_t));
+						$$->expr = $1;
+						$$->desc = 1;
+					}
+					;
+
+limit_clause        : LIMIT INT_LITERAL {
+						$$ = (limit_info_t*)parser_alloc(sizeof(limit_info_t));
+						$$->offset = 0;
+						$$->count  = $2;
+					}
+					| LIMIT INT_LITERAL ',' INT_LITERAL {
+						$$ = (limit_info_t*)parser_alloc(sizeof(limit_info_t));
+						$$->offset = $2;
+						$$->count  = $4;
+					}
+					| /* empty */ { $$ = NULL; }
+					;
+
 table_refs          : table_refs ',' table_item {
-						$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+						$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 						$$->data = $3;
 						$$->next = $1;
 					}
 					| table_item {
-						$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+						$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 						$$->data = $1;
 						$$->next = NULL;
 					}
 					;
 
 table_item          : table_name {
-					 	$$ = (table_join_info_t*)calloc(1, sizeof(table_join_info_t));
+					 	$$ = (table_join_info_t*)parser_calloc(sizeof(table_join_info_t));
 						$$->join_type = TABLE_JOIN_NONE;
 						$$->table = $1;
 					}
 				    | table_name AS IDENTIFIER {
-					 	$$ = (table_join_info_t*)calloc(1, sizeof(table_join_info_t));
+					 	$$ = (table_join_info_t*)parser_calloc(sizeof(table_join_info_t));
 						$$->join_type = TABLE_JOIN_NONE;
 						$$->table = $1;
 						$$->alias = $3;
@@ -197,12 +284,12 @@ select_expr_list_s  : select_expr_list { $$ = $1; }
 					| '*'              { $$ = NULL; }
 
 select_expr_list    : select_expr_list ',' select_expr {
-						$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+						$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 						$$->data = $3;
 						$$->next = $1;
 					}
 					| select_expr {
-						$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+						$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 						$$->data = $1;
 						$$->next = NULL;
 					}
@@ -212,24 +299,24 @@ select_expr         : expr            { $$ = $1; }
 					| aggregate_expr  { $$ = $1; }
 
 aggregate_expr      : aggregate_op '(' aggregate_term ')' {
-						$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+						$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 						$$->left  = $3;
 						$$->op    = $1;
 					}
 					| COUNT '(' aggregate_term ')' {
-						$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+						$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 						$$->left  = $3;
 						$$->op    = OPERATOR_COUNT;
 					}
 					| COUNT '(' '*' ')' {
-						$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+						$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 						$$->left  = NULL;
 						$$->op    = OPERATOR_COUNT;
 					}
 					;
 
 aggregate_term      : column_ref {
-						$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+						$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 						$$->column_ref = $1;
 						$$->term_type  = TERM_COLUMN_REF;
 					}
@@ -250,65 +337,67 @@ table_extra_options : ',' table_extra_option_list  { $$ = $2; }
 					;
 
 table_extra_option_list : table_extra_option_list ',' table_extra_option {
-							$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+							$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 							$$->data = $3;
 							$$->next = $1;
 						}
 						| table_extra_option {
-							$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+							$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 							$$->data = $1;
 							$$->next = NULL;
 						}
 						;
 
-table_extra_option : PRIMARY KEY '(' IDENTIFIER ')' {
-				   	$$ = (table_constraint_t*)calloc(1, sizeof(table_constraint_t));
-					$$->column_ref = (column_ref_t*)malloc(sizeof(column_ref_t));
+table_extra_option : PRIMARY KEY '(' IDENTIFIER ')' index_method {
+				   	$$ = (table_constraint_t*)parser_calloc(sizeof(table_constraint_t));
+					$$->column_ref = (column_ref_t*)parser_alloc(sizeof(column_ref_t));
 					$$->column_ref->table = NULL;
 					$$->column_ref->column = $4;
 					$$->type = TABLE_CONSTRAINT_PRIMARY_KEY;
+					$$->index_method = $6;
 				   }
 				   | FOREIGN KEY '(' IDENTIFIER ')' REFERENCES IDENTIFIER '(' IDENTIFIER ')' {
-				   	$$ = (table_constraint_t*)calloc(1, sizeof(table_constraint_t));
-					$$->column_ref = (column_ref_t*)malloc(sizeof(column_ref_t));
+				   	$$ = (table_constraint_t*)parser_calloc(sizeof(table_constraint_t));
+					$$->column_ref = (column_ref_t*)parser_alloc(sizeof(column_ref_t));
 					$$->column_ref->table = NULL;
 					$$->column_ref->column = $4;
-					$$->foreign_column_ref = (column_ref_t*)malloc(sizeof(column_ref_t));
+					$$->foreign_column_ref = (column_ref_t*)parser_alloc(sizeof(column_ref_t));
 					$$->foreign_column_ref->table = $7;
 					$$->foreign_column_ref->column = $9;
 					$$->type = TABLE_CONSTRAINT_FOREIGN_KEY;
 				   }
-				   | UNIQUE '(' column_ref ')' {
-				   	$$ = (table_constraint_t*)calloc(1, sizeof(table_constraint_t));
+				   | UNIQUE '(' column_ref ')' index_method {
+				   	$$ = (table_constraint_t*)parser_calloc(sizeof(table_constraint_t));
 					$$->type = TABLE_CONSTRAINT_UNIQUE;
 					$$->column_ref = $3;
+					$$->index_method = $5;
 				   }
 				   | CHECK '(' condition ')' {
-				   	$$ = (table_constraint_t*)calloc(1, sizeof(table_constraint_t));
+				   	$$ = (table_constraint_t*)parser_calloc(sizeof(table_constraint_t));
 					$$->type = TABLE_CONSTRAINT_CHECK;
 					$$->check_cond = $3;
 				   }
 				   ;
 
 column_ref   : IDENTIFIER {
-			 	$$ = (column_ref_t*)malloc(sizeof(column_ref_t));
+			 	$$ = (column_ref_t*)parser_alloc(sizeof(column_ref_t));
 				$$->table  = NULL;
 				$$->column = $1;
 			 }
 			 | table_name '.' IDENTIFIER {
-			 	$$ = (column_ref_t*)malloc(sizeof(column_ref_t));
+			 	$$ = (column_ref_t*)parser_alloc(sizeof(column_ref_t));
 				$$->table  = $1;
 				$$->column = $3;
 			 }
 			 ;
 
 column_list  : column_list ',' column_ref {
-				$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+				$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 				$$->data = $3;
 				$$->next = $1;
 			 }
 			 | column_ref {
-			 	$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+			 	$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 				$$->data = $1;
 				$$->next = NULL;
 			 }
@@ -320,7 +409,7 @@ table_fields : table_field                  { $$ = $1; }
 			 ;
 
 table_field  : IDENTIFIER field_type field_width field_flags default_expr {
-			 	$$ = (field_item_t*)malloc(sizeof(field_item_t));
+			 	$$ = (field_item_t*)parser_alloc(sizeof(field_item_t));
 				$$->name = $1;
 				$$->type = $2;
 				$$->width = $3;
@@ -367,7 +456,7 @@ compare_op : '='  { $$ = OPERATOR_EQ; }
 		   ;
 
 condition  : condition logical_op cond_term {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->right = $3;
 				$$->op    = $2;
@@ -376,65 +465,65 @@ condition  : condition logical_op cond_term {
 		   ;
 
 cond_term  : expr compare_op expr {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->right = $3;
 				$$->op    = $2;
 		   }
 		   | expr IN '(' literal_list_expr ')' {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->right = $4;
 				$$->op    = OPERATOR_IN;
 		   }
 		   | expr IS NULL_TOKEN {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->op    = OPERATOR_ISNULL;
 		   }
 		   | expr IS NOT NULL_TOKEN {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->op    = OPERATOR_NOTNULL;
 		   }
 		   | NOT cond_term {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $2;
 				$$->op    = OPERATOR_NOT;
 		   }
 		   | '(' condition ')' { $$ = $2; }
 		   | TRUE {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->val_b     = 1;
 				$$->term_type = TERM_BOOL;
 		   }
 		   | FALSE {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->val_b     = 0;
 				$$->term_type = TERM_BOOL;
 		   }
 		   ;
 
 expr_list  : expr_list ',' expr {
-				$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+				$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 				$$->data = $3;
 				$$->next = $1;
 		   }
 		   | expr {
-				$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+				$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 				$$->data = $1;
 				$$->next = NULL;
 		   }
 		   ;
 
 expr       : expr '+' factor {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->right = $3;
 				$$->op    = OPERATOR_ADD;
 		   }
 		   | expr '-' factor {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->right = $3;
 				$$->op    = OPERATOR_MINUS;
@@ -443,13 +532,13 @@ expr       : expr '+' factor {
 		   ;
 
 factor     : factor '*' term {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->right = $3;
 				$$->op    = OPERATOR_MUL;
 		   }
 		   | factor '/' term {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $1;
 				$$->right = $3;
 				$$->op    = OPERATOR_DIV;
@@ -458,59 +547,64 @@ factor     : factor '*' term {
 		   ;
 
 term       : column_ref {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->column_ref = $1;
 				$$->term_type  = TERM_COLUMN_REF;
 		   }
 		   | '-' term {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->left  = $2;
 				$$->op    = OPERATOR_NEGATE;
 		   }
 		   | literal      { $$ = $1; }
 		   | NULL_TOKEN {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->term_type  = TERM_NULL;
 		   }
+		   | '?' {
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
+				$$->val_i      = param_num++;
+				$$->term_type  = TERM_PARAM;
+		   }
 		   | '(' expr ')' { $$ = $2; }
 		   ;
 
 literal    : INT_LITERAL {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->val_i      = $1;
 				$$->term_type  = TERM_INT;
 		   }
 		   | FLOAT_LITERAL {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->val_f      = $1;
 				$$->term_type  = TERM_FLOAT;
 		   }
 		   | DATE_LITERAL {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->val_s      = $1;
 				$$->term_type  = TERM_DATE;
 		   }
 		   | STRING_LITERAL {
-		   		$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+		   		$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 				$$->val_s      = $1;
 				$$->term_type  = TERM_STRING;
 		   }
 		   ;
 
 literal_list : literal_list ',' literal {
-				$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+				$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 				$$->data = $3;
 				$$->next = $1;
 			 }
 			 | literal {
-				$$ = (linked_list_t*)malloc(sizeof(linked_list_t));
+				$$ = (linked_list_t*)parser_alloc(sizeof(linked_list_t));
 				$$->data = $1;
 				$$->next = NULL;
 			 }
 			 ;
 
 literal_list_expr : literal_list {
-					$$ = (expr_node_t*)calloc(1, sizeof(expr_node_t));
+					$$ = (expr_node_t*)parser_calloc(sizeof(expr_node_t));
 					$$->literal_list = $1;
 					$$->term_type    = TERM_LITERAL_LIST;
 				  }
@@ -534,9 +628,10 @@ int yywrap()
 	return 1;
 }
 
-char run_parser(const char *input)
+char run_statements(const char *input)
 {
 	char ret;
+	param_num = 0;
 	if(input) {
 		YY_BUFFER_STATE buf = yy_scan_string(input);
 		yy_switch_to_buffer(buf);
@@ -546,7 +641,14 @@ char run_parser(const char *input)
 		ret = yyparse();
 	}
 
-	execute_quit();
+	// what is left of a statement not parsed
+	execute_end_statement();
+	return ret;
+}
 
+char run_parser(const char *input)
+{
+	char ret = run_statements(input);
+	execute_quit();
 	return ret;
 }
@@ -0,0 +1,430 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cassert>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "server.h"
+#include "../defs.h"
+#include "../database/dbms.h"
+#include "../parser/execute.h"
+
+extern "C" char run_statements(const char *input);
+
+/* the server prints to the stderr it starts with, see output_capture */
+static FILE *log_file = stderr;
+static int stop_fd = -1;
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int)
+{
+	stop_requested = 1;
+	char c = 's';
+	if(write(stop_fd, &c, 1) < 0) {}
+}
+
+static bool set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+namespace {
+
+/* What a request prints is taken by pointing stdout and stderr to
+ * streams in memory while it runs (glibc lets them be assigned). It is
+ * safe since one request runs at a time, and the server itself prints
+ * to `log_file`. */
+class output_capture
+{
+	FILE *saved[2], *streams[2];
+	char *bufs[2];
+	size_t sizes[2];
+	bool finished;
+
+public:
+	output_capture() : finished(false)
+	{
+		saved[0] = stdout;
+		saved[1] = stderr;
+		for(int i = 0; i != 2; ++i)
+		{
+			bufs[i] = nullptr;
+			sizes[i] = 0;
+			streams[i] = open_memstream(&bufs[i], &sizes[i]);
+		}
+
+		if(streams[0]) stdout = streams[0];
+		if(streams[1]) stderr = streams[1];
+	}
+
+	~output_capture()
+	{
+		if(!finished)
+		{
+			std::string out, err;
+			finish(out, err);
+		}
+	}
+
+	void finish(std::string &out, std::string &err)
+	{
+		stdout = saved[0];
+		stderr = saved[1];
+		std::string *dst[2] = { &out, &err };
+		for(int i = 0; i != 2; ++i)
+		{
+			if(!streams[i]) continue;
+			std::fclose(streams[i]);
+			dst[i]->assign(bufs[i], sizes[i]);
+			std::free(bufs[i]);
+		}
+
+		finished = true;
+	}
+};
+
+}
+
+server::server() : listen_fd(-1), next_id(0), workers_stop(false)
+{
+	wake_fd[0] = wake_fd[1] = -1;
+}
+
+server::~server()
+{
+	if(listen_fd >= 0) close(listen_fd);
+	if(wake_fd[0] >= 0) close(wake_fd[0]);
+	if(wake_fd[1] >= 0) close(wake_fd[1]);
+}
+
+void server::append_frame(std::string &out, uint8_t type, const char *data, size_t size)
+{
+	uint32_t len = htonl((uint32_t)size);
+	out.push_back((char)type);
+	out.append((const char*)&len, 4);
+	out.append(data, size);
+}
+
+bool server::run(const char *address, int port, int worker_num)
+{
+	sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if(address && inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+	{
+		std::fprintf(stderr, "[Error] Invalid address `%s`.\n", address);
+		return false;
+	}
+
+	int on = 1;
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(listen_fd < 0
+		|| setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0
+		|| bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0
+		|| listen(listen_fd, SERVER_BACKLOG) != 0
+		|| !set_nonblocking(listen_fd)
+		|| pipe(wake_fd) != 0
+		|| !set_nonblocking(wake_fd[0]) || !set_nonblocking(wake_fd[1]))
+	{
+		std::fprintf(stderr, "[Error] Fail to listen at port %d: %s.\n", port, std::strerror(errno));
+		return false;
+	}
+
+	log_file = stderr;
+	stop_fd = wake_fd[1];
+	struct sigaction act;
+	std::memset(&act, 0, sizeof(act));
+	act.sa_handler = on_stop_signal;
+	sigaction(SIGINT, &act, nullptr);
+	sigaction(SIGTERM, &act, nullptr);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	std::printf("[Info] Listening at %s:%d with %d worker(s).\n",
+		address ? address : "*", port, worker_num);
+	std::fflush(stdout);
+	for(int i = 0; i != worker_num; ++i)
+		workers.emplace_back(&server::worker_main, this);
+
+	bool stopping = false;
+	std::vector<pollfd> fds;
+	std::vector<uint64_t> ids;
+	while(!stopping || !conns.empty())
+	{
+		fds.clear();
+		ids.clear();
+		fds.push_back({ wake_fd[0], POLLIN, 0 });
+		fds.push_back({ stopping ? -1 : listen_fd, POLLIN, 0 });
+		for(auto &p : conns)
+		{
+			connection_t *conn = p.second;
+			if(conn->fd < 0) continue;
+			short events = 0;
+			if(!conn->eof && !conn->hung_up && conn->in.size() < SERVER_MAX_REQUEST + 5)
+				events |= POLLIN;
+			if(conn->out_pos != conn->out.size())
+				events |= POLLOUT;
+			fds.push_back({ conn->fd, events, 0 });
+			ids.push_back(p.first);
+		}
+
+		if(poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if(errno == EINTR) continue;
+			std::fprintf(log_file, "[Error] poll: %s.\n", std::strerror(errno));
+			break;
+		}
+
+		if(fds[0].revents & POLLIN)
+		{
+			char buf[64];
+			while(read(wake_fd[0], buf, sizeof(buf)) > 0);
+			take_results();
+		}
+
+		if(stop_requested && !stopping)
+		{
+			stopping = true;
+			for(auto &p : conns)
+				p.second->closing = true;
+		}
+
+		if(fds[1].revents & POLLIN)
+			accept_clients();
+
+		for(size_t i = 0; i != ids.size(); ++i)
+		{
+			auto it = conns.find(ids[i]);
+			short revents = fds[i + 2].revents;
+			if(it == conns.end() || !revents) continue;
+			connection_t *conn = it->second;
+			if(revents & POLLIN)
+				read_requests(it->first, conn);
+			else if(revents & (POLLERR | POLLHUP | POLLNVAL))
+				conn->hung_up = true;
+			if((revents & POLLOUT) && !conn->hung_up)
+				send_responses(conn);
+		}
+
+		for(auto &p : conns)
+			dispatch(p.first, p.second);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(job_lock);
+		workers_stop = true;
+		job_cv.notify_all();
+	}
+
+	for(std::thread &t : workers)
+		t.join();
+	workers.clear();
+	std::printf("[Info] Server stopped.\n");
+	return true;
+}
+
+void server::accept_clients()
+{
+	for(;;)
+	{
+		int fd = accept(listen_fd, nullptr, nullptr);
+		if(fd < 0)
+		{
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				std::fprintf(log_file, "[Error] accept: %s.\n", std::strerror(errno));
+			return;
+		}
+
+		if(conns.size() >= SERVER_MAX_CONNECTIONS || !set_nonblocking(fd))
+		{
+			close(fd);
+			continue;
+		}
+
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		conns[next_id++] = new connection_t(fd);
+	}
+}
+
+void server::read_requests(uint64_t id, connection_t *conn)
+{
+	char buf[1 << 16];
+	while(conn->in.size() < SERVER_MAX_REQUEST + 5)
+	{
+		ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+		if(n > 0)
+		{
+			conn->in.append(buf, n);
+		} else if(n == 0) {
+			// the requests read are still answered
+			conn->eof = true;
+			return;
+		} else {
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				debug_printf("[Debug] Client %llu: %s.\n", (unsigned long long)id, std::strerror(errno));
+				conn->hung_up = true;
+			}
+
+			return;
+		}
+	}
+
+	UNUSED(id);
+}
+
+void server::send_responses(connection_t *conn)
+{
+	while(conn->out_pos != conn->out.size())
+	{
+		ssize_t n = send(conn->fd, conn->out.data() + conn->out_pos,
+			conn->out.size() - conn->out_pos, MSG_NOSIGNAL);
+		if(n < 0)
+		{
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				conn->hung_up = true;
+			return;
+		}
+
+		conn->out_pos += n;
+	}
+
+	conn->out.clear();
+	conn->out_pos = 0;
+}
+
+/* Hand the next request of an idle connection to the workers, or its
+ * session to be closed once it is done. */
+void server::dispatch(uint64_t id, connection_t *conn)
+{
+	if(conn->busy)
+		return;
+
+	job_t job { id, conn, std::string() };
+	if(!conn->hung_up && !conn->closing && conn->in.size() >= 5)
+	{
+		uint32_t len;
+		std::memcpy(&len, conn->in.data() + 1, 4);
+		len = ntohl(len);
+		if((uint8_t)conn->in[0] != FRAME_QUERY || len > SERVER_MAX_REQUEST)
+		{
+			std::fprintf(log_file, "[Error] Bad request from client %llu, disconnected.\n",
+				(unsigned long long)id);
+			conn->hung_up = true;
+		} else if(conn->in.size() >= len + 5) {
+			job.sql = conn->in.substr(5, len);
+			conn->in.erase(0, len + 5);
+			if(job.sql.empty())
+				job.sql = " ";  // empty is for closing
+		}
+	}
+
+	bool sent = conn->out_pos == conn->out.size();
+	if(job.sql.empty() && !conn->hung_up && !((conn->closing || conn->eof) && sent))
+		return;
+
+	if(job.sql.empty() && conn->fd >= 0)
+	{
+		close(conn->fd);
+		conn->fd = -1;
+	}
+
+	conn->busy = true;
+	std::lock_guard<std::mutex> guard(job_lock);
+	jobs.push_back(std::move(job));
+	job_cv.notify_one();
+}
+
+void server::take_results()
+{
+	std::vector<result_t> done;
+	{
+		std::lock_guard<std::mutex> guard(job_lock);
+		done.swap(results);
+	}
+
+	for(result_t &r : done)
+	{
+		auto it = conns.find(r.id);
+		assert(it != conns.end());
+		connection_t *conn = it->second;
+		conn->busy = false;
+		if(r.released)
+		{
+			delete conn;
+			conns.erase(it);
+		} else if(!conn->hung_up) {
+			conn->out += r.response;
+			conn->closing |= r.session_closed;
+			send_responses(conn);
+		}
+	}
+}
+
+void server::worker_main()
+{
+	for(;;)
+	{
+		job_t job;
+		{
+			std::unique_lock<std::mutex> guard(job_lock);
+			job_cv.wait(guard, [this] { return !jobs.empty() || workers_stop; });
+			if(jobs.empty())
+				return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		result_t result;
+		run_job(job, result);
+		{
+			std::lock_guard<std::mutex> guard(job_lock);
+			results.push_back(std::move(result));
+		}
+
+		char c = 'r';
+		if(write(wake_fd[1], &c, 1) < 0) {}
+	}
+}
+
+/* Run the statements of a request in the session of its client. */
+void server::run_job(job_t &job, result_t &result)
+{
+	session_t &s = job.conn->session;
+	result.id = job.id;
+	result.released = job.sql.empty();
+	dbms *db = dbms::get_instance();
+
+	std::lock_guard<std::mutex> guard(exec_lock);
+	output_capture capture;
+	db->switch_session(&s);
+	char ret = 0;
+	if(result.released)
+		execute_close_session();
+	else ret = run_statements(job.sql.c_str());
+	db->switch_session(nullptr);
+
+	std::string out, err;
+	capture.finish(out, err);
+	result.session_closed = s.closed;
+	if(result.released)
+		return;
+
+	if(!out.empty())
+		append_frame(result.response, FRAME_OUTPUT, out.data(), out.size());
+	if(!err.empty())
+		append_frame(result.response, FRAME_ERROR, err.data(), err.size());
+	char status = s.closed ? DONE_CLOSED : ret ? DONE_SYNTAX_ERROR : DONE_OK;
+	append_frame(result.response, FRAME_DONE, &status, 1);
+}
@@ -0,0 +1,100 @@
+#ifndef __TRIVIALDB_SERVER__
+#define __TRIVIALDB_SERVER__
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <stdint.h>
+#include "../database/session.h"
+
+/* Serve many clients in one process, which share the page cache. The
+ * event loop accepts the connections, reads the requests and sends the
+ * responses, and the requests are run by a pool of workers. A client
+ * has its own session, and its requests run in order. The statements
+ * still run one at a time, since the tables are not shared safely by
+ * the threads, but a slow client does not hold up the others.
+ *
+ * Each message is a frame: a one-byte type, the length of the payload
+ * in four bytes in network order, and the payload. A client sends the
+ * statements in a FRAME_QUERY, and the server answers with what they
+ * printed to stdout (the rows selected and the messages) in a
+ * FRAME_OUTPUT and what they printed to stderr (the errors) in a
+ * FRAME_ERROR, each only if not empty, followed by a FRAME_DONE of one
+ * byte, one of the DONE_ statuses. */
+class server
+{
+public:
+	enum : uint8_t
+	{
+		FRAME_QUERY = 'Q', FRAME_OUTPUT = 'O', FRAME_ERROR = 'E', FRAME_DONE = 'D'
+	};
+
+	enum : uint8_t { DONE_OK, DONE_SYNTAX_ERROR, DONE_CLOSED };
+
+private:
+	struct connection_t
+	{
+		int fd;
+		session_t session;
+		std::string in, out;
+		size_t out_pos;
+		bool busy;     // a request or the close is being run by a worker
+		bool eof;      // closed once the requests read are answered
+		bool closing;  // closed once the responses are sent
+		bool hung_up;  // nothing more is sent or read
+
+		connection_t(int fd)
+			: fd(fd), out_pos(0), busy(false), eof(false), closing(false), hung_up(false) {}
+	};
+
+	struct job_t
+	{
+		uint64_t id;
+		connection_t *conn;
+		std::string sql;  // empty to close the session
+	};
+
+	struct result_t
+	{
+		uint64_t id;
+		std::string response;
+		bool session_closed;  // by EXIT
+		bool released;        // the connection can be deleted
+	};
+
+	int listen_fd, wake_fd[2];
+	uint64_t next_id;
+	std::map<uint64_t, connection_t*> conns;
+
+	std::mutex exec_lock;  // the statements run one at a time
+	std::mutex job_lock;
+	std::condition_variable job_cv;
+	std::deque<job_t> jobs;
+	std::vector<result_t> results;  // guarded by `job_lock`
+	bool workers_stop;
+	std::vector<std::thread> workers;
+
+	void worker_main();
+	void run_job(job_t &job, result_t &result);
+	void accept_clients();
+	void read_requests(uint64_t id, connection_t *conn);
+	void send_responses(connection_t *conn);
+	void dispatch(uint64_t id, connection_t *conn);
+	void take_results();
+
+public:
+	server();
+	~server();
+
+	/* Listen at `address` (nullptr for all addresses) and `port`, and
+	 * serve until SIGINT or SIGTERM. Returns false if fails to listen. */
+	bool run(const char *address, int port, int worker_num);
+
+	static void append_frame(std::string &out, uint8_t type, const char *data, size_t size);
+};
+
+#endif
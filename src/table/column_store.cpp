@@ -0,0 +1,456 @@
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <limits>
+#include <algorithm>
+#include <unistd.h>
+#include "column_store.h"
+#include "table.h"
+
+/* kept in the metadata of the file */
+struct column_store_meta_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t col_num, group_num;
+	uint32_t dir_offset, dir_bytes;
+};
+
+namespace {
+
+/* The values are encoded as unsigned, an INT or DATE with its sign bit
+ * flipped so that the order is kept, a FLOAT as its bits. */
+inline uint32_t to_key(int type, const char *p)
+{
+	uint32_t key;
+	std::memcpy(&key, p, sizeof(key));
+	return type == COL_TYPE_FLOAT ? key : key ^ 0x80000000u;
+}
+
+inline int bit_width(uint32_t v)
+{
+	return v ? 32 - __builtin_clz(v) : 0;
+}
+
+inline uint32_t packed_size(int rows, int bits)
+{
+	return ((uint64_t)rows * bits + 7) / 8;
+}
+
+/* The values of `bits` bits are packed one after another, they are read
+ * and written a 64-bit word at a time, so 8 bytes are kept after them. */
+void pack(std::vector<char> &out, const uint32_t *v, int rows, int bits)
+{
+	size_t base = out.size();
+	out.resize(base + packed_size(rows, bits) + 8, 0);
+	char *p = out.data() + base;
+	for(int i = 0; i != rows && bits; ++i)
+	{
+		uint64_t pos = (uint64_t)i * bits, word;
+		std::memcpy(&word, p + pos / 8, sizeof(word));
+		word |= (uint64_t)v[i] << (pos % 8);
+		std::memcpy(p + pos / 8, &word, sizeof(word));
+	}
+
+	out.resize(base + packed_size(rows, bits));
+}
+
+void unpack(const char *p, int rows, int bits, uint32_t *out)
+{
+	if(bits == 0)
+	{
+		std::fill(out, out + rows, 0);
+		return;
+	}
+
+	uint64_t mask = (1ull << bits) - 1;
+	for(int i = 0; i != rows; ++i)
+	{
+		uint64_t pos = (uint64_t)i * bits, word;
+		std::memcpy(&word, p + pos / 8, sizeof(word));
+		out[i] = (word >> (pos % 8)) & mask;
+	}
+}
+
+template<typename T>
+void append(std::vector<char> &out, const T *v, size_t num)
+{
+	const char *p = reinterpret_cast<const char*>(v);
+	out.insert(out.end(), p, p + num * sizeof(T));
+}
+
+/* Encode column `cid` of the records into `out`, and fill the segment
+ * but its offset. */
+void encode_column(const char *records, int record_size, int rows,
+	int cid, int offset, int type, column_segment_t &seg, std::vector<char> &out)
+{
+	std::vector<uint32_t> keys(rows);
+	std::vector<char> bitmap((rows + 7) / 8, 0);
+	std::memset(&seg, 0, sizeof(seg));
+	bool numeric = type != COL_TYPE_VARCHAR;
+	bool first = true;
+	uint32_t prev = 0;
+	for(int i = 0; i != rows; ++i)
+	{
+		const char *rec = records + (size_t)i * record_size;
+		if((((const int*)rec)[1] >> cid) & 1)
+		{
+			++seg.nulls;
+			bitmap[i / 8] |= 1 << (i % 8);
+			continue;
+		}
+
+		if(!numeric) continue;
+		prev = keys[i] = to_key(type, rec + offset);
+		if(type == COL_TYPE_FLOAT)
+		{
+			float v;
+			std::memcpy(&v, rec + offset, sizeof(v));
+			if(first || v < seg.min_f) seg.min_f = v;
+			if(first || v > seg.max_f) seg.max_f = v;
+		} else {
+			int v;
+			std::memcpy(&v, rec + offset, sizeof(v));
+			if(first || v < seg.min_i) seg.min_i = v;
+			if(first || v > seg.max_i) seg.max_i = v;
+		}
+
+		if(first)
+		{
+			// the NULLs before take the first value
+			for(int j = 0; j != i; ++j)
+				keys[j] = prev;
+			first = false;
+		}
+	}
+
+	// the NULLs take the value before them, so that the runs go on
+	for(int i = 1; i < rows; ++i)
+	{
+		if((unsigned char)bitmap[i / 8] >> (i % 8) & 1)
+			keys[i] = keys[i - 1];
+	}
+
+	out.clear();
+	if(seg.nulls) out = bitmap;
+	seg.encoding = column_store::ENC_NONE;
+	if(!numeric) return;
+
+	uint32_t lo = *std::min_element(keys.begin(), keys.end());
+	uint32_t hi = *std::max_element(keys.begin(), keys.end());
+	int for_bits = bit_width(hi - lo);
+
+	std::vector<uint32_t> dict(keys);
+	std::sort(dict.begin(), dict.end());
+	dict.erase(std::unique(dict.begin(), dict.end()), dict.end());
+	int dict_bits = bit_width(dict.size() - 1);
+
+	std::vector<uint32_t> run_values;
+	std::vector<uint16_t> run_lengths;
+	for(int i = 0; i != rows; ++i)
+	{
+		if(i && keys[i] == run_values.back()
+			&& run_lengths.back() != std::numeric_limits<uint16_t>::max())
+		{
+			++run_lengths.back();
+		} else {
+			run_values.push_back(keys[i]);
+			run_lengths.push_back(1);
+		}
+	}
+
+	uint64_t size[4];
+	size[column_store::ENC_NONE] = (uint64_t)rows * 4;
+	size[column_store::ENC_FOR] = packed_size(rows, for_bits);
+	size[column_store::ENC_DICT] = dict.size() <= COLUMN_DICT_MAX_SIZE
+		? dict.size() * 4 + packed_size(rows, dict_bits)
+		: std::numeric_limits<uint64_t>::max();
+	size[column_store::ENC_RLE] = run_values.size() * 6;
+	int enc = std::min_element(size, size + 4) - size;
+
+	seg.encoding = enc;
+	switch(enc)
+	{
+		case column_store::ENC_NONE:
+			append(out, keys.data(), rows);
+			break;
+		case column_store::ENC_FOR:
+			seg.ref = lo;
+			seg.bits = for_bits;
+			for(uint32_t &k : keys)
+				k -= lo;
+			pack(out, keys.data(), rows, for_bits);
+			break;
+		case column_store::ENC_DICT:
+			seg.ref = dict.size();
+			seg.bits = dict_bits;
+			append(out, dict.data(), dict.size());
+			for(uint32_t &k : keys)
+				k = std::lower_bound(dict.begin(), dict.end(), k) - dict.begin();
+			pack(out, keys.data(), rows, dict_bits);
+			break;
+		case column_store::ENC_RLE:
+			seg.ref = run_values.size();
+			append(out, run_values.data(), run_values.size());
+			append(out, run_lengths.data(), run_lengths.size());
+			break;
+	}
+}
+
+/* Write bytes into pages 1, 2, ... of a new file, one after another. */
+class segment_writer
+{
+	pager *pg;
+	char page[PAGE_SIZE];
+	uint32_t size;
+	int next_pid;
+	bool ok;
+
+	void write_page()
+	{
+		int pid = pg->new_page();
+		ok = ok && pid == next_pid++;
+		if(ok) std::memcpy(pg->read_for_write(pid), page, PAGE_SIZE);
+		std::memset(page, 0, PAGE_SIZE);
+	}
+
+public:
+	explicit segment_writer(pager *pg) : pg(pg), size(0), next_pid(1), ok(true)
+	{
+		std::memset(page, 0, PAGE_SIZE);
+	}
+
+	uint32_t get_size() { return size; }
+	bool good() { return ok; }
+
+	void write(const char *data, uint32_t bytes)
+	{
+		while(bytes)
+		{
+			uint32_t at = size % PAGE_SIZE;
+			uint32_t len = std::min<uint32_t>(bytes, PAGE_SIZE - at);
+			std::memcpy(page + at, data, len);
+			data += len;
+			bytes -= len;
+			size += len;
+			if(size % PAGE_SIZE == 0)
+				write_page();
+		}
+	}
+
+	void finish()
+	{
+		if(size % PAGE_SIZE)
+			write_page();
+	}
+};
+
+}
+
+void column_store::open(const char *filename, uint32_t version)
+{
+	close();
+	this->filename = filename;
+	if(page_fs::get_instance()->is_read_only())
+	{
+		// only a store of the data is read, it is not rebuilt
+		if(access(filename, F_OK) != 0)
+			return;
+		pg = std::make_shared<pager>(filename, false);
+		if(!load(version))
+			close();
+		return;
+	}
+
+	pg = std::make_shared<pager>(filename, false);
+	if(!load(version))
+		reset();
+}
+
+void column_store::close()
+{
+	if(pg) pg->close();
+	pg = nullptr;
+	groups.clear();
+	valid = false;
+}
+
+/* An outdated file is removed at once rather than kept until it is
+ * rebuilt, so that it is never taken for the data of a later version. */
+void column_store::reset()
+{
+	if(pg) pg->close();
+	groups.clear();
+	valid = false;
+	std::remove(filename.c_str());
+	std::remove((filename + ".wal").c_str());
+	pg = std::make_shared<pager>(filename.c_str(), false);
+}
+
+bool column_store::load(uint32_t version)
+{
+	column_store_meta_t meta;
+	pg->get_meta(&meta, sizeof(meta));
+	if(meta.magic != COLUMN_STORE_MAGIC || meta.version != version
+		|| meta.col_num > MAX_COL_NUM)
+		return false;
+
+	size_t group_bytes = sizeof(int) * 3 + sizeof(column_segment_t) * meta.col_num;
+	if(meta.dir_bytes != group_bytes * meta.group_num
+		|| (uint64_t)meta.dir_offset + meta.dir_bytes > (uint64_t)pg->page_num() * PAGE_SIZE)
+		return false;
+
+	std::vector<char> dir(meta.dir_bytes);
+	read_bytes(meta.dir_offset, meta.dir_bytes, dir.data());
+	groups.resize(meta.group_num);
+	const char *p = dir.data();
+	for(column_group_t &g : groups)
+	{
+		std::memset(&g, 0, sizeof(g));
+		std::memcpy(&g.rows, p, sizeof(int) * 3);
+		std::memcpy(g.cols, p + sizeof(int) * 3, sizeof(column_segment_t) * meta.col_num);
+		p += group_bytes;
+	}
+
+	col_num = meta.col_num;
+	this->version = version;
+	return valid = true;
+}
+
+void column_store::read_bytes(uint32_t offset, uint32_t bytes, char *dst)
+{
+	while(bytes)
+	{
+		int pid = 1 + offset / PAGE_SIZE;
+		uint32_t at = offset % PAGE_SIZE;
+		uint32_t len = std::min<uint32_t>(bytes, PAGE_SIZE - at);
+		const char *page = pg->pin(pid);
+		std::memcpy(dst, page + at, len);
+		pg->unpin(pid);
+		dst += len;
+		offset += len;
+		bytes -= len;
+	}
+}
+
+bool column_store::build(table_manager *table, uint32_t version)
+{
+	reset();
+	col_num = table->get_column_num();
+	int record_size = table->get_temp_record_size();
+	std::vector<char> records((size_t)SCAN_BATCH_ROWS * record_size), seg;
+	segment_writer out(pg.get());
+
+	auto it = table->get_record_iterator_lower_bound(std::numeric_limits<int>::min());
+	while(!it.is_end())
+	{
+		column_group_t g;
+		std::memset(&g, 0, sizeof(g));
+		g.pid = it.get().first;
+		g.pos = it.get().second;
+		for(; g.rows != SCAN_BATCH_ROWS && !it.is_end(); it.next())
+		{
+			record_manager rm(table->get_pager());
+			rm.open(it.get(), false);
+			rm.read(records.data() + (size_t)g.rows++ * record_size, record_size);
+		}
+
+		for(int i = 0; i != col_num; ++i)
+		{
+			encode_column(records.data(), record_size, g.rows, i,
+				table->get_column_offset(i), table->get_column_type(i), g.cols[i], seg);
+			g.cols[i].offset = out.get_size();
+			g.cols[i].bytes = seg.size();
+			out.write(seg.data(), seg.size());
+		}
+
+		groups.push_back(g);
+	}
+
+	column_store_meta_t meta;
+	meta.magic = COLUMN_STORE_MAGIC;
+	meta.version = version;
+	meta.col_num = col_num;
+	meta.group_num = groups.size();
+	meta.dir_offset = out.get_size();
+	for(const column_group_t &g : groups)
+	{
+		out.write((const char*)&g.rows, sizeof(int) * 3);
+		out.write((const char*)g.cols, sizeof(column_segment_t) * col_num);
+	}
+
+	meta.dir_bytes = out.get_size() - meta.dir_offset;
+	out.finish();
+	if(!out.good())
+	{
+		std::fprintf(stderr, "[Error] Fail to build the column store `%s`.\n", filename.c_str());
+		reset();
+		return false;
+	}
+
+	pg->set_meta(&meta, sizeof(meta));
+	this->version = version;
+	return valid = true;
+}
+
+void column_store::decode(int g, int cid, int type, column_vector_t &col, std::vector<char> &buf)
+{
+	assert(valid && g < (int)groups.size() && cid < col_num);
+	const column_segment_t &seg = groups[g].cols[cid];
+	int rows = groups[g].rows;
+	buf.resize(seg.bytes + 8);
+	read_bytes(seg.offset, seg.bytes, buf.data());
+
+	const char *p = buf.data();
+	col.nulls.assign(rows, 0);
+	if(seg.nulls)
+	{
+		for(int i = 0; i != rows; ++i)
+			col.nulls[i] = (unsigned char)p[i / 8] >> (i % 8) & 1;
+		p += (rows + 7) / 8;
+	}
+
+	if(type == COL_TYPE_VARCHAR)
+		return;
+
+	// the keys are decoded into `ints` in place
+	col.ints.resize(rows);
+	uint32_t *keys = reinterpret_cast<uint32_t*>(col.ints.data());
+	switch(seg.encoding)
+	{
+		case ENC_NONE:
+			std::memcpy(keys, p, (size_t)rows * 4);
+			break;
+		case ENC_FOR:
+			unpack(p, rows, seg.bits, keys);
+			for(int i = 0; i != rows; ++i)
+				keys[i] += seg.ref;
+			break;
+		case ENC_DICT:
+			unpack(p + seg.ref * 4, rows, seg.bits, keys);
+			for(int i = 0; i != rows; ++i)
+				std::memcpy(keys + i, p + keys[i] * 4, 4);
+			break;
+		case ENC_RLE: {
+			const char *lengths = p + seg.ref * 4;
+			for(uint32_t r = 0, i = 0; r != seg.ref; ++r)
+			{
+				uint32_t v;
+				uint16_t len;
+				std::memcpy(&v, p + r * 4, 4);
+				std::memcpy(&len, lengths + r * 2, 2);
+				std::fill(keys + i, keys + i + len, v);
+				i += len;
+			}
+			break; }
+	}
+
+	if(type == COL_TYPE_FLOAT)
+	{
+		col.floats.resize(rows);
+		std::memcpy(col.floats.data(), keys, (size_t)rows * 4);
+	} else {
+		for(int i = 0; i != rows; ++i)
+			keys[i] ^= 0x80000000u;
+	}
+}
@@ -0,0 +1,93 @@
+#ifndef __TRIVIALDB_COLUMN_STORE__
+#define __TRIVIALDB_COLUMN_STORE__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "../defs.h"
+#include "../page/pager.h"
+
+class table_manager;
+
+/* The values of a column in the rows of a batch, INT and DATE values
+ * are in `ints`, FLOAT values in `floats`. */
+struct column_vector_t
+{
+	std::vector<int> ints;
+	std::vector<float> floats;
+	std::vector<char> nulls;
+};
+
+/* A column in a group of rows: where its values are, how they are
+ * encoded, and the least and the largest of them (the zone map). A
+ * segment is a bitmap of the NULLs, if any, and the values encoded. */
+struct column_segment_t
+{
+	union { int min_i; float min_f; };
+	union { int max_i; float max_f; };
+	uint32_t offset, bytes;
+	uint32_t ref;      // the base of ENC_FOR, the size of the dictionary or the runs
+	uint16_t nulls;    // number of NULLs
+	uint8_t encoding, bits;
+};
+
+/* SCAN_BATCH_ROWS rows following each other in order of rid, the first
+ * of which is at position `pos` of leaf `pid` in the data file. */
+struct column_group_t
+{
+	int rows, pid, pos;
+	column_segment_t cols[MAX_COL_NUM];
+};
+
+/* The columns of a columnar table. The rows are still kept in the rowid
+ * B-tree, which is all the statements change and the indices and the
+ * constraints refer to, and the column store is a copy of them made for
+ * the scans, rebuilt from the B-tree once the data has changed since.
+ * It is kept in `<table>.tcol` along with the `data_version` of the
+ * data it is made of.
+ *
+ * The rows are split into groups of SCAN_BATCH_ROWS rows, and each
+ * column of a group is a segment. The segments are written one after
+ * another into the pages of the file, followed by the directory of the
+ * groups, so a range of bytes is read from pages 1, 2, ... in order.
+ * INT, FLOAT and DATE values are encoded by one of the encodings below,
+ * whichever is the smallest, and the NULLs take the value before them.
+ * Of a VARCHAR column only the NULLs are kept. */
+class column_store
+{
+public:
+	enum { ENC_NONE, ENC_FOR, ENC_DICT, ENC_RLE };
+
+private:
+	std::shared_ptr<pager> pg;
+	std::string filename;
+	bool valid;
+	uint32_t version;
+	int col_num;
+	std::vector<column_group_t> groups;
+
+	void reset();
+	bool load(uint32_t version);
+	void read_bytes(uint32_t offset, uint32_t bytes, char *dst);
+
+public:
+	column_store() : valid(false), version(0), col_num(0) {}
+	~column_store() { close(); }
+
+	/* Open the store of the data of `version`, it is emptied if made of
+	 * other data, and it is not valid until it is built. */
+	void open(const char *filename, uint32_t version);
+	void close();
+	bool is_valid(uint32_t version) const { return valid && this->version == version; }
+	/* make the store of the rows of `table`, whose data is of `version` */
+	bool build(table_manager *table, uint32_t version);
+
+	int get_group_num() const { return groups.size(); }
+	const column_group_t &get_group(int g) const { return groups[g]; }
+	/* Decode column `cid` of type `type` of group `g` into `col`, `buf`
+	 * holds the bytes read. It may be called by several threads. */
+	void decode(int g, int cid, int type, column_vector_t &col, std::vector<char> &buf);
+};
+
+#endif
@@ -3,6 +3,42 @@
 #include "../page/overflow_page.h"
 #include <cstring>
 
+record_manager::record_manager(const record_manager &rm)
+	: pg(nullptr), pinned_pid(0)
+{
+	*this = rm;
+}
+
+record_manager& record_manager::operator = (const record_manager &rm)
+{
+	if(this == &rm) return *this;
+	// pin first, in case both share the same page
+	if(rm.pinned_pid)
+		rm.pg->pin(rm.pinned_pid);
+	if(pg && pinned_pid)
+		pg->unpin(pinned_pid);
+
+	pg = rm.pg;
+	pid = rm.pid;
+	pos = rm.pos;
+	cur_pid = rm.cur_pid;
+	pinned_pid = rm.pinned_pid;
+	cur_buf = rm.cur_buf;
+	remain = rm.remain;
+	next_pid = rm.next_pid;
+	offset = rm.offset;
+	dirty = rm.dirty;
+	return *this;
+}
+
+char *record_manager::load_page(int page_id)
+{
+	char *addr = pg->pin(page_id, dirty);
+	if(pinned_pid) pg->unpin(pinned_pid);
+	pinned_pid = page_id;
+	return addr;
+}
+
 void record_manager::open(int pid, int pos, bool dirty)
 {
 	this->pid = pid;
@@ -13,11 +49,14 @@ void record_manager::open(int pid, int pos, bool dirty)
 
 	if(pid)
 	{
-		data_page<int> page { dirty ? pg->read_for_write(pid) : pg->read(pid), pg };
+		data_page<int> page { load_page(pid), pg };
 		auto block = page.get_block(pos);
 		remain = block.first.size - sizeof(data_page<int>::block_header);
 		next_pid = block.first.ov_page;
 		cur_buf = block.second;
+	} else if(pinned_pid) {
+		pg->unpin(pinned_pid);
+		pinned_pid = 0;
 	}
 }
 
@@ -29,7 +68,7 @@ record_manager& record_manager::seek(int offset)
 	} else {
 		this->cur_pid = pid;
 		this->offset = 0;
-		data_page<int> page { dirty ? pg->read_for_write(pid) : pg->read(pid), pg };
+		data_page<int> page { load_page(pid), pg };
 		auto block = page.get_block(pos);
 		remain = block.first.size - sizeof(data_page<int>::block_header);
 		next_pid = block.first.ov_page;
@@ -46,8 +85,9 @@ record_manager& record_manager::write(const void *b, int size)
 	while(size)
 	{
 		int l = size < remain ? size : remain;
-		std::memcpy(cur_buf, data, l);
+		// before it is modified, the log takes the image of the page
 		if(!dirty) pg->mark_dirty(cur_pid);
+		std::memcpy(cur_buf, data, l);
 		data += l;
 		size -= l;
 		forward(l);
@@ -78,7 +118,7 @@ record_manager& record_manager::forward(int size)
 	cur_buf += size;
 	while(remain <= 0 && next_pid)
 	{
-		overflow_page page { dirty ? pg->read_for_write(next_pid) : pg->read(next_pid), pg };
+		overflow_page page { load_page(next_pid), pg };
 		remain += page.size();
 		cur_buf = page.block() + (page.size() - remain);
 		cur_pid = next_pid;
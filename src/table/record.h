@@ -5,15 +5,23 @@
 #include "../page/data_page.h"
 
 class table_manager;
+
+/* The page holding the current position of the record is pinned,
+ * so `ptr()` is valid as long as the record manager is not moved. */
 class record_manager
 {
 	pager *pg;
-	int pid, pos, cur_pid;
+	int pid, pos, cur_pid, pinned_pid;
 	char *cur_buf;
 	int remain, next_pid, offset;
 	bool dirty;
+
+	char *load_page(int page_id);
 public:
-	record_manager(pager *pg) : pg(pg), pid(0) {}
+	record_manager(pager *pg) : pg(pg), pid(0), pinned_pid(0) {}
+	record_manager(const record_manager &rm);
+	record_manager& operator = (const record_manager &rm);
+	~record_manager() { if(pinned_pid) pg->unpin(pinned_pid); }
 	void open(int pid, int pos, bool dirty);
 	void open(std::pair<int, int> pw, bool dirty) {
 		open(pw.first, pw.second, dirty);
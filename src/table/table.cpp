@@ -1,4 +1,5 @@
 #include "table.h"
+#include "column_store.h"
 #include "../index/index.h"
 #include "../expression/expression.h"
 #include "../utils/type_cast.h"
@@ -8,12 +9,17 @@
 #include <cstdio>
 #include <cstring>
 #include <string>
+#include <sstream>
+#include <numeric>
+#include <limits>
+#include <algorithm>
 
 index_manager::comparer_t get_index_comparer(int type)
 {
 	switch(type)
 	{
 		case COL_TYPE_INT:
+		case COL_TYPE_DATE:
 			return integer_bin_comparer;
 		case COL_TYPE_FLOAT:
 			return float_bin_comparer;
@@ -29,47 +35,94 @@ record_manager table_manager::open_record_from_index_lower_bound(
 	std::pair<int, int> idx_pos, int *rid)
 {
 	index_btree::leaf_page page { pg->read(idx_pos.first), pg.get() };
-	int r = page.get_child(idx_pos.second);
+	int r = page.get_rid(idx_pos.second);
 	record_manager rm = get_record_ptr_lower_bound(r, false);
 	if(rid != nullptr) rm.read(rid, 4);
 	return rm;
 }
 
+int table_manager::cache_record_from_index(std::pair<int, int> idx_pos, int cid)
+{
+	// [rid, nullmark, data]
+	index_btree::leaf_page page { pg->read(idx_pos.first), pg.get() };
+	const char *entry = page.get_key(idx_pos.second);
+	int rid = *(const int*)entry;
+	((int*)tmp_cache)[0] = rid;  // the main index is at offset 0
+	((int*)tmp_cache)[1] = entry[4] ? 1u << cid : 0;
+	// a string keeps only its own bytes in the leaf
+	int kept = page.get_size(idx_pos.second) - (int)sizeof(int) - 1;
+	char *col = tmp_cache + header.col_offset[cid];
+	std::memcpy(col, entry + sizeof(int) + 1, kept);
+	std::memset(col + kept, 0, header.col_length[cid] - kept);
+	cache_record_from_tmp_cache();
+	return rid;
+}
+
 void table_manager::cache_record(record_manager *rm)
 {
 	rm->seek(0);
-	rm->read(tmp_cache, tmp_record_size);
-	cache_record_from_tmp_cache();
+	auto block = rm->ptr();
+	if(block.second >= tmp_record_size)
+	{
+		cached.data = block.first;
+		cached.size = tmp_record_size;
+		cached_rm = nullptr;
+	} else {
+		// the data page is unpinned once `rm` moves on, keep a copy of its part
+		std::memcpy(tmp_cache, block.first, block.second);
+		cached.data = tmp_cache;
+		cached.size = block.second;
+		cached_rm = rm;
+	}
+
+	expression::cache_table(header.table_name, &header, &cached);
+}
+
+void table_manager::cache_record(const char *record)
+{
+	cached.data = record;
+	cached.size = tmp_record_size;
+	cached_rm = nullptr;
+	expression::cache_table(header.table_name, &header, &cached);
 }
 
 void table_manager::cache_record_from_tmp_cache()
 {
-	expression::cache_clear(header.table_name);
-	int null_mark = ((int*)tmp_cache)[1];
-	for(int i = 0; i < header.col_num; ++i)
-	{
-		if(i == header.main_index && header.is_main_index_additional)
-			continue;
+	cached.data = tmp_cache;
+	cached.size = tmp_record_size;
+	cached_rm = nullptr;
+	expression::cache_table(header.table_name, &header, &cached);
+}
 
-		char *buf = nullptr;
-		if(!((null_mark >> i) & 1))
-			buf = tmp_cache + header.col_offset[i];
+void table_manager::load_cached_record(record_view_t *view)
+{
+	table_manager *tm = static_cast<table_manager*>(view->owner);
+	assert(tm->cached_rm);
+	tm->cached_rm->seek(0);
+	tm->cached_rm->read(tm->tmp_cache, tm->tmp_record_size);
+	tm->cache_record_from_tmp_cache();
+}
 
-		expression::cache_column(
-			header.table_name,
-			header.col_name[i],
-			typecast::column_to_expr(buf, header.col_type[i])
-		);
+void table_manager::materialize_cached_record()
+{
+	if(cached.size < tmp_record_size)
+	{
+		load_cached_record(&cached);
+	} else if(cached.data != tmp_cache) {
+		std::memcpy(tmp_cache, cached.data, tmp_record_size);
+		cache_record_from_tmp_cache();
 	}
 }
 
 const char* table_manager::get_cached_column(int cid)
 {
 	assert(cid >= 0 && cid < header.col_num);
-	int null_mark = ((int*)tmp_cache)[1];
-	if(!((null_mark >> cid) & 1))
-		return tmp_cache + header.col_offset[cid];
-	else return nullptr;
+	int null_mark = ((const int*)cached.data)[1];
+	if((null_mark >> cid) & 1)
+		return nullptr;
+	if(header.col_offset[cid] + header.col_length[cid] > cached.size)
+		load_cached_record(&cached);
+	return cached.data + header.col_offset[cid];
 }
 
 void table_manager::load_indices()
@@ -82,7 +135,9 @@ void table_manager::load_indices()
 			indices[i] = new index_manager(pg.get(),
 				header.col_length[i],
 				header.index_root[i],
-				get_index_comparer(header.col_type[i])
+				header.col_type[i],
+				header.bloom_root[i],
+				get_index_type(i)
 			);
 		}
 	}
@@ -96,6 +151,7 @@ void table_manager::free_indices()
 		{
 			assert(indices[i]);
 			header.index_root[i] = indices[i]->get_root_pid();
+			header.bloom_root[i] = indices[i]->get_filter_root();
 			delete indices[i];
 			indices[i] = nullptr;
 		}
@@ -109,6 +165,8 @@ void table_manager::free_check_constraints()
 		expression::free_exprnode(check_conds[i]);
 		check_conds[i] = nullptr;
 	}
+
+	check_exprs.clear();
 }
 
 void table_manager::load_check_constraints()
@@ -130,8 +188,10 @@ std::shared_ptr<table_manager> table_manager::mirror(const char *alias_name)
 	tb->pg = pg;
 	tb->btr = btr;
 	tb->header = header;
+	tb->stats = stats;
 	tb->allocate_temp_record();
 	std::memcpy(tb->indices, indices, sizeof(indices));
+	tb->columns = columns;
 	std::memcpy(tb->check_conds, check_conds, sizeof(check_conds));
 	std::strcpy(tb->header.table_name, alias_name);
 	return tb;
@@ -144,14 +204,23 @@ bool table_manager::open(const char *table_name)
 	std::string thead = tname + ".thead";
 	std::string tdata = tname + ".tdata";
 
+	// the fields added at the end are zero in an older header
+	std::memset(&header, 0, sizeof(header));
 	std::ifstream ifs(thead, std::ios::binary);
 	ifs.read((char*)&header, sizeof(header));
 	pg = std::make_shared<pager>(tdata.c_str());
+	load_meta();
+	load_stats();
 	btr = std::make_shared<int_btree>(
 			pg.get(), header.index_root[header.main_index]);
 	allocate_temp_record();
 	load_indices();
 	load_check_constraints();
+	if(header.engine == TABLE_ENGINE_COLUMNAR)
+	{
+		columns = new column_store;
+		columns->open((tname + ".tcol").c_str(), header.data_version);
+	}
 
 	is_mirror = false;
 	return is_open = true;
@@ -168,9 +237,16 @@ bool table_manager::create(const char *table_name, const table_header_t *header)
 
 	this->header = *header;
 	this->header.index_root[header->main_index] = btr->get_root_page_id();
+	stats.magic = 0;
+	std::remove((tname + ".tstat").c_str());
 	allocate_temp_record();
 	load_indices();
 	load_check_constraints();
+	if(this->header.engine == TABLE_ENGINE_COLUMNAR)
+	{
+		columns = new column_store;
+		columns->open((tname + ".tcol").c_str(), this->header.data_version);
+	}
 
 	is_mirror = false;
 	return is_open = true;
@@ -182,8 +258,12 @@ void table_manager::drop()
 	close();
 	std::string thead = tname + ".thead";
 	std::string tdata = tname + ".tdata";
+	std::string tstat = tname + ".tstat";
 	std::remove(thead.c_str());
 	std::remove(tdata.c_str());
+	std::remove(tstat.c_str());
+	std::remove((tname + ".tcol").c_str());
+	std::remove(compressed_io_backend::map_filename(tdata.c_str()).c_str());
 }
 
 void table_manager::close()
@@ -195,15 +275,23 @@ void table_manager::close()
 		std::string thead = tname + ".thead";
 		std::string tdata = tname + ".tdata";
 
+		save_meta();
 		header.index_root[header.main_index] = btr->get_root_page_id();
 		free_indices();
 		free_check_constraints();
 
-		std::ofstream ofs(thead, std::ios::binary);
-		ofs.write((char*)&header, sizeof(header));
+		if(!page_fs::get_instance()->is_read_only())
+		{
+			std::ofstream ofs(thead, std::ios::binary);
+			ofs.write((char*)&header, sizeof(header));
+		}
+
 		pg->close();
+		delete columns;
 	}
 
+	columns = nullptr;
+
 	btr = nullptr;
 	pg = nullptr;
 	delete []tmp_record;
@@ -216,6 +304,200 @@ void table_manager::close()
 	is_mirror = false;
 }
 
+void table_manager::save_meta()
+{
+	if(!is_open || is_mirror) return;
+	table_meta_t meta;
+	std::memset(&meta, 0, sizeof(meta));
+	meta.magic = TABLE_META_MAGIC;
+	meta.flag_indexed = header.flag_indexed;
+	meta.flag_hashed = header.flag_hashed;
+	meta.records_num = header.records_num;
+	meta.auto_inc = header.auto_inc;
+	meta.data_version = header.data_version;
+	for(int i = 0; i < header.col_num; ++i)
+	{
+		if(i == header.main_index)
+			meta.index_root[i] = btr->get_root_page_id();
+		else if(indices[i])
+			meta.index_root[i] = indices[i]->get_root_pid();
+		else meta.index_root[i] = header.index_root[i];
+		meta.bloom_root[i] = indices[i] ? indices[i]->get_filter_root() : header.bloom_root[i];
+	}
+
+	pg->set_meta(&meta, sizeof(meta));
+}
+
+/* The header file is written only when the table is closed, the meta
+ * in the data file is newer if the database has not been closed. */
+void table_manager::load_meta()
+{
+	// the fields added at the end are zero in an older file
+	table_meta_t meta;
+	std::memset(&meta, 0, sizeof(meta));
+	pg->get_meta(&meta, sizeof(meta));
+	if(meta.magic != TABLE_META_MAGIC)
+		return;
+
+	header.flag_indexed = meta.flag_indexed;
+	header.flag_hashed = meta.flag_hashed;
+	header.records_num = meta.records_num;
+	header.auto_inc = meta.auto_inc;
+	header.data_version = meta.data_version;
+	std::memcpy(header.index_root, meta.index_root, sizeof(meta.index_root));
+	std::memcpy(header.bloom_root, meta.bloom_root, sizeof(meta.bloom_root));
+}
+
+/* The statistics are kept in their own file, they are only estimates
+ * and need not be logged with the data. */
+void table_manager::load_stats()
+{
+	stats.magic = 0;
+	std::ifstream ifs(tname + ".tstat", std::ios::binary);
+	if(!ifs.read((char*)&stats, sizeof(stats)) || stats.magic != TABLE_STATS_MAGIC)
+		stats.magic = 0;
+}
+
+void table_manager::analyze()
+{
+	assert(!is_mirror);
+	std::vector<column_stats_builder> builders;
+	for(int i = 0; i < header.col_num; ++i)
+		builders.emplace_back(header.col_type[i]);
+
+	auto it = get_record_iterator_lower_bound(0);
+	for(; !it.is_end(); it.next())
+	{
+		record_manager rm(pg.get());
+		rm.open(it.get(), false);
+		rm.read(tmp_cache, tmp_record_size);
+		int null_mark = ((int*)tmp_cache)[1];
+		for(int i = 0; i < header.col_num; ++i)
+		{
+			if((null_mark >> i) & 1)
+				builders[i].add(nullptr);
+			else builders[i].add(tmp_cache + header.col_offset[i]);
+		}
+	}
+
+	std::memset(&stats, 0, sizeof(stats));
+	stats.magic = TABLE_STATS_MAGIC;
+	stats.records_num = header.records_num;
+	for(int i = 0; i < header.col_num; ++i)
+		builders[i].build(stats.cols[i]);
+
+	std::ofstream ofs(tname + ".tstat", std::ios::binary);
+	ofs.write((char*)&stats, sizeof(stats));
+	if(!ofs)
+		std::fprintf(stderr, "[Error] Fail to save the statistics of `%s`.\n", header.table_name);
+}
+
+/* Rebuild the data file: the records and the entries of each index are
+ * loaded into a new file, in which the leaves of each tree are laid out
+ * in order, and the new file then takes the place of the old one. */
+bool table_manager::vacuum(int fill_factor)
+{
+	assert(!is_mirror);
+	std::string tdata = tname + ".tdata";
+	std::string tmp_name = tdata + ".vacuum";
+	std::remove(tmp_name.c_str());
+	std::remove((tmp_name + ".wal").c_str());
+
+	// the new file is compressed if the old one is
+	auto new_pg = std::make_shared<pager>(tmp_name.c_str(), pg->is_compressed());
+	bool compressed = new_pg->is_compressed();
+	int_btree new_btr(new_pg.get(), 0);
+	index_manager *new_indices[MAX_COL_NUM] = { nullptr };
+	for(int i = 0; i < header.col_num; ++i)
+	{
+		if(indices[i])
+		{
+			new_indices[i] = new index_manager(new_pg.get(),
+				header.col_length[i], 0, header.col_type[i], 0, get_index_type(i));
+			if(indices[i]->get_filter_bits())
+				new_indices[i]->create_filter(indices[i]->get_filter_bits());
+		}
+	}
+
+	// the records move, so the column store is built again
+	++header.data_version;
+	std::vector<char> buf(tmp_record_size);
+	new_btr.bulk_load_begin(fill_factor);
+	auto it = get_record_iterator_lower_bound(std::numeric_limits<int>::min());
+	for(; !it.is_end(); it.next())
+	{
+		record_manager rm(pg.get());
+		rm.open(it.get(), false);
+		rm.read(buf.data(), tmp_record_size);
+		new_btr.bulk_load_append(buf.data(), tmp_record_size);
+
+		int rid = ((int*)buf.data())[0];
+		int null_mark = ((int*)buf.data())[1];
+		for(int i = 0; i < header.col_num; ++i)
+		{
+			if(!new_indices[i]) continue;
+			if((null_mark >> i) & 1)
+				new_indices[i]->bulk_load_add(nullptr, rid);
+			else new_indices[i]->bulk_load_add(buf.data() + header.col_offset[i], rid);
+		}
+	}
+
+	new_btr.bulk_load_end();
+	int old_roots[MAX_COL_NUM], old_blooms[MAX_COL_NUM];
+	std::memcpy(old_roots, header.index_root, sizeof(old_roots));
+	std::memcpy(old_blooms, header.bloom_root, sizeof(old_blooms));
+	header.index_root[header.main_index] = new_btr.get_root_page_id();
+	for(int i = 0; i < header.col_num; ++i)
+	{
+		if(!new_indices[i]) continue;
+		new_indices[i]->bulk_load_end(fill_factor);
+		header.index_root[i] = new_indices[i]->get_root_pid();
+		header.bloom_root[i] = new_indices[i]->get_filter_root();
+		delete new_indices[i];
+	}
+
+	// the new file is complete with its meta before it is renamed
+	table_meta_t meta;
+	std::memset(&meta, 0, sizeof(meta));
+	meta.magic = TABLE_META_MAGIC;
+	meta.flag_indexed = header.flag_indexed;
+	meta.flag_hashed = header.flag_hashed;
+	meta.records_num = header.records_num;
+	meta.auto_inc = header.auto_inc;
+	meta.data_version = header.data_version;
+	std::memcpy(meta.index_root, header.index_root, sizeof(meta.index_root));
+	std::memcpy(meta.bloom_root, header.bloom_root, sizeof(meta.bloom_root));
+	new_pg->set_meta(&meta, sizeof(meta));
+	new_pg->close();
+
+	for(int i = 0; i < header.col_num; ++i)
+	{
+		delete indices[i];
+		indices[i] = nullptr;
+	}
+
+	btr = nullptr;
+	pg->close();
+	bool succ = compressed
+		? compressed_io_backend::replace(tmp_name.c_str(), tdata.c_str())
+		: std::rename(tmp_name.c_str(), tdata.c_str()) == 0;
+	if(!succ)
+	{
+		std::fprintf(stderr, "[Error] Fail to replace `%s`.\n", tdata.c_str());
+		std::remove(tmp_name.c_str());
+		std::remove(compressed_io_backend::map_filename(tmp_name.c_str()).c_str());
+		std::memcpy(header.index_root, old_roots, sizeof(old_roots));
+		std::memcpy(header.bloom_root, old_blooms, sizeof(old_blooms));
+	}
+
+	pg = std::make_shared<pager>(tdata.c_str());
+	load_meta();
+	btr = std::make_shared<int_btree>(
+			pg.get(), header.index_root[header.main_index]);
+	load_indices();
+	return succ;
+}
+
 int table_manager::lookup_column(const char *col_name)
 {
 	for(int i = 0; i < header.col_num; ++i)
@@ -237,6 +519,9 @@ void table_manager::allocate_temp_record()
 	tmp_cache = new char[tot_len];
 	tmp_index = new char[tot_len];
 	tmp_null_mark = reinterpret_cast<int*>(tmp_record + 4);
+	std::memset(tmp_cache, 0, tot_len);
+	cached = { tmp_cache, tot_len, &table_manager::load_cached_record, this };
+	cached_rm = nullptr;
 }
 
 bool table_manager::set_temp_record(int col, const void *data)
@@ -287,6 +572,7 @@ void table_manager::init_temp_record()
 int table_manager::insert_record()
 {
 	assert(header.col_offset[header.main_index] == 0);
+	++header.data_version;
 	int *rid = (int*)tmp_record;
 	if(header.is_main_index_additional)
 		*rid = header.auto_inc;
@@ -307,9 +593,10 @@ int table_manager::insert_record()
 		if(i != header.main_index && ((1u << i) & header.flag_indexed))
 		{
 			assert(indices[i]);
-			if(*tmp_null_mark & (1u << i))
-				indices[i]->insert(nullptr, *rid);
-			else indices[i]->insert(tmp_record + header.col_offset[i], *rid);
+			const char *key = *tmp_null_mark & (1u << i) ? nullptr : tmp_record + header.col_offset[i];
+			if(deferred_indices & (1u << i))
+				indices[i]->bulk_load_add(key, *rid);
+			else indices[i]->insert(key, *rid);
 		}
 	}
 
@@ -321,9 +608,268 @@ int table_manager::insert_record()
 	return *rid;
 }
 
+void table_manager::begin_bulk_insert()
+{
+	deferred_indices = 0;
+	for(int i = 0; i != header.foreign_key_num; ++i)
+	{
+		// the rows may refer to those loaded before
+		if(std::strcmp(header.foreign_key_ref_table[i], header.table_name) == 0)
+			return;
+	}
+
+	uint32_t checked = header.flag_primary | header.flag_unique | (1u << header.main_index);
+	for(int i = 0; i != header.col_num; ++i)
+	{
+		uint32_t bit = 1u << i;
+		if((header.flag_indexed & bit) && !(checked & bit) && indices[i]->empty())
+			deferred_indices |= bit;
+	}
+}
+
+void table_manager::end_bulk_insert(int fill_factor)
+{
+	for(int i = 0; i != header.col_num; ++i)
+	{
+		if(deferred_indices & (1u << i))
+			indices[i]->bulk_load_end(fill_factor);
+	}
+
+	deferred_indices = 0;
+}
+
+/* The result is the same as inserting the records one by one with
+ * `insert_record`: the constraints of each row are checked in order,
+ * and a row may conflict with the rows inserted before it. But the
+ * lookups are done key by key, the rows with equal keys share one, and
+ * the rows which pass are put into each b-tree in the order of its key,
+ * so that consecutive keys are inserted into a leaf without descending
+ * from the root again. */
+int table_manager::insert_records(const char *records, int num)
+{
+	assert(header.col_offset[header.main_index] == 0);
+	++header.data_version;
+	bool self_referenced = false;
+	for(int i = 0; i != header.foreign_key_num; ++i)
+		if(std::strcmp(header.foreign_key_ref_table[i], header.table_name) == 0)
+			self_referenced = true;
+
+	if(num == 1 || self_referenced || !header.is_main_index_additional)
+	{
+		int count = 0;
+		for(int i = 0; i != num; ++i)
+		{
+			std::memcpy(tmp_record, records + (size_t)i * tmp_record_size, tmp_record_size);
+			count += insert_record() > 0;
+		}
+		return count;
+	}
+
+	std::vector<char> rows(records, records + (size_t)num * tmp_record_size);
+	auto row = [&](int i) { return rows.data() + (size_t)i * tmp_record_size; };
+	// the rows are given rids after the existing ones while checking
+	for(int i = 0; i != num; ++i)
+		*(int*)row(i) = header.auto_inc + i;
+
+	int main_index_col = 1u << header.main_index;
+	bool primary_to_check = !(header.flag_primary & main_index_col);
+	uint32_t unique_to_check = header.flag_unique & ~main_index_col;
+	std::vector<int> firsts;
+
+	// the rid of the row each key conflicts with, 0 if none (rids start from 1)
+	std::vector<int> primary_group, primary_conflict;
+	if(primary_to_check)
+	{
+		primary_group = group_records(rows.data(), num, header.flag_primary, firsts);
+		for(int r : firsts)
+			primary_conflict.push_back(find_primary_conflict(row(r)));
+	}
+
+	std::vector<int> unique_group[MAX_COL_NUM];
+	std::vector<char> unique_ok[MAX_COL_NUM], unique_taken[MAX_COL_NUM];
+	for(int i = 0; i != header.col_num; ++i)
+	{
+		if(!(unique_to_check & (1u << i)))
+			continue;
+		unique_group[i] = group_records(rows.data(), num, 1u << i, firsts);
+		for(int r : firsts)
+			unique_ok[i].push_back(check_unique(row(r), i));
+		unique_taken[i].assign(firsts.size(), 0);
+	}
+
+	std::vector<char> value_ok(num, 1);
+	for(int i = 0; i != num && header.check_constaint_num; ++i)
+	{
+		std::memcpy(tmp_cache, row(i), tmp_record_size);
+		cache_record_from_tmp_cache();
+		for(int j = 0; j != header.check_constaint_num && value_ok[i]; ++j)
+			value_ok[i] = check_value_constraint(j);
+	}
+
+	std::vector<int> foreign_group[MAX_COL_NUM];
+	std::vector<char> foreign_ok[MAX_COL_NUM];
+	for(int i = 0; i != header.foreign_key_num; ++i)
+	{
+		foreign_group[i] = group_records(rows.data(), num, 1u << header.foreign_key[i], firsts);
+		std::vector<const char*> keys;
+		for(int r : firsts)
+			keys.push_back(row(r) + header.col_offset[header.foreign_key[i]]);
+		foreign_ok[i].resize(firsts.size());
+		check_foreign(i, keys, foreign_ok[i].data());
+	}
+
+	// decide in order, as rows conflict with the ones inserted before
+	std::vector<int> primary_taken(primary_conflict.size(), 0);
+	std::vector<int> inserted;
+	for(int i = 0; i != num; ++i)
+	{
+		char *buf = row(i);
+		if(!check_notnull(buf))
+			continue;
+
+		if(primary_to_check)
+		{
+			int g = primary_group[i];
+			int rid = primary_conflict[g] ? primary_conflict[g] : primary_taken[g];
+			if(rid)
+			{
+				std::fprintf(stderr, "[Error] Primary key confliction with __rowid__ = %d\n", rid);
+				continue;
+			}
+		}
+
+		bool succ = true;
+		for(int j = 0; j != header.col_num && succ; ++j)
+		{
+			if(unique_to_check & (1u << j))
+			{
+				int g = unique_group[j][i];
+				succ = unique_ok[j][g] && !unique_taken[j][g];
+			}
+		}
+
+		if(!succ)
+		{
+			std::fprintf(stderr, "[Error] Record not unique!\n");
+			continue;
+		}
+
+		if(!value_ok[i])
+		{
+			std::fprintf(stderr, "[Error] Value constraint broken!\n");
+			continue;
+		}
+
+		for(int j = 0; j != header.foreign_key_num && succ; ++j)
+			succ = foreign_ok[j][foreign_group[j][i]];
+		if(!succ)
+		{
+			std::fprintf(stderr, "[Error] Foreign key constraint broken!\n");
+			continue;
+		}
+
+		int rid = *(int*)buf = header.auto_inc++;
+		++header.records_num;
+		if(primary_to_check)
+			primary_taken[primary_group[i]] = rid;
+		int null_mark = ((int*)buf)[1];
+		for(int j = 0; j != header.col_num; ++j)
+		{
+			// NULL is not found by the lookups of other rows
+			if((unique_to_check & (1u << j)) && !((null_mark >> j) & 1))
+				unique_taken[j][unique_group[j][i]] = 1;
+		}
+
+		inserted.push_back(i);
+	}
+
+	// the rids are ascending
+	for(int i : inserted)
+		btr->insert_sorted(*(int*)row(i), row(i), tmp_record_size);
+
+	for(int i = 0; i < header.col_num; ++i)
+	{
+		if(i == header.main_index || !((1u << i) & header.flag_indexed))
+			continue;
+
+		assert(indices[i]);
+		int offset = header.col_offset[i];
+		auto comparer = get_index_comparer(header.col_type[i]);
+		auto is_null = [&](int r) { return (((int*)row(r))[1] >> i) & 1; };
+		if(deferred_indices & (1u << i))
+		{
+			for(int r : inserted)
+				indices[i]->bulk_load_add(is_null(r) ? nullptr : row(r) + offset, *(int*)row(r));
+			continue;
+		}
+
+		std::vector<int> order = inserted;
+		// in the order of index entries, NULL first
+		std::sort(order.begin(), order.end(), [&](int a, int b) {
+			if(is_null(a) != is_null(b))
+				return is_null(a) > is_null(b);
+			if(!is_null(a))
+			{
+				int r = comparer(row(a) + offset, row(b) + offset);
+				if(r != 0) return r < 0;
+			}
+			return *(int*)row(a) < *(int*)row(b);
+		} );
+
+		for(int r : order)
+			indices[i]->insert_sorted(is_null(r) ? nullptr : row(r) + offset, *(int*)row(r));
+	}
+
+	return (int)inserted.size();
+}
+
+/* Number the records by the values of the columns in `cols`, records
+ * with equal values are in the same group. The groups are numbered in
+ * ascending order of the values, and `firsts` gets a record of each. */
+std::vector<int> table_manager::group_records(const char *records, int num,
+	uint32_t cols, std::vector<int> &firsts)
+{
+	auto row = [&](int i) { return records + (size_t)i * tmp_record_size; };
+	int key_num = 0, offsets[MAX_COL_NUM];
+	index_manager::comparer_t comparers[MAX_COL_NUM];
+	for(int i = 0; i != header.col_num; ++i)
+	{
+		if(!(cols & (1u << i)))
+			continue;
+		offsets[key_num] = header.col_offset[i];
+		comparers[key_num++] = get_index_comparer(header.col_type[i]);
+	}
+
+	auto compare = [&](int a, int b) {
+		for(int i = 0; i != key_num; ++i)
+		{
+			int r = comparers[i](row(a) + offsets[i], row(b) + offsets[i]);
+			if(r != 0) return r;
+		}
+		return 0;
+	};
+
+	std::vector<int> order(num), group(num);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return compare(a, b) < 0;
+	} );
+
+	firsts.clear();
+	for(int i = 0; i != num; ++i)
+	{
+		if(i == 0 || compare(order[i - 1], order[i]) != 0)
+			firsts.push_back(order[i]);
+		group[order[i]] = (int)firsts.size() - 1;
+	}
+
+	return group;
+}
+
 bool table_manager::remove_record(int rid)
 {
 	assert(!is_mirror);
+	++header.data_version;
 	record_manager rm = get_record_ptr(rid);
 	if(rm.valid())
 	{
@@ -348,6 +894,23 @@ bool table_manager::remove_record(int rid)
 	} else return false;
 }
 
+column_store *table_manager::get_column_store()
+{
+	if(columns == nullptr)
+		return nullptr;
+	if(!columns->is_valid(header.data_version))
+	{
+		if(page_fs::get_instance()->is_read_only())
+			return nullptr;
+		// the store is written, and read back, as it is
+		snapshot_pause pause;
+		if(!columns->build(this, header.data_version))
+			return nullptr;
+	}
+
+	return columns;
+}
+
 btree_iterator<int_btree::leaf_page> table_manager::get_record_iterator_lower_bound(int rid)
 {
 	auto ret = btr->lower_bound(rid);
@@ -370,83 +933,74 @@ record_manager table_manager::get_record_ptr(int rid, bool dirty)
 	else return record_manager(pg.get());
 }
 
-void table_manager::dump_header(FILE *f)
+void table_manager::get_column_names(std::vector<std::string> &names)
 {
 	for(int i = 0; i < header.col_num - 1; ++i)
-	{
-		if(i != 0) std::fprintf(f, ",");
-		std::fprintf(f, "%s.%s", header.table_name, header.col_name[i]);
-	}
+		names.push_back(std::string(header.table_name) + "." + header.col_name[i]);
 }
 
-void table_manager::dump_record(FILE *f, int rid)
+void table_manager::get_record_values(const char *record, std::vector<expression> &vals)
 {
-	record_manager rec = get_record_ptr(rid);
-	dump_record(f, &rec);
-}
-
-void table_manager::dump_record(FILE *f, record_manager *rm)
-{
-	rm->seek(0);
-	rm->read(tmp_cache, tmp_record_size);
-	int null_mark = ((int*)tmp_cache)[1];
+	int null_mark = ((const int*)record)[1];
 	for(int i = 0; i < header.col_num - 1; ++i)
 	{
-		if(i != 0) std::fprintf(f, ",");
+		expression val;
+		const char *buf = record + header.col_offset[i];
 		if(null_mark & (1u << i))
 		{
-			std::fprintf(f, "NULL");
+			val.type = TERM_NULL;
+			vals.push_back(val);
 			continue;
 		}
 
-		char *buf = tmp_cache + header.col_offset[i];
 		switch(header.col_type[i])
 		{
 			case COL_TYPE_INT:
-				std::fprintf(f, "%d", *(int*)buf);
+				val.type = TERM_INT;
+				val.val_i = *(const int*)buf;
 				break;
 			case COL_TYPE_FLOAT:
-				std::fprintf(f, "%f", *(float*)buf);
+				val.type = TERM_FLOAT;
+				val.val_f = *(const float*)buf;
 				break;
 			case COL_TYPE_VARCHAR:
-				std::fprintf(f, "%s", buf);
+				val.type = TERM_STRING;
+				val.val_s = const_cast<char*>(buf);
+				break;
+			case COL_TYPE_DATE:
+				val.type = TERM_DATE;
+				val.val_i = *(const int*)buf;
 				break;
-			case COL_TYPE_DATE: {
-				char date_buf[32];
-				time_t time = *(int*)buf;
-				auto tm = std::localtime(&time);
-				std::strftime(date_buf, 32, DATE_TEMPLATE, tm);
-				std::fprintf(f, "%s", date_buf);
-				break; }
 			default:
 				debug_puts("[Error] Data type not supported!");
+				val.type = TERM_NULL;
 		}
+
+		vals.push_back(val);
 	}
 }
 
 bool table_manager::modify_record(int rid, int col, const void* data)
 {
 	assert(!is_mirror);
+	++header.data_version;
 	record_manager rec = get_record_ptr(rid, true);
 	if(!rec.valid()) return false;
 	assert(col >= 0 && col < header.col_num);
 
 	// record must be cached by cache_record()
+	materialize_cached_record();
 	int is_old_record_null = ((int*)tmp_cache)[1] & (1u << col);
 	if(data == nullptr)
 	{
 		((int*)tmp_cache)[1] |= 1u << col;
 	} else {
+		// the constraints are checked against tmp_cache
+		((int*)tmp_cache)[1] &= ~(1u << col);
 		std::memcpy(tmp_record, tmp_cache + header.col_offset[col], header.col_length[col]);
 		std::memcpy(tmp_cache + header.col_offset[col], data, header.col_length[col]);
 	}
 
-	expression::cache_replace(
-		header.table_name,
-		header.col_name[col], 
-		typecast::column_to_expr((char*)data, header.col_type[col])
-	);
-
 	if(!check_constraints(tmp_cache))
 		return false;
 
@@ -454,11 +1008,11 @@ bool table_manager::modify_record(int rid, int col, const void* data)
 	{
 		rec.seek(header.col_offset[col]);
 		rec.write(data, header.col_length[col]);
-	} else {
-		rec.seek(4);
-		rec.write(tmp_cache + 4, 4);
 	}
 
+	rec.seek(4);
+	rec.write(tmp_cache + 4, 4);
+
 	if(indices[col] != nullptr)
 	{
 		// update index
@@ -488,7 +1042,8 @@ bool table_manager::has_index(int cid)
 	return (header.flag_indexed >> cid) & 1u;
 }
 
-void table_manager::create_index(const char *col_name)
+void table_manager::create_index(const char *col_name, int fill_factor,
+	int bloom_bits, int index_type)
 {
 	int cid = lookup_column(col_name);
 	if(cid < 0)
@@ -498,13 +1053,50 @@ void table_manager::create_index(const char *col_name)
 		std::fprintf(stderr, "[Error] index for column `%s' already exists.\n", col_name);
 	} else {
 		header.flag_indexed |= 1u << cid;
+		if(index_type == INDEX_TYPE_HASH)
+			header.flag_hashed |= 1u << cid;
 		indices[cid] = new index_manager(pg.get(),
 			header.col_length[cid],
 			header.index_root[cid],
-			get_index_comparer(header.col_type[cid])
+			header.col_type[cid],
+			0, index_type
 		);
+		if(bloom_bits)
+			indices[cid]->create_filter(bloom_bits);
+		header.bloom_root[cid] = indices[cid]->get_filter_root();
+
+		// the existing rows are sorted and loaded at once
+		auto it = get_record_iterator_lower_bound(0);
+		for(; !it.is_end(); it.next())
+		{
+			int rid, null_mark;
+			record_manager rm(pg.get());
+			rm.open(it.get(), false);
+			rm.read(&rid, 4);
+			rm.read(&null_mark, 4);
+			if((null_mark >> cid) & 1)
+			{
+				indices[cid]->bulk_load_add(nullptr, rid);
+			} else {
+				rm.seek(header.col_offset[cid]);
+				rm.read(tmp_index, header.col_length[cid]);
+				indices[cid]->bulk_load_add(tmp_index, rid);
+			}
+		}
+
+		indices[cid]->bulk_load_end(fill_factor);
+	}
+}
 
-		// TODO: add existed data.
+void table_manager::create_filters(int bloom_bits)
+{
+	for(int i = 0; i != header.col_num; ++i)
+	{
+		if(indices[i])
+		{
+			indices[i]->create_filter(bloom_bits);
+			header.bloom_root[i] = indices[i]->get_filter_root();
+		}
 	}
 }
 
@@ -534,7 +1126,7 @@ bool table_manager::check_constraints(const char *buf)
 
 	for(int i = 0; i != header.check_constaint_num; ++i)
 	{
-		if(!check_value_constraint(check_conds[i]))
+		if(!check_value_constraint(i))
 		{
 			std::fprintf(stderr, "[Error] Value constraint broken!\n");
 			return false;
@@ -553,19 +1145,143 @@ bool table_manager::check_constraints(const char *buf)
 	return true;
 }
 
+/* Find the table and its column a foreign key refers to, once every
+ * statement, as tables may be dropped in between. The keys kept are
+ * forgotten once that table changes. */
+table_manager::foreign_ref_t *table_manager::resolve_foreign(int key_id)
+{
+	if(foreign_refs.size() != (size_t)header.foreign_key_num)
+		foreign_refs.assign(header.foreign_key_num, foreign_ref_t());
+
+	dbms *db = dbms::get_instance();
+	foreign_ref_t &ref = foreign_refs[key_id];
+	if(ref.statement != db->get_statement_num())
+	{
+		const char *table = header.foreign_key_ref_table[key_id];
+		const char *column = header.foreign_key_ref_column[key_id];
+		table_manager *tm = db->find_table(table);
+		if(tm == nullptr)
+		{
+			std::printf("[Error] No table named `%s`\n", table);
+			return nullptr;
+		}
+
+		int cid = tm->lookup_column(column);
+		if(cid < 0)
+		{
+			std::printf("[Error] No column named `%s` in `%s`\n", column, table);
+			return nullptr;
+		}
+
+		if(!tm->indices[cid])
+		{
+			std::printf("[Error] No index for column `%s` in table `%s`\n", column, table);
+			return nullptr;
+		}
+
+		ref.statement = db->get_statement_num();
+		ref.table = tm;
+		ref.column = cid;
+		ref.version = tm->header.data_version - 1;
+	}
+
+	if(ref.version != ref.table->header.data_version)
+	{
+		ref.version = ref.table->header.data_version;
+		ref.used.assign(FOREIGN_KEY_CACHE_SLOTS, 0);
+		ref.keys.resize((size_t)FOREIGN_KEY_CACHE_SLOTS * header.col_length[header.foreign_key[key_id]]);
+	}
+
+	return &ref;
+}
+
 bool table_manager::check_foreign(const char *buf, int key_id)
 {
+	const char *key = buf + header.col_offset[header.foreign_key[key_id]];
+	char ok;
+	check_foreign(key_id, std::vector<const char*>(1, key), &ok);
+	return ok;
+}
+
+/* The keys found lately are taken from the cache of the foreign key, the
+ * others are found in key order in one walk of the index referred to. */
+void table_manager::check_foreign(int key_id, const std::vector<const char*> &keys, char *ok)
+{
+	std::fill(ok, ok + keys.size(), 0);
+	foreign_ref_t *ref = resolve_foreign(key_id);
+	if(ref == nullptr)
+		return;
+
 	int cid = header.foreign_key[key_id];
-	return dbms::get_instance()->value_exists(
-		header.foreign_key_ref_table[key_id],
-		header.foreign_key_ref_column[key_id],
-		buf + header.col_offset[cid]
-	);
+	int type = ref->table->header.col_type[ref->column];
+	size_t length = header.col_length[cid];
+	auto comparer = get_index_comparer(type);
+	auto slot = [&](const char *key) {
+		return dbms::hash_join_key(key, type) % FOREIGN_KEY_CACHE_SLOTS;
+	};
+
+	std::vector<int> missed;
+	for(size_t i = 0; i != keys.size(); ++i)
+	{
+		size_t k = slot(keys[i]);
+		if(ref->used[k] && comparer(ref->keys.data() + k * length, keys[i]) == 0)
+			ok[i] = 1;
+		else missed.push_back((int)i);
+	}
+
+	if(missed.empty())
+		return;
+
+	// the keys of a batch come sorted from group_records()
+	auto key_less = [&](int a, int b) { return comparer(keys[a], keys[b]) < 0; };
+	if(!std::is_sorted(missed.begin(), missed.end(), key_less))
+		std::sort(missed.begin(), missed.end(), key_less);
+
+	// the index reads keys of its own length, which may be longer
+	size_t ref_length = ref->table->header.col_length[ref->column];
+	std::vector<char> padded;
+	if(length < ref_length)
+		padded.assign(missed.size() * ref_length, 0);
+	std::vector<const char*> sorted;
+	for(int i : missed)
+	{
+		if(padded.empty())
+		{
+			sorted.push_back(keys[i]);
+		} else {
+			char *key = padded.data() + sorted.size() * ref_length;
+			std::memcpy(key, keys[i], length);
+			sorted.push_back(key);
+		}
+	}
+
+	std::vector<char> found(sorted.size());
+	ref->table->find_keys(ref->column, sorted.data(), (int)sorted.size(), found.data());
+	for(size_t j = 0; j != missed.size(); ++j)
+	{
+		if(!found[j]) continue;
+		const char *key = keys[missed[j]];
+		size_t k = slot(key);
+		ok[missed[j]] = 1;
+		ref->used[k] = 1;
+		std::memcpy(ref->keys.data() + k * length, key, length);
+	}
 }
 
 bool table_manager::check_unique(const char *buf, int col)
 {
 	assert(indices[col]);
+	if(indices[col]->is_hash())
+	{
+		indices[col]->find(buf + header.col_offset[col], index_rids);
+		for(int rid : index_rids)
+			if(rid != *(int*)buf) return false;
+		return true;
+	}
+
+	if(!indices[col]->may_contain(buf + header.col_offset[col]))
+		return true;
+
 	auto it = indices[col]->get_iterator_lower_bound(buf + header.col_offset[col]);
 	if(it.is_end())
 		return true;
@@ -587,23 +1303,26 @@ bool table_manager::check_unique(const char *buf, int col)
 }
 
 bool table_manager::check_primary(const char *buf)
+{
+	int rid = find_primary_conflict(buf);
+	if(rid)
+	{
+		std::fprintf(stderr, "[Error] Primary key confliction with __rowid__ = %d\n", rid);
+		return false;
+	}
+
+	return true;
+}
+
+// the rid of the record with the same primary key, 0 if none
+int table_manager::find_primary_conflict(const char *buf)
 {
 	int first_primary = 0;
 	while(!(header.flag_primary & (1u << first_primary)))
 		++first_primary;
 
-	assert(indices[first_primary]);
-	auto it = indices[first_primary]->get_iterator_lower_bound(
-			buf + header.col_offset[first_primary]);
-
-	for(; !it.is_end(); it.next())
-	{
-		int rid;
-		record_manager rm = open_record_from_index_lower_bound(it.get(), &rid);
-		if(rid == *(int*)buf)
-			continue;
-
-		int first_not_conflicted = -1;
+	// the first primary column not equal to that of `rm`, -1 if none
+	auto first_not_conflicted = [&](record_manager &rm) {
 		for(int i = 0; i != header.col_num; ++i)
 		{
 			if(!(header.flag_primary & (1u << i)))
@@ -612,22 +1331,49 @@ bool table_manager::check_primary(const char *buf)
 			rm.read(tmp_index, header.col_length[i]);
 			auto comparer = get_index_comparer(header.col_type[i]);
 			if(comparer(tmp_index, buf + header.col_offset[i]) != 0)
-			{
-				first_not_conflicted = i;
-				break;
-			}
+				return i;
 		}
 
-		if(first_not_conflicted == -1)
+		return -1;
+	};
+
+	assert(indices[first_primary]);
+	if(indices[first_primary]->is_hash())
+	{
+		indices[first_primary]->find(buf + header.col_offset[first_primary], index_rids);
+		for(int rid : index_rids)
 		{
-			std::fprintf(stderr, "[Error] Primary key confliction with __rowid__ = %d\n", rid);
-			return false;
-		} else if(first_not_conflicted == first_primary) {
-			return true;
+			if(rid == *(int*)buf)
+				continue;
+			record_manager rm = get_record_ptr(rid);
+			if(first_not_conflicted(rm) == -1)
+				return rid;
 		}
+
+		return 0;
 	}
 
-	return true;
+	if(!indices[first_primary]->may_contain(buf + header.col_offset[first_primary]))
+		return 0;
+
+	auto it = indices[first_primary]->get_iterator_lower_bound(
+			buf + header.col_offset[first_primary]);
+
+	for(; !it.is_end(); it.next())
+	{
+		int rid;
+		record_manager rm = open_record_from_index_lower_bound(it.get(), &rid);
+		if(rid == *(int*)buf)
+			continue;
+
+		int col = first_not_conflicted(rm);
+		if(col == -1)
+			return rid;
+		else if(col == first_primary)
+			return 0;
+	}
+
+	return 0;
 }
 
 bool table_manager::check_notnull(const char *buf)
@@ -638,39 +1384,74 @@ bool table_manager::check_notnull(const char *buf)
 	return true;
 }
 
-bool table_manager::check_value_constraint(const expr_node_t *expr)
+bool table_manager::check_value_constraint(int check_id)
 {
+	uint64_t statement = dbms::get_instance()->get_statement_num();
+	if(check_statement != statement || check_exprs.empty())
+	{
+		check_exprs.clear();
+		for(int i = 0; i != header.check_constaint_num; ++i)
+			check_exprs.emplace_back(check_conds[i]);
+		check_statement = statement;
+	}
+
 	try {
-		return typecast::expr_to_bool(expression::eval(expr));
+		return typecast::expr_to_bool(check_exprs[check_id].eval());
 	} catch(const char *msg) {
 		std::puts(msg);
 		return false;
 	}
 }
 
-bool table_manager::value_exists(const char *column, const char *key)
+void table_manager::find_keys(int cid, const char *const *keys, int num, char *found)
 {
-	int cid = lookup_column(column);
-	if(cid < 0)
+	assert(indices[cid]);
+	if(indices[cid]->is_hash())
 	{
-		std::printf("[Error] No column named `%s` in `%s`\n",
-				column, header.table_name);
-		return false;
+		for(int i = 0; i != num; ++i)
+			found[i] = indices[cid]->contains(keys[i]);
+		return;
 	}
 
-	index_manager *idx = indices[cid];
-	if(!idx) 
+	auto comparer = get_index_comparer(header.col_type[cid]);
+	// [rid, nullmark, data], the keys not NULL come after the NULL entries,
+	// the leaf is pinned, the filter reads its own pages
+	page_pin leaf;
+	index_btree::leaf_page page { nullptr, pg.get() };
+	auto data = [&](int pos) { return page.get_key(pos) + sizeof(int) + 1; };
+
+	int pid = 0, pos = 0;
+	for(int i = 0; i != num; ++i)
 	{
-		std::printf("[Error] No index for column `%s` in table `%s`\n",
-				column, header.table_name);
-		return false;
-	}
+		// the leaf and the position in it are kept for the next key
+		if(!indices[cid]->may_contain(keys[i]))
+		{
+			found[i] = 0;
+			continue;
+		}
+
+		if(pid && comparer(data(page.size() - 1), keys[i]) >= 0)
+		{
+			// in the leaf of the key before, after it
+			int hi = page.size() - 1;
+			while(pos < hi)
+			{
+				int mid = (pos + hi) / 2;
+				if(comparer(data(mid), keys[i]) < 0)
+					pos = mid + 1;
+				else hi = mid;
+			}
+		} else {
+			auto ret = indices[cid]->lower_bound(keys[i]);
+			pid = ret.first;
+			pos = ret.second;
+			if(pid)
+			{
+				leaf = page_pin { pg.get(), pid };
+				page = index_btree::leaf_page { leaf.get(), pg.get() };
+			}
+		}
 
-	auto it = idx->get_iterator_lower_bound(key);
-	if(it.is_end()) return false;
-	record_manager rm = open_record_from_index_lower_bound(it.get());
-	auto comparer = get_index_comparer(get_column_type(cid));
-	rm.seek(header.col_offset[cid]);
-	rm.read(tmp_index, header.col_length[cid]);
-	return comparer(key, tmp_index) == 0;
+		found[i] = pid && comparer(data(pos), keys[i]) == 0;
+	}
 }
@@ -10,7 +10,9 @@
 #include "../btree/btree.h"
 #include "../btree/iterator.h"
 #include "../index/index.h"
+#include "../expression/expression.h"
 #include "table_header.h"
+#include "table_stats.h"
 #include "record.h"
 
 /*    Data page structure for rows
@@ -18,34 +20,70 @@
  */
 
 struct expr_node_t;
+class column_store;
 class table_manager
 {
 	bool is_open, is_mirror;
 	table_header_t header;
+	table_stats_t stats;
 	std::shared_ptr<int_btree> btr;
 	std::shared_ptr<pager> pg;
 	std::string tname;
 	index_manager *indices[MAX_COL_NUM];
+	// the columns of a columnar table, shared with the mirrors
+	column_store *columns;
 	expr_node_t *check_conds[MAX_CHECK_CONSTRAINT_NUM];
+	/* the CHECK constraints compiled in the statement `check_statement`,
+	 * since they are bound to the records cached in it */
+	std::vector<compiled_expression> check_exprs;
+	uint64_t check_statement;
 	const char *error_msg;
+	// the indices whose entries are added by end_bulk_insert()
+	uint32_t deferred_indices;
+
+	/* What a foreign key refers to, resolved once in a statement, and
+	 * the keys found there lately, kept while that table is unchanged. */
+	struct foreign_ref_t
+	{
+		uint64_t statement;
+		table_manager *table;
+		int column;
+		uint32_t version;
+		std::vector<char> keys;  // FOREIGN_KEY_CACHE_SLOTS of the key length
+		std::vector<char> used;
+
+		foreign_ref_t() : statement(0), table(nullptr), column(-1), version(0) {}
+	};
+
+	std::vector<foreign_ref_t> foreign_refs;
 
 	int tmp_record_size;
 	char *tmp_record;
 	char *tmp_cache, *tmp_index;
 	int *tmp_null_mark;
+	// the rids found in a hash index
+	std::vector<int> index_rids;
+	// the cached record, and the record manager it is read from
+	record_view_t cached;
+	record_manager *cached_rm;
+	static void load_cached_record(record_view_t *view);
 	void allocate_temp_record();
 	void load_indices();
 	void free_indices();
 	void load_check_constraints();
 	void free_check_constraints();
+	void load_meta();
+	void load_stats();
 public:
-	table_manager() : is_open(false), tmp_record(nullptr) { }
+	table_manager() : is_open(false), columns(nullptr), check_statement(0), deferred_indices(0), tmp_record(nullptr) { stats.magic = 0; }
 	~table_manager() { if(is_open) close(); }
 	bool create(const char *table_name, const table_header_t *header);
 	bool open(const char *table_name);
 	void drop();
 	void close();
 	std::shared_ptr<table_manager> mirror(const char *alias_name);
+	/* keep the header fields changed by the statement in the data file */
+	void save_meta();
 
 	int lookup_column(const char *col_name);
 	int get_column_offset(int col) { return header.col_offset[col]; }
@@ -53,43 +91,106 @@ public:
 	const char* get_column_name(int col) { return header.col_name[col]; }
 	uint8_t get_column_type(int col) { return header.col_type[col]; }
 	int get_column_num() { return header.col_num; }
+	int get_main_index() { return header.main_index; }
 	const char *get_table_name() { return header.table_name; }
-	void dump_table_info() { header.dump(); }
+	int get_record_num() { return header.records_num; }
+	void dump_table_info() { header.dump(get_stats()); }
+
+	/* collect the statistics of the columns, see table_stats_t */
+	void analyze();
+	/* Rebuild the data file with its trees loaded bottom up, pages
+	 * filled to `fill_factor` percent, so the file holds no free page. */
+	bool vacuum(int fill_factor);
+	/* returns nullptr if the table has not been analyzed */
+	const table_stats_t *get_stats() { return stats.magic == TABLE_STATS_MAGIC ? &stats : nullptr; }
 
 	void init_temp_record();
 	int insert_record();
+	/* insert `num` records laid out like the temp record one after
+	 * another, returns the number of rows inserted */
+	int insert_records(const char *records, int num);
+	/* While many rows are loaded into an empty table, the entries of its
+	 * indices not used to check the constraints (those of neither PRIMARY
+	 * KEY nor UNIQUE) are sorted and loaded bottom up at the end. The
+	 * other statements see the indices only after end_bulk_insert(). */
+	void begin_bulk_insert();
+	void end_bulk_insert(int fill_factor);
 	bool remove_record(int rid);
 	bool modify_record(int rid, int col, const void* data);
 	bool set_temp_record(int col, const void* data);
+	const char *get_temp_record() { return tmp_record; }
+	int get_temp_record_size() { return tmp_record_size; }
 
+	/* Cache the record for the expressions to read in place, `rm` must
+	 * stay open as long as the record is used. Of a record continued in
+	 * overflow pages only the part in the data page is copied, the rest
+	 * is read once a column in it is used. */
 	void cache_record(record_manager *rm);
+	// cache a whole record in place, it must stay valid as long as used
+	void cache_record(const char *record);
 	const char* get_cached_column(int cid);
 
-	void create_index(const char *col_name);
+	/* `bloom_bits` bits per key are taken by the bloom filter of the
+	 * index, 0 for none, see index_manager::create_filter. A hash index
+	 * (INDEX_TYPE_HASH) has no filter. */
+	void create_index(const char *col_name, int fill_factor = BTREE_BULK_FILL_FACTOR,
+		int bloom_bits = 0, int index_type = INDEX_TYPE_BTREE);
+	// a bloom filter for each index without one
+	void create_filters(int bloom_bits);
 	bool has_index(const char *col_name);
 	bool has_index(int cid);
+	// INDEX_TYPE_BTREE or INDEX_TYPE_HASH, of an indexed column
+	int get_index_type(int cid)
+	{
+		return (header.flag_hashed >> cid) & 1u ? INDEX_TYPE_HASH : INDEX_TYPE_BTREE;
+	}
 	index_manager *get_index(int cid);
 	record_manager open_record_from_index_lower_bound(std::pair<int, int> idx_pos, int *rid = nullptr);
-	bool value_exists(const char *column, const char *key);
+	/* Cache the column `cid` and the rowid from the entry of its index
+	 * at `idx_pos`, without reading the record, the other columns are
+	 * left undefined. Returns the rid. */
+	int cache_record_from_index(std::pair<int, int> idx_pos, int cid);
+	/* Whether each of the `num` keys, sorted in the order of the index
+	 * of column `cid`, is in the column. A key in the leaf where the key
+	 * before is found is searched in that leaf, without descending from
+	 * the root again. */
+	void find_keys(int cid, const char *const *keys, int num, char *found);
 
 	// get the record R such that R.rid = min_{r.rid >= rid} r.rid
 	record_manager get_record_ptr_lower_bound(int rid, bool dirty=false);
 	btree_iterator<int_btree::leaf_page> get_record_iterator_lower_bound(int rid);
+	// the page ids of the leaves holding the records, in order of rid
+	void get_record_leaves(std::vector<int> &pids) { btr->leaves(pids); }
+	/* The column store of a columnar table, built first if the rows have
+	 * changed since. Returns nullptr for a row table, or if it fails. */
+	column_store *get_column_store();
+	bool is_columnar() { return columns != nullptr; }
+	pager *get_pager() { return pg.get(); }
 	// get the record R such that R.rid = rid
 	record_manager get_record_ptr(int rid, bool dirty=false);
 
-	void dump_header(FILE *f);
-	void dump_record(FILE *f, int rid);
-	void dump_record(FILE *f, record_manager *rm);
+	/* append the names of the columns, as `table.column` */
+	void get_column_names(std::vector<std::string> &names);
+	/* append the values of the columns of `record`, the strings point
+	 * into it */
+	void get_record_values(const char *record, std::vector<expression> &vals);
 
 private:
 	bool check_constraints(const char *buf);
 	bool check_unique(const char *buf, int col);
 	bool check_primary(const char *buf);
+	int find_primary_conflict(const char *buf);
+	std::vector<int> group_records(const char *records, int num,
+		uint32_t cols, std::vector<int> &firsts);
+	foreign_ref_t *resolve_foreign(int key_id);
 	bool check_foreign(const char *buf, int key_id);
+	void check_foreign(int key_id, const std::vector<const char*> &keys, char *ok);
 	bool check_notnull(const char *buf);
-	bool check_value_constraint(const expr_node_t *expr);
+	// the CHECK constraint `check_id` on the cached record
+	bool check_value_constraint(int check_id);
 	void cache_record_from_tmp_cache();
+	// copy the cached record into tmp_cache if it is read in place
+	void materialize_cached_record();
 };
 
 #endif
@@ -1,15 +1,37 @@
 #include <cstring>
 #include <cstdio>
 #include <sstream>
+#include <strings.h>
 #include "table_header.h"
+#include "table_stats.h"
 #include "../utils/type_cast.h"
 #include "../expression/expression.h"
 #include "../parser/defs.h"
 
+// the index type of USING `method`, -1 if it is unknown
+int lookup_index_type(const char *method)
+{
+	if(method == nullptr || strcasecmp(method, "btree") == 0)
+		return INDEX_TYPE_BTREE;
+	if(strcasecmp(method, "hash") == 0)
+		return INDEX_TYPE_HASH;
+	std::fprintf(stderr, "[Error] Unknown index type `%s`.\n", method);
+	return -1;
+}
+
 bool fill_table_header(table_header_t *header, const table_def_t *table)
 {
 	std::memset(header, 0, sizeof(table_header_t));
 	std::strncpy(header->table_name, table->name, MAX_NAME_LEN);
+	if(table->engine == nullptr || strcasecmp(table->engine, "row") == 0) {
+		header->engine = TABLE_ENGINE_ROW;
+	} else if(strcasecmp(table->engine, "columnar") == 0) {
+		header->engine = TABLE_ENGINE_COLUMNAR;
+	} else {
+		std::fprintf(stderr, "[Error] Unknown table engine `%s`.\n", table->engine);
+		return false;
+	}
+
 	int offset = 8;  // 4 bytes for __rowid__, and 4 bytes for not null
 	for(field_item_t *field = table->fields; field; field = field->next)
 	{
@@ -82,20 +104,22 @@ bool fill_table_header(table_header_t *header, const table_def_t *table)
 	/* resolve constraint field */
 	for(linked_list_t *link_ptr = table->constraints; link_ptr; link_ptr = link_ptr->next)
 	{
-		int cid;
+		int cid, index_type;
 		table_constraint_t *constraint = (table_constraint_t*)link_ptr->data;
 		std::ostringstream os;
 		switch(constraint->type)
 		{
 			case TABLE_CONSTRAINT_UNIQUE:
-				cid = lookup_column(constraint->column_ref->column);
-				if(cid < 0) return false;
-				header->flag_unique |= 1 << cid;
-				break;
 			case TABLE_CONSTRAINT_PRIMARY_KEY:
 				cid = lookup_column(constraint->column_ref->column);
 				if(cid < 0) return false;
-				header->flag_primary |= 1 << cid;
+				index_type = lookup_index_type(constraint->index_method);
+				if(index_type < 0) return false;
+				if(index_type == INDEX_TYPE_HASH)
+					header->flag_hashed |= 1 << cid;
+				if(constraint->type == TABLE_CONSTRAINT_UNIQUE)
+					header->flag_unique |= 1 << cid;
+				else header->flag_primary |= 1 << cid;
 				break;
 			case TABLE_CONSTRAINT_FOREIGN_KEY:
 				cid = lookup_column(constraint->column_ref->column);
@@ -150,6 +174,16 @@ bool fill_table_header(table_header_t *header, const table_def_t *table)
 	header->flag_indexed |= 1u << first_primary;
 	header->auto_inc = 1;
 
+	// of a composite primary key only the first column has an index
+	for(int i = 0; i != header->col_num; ++i)
+	{
+		if((header->flag_hashed & ~header->flag_indexed) & (1u << i))
+		{
+			std::fprintf(stderr, "[Error] Column `%s` has no index to hash.\n", header->col_name[i]);
+			return false;
+		}
+	}
+
 	header->primary_key_num = 0;
 	for(int i = 0; i != header->col_num; ++i)
 		if(header->flag_primary & (1u << i))
@@ -158,12 +192,14 @@ bool fill_table_header(table_header_t *header, const table_def_t *table)
 	return true;
 }
 
-void table_header_t::dump()
+void table_header_t::dump(const table_stats_t *stats)
 {
 	std::printf("======== Table Info Begin ========\n");
 	std::printf("Table name  = %s\n", table_name);
 	std::printf("Column size = %d\n", col_num);
 	std::printf("Record size = %d\n", records_num);
+	if(engine == TABLE_ENGINE_COLUMNAR)
+		std::printf("Engine      = columnar\n");
 	for(int i = 0; i != col_num; ++i)
 	{
 		std::printf("  [column] name = %s, type = ", col_name[i]);
@@ -195,6 +231,20 @@ void table_header_t::dump()
 			std::printf("UNIQUE ");
 		if(flag_indexed & (1 << i))
 			std::printf("INDEXED ");
+		if(bloom_root[i])
+			std::printf("BLOOM ");
+		if(flag_hashed & (1 << i))
+			std::printf("HASH ");
+		std::puts("");
+	}
+
+	for(int i = 0; stats && i != col_num; ++i)
+	{
+		const column_stats_t &col = stats->cols[i];
+		std::printf("  [stats] %s: distinct = %.0f, null = %.1f%%",
+			col_name[i], col.distinct, col.null_frac * 100);
+		if(col.bucket_num)
+			std::printf(", range = [%g, %g]", col.bound[0], col.bound[col.bucket_num]);
 		std::puts("");
 	}
 
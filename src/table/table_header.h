@@ -3,6 +3,8 @@
 #include "../defs.h"
 #include <stdint.h>
 
+struct table_stats_t;
+
 struct table_header_t
 {
 	// the number of columns (fixed and variant)
@@ -31,7 +33,30 @@ struct table_header_t
 	char col_name[MAX_COL_NUM][MAX_NAME_LEN];
 	char table_name[MAX_NAME_LEN];
 
-	void dump();
+	// TABLE_ENGINE_ROW or TABLE_ENGINE_COLUMNAR
+	uint8_t engine;
+	// bumped whenever a record is changed, see column_store
+	uint32_t data_version;
+	// first page of the bloom filter of index, 0 if none
+	int bloom_root[MAX_COL_NUM];
+	// the indices of INDEX_TYPE_HASH
+	uint32_t flag_hashed;
+
+	void dump(const table_stats_t *stats = nullptr);
+};
+
+/* The fields of the header changed along with the data, they are kept
+ * in the data file as well, so that they are recovered with the data. */
+struct table_meta_t
+{
+	uint32_t magic;
+	uint32_t flag_indexed;
+	int records_num;
+	int64_t auto_inc;
+	int index_root[MAX_COL_NUM];
+	uint32_t data_version;
+	int bloom_root[MAX_COL_NUM];
+	uint32_t flag_hashed;
 };
 
 
@@ -0,0 +1,121 @@
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include "table_stats.h"
+
+/* strings are hashed ignoring case, since `=` compares them so */
+static uint64_t hash_value(const char *data, int type)
+{
+	uint64_t h = 14695981039346656037ull;
+	if(type == COL_TYPE_VARCHAR)
+	{
+		for(const char *p = data; *p; ++p)
+			h = (h ^ (unsigned char)std::tolower((unsigned char)*p)) * 1099511628211ull;
+	} else {
+		for(int i = 0; i != 4; ++i)
+			h = (h ^ (unsigned char)data[i]) * 1099511628211ull;
+	}
+
+	// spread the bits, the estimate needs uniform hashes
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+double column_stats_t::eq_selectivity() const
+{
+	return (1 - null_frac) / std::max(1.0, distinct);
+}
+
+double column_stats_t::less_selectivity(double value) const
+{
+	if(bucket_num == 0)
+		return (1 - null_frac) / 3;
+	if(value <= bound[0])
+		return 0;
+	if(value > bound[bucket_num])
+		return 1 - null_frac;
+
+	// bound[i] <= value < bound[i + 1]
+	int i = std::upper_bound(bound, bound + bucket_num + 1, value) - bound - 1;
+	double frac = i;
+	if(i < bucket_num && bound[i + 1] > bound[i])
+		frac += (value - bound[i]) / (bound[i + 1] - bound[i]);
+	return (1 - null_frac) * frac / bucket_num;
+}
+
+double column_stats_t::range_selectivity(double lower, double upper) const
+{
+	if(lower > upper)
+		return 0;
+	double ret = less_selectivity(upper) - less_selectivity(lower);
+	return std::max(ret, eq_selectivity());
+}
+
+column_stats_builder::column_stats_builder(int type)
+	: type(type), rows(0), null_num(0), seed(0x9e3779b97f4a7c15ull)
+{
+}
+
+void column_stats_builder::add(const char *data)
+{
+	++rows;
+	if(data == nullptr)
+	{
+		++null_num;
+		return;
+	}
+
+	// keep the smallest hashes
+	uint64_t h = hash_value(data, type);
+	if(hashes.size() < STATS_DISTINCT_HASHES)
+	{
+		hashes.insert(h);
+	} else if(h < *hashes.rbegin() && hashes.insert(h).second) {
+		hashes.erase(std::prev(hashes.end()));
+	}
+
+	if(type == COL_TYPE_VARCHAR)
+		return;
+
+	double value = type == COL_TYPE_FLOAT ? *(const float*)data : *(const int*)data;
+	if(sample.size() < STATS_HISTOGRAM_SAMPLE)
+	{
+		sample.push_back(value);
+	} else {
+		// reservoir sampling
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		uint64_t pos = (seed >> 16) % (rows - null_num);
+		if(pos < STATS_HISTOGRAM_SAMPLE)
+			sample[pos] = value;
+	}
+}
+
+void column_stats_builder::build(column_stats_t &stats)
+{
+	std::memset(&stats, 0, sizeof(stats));
+	if(rows == 0) return;
+	stats.null_frac = (double)null_num / rows;
+	if(hashes.size() < STATS_DISTINCT_HASHES)
+	{
+		stats.distinct = hashes.size();
+	} else {
+		// the k-th smallest of n uniform hashes is about k / n of the range
+		double kth = (double)*hashes.rbegin() / 18446744073709551616.0;
+		stats.distinct = std::min<double>(rows - null_num, (STATS_DISTINCT_HASHES - 1) / kth);
+	}
+
+	if(sample.empty()) return;
+	std::sort(sample.begin(), sample.end());
+	int num = sample.size();
+	stats.bucket_num = std::min(STATS_HISTOGRAM_BUCKETS, num);
+	for(int i = 0; i <= stats.bucket_num; ++i)
+	{
+		int pos = (int)((int64_t)i * num / stats.bucket_num);
+		stats.bound[i] = sample[std::min(num - 1, pos)];
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef __TRIVIALDB_TABLE_STATS__
+#define __TRIVIALDB_TABLE_STATS__
+#include "../defs.h"
+#include <stdint.h>
+#include <set>
+#include <vector>
+
+// the selectivities assumed without the statistics
+#define STATS_DEFAULT_EQ_SELECTIVITY    0.1
+#define STATS_DEFAULT_NULL_SELECTIVITY  0.1
+#define STATS_DEFAULT_SELECTIVITY       (1.0 / 3)
+
+/* The statistics of a column collected by ANALYZE. The INT, FLOAT and
+ * DATE columns have an equi-depth histogram of their values as well. */
+struct column_stats_t
+{
+	double distinct, null_frac;
+	int bucket_num;
+	double bound[STATS_HISTOGRAM_BUCKETS + 1];
+
+	/* the fraction of the rows for which `column = value` is true with
+	 * a value of the column, and for which `column < value` is true */
+	double eq_selectivity() const;
+	double less_selectivity(double value) const;
+	/* for `lower <= column <= upper`, a bound may be infinite */
+	double range_selectivity(double lower, double upper) const;
+};
+
+struct table_stats_t
+{
+	uint32_t magic;
+	int records_num;   // when analyzed
+	column_stats_t cols[MAX_COL_NUM];
+};
+
+/* Collect the statistics of a column from all of its values, the
+ * distinct values are estimated from the smallest hashes of the values,
+ * and the histogram is built from a sample of them. */
+class column_stats_builder
+{
+	int type, rows, null_num;
+	uint64_t seed;
+	std::set<uint64_t> hashes;
+	std::vector<double> sample;
+
+public:
+	explicit column_stats_builder(int type);
+	/* `data` is nullptr if the value is NULL */
+	void add(const char *data);
+	void build(column_stats_t &stats);
+};
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef __TRIVIALDB_ARENA__
+#define __TRIVIALDB_ARENA__
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/* A bump allocator for memory of the same lifetime, e.g. that of a
+ * statement. The memory is freed all at once by reset(), which keeps a
+ * block as large as all that was taken, so the next time the same work
+ * is done without calling malloc. */
+class arena
+{
+	struct block_t
+	{
+		block_t *next;
+		size_t size;
+	};
+
+	enum { MIN_BLOCK_SIZE = 4096, MAX_KEPT_SIZE = 1 << 20 };
+
+	block_t *blocks;  // the one in use is the first
+	char *top, *end;
+	size_t total;     // the bytes of all the blocks
+
+	void *grow(size_t size, size_t align)
+	{
+		size_t want = size + align + sizeof(block_t);
+		size_t block_size = blocks ? blocks->size * 2 : (size_t)MIN_BLOCK_SIZE;
+		while(block_size < want)
+			block_size *= 2;
+		block_t *b = (block_t*)std::malloc(block_size);
+		if(!b) throw std::bad_alloc();
+		b->next = blocks;
+		b->size = block_size;
+		blocks  = b;
+		total  += block_size;
+		top = (char*)(b + 1);
+		end = (char*)b + block_size;
+		return allocate(size, align);
+	}
+
+	void free_blocks()
+	{
+		while(blocks)
+		{
+			block_t *b = blocks;
+			blocks = b->next;
+			std::free(b);
+		}
+
+		top = end = nullptr;
+		total = 0;
+	}
+
+public:
+	arena() : blocks(nullptr), top(nullptr), end(nullptr), total(0) {}
+	~arena() { free_blocks(); }
+	arena(const arena&) = delete;
+	arena &operator=(const arena&) = delete;
+
+	void *allocate(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		size_t pad = (align - (size_t)top % align) % align;
+		if(!top || size + pad > (size_t)(end - top))
+			return grow(size, align);
+		char *p = top + pad;
+		top = p + size;
+		return p;
+	}
+
+	void *allocate_zero(size_t size)
+	{
+		void *p = allocate(size);
+		std::memset(p, 0, size);
+		return p;
+	}
+
+	char *strndup(const char *str, size_t len)
+	{
+		char *p = (char*)allocate(len + 1, 1);
+		std::memcpy(p, str, len);
+		p[len] = 0;
+		return p;
+	}
+
+	char *strdup(const char *str) { return strndup(str, std::strlen(str)); }
+
+	/* Free all that was taken, keeping one block of the size of all,
+	 * unless it is more than MAX_KEPT_SIZE. */
+	void reset()
+	{
+		if(total > MAX_KEPT_SIZE)
+		{
+			free_blocks();
+		} else if(blocks && blocks->next) {
+			size_t size = total;
+			free_blocks();
+			blocks = (block_t*)std::malloc(size);
+			if(!blocks) return;
+			blocks->next = nullptr;
+			blocks->size = size;
+			total = size;
+		}
+
+		if(blocks)
+		{
+			top = (char*)(blocks + 1);
+			end = (char*)blocks + blocks->size;
+		}
+	}
+
+	/* give the memory to `other`, which is emptied first */
+	void move_to(arena &other)
+	{
+		other.free_blocks();
+		other.blocks = blocks;
+		other.top    = top;
+		other.end    = end;
+		other.total  = total;
+		blocks = nullptr;
+		top = end = nullptr;
+		total = 0;
+	}
+
+	size_t capacity() const { return total; }
+};
+
+/* An allocator of the containers from an arena, or from the heap if
+ * there is no arena. The memory taken from the arena is given back when
+ * it is reset. */
+template<typename T>
+struct arena_allocator
+{
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+	arena *mem;
+
+	arena_allocator(arena *mem = nullptr) : mem(mem) {}
+	template<typename U>
+	arena_allocator(const arena_allocator<U> &other) : mem(other.mem) {}
+
+	T *allocate(size_t n)
+	{
+		if(mem) return (T*)mem->allocate(n * sizeof(T), alignof(T));
+		return (T*)::operator new(n * sizeof(T));
+	}
+
+	void deallocate(T *p, size_t)
+	{
+		if(!mem) ::operator delete(p);
+	}
+
+	template<typename U>
+	struct rebind { typedef arena_allocator<U> other; };
+
+	template<typename U>
+	bool operator==(const arena_allocator<U> &other) const { return mem == other.mem; }
+	template<typename U>
+	bool operator!=(const arena_allocator<U> &other) const { return mem != other.mem; }
+};
+
+template<typename T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
+
+#endif
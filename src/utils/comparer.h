@@ -3,8 +3,8 @@
 
 #include <cctype>
 #include <cstring>
-#include <regex>
 #include <string>
+#include "like_matcher.h"
 
 template<typename T>
 inline int basic_type_comparer(T x, T y)
@@ -53,51 +53,7 @@ inline int strcasecmp(const char *s1, const char *s2)
 inline bool strlike(const char *s1, const char *s2)
 {
 	// See: https://docs.microsoft.com/en-us/sql/t-sql/language-elements/like-transact-sql?view=sql-server-2017
-	enum {
-		STATUS_A,
-		STATUS_SLASH,
-	} status = STATUS_A;
-	std::string pattern;
-
-	for(int i = 0; s2[i]; ++i)
-	{
-		switch(status)
-		{
-			case STATUS_A:
-				switch(s2[i])
-				{
-					case '\\':
-						status = STATUS_SLASH;
-						break;
-					case '%':
-						pattern += ".*";
-						break;
-					case '_':
-						pattern.push_back('.');
-						break;
-					default:
-						pattern.push_back(s2[i]);
-						break;
-				}
-				break;
-			case STATUS_SLASH:
-				switch(s2[i])
-				{
-					case '%':
-					case '_':
-						pattern.push_back(s2[i]);
-						break;
-					default:
-						pattern.push_back('\\');
-						pattern.push_back(s2[i]);
-						break;
-				}
-				status = STATUS_A;
-				break;
-		}
-	}
-
-	return std::regex_match(s1, std::regex(pattern));
+	return like_matcher(s2).match(s1);
 }
 
 #endif
@@ -0,0 +1,101 @@
+#ifndef __TRIVIALDB_EXEC_STATS__
+#define __TRIVIALDB_EXEC_STATS__
+
+#include <cstdint>
+#include <mutex>
+
+/* Counters of the work done, kept by each thread in its own copy, so
+ * counting costs an increment on the hot paths. The copy of a thread
+ * is added to the totals of the process by flush_thread_stats(), at the
+ * end of each statement, or of each round of a background thread. */
+struct exec_stats_t
+{
+	// the page cache
+	uint64_t cache_hits, cache_misses, cache_evictions;
+	uint64_t pages_read, pages_written;
+	// the B-trees, a descent goes from the root to a leaf
+	uint64_t btree_descents, btree_splits, btree_merges;
+	// the bloom filters of the indices, a negative saves a descent
+	uint64_t bloom_probes, bloom_negatives;
+	// of a compiled expression, or of a conjunct over a row of a batch
+	uint64_t expr_evals;
+	// by the scans and joins
+	uint64_t rows_examined, rows_emitted;
+	uint64_t statements;
+
+	void add(const exec_stats_t &other)
+	{
+		cache_hits      += other.cache_hits;
+		cache_misses    += other.cache_misses;
+		cache_evictions += other.cache_evictions;
+		pages_read      += other.pages_read;
+		pages_written   += other.pages_written;
+		btree_descents  += other.btree_descents;
+		btree_splits    += other.btree_splits;
+		btree_merges    += other.btree_merges;
+		bloom_probes    += other.bloom_probes;
+		bloom_negatives += other.bloom_negatives;
+		expr_evals      += other.expr_evals;
+		rows_examined   += other.rows_examined;
+		rows_emitted    += other.rows_emitted;
+		statements      += other.statements;
+	}
+
+	/* the counters since `before`, a copy taken earlier */
+	exec_stats_t since(const exec_stats_t &before) const
+	{
+		exec_stats_t d = *this;
+		d.cache_hits      -= before.cache_hits;
+		d.cache_misses    -= before.cache_misses;
+		d.cache_evictions -= before.cache_evictions;
+		d.pages_read      -= before.pages_read;
+		d.pages_written   -= before.pages_written;
+		d.btree_descents  -= before.btree_descents;
+		d.btree_splits    -= before.btree_splits;
+		d.btree_merges    -= before.btree_merges;
+		d.bloom_probes    -= before.bloom_probes;
+		d.bloom_negatives -= before.bloom_negatives;
+		d.expr_evals      -= before.expr_evals;
+		d.rows_examined   -= before.rows_examined;
+		d.rows_emitted    -= before.rows_emitted;
+		d.statements      -= before.statements;
+		return d;
+	}
+};
+
+inline exec_stats_t &thread_stats()
+{
+	static thread_local exec_stats_t stats;
+	return stats;
+}
+
+inline std::mutex &total_stats_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+inline exec_stats_t &total_stats_unlocked()
+{
+	static exec_stats_t stats;
+	return stats;
+}
+
+/* add the counters of the thread to the totals, and clear them */
+inline void flush_thread_stats()
+{
+	exec_stats_t &stats = thread_stats();
+	std::lock_guard<std::mutex> guard(total_stats_lock());
+	total_stats_unlocked().add(stats);
+	stats = exec_stats_t();
+}
+
+/* the totals of the process, those not flushed by the threads yet
+ * are not in them */
+inline exec_stats_t get_total_stats()
+{
+	std::lock_guard<std::mutex> guard(total_stats_lock());
+	return total_stats_unlocked();
+}
+
+#endif
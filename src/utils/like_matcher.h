@@ -0,0 +1,113 @@
+#ifndef __TRIVIALDB_LIKE_MATCHER__
+#define __TRIVIALDB_LIKE_MATCHER__
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* A LIKE pattern compiled once for all the strings it is matched with.
+ * `%` matches any string, `_` any one character, and `\` makes the next
+ * character literal. A pattern of one literal run, with or without `%`
+ * at its ends, is matched by strcmp, memcmp or strstr. Others are run
+ * by the greedy matcher, which goes back to the last `%` on a mismatch. */
+class like_matcher
+{
+	enum { ANY_ONE = -1, ANY_STRING = -2 };
+	enum { LIKE_EXACT, LIKE_PREFIX, LIKE_SUFFIX, LIKE_CONTAINS, LIKE_GENERAL } kind;
+
+	std::vector<int> tokens;  // a character, ANY_ONE or ANY_STRING
+	std::string literal;      // the literal run of the fast paths
+	std::string prefix;
+
+	bool match_general(const unsigned char *s) const
+	{
+		size_t n = tokens.size(), p = 0, i = 0;
+		size_t star = n, back = 0;
+		while(s[i])
+		{
+			if(p != n && (tokens[p] == ANY_ONE || tokens[p] == s[i])) {
+				++p, ++i;
+			} else if(p != n && tokens[p] == ANY_STRING) {
+				star = p++;
+				back = i;
+			} else if(star != n) {
+				// let the last `%` take one more character
+				p = star + 1;
+				i = ++back;
+			} else {
+				return false;
+			}
+		}
+
+		while(p != n && tokens[p] == ANY_STRING)
+			++p;
+		return p == n;
+	}
+
+public:
+	explicit like_matcher(const char *pattern)
+	{
+		bool escaped = false;
+		for(const char *c = pattern; *c; ++c)
+		{
+			if(escaped) {
+				tokens.push_back((unsigned char)*c);
+				escaped = false;
+			} else if(*c == '\\') {
+				escaped = true;
+			} else if(*c == '%') {
+				if(tokens.empty() || tokens.back() != ANY_STRING)
+					tokens.push_back(ANY_STRING);
+			} else if(*c == '_') {
+				tokens.push_back(ANY_ONE);
+			} else {
+				tokens.push_back((unsigned char)*c);
+			}
+		}
+
+		size_t first = 0, last = tokens.size();
+		for(; first != last && tokens[first] >= 0; ++first)
+			prefix.push_back((char)tokens[first]);
+
+		bool leading = !tokens.empty() && tokens.front() == ANY_STRING;
+		bool trailing = tokens.size() > leading && tokens.back() == ANY_STRING;
+		size_t begin = leading, end = tokens.size() - trailing;
+		bool plain = true;
+		for(size_t i = begin; i != end; ++i)
+		{
+			if(tokens[i] < 0) plain = false;
+			else literal.push_back((char)tokens[i]);
+		}
+
+		if(!plain) kind = LIKE_GENERAL;
+		else if(leading && trailing) kind = LIKE_CONTAINS;
+		else if(leading) kind = LIKE_SUFFIX;
+		else if(trailing) kind = LIKE_PREFIX;
+		else kind = LIKE_EXACT;
+	}
+
+	bool match(const char *s) const
+	{
+		switch(kind)
+		{
+			case LIKE_EXACT:
+				return std::strcmp(s, literal.c_str()) == 0;
+			case LIKE_PREFIX:
+				return std::strncmp(s, literal.data(), literal.size()) == 0;
+			case LIKE_SUFFIX: {
+				size_t len = std::strlen(s);
+				return len >= literal.size() && std::memcmp(
+					s + len - literal.size(), literal.data(), literal.size()) == 0; }
+			case LIKE_CONTAINS:
+				return std::strstr(s, literal.c_str()) != nullptr;
+			default:
+				return match_general((const unsigned char*)s);
+		}
+	}
+
+	/* the literal text before the first wildcard, the strings matched
+	 * all start with it */
+	const std::string &get_prefix() const { return prefix; }
+};
+
+#endif
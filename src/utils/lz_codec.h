@@ -0,0 +1,145 @@
+#ifndef __TRIVIALDB_LZ_CODEC__
+#define __TRIVIALDB_LZ_CODEC__
+
+#include <cstring>
+#include <stdint.h>
+
+/* A small LZ77 codec in the manner of LZ4, for blocks of up to 64 KB.
+ * The output is a list of sequences, each is a token byte (the number
+ * of literals in the high 4 bits, the match length minus 4 in the low
+ * ones, 15 meaning more in the following bytes, each 255 but the last),
+ * the literals, and a 2-byte offset back to the match. The last
+ * sequence has only literals. */
+namespace lz_codec
+{
+	enum { MIN_MATCH = 4, HASH_BITS = 12 };
+
+	inline uint32_t read32(const unsigned char *p)
+	{
+		uint32_t x;
+		std::memcpy(&x, p, sizeof(x));
+		return x;
+	}
+
+	inline unsigned char *put_length(unsigned char *op, unsigned char *end, int len)
+	{
+		for(; len >= 255; len -= 255)
+		{
+			if(op == end) return nullptr;
+			*op++ = 255;
+		}
+
+		if(op == end) return nullptr;
+		*op++ = (unsigned char)len;
+		return op;
+	}
+
+	inline unsigned char *put_sequence(unsigned char *op, unsigned char *end,
+		const unsigned char *lit, int lit_len, int offset, int match_len)
+	{
+		if(op == end) return nullptr;
+		int m = match_len ? match_len - MIN_MATCH : 0;
+		unsigned char *token = op++;
+		*token = (unsigned char)((lit_len < 15 ? lit_len : 15) << 4 | (m < 15 ? m : 15));
+		if(lit_len >= 15 && !(op = put_length(op, end, lit_len - 15)))
+			return nullptr;
+		if(end - op < lit_len) return nullptr;
+		std::memcpy(op, lit, lit_len);
+		op += lit_len;
+		if(!match_len) return op;
+
+		if(end - op < 2) return nullptr;
+		*op++ = (unsigned char)offset;
+		*op++ = (unsigned char)(offset >> 8);
+		if(m >= 15 && !(op = put_length(op, end, m - 15)))
+			return nullptr;
+		return op;
+	}
+
+	/* Returns the size compressed into `dst`, or 0 if it does not fit
+	 * in `capacity` bytes. */
+	inline int compress(const char *source, int size, char *dest, int capacity)
+	{
+		const unsigned char *src = (const unsigned char*)source;
+		unsigned char *op = (unsigned char*)dest, *end = op + capacity;
+		int table[1 << HASH_BITS];
+		std::memset(table, -1, sizeof(table));
+
+		int ip = 0, anchor = 0, misses = 0;
+		while(ip + MIN_MATCH <= size)
+		{
+			uint32_t seq = read32(src + ip);
+			uint32_t h = (seq * 2654435761u) >> (32 - HASH_BITS);
+			int ref = table[h];
+			table[h] = ip;
+			if(ref < 0 || ip - ref > 65535 || read32(src + ref) != seq)
+			{
+				// skip faster over the data that does not compress
+				ip += 1 + (misses++ >> 5);
+				continue;
+			}
+
+			int len = MIN_MATCH;
+			while(ip + len < size && src[ref + len] == src[ip + len])
+				++len;
+			op = put_sequence(op, end, src + anchor, ip - anchor, ip - ref, len);
+			if(!op) return 0;
+			ip += len;
+			anchor = ip;
+			misses = 0;
+		}
+
+		op = put_sequence(op, end, src + anchor, size - anchor, 0, 0);
+		return op ? int(op - (unsigned char*)dest) : 0;
+	}
+
+	inline bool get_length(const unsigned char *src, int size, int &ip, int &len)
+	{
+		unsigned char b;
+		do {
+			if(ip >= size) return false;
+			b = src[ip++];
+			len += b;
+		} while(b == 255);
+		return true;
+	}
+
+	/* Returns the size decompressed into `dst`, or -1 if the data is
+	 * broken or does not fit in `capacity` bytes. */
+	inline int decompress(const char *source, int size, char *dest, int capacity)
+	{
+		const unsigned char *src = (const unsigned char*)source;
+		unsigned char *dst = (unsigned char*)dest;
+		int ip = 0, op = 0;
+		while(ip < size)
+		{
+			int token = src[ip++];
+			int lit_len = token >> 4;
+			if(lit_len == 15 && !get_length(src, size, ip, lit_len))
+				return -1;
+			if(lit_len > size - ip || lit_len > capacity - op)
+				return -1;
+			std::memcpy(dst + op, src + ip, lit_len);
+			ip += lit_len;
+			op += lit_len;
+			if(ip == size) break;
+
+			if(size - ip < 2) return -1;
+			int offset = src[ip] | src[ip + 1] << 8;
+			ip += 2;
+			int match_len = token & 15;
+			if(match_len == 15 && !get_length(src, size, ip, match_len))
+				return -1;
+			match_len += MIN_MATCH;
+			if(offset == 0 || offset > op || match_len > capacity - op)
+				return -1;
+			// the match may overlap the bytes it produces
+			for(int i = 0; i != match_len; ++i, ++op)
+				dst[op] = dst[op - offset];
+		}
+
+		return op;
+	}
+}
+
+#endif
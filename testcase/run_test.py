@@ -14,7 +14,7 @@ for filename in list(os.listdir('.')):
         else:
             print('[Fail] %s, elapsed = %.2lfs' % (filename, time.time() - t_start))
             break
-        os.system('rm *.database *.thead *.tdata %s.out' % f0)
+        os.system('rm *.database *.thead *.tdata *.tstat *.tdata.cmap *.tcol *.wal %s.out' % f0)
     elif filename.endswith('.py') and filename != 'run_test.py':
         f0 = filename[:-3]
         os.system('python3 ' + filename)
@@ -25,4 +25,4 @@ for filename in list(os.listdir('.')):
         else:
             print('[Fail] %s, elapsed = %.2lfs' % (filename, time.time() - t_start))
             break
-        os.system('rm *.database *.thead *.tdata %s.sql %s.out ans/%s.ans' % (f0, f0, f0))
+        os.system('rm *.database *.thead *.tdata *.tstat *.tdata.cmap *.tcol *.wal %s.sql %s.out ans/%s.ans' % (f0, f0, f0))
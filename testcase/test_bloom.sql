@@ -0,0 +1,43 @@
+CREATE DATABASE db_bloom;
+USE db_bloom;
+SET index_bloom_bits = 32;
+CREATE TABLE Digit (V int PRIMARY KEY);
+INSERT INTO Digit VALUES (0), (1), (2), (3), (4), (5), (6), (7), (8), (9);
+
+SET OUTPUT = 'test_bloom.csv';
+SELECT A.V * 1000 + B.V * 100 + C.V * 10 + D.V, D.V FROM Digit AS A, Digit AS B, Digit AS C, Digit AS D;
+
+SET OUTPUT = 'test_bloom.out';
+CREATE TABLE Item (
+    ID int PRIMARY KEY,
+    Price float,
+    Name varchar(10),
+    UNIQUE (Name)
+);
+
+COPY Item (Price, ID) FROM 'test_bloom.csv';
+SELECT COUNT(*) FROM Item;
+INSERT INTO Item VALUES (9999, 1.0, NULL), (10000, 1.0, NULL);
+INSERT INTO Item VALUES (10001, -0.0, 'apple'), (10002, 0.0, 'Apple');
+INSERT INTO Item VALUES (10003, 2.0, 'apple');
+SELECT ID, Price, Name FROM Item WHERE ID > 9990;
+
+DELETE FROM Item WHERE ID > 10000;
+INSERT INTO Item VALUES (10001, 3.0, 'apple');
+SELECT ID, Price, Name FROM Item WHERE ID > 9990;
+
+CREATE TABLE Sale (
+    ItemID int,
+    Amount int,
+    FOREIGN KEY (ItemID) REFERENCES Item(ID)
+);
+
+INSERT INTO Sale VALUES (10001, 1), (10002, 2), (5, 3), (12345, 4);
+SELECT Sale.Amount, Item.Name FROM Sale, Item WHERE Sale.ItemID = Item.ID;
+SELECT COUNT(*) FROM Digit, Item WHERE Digit.V = Item.ID;
+
+VACUUM Item;
+INSERT INTO Item VALUES (7, 1.0, 'pear');
+INSERT INTO Item VALUES (20000, 1.0, 'pear');
+SELECT COUNT(*) FROM Item;
+SELECT COUNT(*) FROM Digit, Item WHERE Digit.V = Item.ID;
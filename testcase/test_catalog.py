@@ -0,0 +1,51 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+import os
+import random
+
+# more tables than are kept open, so that they are closed and opened again
+TABLE_NUM = 300
+
+create_stmt = '''
+CREATE DATABASE db_test_catalog;
+SET OUTPUT = 'test_catalog.out';
+USE db_test_catalog;
+'''
+
+random.seed(321)
+fout = open('test_catalog.sql', 'w')
+fans = open('ans/test_catalog.ans', 'w')
+
+fout.write(create_stmt)
+rows = []
+for i in range(TABLE_NUM):
+    A = [ random.randint(0, 99) for j in range(random.randint(1, 20)) ]
+    rows.append(A)
+    fout.write('CREATE TABLE T%d (ID int PRIMARY KEY, V int, CHECK (V >= 0));\n' % i)
+    fout.write('INSERT INTO T%d VALUES ' % i + ','.join([ '(%d, %d)' % (j, v) for j, v in enumerate(A) ]) + ';\n')
+
+fout.write('CREATE TABLE R (ID int, T int, FOREIGN KEY (T) REFERENCES T0(ID));\n')
+fout.write('INSERT INTO R VALUES (1, 0);\n')
+fout.write('INSERT INTO R VALUES (2, %d);\n' % len(rows[0]))
+
+for k in range(100):
+    i = random.randint(0, TABLE_NUM - 1)
+    fout.write('SELECT COUNT(*) FROM T%d WHERE V < 50;\n' % i)
+    fans.write('COUNT(*)\n%d\n' % len([ v for v in rows[i] if v < 50 ]))
+
+# T0 is closed by the queries above, the foreign key opens it again
+fout.write('INSERT INTO R VALUES (3, 0);\n')
+fout.write('SELECT COUNT(*) FROM R;\n')
+fans.write('COUNT(*)\n2\n')
+
+fout.write('DROP TABLE T7;\n')
+fout.write('CREATE TABLE T7 (ID int);\n')
+fout.write('SELECT COUNT(*) FROM T7;\n')
+fans.write('COUNT(*)\n0\n')
+
+fout.write('USE db_test_catalog;\n')
+fout.write('SELECT COUNT(*) FROM T1, T%d WHERE T1.V = T%d.V;\n' % (TABLE_NUM - 1, TABLE_NUM - 1))
+fans.write('COUNT(*)\n%d\n' % sum(rows[1].count(v) for v in rows[TABLE_NUM - 1]))
+
+fout.close()
+fans.close()
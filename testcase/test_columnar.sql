@@ -0,0 +1,12 @@
+CREATE DATABASE db_columnar;
+SET OUTPUT = 'test_columnar.out';
+USE db_columnar;
+CREATE TABLE Sales (SaleID int PRIMARY KEY, Qty int, Price float, Region varchar(10)) ENGINE = columnar;
+INSERT INTO Sales VALUES (1, 3, 2.5, 'north'), (2, 5, 1.5, 'south'), (3, NULL, 4.0, 'north'), (4, 7, NULL, NULL);
+SELECT COUNT(*), SUM(Qty), MAX(Price) FROM Sales;
+SELECT SUM(Qty), MIN(Price) FROM Sales WHERE Qty > 4;
+SELECT SaleID, Region FROM Sales WHERE Price >= 2.0;
+UPDATE Sales SET Qty = 10 WHERE SaleID = 3;
+SELECT COUNT(Qty), SUM(Qty) FROM Sales WHERE Qty >= 10;
+CREATE TABLE Broken (ID int) ENGINE = heap;
+EXIT;
@@ -0,0 +1,10 @@
+CREATE DATABASE db_compression;
+SET OUTPUT = 'test_compression.out';
+USE db_compression;
+SET page_compression = 1;
+CREATE TABLE Notes (NoteID int PRIMARY KEY, Body varchar(200));
+INSERT INTO Notes VALUES (1, 'aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa'), (2, 'abababababababababababab'), (3, NULL);
+SET page_compression = 0;
+VACUUM Notes;
+SELECT NoteID, Body FROM Notes WHERE NoteID > 1;
+EXIT;
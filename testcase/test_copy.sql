@@ -0,0 +1,65 @@
+CREATE DATABASE db_copy;
+USE db_copy;
+CREATE TABLE Source (
+    ID int PRIMARY KEY,
+    Score float,
+    Name varchar(20),
+    Born date
+);
+
+INSERT INTO Source VALUES
+	(1, 3.5, 'Smith John', '1990-01-02'),
+	(2, NULL, 'say "hi"', '1991-03-04'),
+	(3, -0.25, NULL, NULL),
+	(4, 100, 'plain', '2000-02-29'),
+	(5, 7, '', '1999-12-31');
+
+SET OUTPUT = 'test_copy.csv';
+SELECT * FROM Source;
+SET OUTPUT = 'test_copy.bin';
+SELECT * FROM Source;
+SET OUTPUT = 'test_copy.col';
+SELECT * FROM Source;
+SET OUTPUT = 'test_copy.csv.lz';
+SELECT * FROM Source;
+SET OUTPUT = 'test_copy_names.csv';
+SELECT ID, Name FROM Source;
+
+SET OUTPUT = 'test_copy.out';
+CREATE TABLE Target (
+    Born date,
+    Name varchar(20),
+    ID int PRIMARY KEY,
+    Score float
+);
+
+CREATE INDEX Target(Score);
+
+COPY Target FROM 'test_copy.csv';
+SELECT ID, Score, Name, Born FROM Target;
+SELECT ID FROM Target WHERE Score > 0.0;
+DELETE FROM Target;
+COPY Target FROM 'test_copy.bin';
+SELECT ID, Score, Name, Born FROM Target;
+DELETE FROM Target;
+COPY Target FROM 'test_copy.col';
+SELECT ID, Score, Name, Born FROM Target;
+DELETE FROM Target;
+COPY Target FROM 'test_copy.csv.lz';
+SELECT ID, Score, Name, Born FROM Target;
+
+COPY Target FROM 'test_copy.csv';
+SELECT COUNT(*) FROM Target;
+
+CREATE TABLE Named (
+    ID int PRIMARY KEY,
+    Name varchar(20) NOT NULL,
+    Level int DEFAULT 1,
+    CHECK (Level < 10)
+);
+
+COPY Named (ID, Name) FROM 'test_copy_names.csv';
+SELECT * FROM Named;
+COPY Named (Name) FROM 'test_copy_names.csv';
+COPY Named FROM 'test_copy_missing.csv';
+SELECT COUNT(*) FROM Named;
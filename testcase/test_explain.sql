@@ -0,0 +1,46 @@
+CREATE DATABASE db_explain;
+SET OUTPUT = 'test_explain.out';
+USE db_explain;
+CREATE TABLE Items (
+    ItemID int PRIMARY KEY,
+    Price int,
+    Name varchar(20)
+);
+
+CREATE TABLE Orders (
+    OrderID int PRIMARY KEY,
+    ItemID int,
+    Qty int
+);
+
+INSERT INTO Items VALUES
+	(1, 30, 'pen'),
+	(2, 10, 'ink'),
+	(3, 20, 'book'),
+	(4, NULL, 'bag'),
+	(5, 10, 'cup'),
+	(6, 20, 'map');
+
+INSERT INTO Orders VALUES
+	(1, 1, 3),
+	(2, 2, 1),
+	(3, 2, 5),
+	(4, 6, 2);
+
+CREATE INDEX Items(Price);
+
+EXPLAIN SELECT ItemID, Name FROM Items WHERE Price = 10;
+EXPLAIN SELECT * FROM Items WHERE Name LIKE 'b%' ORDER BY Name LIMIT 2;
+EXPLAIN SELECT * FROM Items WHERE Price > 10 ORDER BY Price DESC;
+EXPLAIN SELECT Items.Name, Orders.Qty FROM Items, Orders
+	WHERE Items.ItemID = Orders.ItemID AND Orders.Qty > 1;
+EXPLAIN SELECT COUNT(*), SUM(Qty) FROM Orders WHERE Qty >= 2;
+EXPLAIN SELECT Price, COUNT(*) FROM Items GROUP BY Price ORDER BY Price;
+
+ANALYZE Items;
+ANALYZE Orders;
+EXPLAIN SELECT Items.Name, Orders.Qty FROM Items, Orders
+	WHERE Items.ItemID = Orders.ItemID AND Items.Price IS NOT NULL;
+
+SELECT Items.Name, Orders.Qty FROM Items, Orders
+	WHERE Items.ItemID = Orders.ItemID AND Orders.Qty > 1;
@@ -0,0 +1,34 @@
+CREATE DATABASE db_fold;
+USE db_fold;
+SET OUTPUT = 'test_fold.out';
+CREATE TABLE Events (
+    ID int,
+	Day date,
+	Score float,
+	Tag varchar(12),
+	CHECK (Day > '2000-01-01'),
+	CHECK (ID IN (1, 2, 3, 5, 8, 13, 21) OR ID > 100 - 50 * 2 + 100)
+);
+
+INSERT INTO Events VALUES
+	(1, '2016-03-01', 1.5, 'a'),
+	(2, '2016-03-02', 2.5, 'b'),
+	(3, '2017-01-01', 3.5, '2016-03-01'),
+	(5, '2018-05-05', NULL, 'c'),
+	(8, '2019-09-09', 8.5, NULL),
+	(13, '2020-02-02', 13.5, 'd'),
+	(4, '2016-03-03', 4.5, 'e'),
+	(101, '2016-03-03', 4.5, 'e'),
+	(102, '1999-12-31', 4.5, 'f');
+
+SELECT ID, Day FROM Events WHERE Day IN ('2016-03-01', '2021-01-01', '2018-05-05', '2016-02-30');
+SELECT ID FROM Events WHERE Tag IN ('2016-03-01', '2017-01-01');
+SELECT ID FROM Events WHERE Tag IN ('e', 'b', 'zz');
+SELECT ID FROM Events WHERE Score IN (13.5, 2.5, 4.5);
+SELECT ID FROM Events WHERE ID IN (101, 2, 13, 7);
+SELECT ID FROM Events WHERE Score * 2.0 > 10.0 * 2.0 - 3.5 * 4.0 + 1.0;
+SELECT ID FROM Events WHERE ID > 2 AND 1 = 1 AND 2 < 3;
+SELECT ID FROM Events WHERE Day IN (1, 2);
+SELECT ID FROM Events WHERE 1 IN (1, 2, 3) AND ID < 3;
+
+EXIT;
@@ -0,0 +1,20 @@
+CREATE DATABASE db_group;
+SET OUTPUT = 'test_group.out';
+USE db_group;
+CREATE TABLE Persons (
+    PersonID int PRIMARY KEY,
+    LastName varchar(20),
+    FirstName varchar(20),
+    Address varchar(20),
+    City varchar(10)
+);
+INSERT INTO Persons (LastName, PersonID) VALUES 
+	('Zarisk', 10),
+	('1999-10-10', 30),
+	('Wasserstein', 20);
+INSERT INTO Persons VALUES 
+	(40, 'Yi', 'Wang', 'Tsinghua Univ.', 'Beijing'),
+	(50, 'Zhong', 'Lei', 'Beijing Univ.', 'Beijing');
+SELECT City, COUNT(*), MIN(PersonID), MAX(PersonID) FROM Persons GROUP BY City;
+SELECT COUNT(*), COUNT(City), AVG(PersonID) FROM Persons;
+EXIT;
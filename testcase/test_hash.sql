@@ -0,0 +1,57 @@
+CREATE DATABASE db_hash;
+USE db_hash;
+CREATE TABLE Digit (V int PRIMARY KEY);
+INSERT INTO Digit VALUES (0), (1), (2), (3), (4), (5), (6), (7), (8), (9);
+
+SET OUTPUT = 'test_hash.csv';
+SELECT A.V * 1000 + B.V * 100 + C.V * 10 + D.V, D.V FROM Digit AS A, Digit AS B, Digit AS C, Digit AS D;
+
+SET OUTPUT = 'test_hash.out';
+CREATE TABLE Item (
+    ID int,
+    Price int,
+    Name varchar(10),
+    PRIMARY KEY (ID) USING HASH,
+    UNIQUE (Name) USING hash
+);
+
+CREATE TABLE Bad (ID int, PRIMARY KEY (ID) USING BITMAP);
+
+COPY Item (Price, ID) FROM 'test_hash.csv';
+SELECT COUNT(*) FROM Item;
+CREATE INDEX Item(Price) USING HASH;
+SELECT COUNT(*) FROM Item WHERE Price = 3;
+SELECT COUNT(*) FROM Item WHERE Price >= 8;
+
+INSERT INTO Item VALUES (42, 1, NULL);
+INSERT INTO Item VALUES (10001, 1, 'apple'), (10002, 2, 'Apple');
+INSERT INTO Item VALUES (10003, 2, 'apple');
+SELECT ID, Price, Name FROM Item WHERE ID = 10002;
+SELECT ID, Price, Name FROM Item WHERE Name = 'apple';
+
+DELETE FROM Item WHERE Price = 7;
+DELETE FROM Item WHERE ID > 10000;
+INSERT INTO Item VALUES (10001, 3, 'apple');
+SELECT COUNT(*) FROM Item;
+SELECT ID, Price, Name FROM Item WHERE ID = 10001;
+SELECT COUNT(*) FROM Item WHERE Price = 7;
+UPDATE Item SET Price = 7 WHERE Price = 5;
+SELECT COUNT(*) FROM Item WHERE Price = 7;
+
+CREATE TABLE Sale (
+    ItemID int,
+    Amount int,
+    FOREIGN KEY (ItemID) REFERENCES Item(ID)
+);
+
+INSERT INTO Sale VALUES (10001, 1), (5, 2), (12345, 3);
+INSERT INTO Sale VALUES (17, 4);
+SELECT Sale.Amount, Item.Name FROM Sale, Item WHERE Sale.ItemID = Item.ID;
+SELECT COUNT(*) FROM Digit, Item WHERE Digit.V = Item.ID;
+
+VACUUM Item;
+INSERT INTO Item VALUES (9, 1, 'pear');
+INSERT INTO Item VALUES (20000, 1, 'pear');
+SELECT COUNT(*) FROM Item;
+SELECT ID, Price, Name FROM Item WHERE Name = 'pear';
+SELECT COUNT(*) FROM Item WHERE Price = 7;
@@ -0,0 +1,40 @@
+CREATE DATABASE db_index;
+SET OUTPUT = 'test_index.out';
+USE db_index;
+CREATE TABLE Items (
+    ItemID int,
+    Price int,
+    Name varchar(20)
+);
+
+INSERT INTO Items VALUES
+	(1, 30, 'pen'),
+	(2, 10, 'ink'),
+	(3, 20, 'book'),
+	(4, NULL, 'bag'),
+	(5, 10, 'cup'),
+	(6, 20, 'map');
+
+CREATE INDEX Items(Price);
+CREATE INDEX Items(Name);
+
+SELECT ItemID, Name FROM Items WHERE Price = 10;
+SELECT ItemID, Name FROM Items WHERE Price = 20;
+SELECT ItemID FROM Items WHERE Name = 'bag';
+
+INSERT INTO Items VALUES (7, 10, 'box');
+DELETE FROM Items WHERE ItemID = 2;
+UPDATE Items SET Price = 20 WHERE Name = 'pen';
+
+SELECT ItemID, Name FROM Items WHERE Price = 10;
+SELECT ItemID, Name FROM Items WHERE Price = 20;
+SELECT ItemID FROM Items WHERE Name = 'box';
+
+SELECT ItemID, Price FROM Items WHERE Price > 10;
+SELECT ItemID, Price FROM Items WHERE Price >= 10 AND Price < 20;
+SELECT ItemID, Price FROM Items WHERE 20 >= Price AND Price > 10 AND ItemID <> 3;
+SELECT ItemID, Name FROM Items WHERE Price = 10 AND Name = 'cup';
+DELETE FROM Items WHERE Price <= 10 AND ItemID > 5;
+SELECT ItemID, Price FROM Items WHERE Price < 100;
+
+EXIT;
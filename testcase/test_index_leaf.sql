@@ -0,0 +1,22 @@
+CREATE DATABASE db_index_leaf;
+SET OUTPUT = 'test_index_leaf.out';
+USE db_index_leaf;
+CREATE TABLE Persons (
+    PersonID int PRIMARY KEY,
+    LastName varchar(20),
+    FirstName varchar(20),
+    Address varchar(20),
+    City varchar(10)
+);
+CREATE INDEX Persons(FirstName);
+INSERT INTO Persons (LastName, PersonID) VALUES 
+	('Zarisk', 10),
+	('1999-10-10', 30),
+	('Wasserstein', 20);
+INSERT INTO Persons VALUES 
+	(40, 'Yi', 'Wang', 'Tsinghua Univ.', 'Beijing'),
+	(50, 'Zhong', 'Lei', 'Beijing Univ.', 'Beijing');
+SELECT PersonID, FirstName FROM Persons WHERE FirstName = 'Wang';
+DELETE FROM Persons WHERE FirstName = 'Lei';
+SELECT PersonID, FirstName FROM Persons WHERE FirstName LIKE '%';
+EXIT;
@@ -0,0 +1,20 @@
+CREATE DATABASE db_like;
+SET OUTPUT = 'test_like.out';
+USE db_like;
+CREATE TABLE Persons (
+    PersonID int PRIMARY KEY,
+    LastName varchar(20),
+    FirstName varchar(20),
+    Address varchar(20),
+    City varchar(10)
+);
+INSERT INTO Persons (LastName, PersonID) VALUES 
+	('Zarisk', 10),
+	('1999-10-10', 30),
+	('Wasserstein', 20);
+INSERT INTO Persons VALUES 
+	(40, 'Yi', 'Wang', 'Tsinghua Univ.', 'Beijing'),
+	(50, 'Zhong', 'Lei', 'Beijing Univ.', 'Beijing');
+SELECT PersonID, LastName FROM Persons WHERE LastName LIKE 'Z%';
+SELECT PersonID, City FROM Persons WHERE City LIKE '%i_g';
+EXIT;
@@ -0,0 +1,21 @@
+CREATE DATABASE db_order;
+SET OUTPUT = 'test_order.out';
+USE db_order;
+CREATE TABLE Persons (
+    PersonID int PRIMARY KEY,
+    LastName varchar(20),
+    FirstName varchar(20),
+    Address varchar(20),
+    City varchar(10)
+);
+INSERT INTO Persons (LastName, PersonID) VALUES 
+	('Zarisk', 10),
+	('1999-10-10', 30),
+	('Wasserstein', 20);
+INSERT INTO Persons VALUES 
+	(40, 'Yi', 'Wang', 'Tsinghua Univ.', 'Beijing'),
+	(50, 'Zhong', 'Lei', 'Beijing Univ.', 'Beijing');
+SELECT PersonID, LastName FROM Persons ORDER BY PersonID DESC LIMIT 2;
+SELECT PersonID, LastName FROM Persons ORDER BY LastName LIMIT 1, 3;
+SELECT City, COUNT(*) FROM Persons GROUP BY City ORDER BY City DESC;
+EXIT;
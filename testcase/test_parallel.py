@@ -0,0 +1,61 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+import random
+import struct
+
+# The tables span many morsels, so that the aggregates are folded by
+# several threads, and the results are the same as of a single thread.
+ROW_NUM = 40000
+
+create_stmt = '''
+CREATE DATABASE db_test_parallel;
+SET OUTPUT = 'test_parallel.out';
+USE db_test_parallel;
+CREATE TABLE Heap (ID int PRIMARY KEY, V int, W int, S varchar(20));
+CREATE TABLE Col (ID int PRIMARY KEY, V int, W int, S varchar(20)) ENGINE = columnar;
+'''
+
+def gen_item(i):
+    w = random.randint(-1000, 1000) if random.randint(0, 9) else None
+    return (i, random.randint(0, 1000), w, '%d' % random.randint(0, 10 ** 12))
+
+def value(x):
+    return 'NULL' if x is None else '%d' % x
+
+random.seed(2024)
+fout = open('test_parallel.sql', 'w')
+fans = open('ans/test_parallel.ans', 'w')
+
+fout.write(create_stmt)
+A = [ gen_item(i) for i in range(ROW_NUM) ]
+for table in ('Heap', 'Col'):
+    for i in range(0, ROW_NUM, 10000):
+        fout.write('INSERT INTO %s VALUES ' % table + ','.join([ "(%d, %d, %s, '%s')" % (x[0], x[1], value(x[2]), x[3])
+            for x in A[i:i + 10000] ]) + ';\n')
+
+# an average is kept in a float
+def average(values):
+    if not values:
+        return 'NULL'
+    return '%f' % struct.unpack('f', struct.pack('f', sum(values) / len(values)))[0]
+
+def answer(rows):
+    V = [ x[1] for x in rows ]
+    W = [ x[2] for x in rows if x[2] is not None ]
+    fans.write('MAX(W),MIN(W),COUNT(W),SUM(V),COUNT(*)\n%s,%s,%d,%d,%d\n\n' % (
+        value(max(W) if W else None), value(min(W) if W else None), len(W), sum(V), len(rows)))
+    fans.write('AVG(W),AVG(V)\n%s,%s\n\n' % (average(W), average(V)))
+
+for threads in (1, 4):
+    fout.write('SET scan_threads = %d;\n' % threads)
+    for table in ('Heap', 'Col'):
+        fout.write('SELECT COUNT(*), SUM(V), COUNT(W), MIN(W), MAX(W) FROM %s;\n' % table)
+        fout.write('SELECT AVG(V), AVG(W) FROM %s;\n' % table)
+        answer(A)
+        fout.write('SELECT COUNT(*), SUM(V), COUNT(W), MIN(W), MAX(W) FROM %s WHERE V < 300 AND W > 0;\n' % table)
+        fout.write('SELECT AVG(V), AVG(W) FROM %s WHERE V < 300 AND W > 0;\n' % table)
+        answer([ x for x in A if x[1] < 300 and x[2] is not None and x[2] > 0 ])
+
+fout.write('EXIT;\n')
+fout.close()
+fans.close()
@@ -0,0 +1,24 @@
+CREATE DATABASE db_prepare;
+SET OUTPUT = 'test_prepare.out';
+USE db_prepare;
+CREATE TABLE Persons (
+    PersonID int PRIMARY KEY,
+    LastName varchar(20),
+    FirstName varchar(20),
+    Address varchar(20),
+    City varchar(10)
+);
+INSERT INTO Persons (LastName, PersonID) VALUES 
+	('Zarisk', 10),
+	('1999-10-10', 30),
+	('Wasserstein', 20);
+INSERT INTO Persons VALUES 
+	(40, 'Yi', 'Wang', 'Tsinghua Univ.', 'Beijing'),
+	(50, 'Zhong', 'Lei', 'Beijing Univ.', 'Beijing');
+PREPARE person AS SELECT PersonID, LastName FROM Persons WHERE PersonID = ?;
+EXECUTE person USING 40;
+EXECUTE person USING 50;
+PREPARE city AS SELECT COUNT(*) FROM Persons WHERE City = ? AND PersonID > ?;
+EXECUTE city USING 'Beijing', 0;
+DEALLOCATE person;
+EXIT;
@@ -0,0 +1,111 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+import hashlib
+import os
+import random
+import signal
+import subprocess
+import time
+
+# The database is opened read-only, and the statements writing to it are
+# rejected. A result not as expected is written into the answer, so the
+# test fails, then the test checks the tables in the usual mode.
+DB = '../build/trivial_db'
+RO_OUT = 'test_readonly.ro'
+MARK = 'test_readonly.mark'
+notes = []
+
+def check(ok, what):
+    if not ok:
+        notes.append('# ' + what)
+
+def run(args, sql):
+    p = subprocess.Popen([ DB ] + args, stdin=subprocess.PIPE,
+        stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    out, err = p.communicate(sql.encode())
+    return p.returncode, out.decode(), err.decode()
+
+def files():
+    names = [ f for f in os.listdir('.') if f.split('.')[0] in ('db_test_readonly', 'T', 'U') ]
+    return { f : hashlib.sha1(open(f, 'rb').read()).hexdigest() for f in names }
+
+random.seed(99)
+A = [ (i, random.randint(0, 1000)) for i in range(2000) ]
+os.system('rm -f *.database *.thead *.tdata *.wal')
+run([], '''CREATE DATABASE db_test_readonly;
+USE db_test_readonly;
+CREATE TABLE T (ID int PRIMARY KEY, V int);
+CREATE TABLE U (ID int);
+INSERT INTO T VALUES %s;
+CREATE INDEX T(V);
+EXIT;
+''' % ','.join([ '(%d, %d)' % x for x in A ]))
+
+writes = [
+    'INSERT INTO T VALUES (5000, 1);',
+    'UPDATE T SET V = 0 WHERE ID < 10;',
+    'DELETE FROM T WHERE ID < 10;',
+    'CREATE TABLE X (A int);',
+    'CREATE INDEX U(ID);',
+    'DROP TABLE U;',
+    'ANALYZE T;',
+    'VACUUM T;',
+    'CREATE DATABASE db_test_readonly_x;',
+    'DROP DATABASE db_test_readonly;',
+]
+
+before = files()
+rc, out, err = run([ '--read-only' ], '\n'.join([
+    'USE db_test_readonly;',
+    "SET OUTPUT = '%s';" % RO_OUT,
+    'SELECT COUNT(*) FROM T WHERE V < 500;',
+    ] + writes + [
+    'SELECT SUM(V) FROM T;',
+    'SELECT V FROM T WHERE ID = 7;',
+    'EXIT;' ]))
+check(rc == 0, 'exited with %d' % rc)
+check(err.count('[Error] The databases are opened read-only.') == len(writes),
+    'writes not rejected: %r' % err)
+check(files() == before, 'files changed in read-only mode')
+ro_out = open(RO_OUT).read() if os.path.exists(RO_OUT) else ''
+expected = 'COUNT(*)\n%d\n\nSUM(V)\n%d\n\nV\n%d\n\n' % (
+    len([ v for _, v in A if v < 500 ]), sum([ v for _, v in A ]), A[7][1])
+check(ro_out == expected, 'read-only results: %r' % ro_out)
+if os.path.exists(RO_OUT):
+    os.remove(RO_OUT)
+
+# a table with a log left by a crash is not opened read-only, since it
+# would be recovered by writing to the file. The console reads the
+# statements piped in line by line, so the file is created once the
+# INSERT is done, while stdin is still open.
+p = subprocess.Popen([ DB ], stdin=subprocess.PIPE,
+    stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+p.stdin.write(("USE db_test_readonly;\nINSERT INTO U VALUES (1);\nSET OUTPUT = '%s';\n" % MARK).encode())
+p.stdin.flush()
+deadline = time.time() + 60
+while time.time() < deadline and p.poll() is None and not os.path.exists(MARK):
+    time.sleep(0.01)
+p.send_signal(signal.SIGKILL)
+p.wait()
+check(os.path.exists(MARK), 'the INSERT before the crash was not run')
+if os.path.exists(MARK):
+    os.remove(MARK)
+
+before = files()
+rc, out, err = run([ '--read-only' ], 'USE db_test_readonly;\nSELECT COUNT(*) FROM U;\nEXIT;\n')
+check('has a log to recover' in err, 'opened with a log to recover: %r' % err)
+check(files() == before, 'recovered in read-only mode')
+
+fout = open('test_readonly.sql', 'w')
+fans = open('ans/test_readonly.ans', 'w')
+fout.write("USE db_test_readonly;\nSET OUTPUT = 'test_readonly.out';\n")
+for note in notes:
+    fans.write(note + '\n')
+
+fout.write('SELECT COUNT(*) FROM T;\n')
+fans.write('COUNT(*)\n%d\n' % len(A))
+fout.write('SELECT COUNT(*) FROM U;\n')
+fans.write('COUNT(*)\n1\n')
+fout.write('EXIT;\n')
+fout.close()
+fans.close()
@@ -0,0 +1,124 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+import os
+import random
+import signal
+import subprocess
+import time
+
+# The process is killed in the middle of a statement twice, and the
+# database is recovered from the logs when it is opened again.
+ROW_NUM = 60000
+COMMITTED_UPDATES = 14
+DB = '../build/trivial_db'
+DATA = 'Big.tdata'
+LOG = 'Big.tdata.wal'
+MARK = 'test_recovery.mark'
+
+create_stmt = '''
+CREATE DATABASE db_test_recovery;
+USE db_test_recovery;
+CREATE TABLE Big (ID int PRIMARY KEY, V int, S varchar(20));
+CREATE TABLE Small (ID int, V int);
+EXIT;
+'''
+
+random.seed(77)
+V = [ random.randint(0, 1000) for i in range(ROW_NUM) ]
+S = [ '%d' % random.randint(0, 10 ** 18) for i in range(ROW_NUM) ]
+notes = []
+
+def file_size(filename):
+    return os.path.getsize(filename) if os.path.exists(filename) else 0
+
+def insert_stmt(first, last):
+    return 'INSERT INTO Big VALUES ' + ','.join([ "(%d, %d, '%d')" % (i, i % 1000, i)
+        for i in range(first, last) ]) + ';'
+
+def wait_for(p, cond, timeout=300):
+    deadline = time.time() + timeout
+    while time.time() < deadline and p.poll() is None and not cond():
+        time.sleep(0.01)
+
+# Run `stmts`, then kill the process once `stmt` has run long enough for
+# `grown` to be true. The cache is small, so that the pages modified by
+# `stmt` are written to the file before it commits. `watch` is called
+# while `stmts` run.
+def crash(stmts, stmt, grown, watch=lambda: None):
+    p = subprocess.Popen([ DB, '--buffer-pool=1M' ], stdin=subprocess.PIPE,
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    # the file is created once the statements before are done, the
+    # console reads the statements piped in line by line
+    stmts = [ 'USE db_test_recovery;' ] + stmts + [ "SET OUTPUT = '%s';" % MARK ]
+    p.stdin.write(('\n'.join(stmts) + '\n').encode())
+    p.stdin.flush()
+    wait_for(p, lambda: watch() or os.path.exists(MARK))
+
+    base = (file_size(DATA), file_size(LOG))
+    p.stdin.write((stmt + '\n').encode())
+    p.stdin.flush()
+    wait_for(p, lambda: grown(*base))
+    running = p.poll() is None
+    p.send_signal(signal.SIGKILL)
+    p.wait()
+    if not os.path.exists(MARK):
+        notes.append('# the statements before `%s` were not run' % stmt[:30])
+    else:
+        os.remove(MARK)
+    if not running:
+        notes.append('# the process exited before `%s` was killed' % stmt[:30])
+
+os.system('rm -f *.database *.thead *.tdata *.wal')
+p = subprocess.Popen([ DB ], stdin=subprocess.PIPE,
+    stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+p.communicate(create_stmt.encode())
+
+stmts = []
+for i in range(0, ROW_NUM, 10000):
+    stmts.append('INSERT INTO Big VALUES ' + ','.join([ "(%d, %d, '%s')" % (j, V[j], S[j])
+        for j in range(i, min(i + 10000, ROW_NUM)) ]) + ';')
+stmts.append('INSERT INTO Small VALUES (1, 1), (2, 2);')
+# more than PAGE_WAL_CHECKPOINT_SIZE is logged, so the log is truncated
+stmts += [ 'UPDATE Big SET V = V + 1;' ] * COMMITTED_UPDATES
+stmts.append('DELETE FROM Small WHERE ID = 1;')
+
+# the log only shrinks when it is truncated
+log_sizes = []
+crash(stmts, 'UPDATE Big SET V = V + 1000;',
+    lambda data, log: file_size(LOG) >= log + (100 << 12),
+    lambda: log_sizes.append(file_size(LOG)))
+if all(a <= b for a, b in zip(log_sizes, log_sizes[1:])):
+    notes.append('# the log was not truncated after a checkpoint')
+
+# the pages appended are not logged before they are modified, they are
+# left out of the file by the header of the last commit
+crash([ 'INSERT INTO Small VALUES (3, 3);' ], insert_stmt(ROW_NUM, ROW_NUM * 2),
+    lambda data, log: file_size(DATA) >= data + (100 << 12))
+
+fout = open('test_recovery.sql', 'w')
+fans = open('ans/test_recovery.ans', 'w')
+fout.write('USE db_test_recovery;\n')
+fout.write("SET OUTPUT = 'test_recovery.out';\n")
+for note in notes:
+    fans.write(note + '\n')
+
+fout.write('SELECT COUNT(*) FROM Big;\n')
+fans.write('COUNT(*)\n%d\n' % ROW_NUM)
+fout.write('SELECT SUM(V) FROM Big;\n')
+fans.write('SUM(V)\n%d\n' % (sum(V) + ROW_NUM * COMMITTED_UPDATES))
+fout.write('SELECT COUNT(*) FROM Big WHERE ID >= %d;\n' % ROW_NUM)
+fans.write('COUNT(*)\n0\n')
+for k in random.sample(range(ROW_NUM), 5):
+    fout.write('SELECT V, S FROM Big WHERE ID = %d;\n' % k)
+    fans.write('S,V\n%s,%d\n' % (S[k], V[k] + COMMITTED_UPDATES))
+fout.write('SELECT ID, V FROM Small;\n')
+fans.write('V,ID\n2,2\n3,3\n')
+
+# the rows which were not inserted can be inserted again
+fout.write(insert_stmt(ROW_NUM, ROW_NUM + 1000) + '\n')
+fout.write('SELECT COUNT(*) FROM Big WHERE ID >= %d;\n' % ROW_NUM)
+fans.write('COUNT(*)\n1000\n')
+
+fout.write('EXIT;\n')
+fout.close()
+fans.close()
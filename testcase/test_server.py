@@ -0,0 +1,145 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+import os
+import signal
+import socket
+import struct
+import subprocess
+import threading
+import time
+
+# Clients talk to a server, and the tables they wrote are checked by the
+# test when it opens the database after the server has exited. A reply
+# not as expected is written into the answer, so the test fails.
+DB = '../build/trivial_db'
+CLIENT_NUM = 4
+INSERT_NUM = 50
+notes = []
+
+def check(ok, what):
+    if not ok:
+        notes.append('# ' + what)
+
+class client:
+    def __init__(self, port):
+        self.sock = socket.create_connection(('127.0.0.1', port), timeout=60)
+        self.buf = b''
+
+    def read(self, n):
+        while len(self.buf) < n:
+            data = self.sock.recv(65536)
+            if not data:
+                raise EOFError
+            self.buf += data
+        ret, self.buf = self.buf[:n], self.buf[n:]
+        return ret
+
+    @staticmethod
+    def frame(sql):
+        data = sql.encode()
+        return b'Q' + struct.pack('!I', len(data)) + data
+
+    def send(self, sql):
+        self.sock.sendall(client.frame(sql))
+
+    # (stdout, stderr, status) of the next request
+    def recv(self):
+        out = { b'O': b'', b'E': b'' }
+        while True:
+            t, n = struct.unpack('!cI', self.read(5))
+            payload = self.read(n)
+            if t == b'D':
+                return out[b'O'].decode(), out[b'E'].decode(), payload[0]
+            out[t] += payload
+
+    def query(self, sql):
+        self.send(sql)
+        return self.recv()
+
+    def closed(self):
+        try:
+            return self.sock.recv(1) == b''
+        except OSError:
+            return True
+
+os.system('rm -f *.database *.thead *.tdata')
+s = socket.socket()
+s.bind(('127.0.0.1', 0))
+port = s.getsockname()[1]
+s.close()
+server = subprocess.Popen([ DB, '--listen=127.0.0.1:%d' % port ],
+    stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+for i in range(500):
+    try:
+        a = client(port)
+        break
+    except OSError:
+        time.sleep(0.01)
+
+o, e, st = a.query('CREATE DATABASE db_test_server; USE db_test_server;'
+    'CREATE TABLE T (K int, I int); CREATE TABLE U (ID int);')
+check(st == 0 and '[Error]' not in e, 'CREATE failed: %r' % e)
+
+# a frame sent a byte at a time, and two frames sent at once
+for b in client.frame('INSERT INTO U VALUES (1);'):
+    a.sock.sendall(bytes([ b ]))
+    time.sleep(0.001)
+check(a.recv()[2] == 0, 'a frame sent in pieces is not run')
+a.sock.sendall(client.frame('INSERT INTO U VALUES (2);') + client.frame('SELECT COUNT(*) FROM U;'))
+check(a.recv()[2] == 0, 'the first of two frames sent at once is not run')
+check('COUNT(*)\n2\n' in a.recv()[0], 'the second of two frames sent at once is not run')
+
+# the errors are sent apart from the output
+o, e, st = a.query('SELECT * FROM Nothing;')
+check(st == 0 and '[Error]' in e and '[Error]' not in o, 'error of SELECT: %r %r %d' % (o, e, st))
+check(a.query('SELECT FROM;')[2] == 1, 'no syntax error')
+
+# the requests of a client are run in order, each sees the one before
+def insert_in_order(k):
+    c = client(port)
+    c.query('USE db_test_server;')
+    for i in range(INSERT_NUM):
+        c.send('INSERT INTO T VALUES (%d, %d);' % (k, i))
+        c.send('SELECT MAX(I) FROM T WHERE K = %d;' % k)
+    for i in range(INSERT_NUM):
+        c.recv()
+        check('MAX(I)\n%d\n' % i in c.recv()[0], 'client %d: request %d out of order' % (k, i))
+    o, e, st = c.query('EXIT;')
+    check(st == 2 and c.closed(), 'client %d: not closed by EXIT' % k)
+
+threads = [ threading.Thread(target=insert_in_order, args=(k,)) for k in range(CLIENT_NUM) ]
+for t in threads: t.start()
+for t in threads: t.join()
+
+# the statements after EXIT are not run
+o, e, st = a.query('EXIT; INSERT INTO U VALUES (3);')
+check(st == 2 and a.closed(), 'not closed by EXIT')
+
+# a client hanging up in the middle of a frame leaves the others served
+b = client(port)
+b.sock.sendall(client.frame('USE db_test_server; INSERT INTO U VALUES (4);')[:20])
+b.sock.close()
+c = client(port)
+o, e, st = c.query('USE db_test_server; INSERT INTO U VALUES (5);')
+check(st == 0, 'not served after a client hung up')
+c.sock.close()
+
+time.sleep(0.1)
+server.send_signal(signal.SIGTERM)
+check(server.wait(60) == 0, 'the server did not exit normally')
+
+fout = open('test_server.sql', 'w')
+fans = open('ans/test_server.ans', 'w')
+fout.write("USE db_test_server;\nSET OUTPUT = 'test_server.out';\n")
+for note in notes:
+    fans.write(note + '\n')
+
+fout.write('SELECT COUNT(*) FROM U;\n')
+fans.write('COUNT(*)\n3\n')
+fout.write('SELECT COUNT(*) FROM U WHERE ID = 3 OR ID = 4;\n')
+fans.write('COUNT(*)\n0\n')
+fout.write('SELECT COUNT(*), SUM(I) FROM T;\n')
+fans.write('SUM(I),COUNT(*)\n%d,%d\n' % (CLIENT_NUM * INSERT_NUM * (INSERT_NUM - 1) // 2, CLIENT_NUM * INSERT_NUM))
+fout.write('EXIT;\n')
+fout.close()
+fans.close()
@@ -0,0 +1,17 @@
+CREATE DATABASE db_snapshot;
+SET OUTPUT = 'test_snapshot.out';
+USE db_snapshot;
+CREATE TABLE Persons (
+    PersonID int PRIMARY KEY,
+    LastName varchar(20)
+);
+INSERT INTO Persons VALUES (10, 'Zarisk'), (30, '1999-10-10'), (20, 'Wasserstein'), (40, 'Yi'), (5, 'Zhong');
+CREATE TABLE Sales (SaleID int PRIMARY KEY, Qty int, Price float, Region varchar(10)) ENGINE = columnar;
+INSERT INTO Sales VALUES (1, 3, 2.5, 'north'), (2, 5, 1.5, 'south'), (3, 10, 4.0, 'north'), (4, 7, NULL, NULL);
+
+UPDATE Sales SET Qty = Qty + 100 WHERE Qty > 4;
+SELECT SaleID, Qty FROM Sales;
+UPDATE Persons SET PersonID = PersonID + 1000 WHERE PersonID >= 10;
+SELECT COUNT(*), MIN(PersonID), MAX(PersonID) FROM Persons WHERE PersonID > 1000;
+SELECT PersonID, LastName FROM Persons;
+EXIT;